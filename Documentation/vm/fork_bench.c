@@ -0,0 +1,148 @@
+/*
+ * fork_bench: time fork() of a process with a large anonymous resident
+ * set, with vm.fork_share_pte off and on, and the cost the child and the
+ * parent then pay on their first write to each 2MB of it.
+ *
+ * The resident set sizes are in GB, 10 50 100 by default: each is
+ * allocated and touched, then forked a few times in both modes.  Run as
+ * root, on a machine with the memory for the largest size.
+ *
+ * No results have been taken with it yet: before/after fork latencies
+ * for the pte sharing patches are still to be measured.
+ *
+ * Usage: fork_bench [size_gb ...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#define SYSCTL		"/proc/sys/vm/fork_share_pte"
+#define PMD_SIZE	(2UL << 20)
+#define ITERS		5
+
+static int pipefd[2];
+
+static void fatal(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void set_share(int on)
+{
+	FILE *f = fopen(SYSCTL, "w");
+
+	if (!f)
+		fatal(SYSCTL);
+	fprintf(f, "%d\n", on);
+	if (fclose(f))
+		fatal(SYSCTL);
+}
+
+/* One write in each 2MB, the first fault there copies a shared table */
+static double touch_pmds(char *buf, size_t len)
+{
+	double start = now();
+	size_t off;
+
+	for (off = 0; off < len; off += PMD_SIZE)
+		buf[off]++;
+	return now() - start;
+}
+
+/*
+ * Fork, time the child's writes which it reports through the pipe, then
+ * the parent's own: returns the fork latency.
+ */
+static double bench_fork(char *buf, size_t len, double *child_touch,
+			 double *parent_touch)
+{
+	double start, forked;
+	pid_t pid;
+
+	start = now();
+	pid = fork();
+	if (pid < 0)
+		fatal("fork");
+	if (pid == 0) {
+		double t = touch_pmds(buf, len);
+
+		if (write(pipefd[1], &t, sizeof(t)) != sizeof(t))
+			_exit(1);
+		_exit(0);
+	}
+	forked = now() - start;
+
+	if (read(pipefd[0], child_touch, sizeof(*child_touch)) !=
+	    sizeof(*child_touch))
+		fatal("read");
+	*parent_touch = touch_pmds(buf, len);
+	if (waitpid(pid, NULL, 0) < 0)
+		fatal("waitpid");
+	return forked;
+}
+
+static void run(unsigned long gb)
+{
+	size_t len = gb << 30;
+	char *buf;
+	int share, i;
+
+	buf = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		fatal("mmap");
+	memset(buf, 0x5a, len);
+
+	for (share = 0; share <= 1; share++) {
+		double best = 1e9, child = 0, parent = 0;
+
+		set_share(share);
+		for (i = 0; i < ITERS; i++) {
+			double c, p, t;
+
+			t = bench_fork(buf, len, &c, &p);
+			if (t < best)
+				best = t;
+			child += c;
+			parent += p;
+		}
+		printf("%4lu GB  fork_share_pte=%d  fork %9.2f ms"
+		       "  child writes %9.2f ms  parent writes %9.2f ms\n",
+		       gb, share, best * 1e3, child * 1e3 / ITERS,
+		       parent * 1e3 / ITERS);
+	}
+	munmap(buf, len);
+}
+
+int main(int argc, char *argv[])
+{
+	static const unsigned long sizes[] = { 10, 50, 100 };
+	int i;
+
+	if (pipe(pipefd))
+		fatal("pipe");
+
+	if (argc > 1) {
+		for (i = 1; i < argc; i++)
+			run(strtoul(argv[i], NULL, 0));
+	} else {
+		for (i = 0; i < 3; i++)
+			run(sizes[i]);
+	}
+	set_share(0);
+	return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * pagefault_bench: page fault and mmap scalability of a multithreaded
+ * process, which all goes through its mmap_sem.
+ *
+ * Each thread repeatedly maps a private anonymous region, faults in
+ * every page of it and unmaps it: the faults take mmap_sem for reading,
+ * mmap() and munmap() for writing.  For 1, 2, 4 ... up to the number of
+ * online cpus threads, prints the page faults per second of the whole
+ * process and its context switches per thread.
+ *
+ * With debugfs mounted and CONFIG_SCHED_DEBUG, each run is done with
+ * the OWNER_SPIN scheduler feature on and off, which turns optimistic
+ * spinning on mutex and rwsem owners on and off.
+ *
+ * No results have been taken with it yet: before/after numbers for
+ * rwsem writer spinning are still to be measured.
+ *
+ * Usage: pagefault_bench [seconds [region_kb]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define FEATURES	"/sys/kernel/debug/sched_features"
+
+static volatile int stop;
+static size_t region;
+static long page_size;
+
+static void fatal(const char *msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* Returns 0 if the scheduler features can't be set */
+static int set_owner_spin(int on)
+{
+	FILE *f = fopen(FEATURES, "w");
+
+	if (!f)
+		return 0;
+	fprintf(f, "%sOWNER_SPIN\n", on ? "" : "NO_");
+	return fclose(f) == 0;
+}
+
+static void *worker(void *arg)
+{
+	unsigned long *faults = arg;
+	size_t off;
+	char *buf;
+
+	while (!stop) {
+		buf = mmap(NULL, region, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED)
+			fatal("mmap");
+		for (off = 0; off < region; off += page_size)
+			buf[off] = 1;
+		*faults += region / page_size;
+		if (munmap(buf, region))
+			fatal("munmap");
+	}
+	return NULL;
+}
+
+static void run(int nthreads, int seconds, const char *tag)
+{
+	unsigned long faults[nthreads];
+	pthread_t threads[nthreads];
+	struct rusage start_ru, end_ru;
+	unsigned long total = 0;
+	double start, elapsed;
+	long csw;
+	int i;
+
+	memset(faults, 0, sizeof(faults));
+	stop = 0;
+	getrusage(RUSAGE_SELF, &start_ru);
+	start = now();
+	for (i = 0; i < nthreads; i++)
+		if (pthread_create(&threads[i], NULL, worker, &faults[i]))
+			fatal("pthread_create");
+	sleep(seconds);
+	stop = 1;
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	elapsed = now() - start;
+	getrusage(RUSAGE_SELF, &end_ru);
+
+	for (i = 0; i < nthreads; i++)
+		total += faults[i];
+	csw = (end_ru.ru_nvcsw - start_ru.ru_nvcsw) +
+	      (end_ru.ru_nivcsw - start_ru.ru_nivcsw);
+	printf("%4d threads %-14s %12.0f faults/s %10ld csw/thread\n",
+	       nthreads, tag, total / elapsed, csw / nthreads);
+}
+
+int main(int argc, char *argv[])
+{
+	int seconds = 5, ncpus, n, spin;
+
+	if (argc > 1)
+		seconds = atoi(argv[1]);
+	region = (argc > 2 ? strtoul(argv[2], NULL, 0) : 1024) << 10;
+	page_size = sysconf(_SC_PAGESIZE);
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	for (n = 1; ; n *= 2) {
+		if (n > ncpus)
+			n = ncpus;
+		if (!set_owner_spin(1)) {
+			run(n, seconds, "");
+		} else {
+			for (spin = 1; spin >= 0; spin--) {
+				set_owner_spin(spin);
+				run(n, seconds,
+				    spin ? "OWNER_SPIN" : "NO_OWNER_SPIN");
+			}
+			set_owner_spin(1);
+		}
+		if (n == ncpus)
+			break;
+	}
+	return 0;
+}
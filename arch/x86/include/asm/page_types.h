@@ -26,6 +26,11 @@
 
 #define HUGE_MAX_HSTATE 2
 
+#ifdef CONFIG_HAVE_ARCH_HUGE_VMAP
+/* Align big ioremap() areas so that they can be mapped with large pages */
+#define IOREMAP_MAX_ORDER	PMD_SHIFT
+#endif
+
 #define PAGE_OFFSET		((unsigned long)__PAGE_OFFSET)
 
 #define VM_DATA_DEFAULT_FLAGS \
@@ -143,6 +143,21 @@ static inline int pmd_large(pmd_t pte)
 		(_PAGE_PSE | _PAGE_PRESENT);
 }
 
+static inline int pmd_write(pmd_t pmd)
+{
+	return pmd_flags(pmd) & _PAGE_RW;
+}
+
+static inline pmd_t pmd_wrprotect(pmd_t pmd)
+{
+	return __pmd(pmd_val(pmd) & ~_PAGE_RW);
+}
+
+static inline pmd_t pmd_mkwrite(pmd_t pmd)
+{
+	return __pmd(pmd_val(pmd) | _PAGE_RW);
+}
+
 static inline pte_t pte_set_flags(pte_t pte, pteval_t set)
 {
 	pteval_t v = native_pte_val(pte);
@@ -389,9 +404,11 @@ static inline pte_t *pte_offset_kernel(pmd_t *pmd, unsigned long address)
 	return (pte_t *)pmd_page_vaddr(*pmd) + pte_index(address);
 }
 
+/* A pte table may be mapped read-only, when fork shares it */
 static inline int pmd_bad(pmd_t pmd)
 {
-	return (pmd_flags(pmd) & ~_PAGE_USER) != _KERNPG_TABLE;
+	return (pmd_flags(pmd) & ~(_PAGE_USER | _PAGE_RW)) !=
+		(_KERNPG_TABLE & ~_PAGE_RW);
 }
 
 static inline unsigned long pages_to_mb(unsigned long npg)
@@ -576,6 +593,46 @@ extern int ptep_test_and_clear_young(struct vm_area_struct *vma,
 extern int ptep_clear_flush_young(struct vm_area_struct *vma,
 				  unsigned long address, pte_t *ptep);
 
+#ifdef CONFIG_SHMEM_HUGEPAGE
+/*
+ * Page cache mapped into user space with a single large pmd.  The pmd
+ * carries the same flags as a pte would, plus _PAGE_PSE.
+ */
+static inline int pmd_trans_huge(pmd_t pmd)
+{
+	return pmd_large(pmd);
+}
+
+#define mk_huge_pmd(page, pgprot)					\
+	__pmd(pmd_val(pfn_pmd(page_to_pfn(page), (pgprot))) | _PAGE_PSE)
+
+static inline pmd_t pmd_mkyoung(pmd_t pmd)
+{
+	return __pmd(pmd_val(pmd) | _PAGE_ACCESSED);
+}
+
+static inline pmd_t pmd_mkdirty(pmd_t pmd)
+{
+	return __pmd(pmd_val(pmd) | _PAGE_DIRTY);
+}
+
+/* The pte that would map the small page at @addr inside a large pmd */
+static inline pte_t huge_pmd_pte(pmd_t pmd, unsigned long addr)
+{
+	return __pte((pmd_val(pmd) & ~_PAGE_PSE) +
+		     (addr & ~PMD_MASK & PAGE_MASK));
+}
+
+static inline pmd_t pmdp_get_and_clear(struct mm_struct *mm,
+				       unsigned long addr, pmd_t *pmdp)
+{
+	return native_make_pmd(xchg(&pmdp->pmd, 0));
+}
+
+extern int pmdp_clear_flush_young(struct vm_area_struct *vma,
+				  unsigned long address, pmd_t *pmdp);
+#endif
+
 #define __HAVE_ARCH_PTEP_GET_AND_CLEAR
 static inline pte_t ptep_get_and_clear(struct mm_struct *mm, unsigned long addr,
 				       pte_t *ptep)
@@ -14,7 +14,9 @@
  * on the local processor, one does not.
  *
  * These are fair FIFO ticket locks, which are currently limited to 256
- * CPUs.
+ * CPUs, or, with CONFIG_QUEUED_SPINLOCKS, queued spinlocks, which are
+ * just as fair but have every waiter spin on a cache line of its own
+ * (see asm-generic/qspinlock.h).
  *
  * (the type definitions are in asm/spinlock_types.h)
  */
@@ -172,7 +174,78 @@ static inline int __ticket_spin_is_contended(raw_spinlock_t *lock)
 	return (((tmp >> TICKET_SHIFT) - tmp) & ((1 << TICKET_SHIFT) - 1)) > 1;
 }
 
-#ifndef CONFIG_PARAVIRT_SPINLOCKS
+#ifdef CONFIG_QUEUED_SPINLOCKS
+
+/*
+ * Only the owner writes the locked byte, so a byte store releases the
+ * lock without disturbing the pending bit and the queue tail.  Stores
+ * are not reordered with older loads and stores on x86, so a compiler
+ * barrier is enough, except with the PPro errata above.
+ */
+static __always_inline void queued_spin_unlock(raw_spinlock_t *lock)
+{
+#if defined(CONFIG_X86_32) && \
+	(defined(CONFIG_X86_OOSTORE) || defined(CONFIG_X86_PPRO_FENCE))
+	asm volatile(LOCK_PREFIX "andb $0, %0"
+		     : "+m" (*(u8 *)&lock->slock)
+		     :
+		     : "memory", "cc");
+#else
+	barrier();
+	ACCESS_ONCE(*(u8 *)&lock->slock) = 0;
+#endif
+}
+#define queued_spin_unlock queued_spin_unlock
+
+/*
+ * The lock fast path is a single cmpxchg; keep it inline.
+ */
+static __always_inline u32 queued_spin_cmpxchg(raw_spinlock_t *lock,
+					       u32 old, u32 new)
+{
+	asm volatile(LOCK_PREFIX "cmpxchgl %2, %1"
+		     : "+a" (old), "+m" (lock->slock)
+		     : "r" (new)
+		     : "memory", "cc");
+	return old;
+}
+#define queued_spin_cmpxchg queued_spin_cmpxchg
+
+#include <asm-generic/qspinlock.h>
+
+static inline int __raw_spin_is_locked(raw_spinlock_t *lock)
+{
+	return queued_spin_is_locked(lock);
+}
+
+static inline int __raw_spin_is_contended(raw_spinlock_t *lock)
+{
+	return queued_spin_is_contended(lock);
+}
+#define __raw_spin_is_contended	__raw_spin_is_contended
+
+static __always_inline void __raw_spin_lock(raw_spinlock_t *lock)
+{
+	queued_spin_lock(lock);
+}
+
+static __always_inline int __raw_spin_trylock(raw_spinlock_t *lock)
+{
+	return queued_spin_trylock(lock);
+}
+
+static __always_inline void __raw_spin_unlock(raw_spinlock_t *lock)
+{
+	queued_spin_unlock(lock);
+}
+
+static __always_inline void __raw_spin_lock_flags(raw_spinlock_t *lock,
+						  unsigned long flags)
+{
+	__raw_spin_lock(lock);
+}
+
+#elif !defined(CONFIG_PARAVIRT_SPINLOCKS)
 
 static inline int __raw_spin_is_locked(raw_spinlock_t *lock)
 {
@@ -206,7 +279,7 @@ static __always_inline void __raw_spin_lock_flags(raw_spinlock_t *lock,
 	__raw_spin_lock(lock);
 }
 
-#endif	/* CONFIG_PARAVIRT_SPINLOCKS */
+#endif	/* CONFIG_QUEUED_SPINLOCKS */
 
 static inline void __raw_spin_unlock_wait(raw_spinlock_t *lock)
 {
@@ -342,6 +342,11 @@
 #define __NR_pwritev		334
 #define __NR_rt_tgsigqueueinfo	335
 #define __NR_perf_counter_open	336
+#define __NR_process_vm_readv	337
+#define __NR_process_vm_writev	338
+#define __NR_sched_setattr	339
+#define __NR_sched_getattr	340
+#define __NR_sched_yield_to	341
 
 #ifdef __KERNEL__
 
@@ -125,6 +125,16 @@ static noinline int gup_huge_pmd(pmd_t pmd, unsigned long addr,
 	refs = 0;
 	head = pte_page(pte);
 	page = head + ((addr & ~PMD_MASK) >> PAGE_SHIFT);
+	if (!PageCompound(head)) {
+		/* shmem extent: a run of independent small pages */
+		do {
+			get_page(page);
+			pages[*nr] = page;
+			(*nr)++;
+			page++;
+		} while (addr += PAGE_SIZE, addr != end);
+		return 1;
+	}
 	do {
 		VM_BUG_ON(compound_head(page) != head);
 		pages[*nr] = page;
@@ -150,6 +160,9 @@ static int gup_pmd_range(pud_t pud, unsigned long addr, unsigned long end,
 		next = pmd_addr_end(addr, end);
 		if (pmd_none(pmd))
 			return 0;
+		/* A pte table shared by fork is copied by the slow path */
+		if (write && !pmd_write(pmd))
+			return 0;
 		if (unlikely(pmd_large(pmd))) {
 			if (!gup_huge_pmd(pmd, addr, next, write, pages, nr))
 				return 0;
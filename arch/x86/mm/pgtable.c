@@ -3,6 +3,7 @@
 #include <asm/pgtable.h>
 #include <asm/tlb.h>
 #include <asm/fixmap.h>
+#include <asm/mtrr.h>
 
 #define PGALLOC_GFP GFP_KERNEL | __GFP_NOTRACK | __GFP_REPEAT | __GFP_ZERO
 
@@ -315,6 +316,23 @@ int ptep_clear_flush_young(struct vm_area_struct *vma,
 	return young;
 }
 
+#ifdef CONFIG_SHMEM_HUGEPAGE
+int pmdp_clear_flush_young(struct vm_area_struct *vma,
+			   unsigned long address, pmd_t *pmdp)
+{
+	int young = 0;
+
+	if (pmd_val(*pmdp) & _PAGE_ACCESSED)
+		young = test_and_clear_bit(_PAGE_BIT_ACCESSED,
+					   (unsigned long *)pmdp);
+	if (young)
+		flush_tlb_range(vma, address & PMD_MASK,
+				(address & PMD_MASK) + PMD_SIZE);
+
+	return young;
+}
+#endif
+
 /**
  * reserve_top_address - reserves a hole in the top of kernel address space
  * @reserve - size of hole to reserve
@@ -351,3 +369,58 @@ void native_set_fixmap(enum fixed_addresses idx, phys_addr_t phys,
 {
 	__native_set_fixmap(idx, pfn_pte(phys >> PAGE_SHIFT, flags));
 }
+
+#ifdef CONFIG_HAVE_ARCH_HUGE_VMAP
+static int __read_mostly huge_vmap_disabled;
+
+static int __init nohugevmap_setup(char *str)
+{
+	huge_vmap_disabled = 1;
+	return 0;
+}
+early_param("nohugevmap", nohugevmap_setup);
+
+int arch_vmap_pmd_supported(void)
+{
+	return !huge_vmap_disabled && cpu_has_pse;
+}
+
+/*
+ * Install a 2MB kernel mapping of @addr in @pmd.
+ * Returns 0 if the caller has to fall back to a pte table.
+ */
+int pmd_set_huge(pmd_t *pmd, phys_addr_t addr, pgprot_t prot)
+{
+	u8 mtrr;
+
+	if (!arch_vmap_pmd_supported())
+		return 0;
+
+	/*
+	 * A large page must not straddle MTRR ranges of different
+	 * types.  The fixed ranges are only looked up by their start,
+	 * so the first megabyte can't be told to be uniform.
+	 */
+	if (addr < 0x100000)
+		return 0;
+	mtrr = mtrr_type_lookup(addr, addr + PMD_SIZE);
+	if (mtrr == 0xFE)
+		return 0;
+
+	set_pmd(pmd, __pmd(addr | pgprot_val(prot) | _PAGE_PSE));
+	return 1;
+}
+
+int pmd_clear_huge(pmd_t *pmd)
+{
+	if (!pmd_large(*pmd))
+		return 0;
+	pmd_clear(pmd);
+	return 1;
+}
+
+int pmd_huge_vmap(pmd_t pmd)
+{
+	return pmd_large(pmd);
+}
+#endif /* CONFIG_HAVE_ARCH_HUGE_VMAP */
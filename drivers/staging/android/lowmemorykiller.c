@@ -19,7 +19,7 @@
 #include <linux/oom.h>
 #include <linux/sched.h>
 
-static int lowmem_shrink(int nr_to_scan, gfp_t gfp_mask);
+static int lowmem_shrink(struct shrinker *shrink, struct shrink_control *sc);
 
 static struct shrinker lowmem_shrinker = {
 	.shrink = lowmem_shrink,
@@ -54,8 +54,10 @@ module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
 
-static int lowmem_shrink(int nr_to_scan, gfp_t gfp_mask)
+static int lowmem_shrink(struct shrinker *shrink, struct shrink_control *sc)
 {
+	int nr_to_scan = sc->nr_to_scan;
+	gfp_t gfp_mask = sc->gfp_mask;
 	struct task_struct *p;
 	struct task_struct *selected = NULL;
 	int rem = 0;
@@ -122,28 +122,53 @@ static void dentry_iput(struct dentry * dentry)
 }
 
 /*
- * dentry_lru_(add|add_tail|del|del_init) must be called with dcache_lock held.
+ * Unused dentries are kept on per-node LRU lists of their superblock,
+ * by the node the dentry itself was allocated on, so that reclaim on
+ * behalf of one node only prunes dentries whose memory is on that node.
+ *
+ * A dentry may also sit on a private list of dentries about to be pruned
+ * (see shrink_dcache_parent()), but it is counted on its node's LRU for
+ * as long as d_lru is not empty.
+ */
+static int dentry_nr_unused_node[MAX_NUMNODES];
+
+static inline int dentry_nid(struct dentry *dentry)
+{
+	return page_to_nid(virt_to_page(dentry));
+}
+
+/*
+ * dentry_lru_(count|add|move_tail|del|del_init) must be called with
+ * dcache_lock held.
  */
+static void dentry_lru_count(struct dentry *dentry, int nr)
+{
+	int nid = dentry_nid(dentry);
+
+	dentry->d_sb->s_dentry_lru[nid].nr_unused += nr;
+	dentry_nr_unused_node[nid] += nr;
+	dentry_stat.nr_unused += nr;
+}
+
 static void dentry_lru_add(struct dentry *dentry)
 {
-	list_add(&dentry->d_lru, &dentry->d_sb->s_dentry_lru);
-	dentry->d_sb->s_nr_dentry_unused++;
-	dentry_stat.nr_unused++;
+	list_add(&dentry->d_lru,
+		 &dentry->d_sb->s_dentry_lru[dentry_nid(dentry)].list);
+	dentry_lru_count(dentry, 1);
 }
 
-static void dentry_lru_add_tail(struct dentry *dentry)
+static void dentry_lru_move_tail(struct dentry *dentry, struct list_head *list)
 {
-	list_add_tail(&dentry->d_lru, &dentry->d_sb->s_dentry_lru);
-	dentry->d_sb->s_nr_dentry_unused++;
-	dentry_stat.nr_unused++;
+	if (list_empty(&dentry->d_lru))
+		dentry_lru_count(dentry, 1);
+	list_move_tail(&dentry->d_lru, list);
 }
 
 static void dentry_lru_del(struct dentry *dentry)
 {
 	if (!list_empty(&dentry->d_lru)) {
 		list_del(&dentry->d_lru);
-		dentry->d_sb->s_nr_dentry_unused--;
-		dentry_stat.nr_unused--;
+		dentry_lru_count(dentry, -1);
 	}
 }
 
@@ -151,8 +176,7 @@ static void dentry_lru_del_init(struct dentry *dentry)
 {
 	if (likely(!list_empty(&dentry->d_lru))) {
 		list_del_init(&dentry->d_lru);
-		dentry->d_sb->s_nr_dentry_unused--;
-		dentry_stat.nr_unused--;
+		dentry_lru_count(dentry, -1);
 	}
 }
 
@@ -442,16 +466,46 @@ static void prune_one_dentry(struct dentry * dentry)
 	}
 }
 
+/*
+ * Prune the dentries on @list, which have been isolated from the LRU.
+ * Called with dcache_lock held, which may be dropped and retaken.
+ */
+static void shrink_dentry_list(struct list_head *list)
+{
+	struct dentry *dentry;
+
+	while (!list_empty(list)) {
+		dentry = list_entry(list->prev, struct dentry, d_lru);
+		dentry_lru_del_init(dentry);
+		spin_lock(&dentry->d_lock);
+		/*
+		 * We found an inuse dentry which was not removed from
+		 * the LRU because of laziness during lookup.  Do not free
+		 * it - just keep it off the LRU list.
+		 */
+		if (atomic_read(&dentry->d_count)) {
+			spin_unlock(&dentry->d_lock);
+			continue;
+		}
+		prune_one_dentry(dentry);
+		/* dentry->d_lock was dropped in prune_one_dentry() */
+		cond_resched_lock(&dcache_lock);
+	}
+}
+
 /*
  * Shrink the dentry LRU on a given superblock.
  * @sb   : superblock to shrink dentry LRU.
- * @count: If count is NULL, we prune all dentries on superblock.
+ * @nid  : node whose dentries to shrink.
+ * @count: If count is NULL, we prune all dentries of the node on superblock.
  * @flags: If flags is non-zero, we need to do special processing based on
  * which flags are set. This means we don't need to maintain multiple
  * similar copies of this loop.
  */
-static void __shrink_dcache_sb(struct super_block *sb, int *count, int flags)
+static void __shrink_dcache_sb(struct super_block *sb, int nid, int *count,
+			       int flags)
 {
+	struct list_head *lru = &sb->s_dentry_lru[nid].list;
 	LIST_HEAD(referenced);
 	LIST_HEAD(tmp);
 	struct dentry *dentry;
@@ -461,15 +515,14 @@ static void __shrink_dcache_sb(struct super_block *sb, int *count, int flags)
 	BUG_ON((flags & DCACHE_REFERENCED) && count == NULL);
 	spin_lock(&dcache_lock);
 	if (count != NULL)
-		/* called from prune_dcache() and shrink_dcache_parent() */
+		/* called from prune_dcache() */
 		cnt = *count;
 restart:
 	if (count == NULL)
-		list_splice_init(&sb->s_dentry_lru, &tmp);
+		list_splice_init(lru, &tmp);
 	else {
-		while (!list_empty(&sb->s_dentry_lru)) {
-			dentry = list_entry(sb->s_dentry_lru.prev,
-					struct dentry, d_lru);
+		while (!list_empty(lru)) {
+			dentry = list_entry(lru->prev, struct dentry, d_lru);
 			BUG_ON(dentry->d_sb != sb);
 
 			spin_lock(&dentry->d_lock);
@@ -493,46 +546,30 @@ restart:
 			cond_resched_lock(&dcache_lock);
 		}
 	}
-	while (!list_empty(&tmp)) {
-		dentry = list_entry(tmp.prev, struct dentry, d_lru);
-		dentry_lru_del_init(dentry);
-		spin_lock(&dentry->d_lock);
-		/*
-		 * We found an inuse dentry which was not removed from
-		 * the LRU because of laziness during lookup.  Do not free
-		 * it - just keep it off the LRU list.
-		 */
-		if (atomic_read(&dentry->d_count)) {
-			spin_unlock(&dentry->d_lock);
-			continue;
-		}
-		prune_one_dentry(dentry);
-		/* dentry->d_lock was dropped in prune_one_dentry() */
-		cond_resched_lock(&dcache_lock);
-	}
-	if (count == NULL && !list_empty(&sb->s_dentry_lru))
+	shrink_dentry_list(&tmp);
+	if (count == NULL && !list_empty(lru))
 		goto restart;
 	if (count != NULL)
 		*count = cnt;
 	if (!list_empty(&referenced))
-		list_splice(&referenced, &sb->s_dentry_lru);
+		list_splice(&referenced, lru);
 	spin_unlock(&dcache_lock);
 }
 
 /**
  * prune_dcache - shrink the dcache
+ * @nid: node whose dentries to free
  * @count: number of entries to try to free
  *
- * Shrink the dcache. This is done when we need more memory, or simply when we
- * need to unmount something (at which point we need to unuse all dentries).
+ * Shrink the dcache. This is done when we need more memory on @nid.
  *
  * This function may fail to free any resources if all the dentries are in use.
  */
-static void prune_dcache(int count)
+static void prune_dcache(int nid, int count)
 {
 	struct super_block *sb;
 	int w_count;
-	int unused = dentry_stat.nr_unused;
+	int unused = dentry_nr_unused_node[nid];
 	int prune_ratio;
 	int pruned;
 
@@ -546,7 +583,9 @@ restart:
 		prune_ratio = unused / count;
 	spin_lock(&sb_lock);
 	list_for_each_entry(sb, &super_blocks, s_list) {
-		if (sb->s_nr_dentry_unused == 0)
+		struct sb_dentry_lru *lru = &sb->s_dentry_lru[nid];
+
+		if (lru->nr_unused == 0)
 			continue;
 		sb->s_count++;
 		/* Now, we reclaim unused dentrins with fairness.
@@ -555,14 +594,14 @@ restart:
 		 * as follows, but the implementation is arranged to avoid
 		 * overflows:
 		 * number of dentries to scan on this sb =
-		 * count * (number of dentries on this sb /
-		 * number of dentries in the machine)
+		 * count * (number of dentries of the node on this sb /
+		 * number of dentries on the node)
 		 */
 		spin_unlock(&sb_lock);
 		if (prune_ratio != 1)
-			w_count = (sb->s_nr_dentry_unused / prune_ratio) + 1;
+			w_count = (lru->nr_unused / prune_ratio) + 1;
 		else
-			w_count = sb->s_nr_dentry_unused;
+			w_count = lru->nr_unused;
 		pruned = w_count;
 		/*
 		 * We need to be sure this filesystem isn't being unmounted,
@@ -573,9 +612,9 @@ restart:
 		 */
 		if (down_read_trylock(&sb->s_umount)) {
 			if ((sb->s_root != NULL) &&
-			    (!list_empty(&sb->s_dentry_lru))) {
+			    (!list_empty(&lru->list))) {
 				spin_unlock(&dcache_lock);
-				__shrink_dcache_sb(sb, &w_count,
+				__shrink_dcache_sb(sb, nid, &w_count,
 						DCACHE_REFERENCED);
 				pruned -= w_count;
 				spin_lock(&dcache_lock);
@@ -607,7 +646,10 @@ restart:
  */
 void shrink_dcache_sb(struct super_block * sb)
 {
-	__shrink_dcache_sb(sb, NULL, 0);
+	int nid;
+
+	for (nid = 0; nid < nr_node_ids; nid++)
+		__shrink_dcache_sb(sb, nid, NULL, 0);
 }
 
 /*
@@ -794,19 +836,19 @@ positive:
 
 /*
  * Search the dentry child list for the specified parent,
- * and move any unused dentries to the end of the unused
- * list for prune_dcache(). We descend to the next level
+ * and move any unused dentries to the end of the @dispose
+ * list for shrink_dentry_list(). We descend to the next level
  * whenever the d_subdirs list is non-empty and continue
  * searching.
  *
  * It returns zero iff there are no unused children,
  * otherwise  it returns the number of children moved to
- * the end of the unused list. This may not be the total
+ * the end of the dispose list. This may not be the total
  * number of unused children, because select_parent can
  * drop the lock and return early due to latency
  * constraints.
  */
-static int select_parent(struct dentry * parent)
+static int select_parent(struct dentry * parent, struct list_head *dispose)
 {
 	struct dentry *this_parent = parent;
 	struct list_head *next;
@@ -821,15 +863,15 @@ resume:
 		struct dentry *dentry = list_entry(tmp, struct dentry, d_u.d_child);
 		next = tmp->next;
 
-		dentry_lru_del_init(dentry);
 		/* 
 		 * move only zero ref count dentries to the end 
-		 * of the unused list for prune_dcache
+		 * of the dispose list for shrink_dentry_list
 		 */
 		if (!atomic_read(&dentry->d_count)) {
-			dentry_lru_add_tail(dentry);
+			dentry_lru_move_tail(dentry, dispose);
 			found++;
-		}
+		} else
+			dentry_lru_del_init(dentry);
 
 		/*
 		 * We can return to the caller if we have found some (this
@@ -869,15 +911,17 @@ out:
  
 void shrink_dcache_parent(struct dentry * parent)
 {
-	struct super_block *sb = parent->d_sb;
-	int found;
+	LIST_HEAD(dispose);
 
-	while ((found = select_parent(parent)) != 0)
-		__shrink_dcache_sb(sb, &found, 0);
+	while (select_parent(parent, &dispose) != 0) {
+		spin_lock(&dcache_lock);
+		shrink_dentry_list(&dispose);
+		spin_unlock(&dcache_lock);
+	}
 }
 
 /*
- * Scan `nr' dentries and return the number which remain.
+ * Scan `nr' dentries of node `nid' and return the number which remain.
  *
  * We need to avoid reentering the filesystem if the caller is performing a
  * GFP_NOFS allocation attempt.  One example deadlock is:
@@ -888,19 +932,23 @@ void shrink_dcache_parent(struct dentry * parent)
  *
  * In this case we return -1 to tell the caller that we baled.
  */
-static int shrink_dcache_memory(int nr, gfp_t gfp_mask)
+static int shrink_dcache_memory(struct shrinker *shrink,
+				struct shrink_control *sc)
 {
-	if (nr) {
-		if (!(gfp_mask & __GFP_FS))
+	int nid = sc->nid;
+
+	if (sc->nr_to_scan) {
+		if (!(sc->gfp_mask & __GFP_FS))
 			return -1;
-		prune_dcache(nr);
+		prune_dcache(nid, sc->nr_to_scan);
 	}
-	return (dentry_stat.nr_unused / 100) * sysctl_vfs_cache_pressure;
+	return (dentry_nr_unused_node[nid] / 100) * sysctl_vfs_cache_pressure;
 }
 
 static struct shrinker dcache_shrinker = {
 	.shrink = shrink_dcache_memory,
 	.seeks = DEFAULT_SEEKS,
+	.flags = SHRINKER_NUMA_AWARE,
 };
 
 /**
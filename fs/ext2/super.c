@@ -31,6 +31,7 @@
 #include <linux/seq_file.h>
 #include <linux/mount.h>
 #include <linux/log2.h>
+#include <linux/cleancache.h>
 #include <linux/quotaops.h>
 #include <asm/uaccess.h>
 #include "ext2.h"
@@ -1063,6 +1064,7 @@ static int ext2_fill_super(struct super_block *sb, void *data, int silent)
 		ext2_warning(sb, __func__,
 			"mounting ext3 filesystem as ext2");
 	ext2_setup_super (sb, es, sb->s_flags & MS_RDONLY);
+	cleancache_init_fs(sb);
 	return 0;
 
 cantfind_ext2:
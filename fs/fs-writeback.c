@@ -426,7 +426,7 @@ writeback_single_inode(struct inode *inode, struct writeback_control *wbc)
 			/*
 			 * The inode is clean, unused
 			 */
-			list_move(&inode->i_list, &inode_unused);
+			inode_lru_move(inode);
 		}
 	}
 	inode_sync_complete(inode);
@@ -385,8 +385,8 @@ static void hugetlbfs_forget_inode(struct inode *inode) __releases(inode_lock)
 
 	if (!hlist_unhashed(&inode->i_hash)) {
 		if (!(inode->i_state & (I_DIRTY|I_SYNC)))
-			list_move(&inode->i_list, &inode_unused);
-		inodes_stat.nr_unused++;
+			inode_lru_move(inode);
+		inode_lru_count(inode, 1);
 		if (!sb || (sb->s_flags & MS_ACTIVE)) {
 			spin_unlock(&inode_lock);
 			return;
@@ -400,7 +400,7 @@ static void hugetlbfs_forget_inode(struct inode *inode) __releases(inode_lock)
 		write_inode_now(inode, 1);
 		spin_lock(&inode_lock);
 		inode->i_state &= ~I_WILL_FREE;
-		inodes_stat.nr_unused--;
+		inode_lru_count(inode, -1);
 		hlist_del_init(&inode->i_hash);
 	}
 	list_del_init(&inode->i_list);
@@ -75,9 +75,18 @@ static unsigned int i_hash_shift __read_mostly;
  */
 
 LIST_HEAD(inode_in_use);
-LIST_HEAD(inode_unused);
 static struct hlist_head *inode_hashtable __read_mostly;
 
+/*
+ * Unused inodes are kept on per-node lists, by the node the inode itself
+ * was allocated on, so that reclaim on behalf of one node only prunes
+ * inodes whose memory is on that node.  A dirty unused inode sits on its
+ * superblock's writeback lists instead, but is counted on its node all
+ * the same.  Both are protected by inode_lock.
+ */
+static struct list_head inode_unused[MAX_NUMNODES];
+static int inode_nr_unused_node[MAX_NUMNODES];
+
 /*
  * A simple spinlock to protect the list manipulations.
  *
@@ -289,6 +298,25 @@ static void init_once(void *foo)
 	inode_init_once(inode);
 }
 
+static inline int inode_nid(struct inode *inode)
+{
+	return page_to_nid(virt_to_page(inode));
+}
+
+/*
+ * inode_lru_(move|count) must be called with inode_lock held.
+ */
+void inode_lru_move(struct inode *inode)
+{
+	list_move(&inode->i_list, &inode_unused[inode_nid(inode)]);
+}
+
+void inode_lru_count(struct inode *inode, int nr)
+{
+	inode_nr_unused_node[inode_nid(inode)] += nr;
+	inodes_stat.nr_unused += nr;
+}
+
 /*
  * inode_lock must be held
  */
@@ -301,7 +329,7 @@ void __iget(struct inode *inode)
 	atomic_inc(&inode->i_count);
 	if (!(inode->i_state & (I_DIRTY|I_SYNC)))
 		list_move(&inode->i_list, &inode_in_use);
-	inodes_stat.nr_unused--;
+	inode_lru_count(inode, -1);
 }
 
 /**
@@ -373,7 +401,7 @@ static void dispose_list(struct list_head *head)
 static int invalidate_list(struct list_head *head, struct list_head *dispose)
 {
 	struct list_head *next;
-	int busy = 0, count = 0;
+	int busy = 0;
 
 	next = head->next;
 	for (;;) {
@@ -399,13 +427,12 @@ static int invalidate_list(struct list_head *head, struct list_head *dispose)
 			list_move(&inode->i_list, dispose);
 			WARN_ON(inode->i_state & I_NEW);
 			inode->i_state |= I_FREEING;
-			count++;
+			/* only unused inodes may be cached with i_count zero */
+			inode_lru_count(inode, -1);
 			continue;
 		}
 		busy = 1;
 	}
-	/* only unused inodes may be cached with i_count zero */
-	inodes_stat.nr_unused -= count;
 	return busy;
 }
 
@@ -450,8 +477,9 @@ static int can_unuse(struct inode *inode)
 }
 
 /*
- * Scan `goal' inodes on the unused list for freeable ones. They are moved to
- * a temporary list and then are freed outside inode_lock by dispose_list().
+ * Scan `goal' inodes on the unused list of node `nid' for freeable ones. They
+ * are moved to a temporary list and then are freed outside inode_lock by
+ * dispose_list().
  *
  * Any inodes which are pinned purely because of attached pagecache have their
  * pagecache removed.  We expect the final iput() on that inode to add it to
@@ -462,10 +490,10 @@ static int can_unuse(struct inode *inode)
  * If the inode has metadata buffers attached to mapping->private_list then
  * try to remove them.
  */
-static void prune_icache(int nr_to_scan)
+static void prune_icache(int nid, int nr_to_scan)
 {
+	struct list_head *lru = &inode_unused[nid];
 	LIST_HEAD(freeable);
-	int nr_pruned = 0;
 	int nr_scanned;
 	unsigned long reap = 0;
 
@@ -474,13 +502,13 @@ static void prune_icache(int nr_to_scan)
 	for (nr_scanned = 0; nr_scanned < nr_to_scan; nr_scanned++) {
 		struct inode *inode;
 
-		if (list_empty(&inode_unused))
+		if (list_empty(lru))
 			break;
 
-		inode = list_entry(inode_unused.prev, struct inode, i_list);
+		inode = list_entry(lru->prev, struct inode, i_list);
 
 		if (inode->i_state || atomic_read(&inode->i_count)) {
-			list_move(&inode->i_list, &inode_unused);
+			list_move(&inode->i_list, lru);
 			continue;
 		}
 		if (inode_has_buffers(inode) || inode->i_data.nrpages) {
@@ -492,7 +520,7 @@ static void prune_icache(int nr_to_scan)
 			iput(inode);
 			spin_lock(&inode_lock);
 
-			if (inode != list_entry(inode_unused.next,
+			if (inode != list_entry(lru->next,
 						struct inode, i_list))
 				continue;	/* wrong inode or list_empty */
 			if (!can_unuse(inode))
@@ -501,9 +529,8 @@ static void prune_icache(int nr_to_scan)
 		list_move(&inode->i_list, &freeable);
 		WARN_ON(inode->i_state & I_NEW);
 		inode->i_state |= I_FREEING;
-		nr_pruned++;
+		inode_lru_count(inode, -1);
 	}
-	inodes_stat.nr_unused -= nr_pruned;
 	if (current_is_kswapd())
 		__count_vm_events(KSWAPD_INODESTEAL, reap);
 	else
@@ -520,27 +547,31 @@ static void prune_icache(int nr_to_scan)
  * not open and the dcache references to those inodes have already been
  * reclaimed.
  *
- * This function is passed the number of inodes to scan, and it returns the
- * total number of remaining possibly-reclaimable inodes.
+ * This function is passed the node and the number of inodes to scan, and it
+ * returns the number of remaining possibly-reclaimable inodes on that node.
  */
-static int shrink_icache_memory(int nr, gfp_t gfp_mask)
+static int shrink_icache_memory(struct shrinker *shrink,
+				struct shrink_control *sc)
 {
-	if (nr) {
+	int nid = sc->nid;
+
+	if (sc->nr_to_scan) {
 		/*
 		 * Nasty deadlock avoidance.  We may hold various FS locks,
 		 * and we don't want to recurse into the FS that called us
 		 * in clear_inode() and friends..
 		 */
-		if (!(gfp_mask & __GFP_FS))
+		if (!(sc->gfp_mask & __GFP_FS))
 			return -1;
-		prune_icache(nr);
+		prune_icache(nid, sc->nr_to_scan);
 	}
-	return (inodes_stat.nr_unused / 100) * sysctl_vfs_cache_pressure;
+	return (inode_nr_unused_node[nid] / 100) * sysctl_vfs_cache_pressure;
 }
 
 static struct shrinker icache_shrinker = {
 	.shrink = shrink_icache_memory,
 	.seeks = DEFAULT_SEEKS,
+	.flags = SHRINKER_NUMA_AWARE,
 };
 
 static void __wait_on_freeing_inode(struct inode *inode);
@@ -1242,8 +1273,8 @@ static void generic_forget_inode(struct inode *inode)
 
 	if (!hlist_unhashed(&inode->i_hash)) {
 		if (!(inode->i_state & (I_DIRTY|I_SYNC)))
-			list_move(&inode->i_list, &inode_unused);
-		inodes_stat.nr_unused++;
+			inode_lru_move(inode);
+		inode_lru_count(inode, 1);
 		if (sb->s_flags & MS_ACTIVE) {
 			spin_unlock(&inode_lock);
 			return;
@@ -1255,7 +1286,7 @@ static void generic_forget_inode(struct inode *inode)
 		spin_lock(&inode_lock);
 		WARN_ON(inode->i_state & I_NEW);
 		inode->i_state &= ~I_WILL_FREE;
-		inodes_stat.nr_unused--;
+		inode_lru_count(inode, -1);
 		hlist_del_init(&inode->i_hash);
 	}
 	list_del_init(&inode->i_list);
@@ -1553,6 +1584,9 @@ void __init inode_init(void)
 {
 	int loop;
 
+	for (loop = 0; loop < MAX_NUMNODES; loop++)
+		INIT_LIST_HEAD(&inode_unused[loop]);
+
 	/* inode slab cache */
 	inode_cachep = kmem_cache_create("inode_cache",
 					 sizeof(struct inode),
@@ -115,7 +115,8 @@ mb_cache_indexes(struct mb_cache *cache)
  * What the mbcache registers as to get shrunk dynamically.
  */
 
-static int mb_cache_shrink_fn(int nr_to_scan, gfp_t gfp_mask);
+static int mb_cache_shrink_fn(struct shrinker *shrink,
+			      struct shrink_control *sc);
 
 static struct shrinker mb_cache_shrinker = {
 	.shrink = mb_cache_shrink_fn,
@@ -191,14 +192,17 @@ forget:
  * This function is called by the kernel memory management when memory
  * gets low.
  *
- * @nr_to_scan: Number of objects to scan
- * @gfp_mask: (ignored)
+ * @shrink: (ignored)
+ * @sc: shrink_control passed containing the number of objects to scan
+ *      in sc->nr_to_scan
  *
  * Returns the number of objects which are present in the cache.
  */
 static int
-mb_cache_shrink_fn(int nr_to_scan, gfp_t gfp_mask)
+mb_cache_shrink_fn(struct shrinker *shrink, struct shrink_control *sc)
 {
+	int nr_to_scan = sc->nr_to_scan;
+	gfp_t gfp_mask = sc->gfp_mask;
 	LIST_HEAD(free_list);
 	struct list_head *l, *ltmp;
 	int count = 0;
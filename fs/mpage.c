@@ -26,6 +26,7 @@
 #include <linux/writeback.h>
 #include <linux/backing-dev.h>
 #include <linux/pagevec.h>
+#include <linux/cleancache.h>
 
 /*
  * I/O completion handler for multipage BIOs.
@@ -188,6 +189,17 @@ do_mpage_readpage(struct bio *bio, struct page *page, unsigned nr_pages,
 	if (page_has_buffers(page))
 		goto confused;
 
+	/*
+	 * A clean copy of the page may have been kept in cleancache when it
+	 * was evicted.  The bio built so far is left for the next page.
+	 */
+	if (cleancache_get_page(page) == 0) {
+		SetPageUptodate(page);
+		SetPageMappedToDisk(page);
+		unlock_page(page);
+		goto out;
+	}
+
 	block_in_file = (sector_t)page->index << (PAGE_CACHE_SHIFT - blkbits);
 	last_block = block_in_file + nr_pages * blocks_per_page;
 	last_block_in_file = (i_size_read(inode) + blocksize - 1) >> blkbits;
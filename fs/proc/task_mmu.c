@@ -8,6 +8,7 @@
 #include <linux/mempolicy.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
+#include <linux/memstats.h>
 
 #include <asm/elf.h>
 #include <asm/uaccess.h>
@@ -317,79 +318,118 @@ struct mem_size_stats {
 	unsigned long private_dirty;
 	unsigned long referenced;
 	unsigned long swap;
+	unsigned long pmd_mapped;
 	u64 pss;
 };
 
-static int smaps_pte_range(pmd_t *pmd, unsigned long addr, unsigned long end,
-			   struct mm_walk *walk)
+static void smaps_pte_entry(pte_t ptent, unsigned long addr,
+			    struct mem_size_stats *mss)
 {
-	struct mem_size_stats *mss = walk->private;
 	struct vm_area_struct *vma = mss->vma;
-	pte_t *pte, ptent;
-	spinlock_t *ptl;
 	struct page *page;
 	int mapcount;
 
-	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
-	for (; addr != end; pte++, addr += PAGE_SIZE) {
-		ptent = *pte;
-
-		if (is_swap_pte(ptent)) {
-			mss->swap += PAGE_SIZE;
-			continue;
-		}
-
-		if (!pte_present(ptent))
-			continue;
+	if (is_swap_pte(ptent)) {
+		mss->swap += PAGE_SIZE;
+		return;
+	}
 
-		mss->resident += PAGE_SIZE;
+	if (!pte_present(ptent))
+		return;
+
+	mss->resident += PAGE_SIZE;
+
+	page = vm_normal_page(vma, addr, ptent);
+	if (!page)
+		return;
+
+	/* Accumulate the size in pages that have been accessed. */
+	if (pte_young(ptent) || PageReferenced(page))
+		mss->referenced += PAGE_SIZE;
+	mapcount = page_mapcount(page);
+	if (mapcount >= 2) {
+		if (pte_dirty(ptent))
+			mss->shared_dirty += PAGE_SIZE;
+		else
+			mss->shared_clean += PAGE_SIZE;
+		mss->pss += (PAGE_SIZE << PSS_SHIFT) / mapcount;
+	} else {
+		if (pte_dirty(ptent))
+			mss->private_dirty += PAGE_SIZE;
+		else
+			mss->private_clean += PAGE_SIZE;
+		mss->pss += (PAGE_SIZE << PSS_SHIFT);
+	}
+}
 
-		page = vm_normal_page(vma, addr, ptent);
-		if (!page)
-			continue;
+static int smaps_pte_range(pmd_t *pmd, unsigned long addr, unsigned long end,
+			   struct mm_walk *walk)
+{
+	struct mem_size_stats *mss = walk->private;
+	struct vm_area_struct *vma = mss->vma;
+	pte_t *pte;
+	spinlock_t *ptl;
 
-		/* Accumulate the size in pages that have been accessed. */
-		if (pte_young(ptent) || PageReferenced(page))
-			mss->referenced += PAGE_SIZE;
-		mapcount = page_mapcount(page);
-		if (mapcount >= 2) {
-			if (pte_dirty(ptent))
-				mss->shared_dirty += PAGE_SIZE;
-			else
-				mss->shared_clean += PAGE_SIZE;
-			mss->pss += (PAGE_SIZE << PSS_SHIFT) / mapcount;
-		} else {
-			if (pte_dirty(ptent))
-				mss->private_dirty += PAGE_SIZE;
-			else
-				mss->private_clean += PAGE_SIZE;
-			mss->pss += (PAGE_SIZE << PSS_SHIFT);
+	if (pmd_trans_huge(*pmd)) {
+		spin_lock(&vma->vm_mm->page_table_lock);
+		if (pmd_trans_huge(*pmd)) {
+			mss->pmd_mapped += end - addr;
+			for (; addr != end; addr += PAGE_SIZE)
+				smaps_pte_entry(huge_pmd_pte(*pmd, addr),
+						addr, mss);
+			spin_unlock(&vma->vm_mm->page_table_lock);
+			return 0;
 		}
+		spin_unlock(&vma->vm_mm->page_table_lock);
+		if (pmd_none(*pmd))
+			return 0;
 	}
+
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE)
+		smaps_pte_entry(*pte, addr, mss);
 	pte_unmap_unlock(pte - 1, ptl);
 	cond_resched();
 	return 0;
 }
 
-static int show_smap(struct seq_file *m, void *v)
+/* Add the pages mapped by @vma to @mss: the counters are not cleared */
+static void smap_gather_stats(struct vm_area_struct *vma,
+			      struct mem_size_stats *mss)
 {
-	struct proc_maps_private *priv = m->private;
-	struct task_struct *task = priv->task;
-	struct vm_area_struct *vma = v;
-	struct mem_size_stats mss;
 	struct mm_walk smaps_walk = {
 		.pmd_entry = smaps_pte_range,
 		.mm = vma->vm_mm,
-		.private = &mss,
+		.private = mss,
 	};
 
-	memset(&mss, 0, sizeof mss);
-	mss.vma = vma;
+	mss->vma = vma;
 	if (vma->vm_mm && !is_vm_hugetlb_page(vma))
 		walk_page_range(vma->vm_start, vma->vm_end, &smaps_walk);
+}
 
-	show_map_vma(m, vma);
+/*
+ * Sum the stats of all the vmas of @mm into @mss, and their size into
+ * @size: the caller holds a reference on @mm, but not its mmap_sem.
+ */
+static void smap_gather_mm(struct mm_struct *mm, struct mem_size_stats *mss,
+			   unsigned long *size)
+{
+	struct vm_area_struct *vma;
 
+	memset(mss, 0, sizeof(*mss));
+	*size = 0;
+	down_read(&mm->mmap_sem);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		smap_gather_stats(vma, mss);
+		*size += vma->vm_end - vma->vm_start;
+	}
+	up_read(&mm->mmap_sem);
+}
+
+static void show_smap_stats(struct seq_file *m, unsigned long size,
+			    struct mem_size_stats *mss)
+{
 	seq_printf(m,
 		   "Size:           %8lu kB\n"
 		   "Rss:            %8lu kB\n"
@@ -400,17 +440,35 @@ static int show_smap(struct seq_file *m, void *v)
 		   "Private_Dirty:  %8lu kB\n"
 		   "Referenced:     %8lu kB\n"
 		   "Swap:           %8lu kB\n"
+		   "ShmemPmdMapped: %8lu kB\n",
+		   size >> 10,
+		   mss->resident >> 10,
+		   (unsigned long)(mss->pss >> (10 + PSS_SHIFT)),
+		   mss->shared_clean  >> 10,
+		   mss->shared_dirty  >> 10,
+		   mss->private_clean >> 10,
+		   mss->private_dirty >> 10,
+		   mss->referenced >> 10,
+		   mss->swap >> 10,
+		   mss->pmd_mapped >> 10);
+}
+
+static int show_smap(struct seq_file *m, void *v)
+{
+	struct proc_maps_private *priv = m->private;
+	struct task_struct *task = priv->task;
+	struct vm_area_struct *vma = v;
+	struct mem_size_stats mss;
+
+	memset(&mss, 0, sizeof mss);
+	smap_gather_stats(vma, &mss);
+
+	show_map_vma(m, vma);
+
+	show_smap_stats(m, vma->vm_end - vma->vm_start, &mss);
+	seq_printf(m,
 		   "KernelPageSize: %8lu kB\n"
 		   "MMUPageSize:    %8lu kB\n",
-		   (vma->vm_end - vma->vm_start) >> 10,
-		   mss.resident >> 10,
-		   (unsigned long)(mss.pss >> (10 + PSS_SHIFT)),
-		   mss.shared_clean  >> 10,
-		   mss.shared_dirty  >> 10,
-		   mss.private_clean >> 10,
-		   mss.private_dirty >> 10,
-		   mss.referenced >> 10,
-		   mss.swap >> 10,
 		   vma_kernel_pagesize(vma) >> 10,
 		   vma_mmu_pagesize(vma) >> 10);
 
@@ -438,6 +496,65 @@ const struct file_operations proc_smaps_operations = {
 	.release	= seq_release_private,
 };
 
+/*
+ * /proc/pid/smaps_rollup: the smaps counters summed over all the vmas, so
+ * that a monitor need not parse one record per mapping to get a process's
+ * Pss and Swap.
+ */
+int proc_pid_smaps_rollup(struct seq_file *m, struct pid_namespace *ns,
+			  struct pid *pid, struct task_struct *task)
+{
+	struct mem_size_stats mss;
+	struct mm_struct *mm;
+	unsigned long size;
+
+	mm = mm_for_maps(task);
+	if (!mm)
+		return 0;
+	smap_gather_mm(mm, &mss, &size);
+	mmput(mm);
+
+	show_smap_stats(m, size, &mss);
+	return 0;
+}
+
+/**
+ * memstats_build - fill a struct memstats for a process
+ * @stats: the record to fill
+ * @task: a task of the process
+ *
+ * The same sums as /proc/pid/smaps_rollup, in bytes, for the memstats
+ * genetlink commands.  Returns 0, or -EACCES if the caller may not read
+ * its maps, by the same check as smaps_rollup, or it has no mm any more.
+ */
+int memstats_build(struct memstats *stats, struct task_struct *task)
+{
+	struct mem_size_stats mss;
+	struct mm_struct *mm;
+	unsigned long size;
+
+	mm = mm_for_maps(task);
+	if (!mm)
+		return -EACCES;
+	smap_gather_mm(mm, &mss, &size);
+	mmput(mm);
+
+	memset(stats, 0, sizeof(*stats));
+	stats->version = MEMSTATS_VERSION;
+	stats->pid = task_tgid_vnr(task);
+	stats->size = size;
+	stats->rss = mss.resident;
+	stats->pss = mss.pss >> PSS_SHIFT;
+	stats->shared_clean = mss.shared_clean;
+	stats->shared_dirty = mss.shared_dirty;
+	stats->private_clean = mss.private_clean;
+	stats->private_dirty = mss.private_dirty;
+	stats->referenced = mss.referenced;
+	stats->swap = mss.swap;
+	stats->shmem_pmd_mapped = mss.pmd_mapped;
+	return 0;
+}
+
 static int clear_refs_pte_range(pmd_t *pmd, unsigned long addr,
 				unsigned long end, struct mm_walk *walk)
 {
@@ -446,6 +563,22 @@ static int clear_refs_pte_range(pmd_t *pmd, unsigned long addr,
 	spinlock_t *ptl;
 	struct page *page;
 
+	if (pmd_trans_huge(*pmd)) {
+		spin_lock(&vma->vm_mm->page_table_lock);
+		if (pmd_trans_huge(*pmd)) {
+			/* One accessed bit for the whole extent */
+			pmdp_clear_flush_young(vma, addr, pmd);
+			page = pmd_page(*pmd) + pte_index(addr);
+			for (; addr != end; page++, addr += PAGE_SIZE)
+				ClearPageReferenced(page);
+			spin_unlock(&vma->vm_mm->page_table_lock);
+			return 0;
+		}
+		spin_unlock(&vma->vm_mm->page_table_lock);
+		if (pmd_none(*pmd))
+			return 0;
+	}
+
 	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
 	for (; addr != end; pte++, addr += PAGE_SIZE) {
 		ptent = *pte;
@@ -598,10 +731,19 @@ static int pagemap_pte_range(pmd_t *pmd, unsigned long addr, unsigned long end,
 		 * and that it isn't a huge page vma */
 		if (vma && (vma->vm_start <= addr) &&
 		    !is_vm_hugetlb_page(vma)) {
-			pte = pte_offset_map(pmd, addr);
-			pfn = pte_to_pagemap_entry(*pte);
-			/* unmap before userspace copy */
-			pte_unmap(pte);
+			/* a huge pmd may be installed or split under us */
+			pmd_t pmdval = *pmd;
+
+			barrier();
+			if (pmd_trans_huge(pmdval)) {
+				pfn = pte_to_pagemap_entry(
+						huge_pmd_pte(pmdval, addr));
+			} else if (pmd_present(pmdval)) {
+				pte = pte_offset_map(&pmdval, addr);
+				pfn = pte_to_pagemap_entry(*pte);
+				/* unmap before userspace copy */
+				pte_unmap(pte);
+			}
 		}
 		err = add_to_pagemap(addr, pfn, pm);
 		if (err)
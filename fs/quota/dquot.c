@@ -616,11 +616,12 @@ static void prune_dqcache(int count)
  * more memory
  */
 
-static int shrink_dqcache_memory(int nr, gfp_t gfp_mask)
+static int shrink_dqcache_memory(struct shrinker *shrink,
+				 struct shrink_control *sc)
 {
-	if (nr) {
+	if (sc->nr_to_scan) {
 		spin_lock(&dq_list_lock);
-		prune_dqcache(nr);
+		prune_dqcache(sc->nr_to_scan);
 		spin_unlock(&dq_list_lock);
 	}
 	return (dqstats.free_dquots / 100) * sysctl_vfs_cache_pressure;
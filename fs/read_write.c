@@ -598,7 +598,8 @@ ssize_t rw_copy_check_uvector(int type, const struct iovec __user * uvector,
 			ret = -EINVAL;
   			goto out;
 		}
-		if (unlikely(!access_ok(vrfy_dir(type), buf, len))) {
+		if (type >= 0 &&
+		    unlikely(!access_ok(vrfy_dir(type), buf, len))) {
 			ret = -EFAULT;
   			goto out;
 		}
@@ -37,6 +37,7 @@
 #include <linux/kobject.h>
 #include <linux/mutex.h>
 #include <linux/file.h>
+#include <linux/cleancache.h>
 #include <asm/uaccess.h>
 #include "internal.h"
 
@@ -55,6 +56,7 @@ static struct super_block *alloc_super(struct file_system_type *type)
 {
 	struct super_block *s = kzalloc(sizeof(struct super_block),  GFP_USER);
 	static struct super_operations default_op;
+	int nid;
 
 	if (s) {
 		if (security_sb_alloc(s)) {
@@ -62,6 +64,17 @@ static struct super_block *alloc_super(struct file_system_type *type)
 			s = NULL;
 			goto out;
 		}
+		s->s_dentry_lru = kcalloc(nr_node_ids,
+					  sizeof(struct sb_dentry_lru),
+					  GFP_USER);
+		if (!s->s_dentry_lru) {
+			security_sb_free(s);
+			kfree(s);
+			s = NULL;
+			goto out;
+		}
+		for (nid = 0; nid < nr_node_ids; nid++)
+			INIT_LIST_HEAD(&s->s_dentry_lru[nid].list);
 		INIT_LIST_HEAD(&s->s_dirty);
 		INIT_LIST_HEAD(&s->s_io);
 		INIT_LIST_HEAD(&s->s_more_io);
@@ -69,7 +82,6 @@ static struct super_block *alloc_super(struct file_system_type *type)
 		INIT_LIST_HEAD(&s->s_instances);
 		INIT_HLIST_HEAD(&s->s_anon);
 		INIT_LIST_HEAD(&s->s_inodes);
-		INIT_LIST_HEAD(&s->s_dentry_lru);
 		init_rwsem(&s->s_umount);
 		mutex_init(&s->s_lock);
 		lockdep_set_class(&s->s_umount, &type->s_umount_key);
@@ -107,6 +119,7 @@ static struct super_block *alloc_super(struct file_system_type *type)
 		s->s_qcop = sb_quotactl_ops;
 		s->s_op = &default_op;
 		s->s_time_gran = 1000000000;
+		s->cleancache_poolid = -1;
 	}
 out:
 	return s;
@@ -121,6 +134,7 @@ out:
 static inline void destroy_super(struct super_block *s)
 {
 	security_sb_free(s);
+	kfree(s->s_dentry_lru);
 	kfree(s->s_subtype);
 	kfree(s->s_options);
 	kfree(s);
@@ -197,6 +211,7 @@ void deactivate_super(struct super_block *s)
 		vfs_dq_off(s, 0);
 		down_write(&s->s_umount);
 		fs->kill_sb(s);
+		cleancache_flush_fs(s);
 		put_filesystem(fs);
 		put_super(s);
 	}
@@ -223,6 +238,7 @@ void deactivate_locked_super(struct super_block *s)
 		spin_unlock(&sb_lock);
 		vfs_dq_off(s, 0);
 		fs->kill_sb(s);
+		cleancache_flush_fs(s);
 		put_filesystem(fs);
 		put_super(s);
 	} else {
@@ -42,7 +42,7 @@
 
 static kmem_zone_t *xfs_buf_zone;
 STATIC int xfsbufd(void *);
-STATIC int xfsbufd_wakeup(int, gfp_t);
+STATIC int xfsbufd_wakeup(struct shrinker *, struct shrink_control *);
 STATIC void xfs_buf_delwri_queue(xfs_buf_t *, int);
 static struct shrinker xfs_buf_shake = {
 	.shrink = xfsbufd_wakeup,
@@ -411,7 +411,7 @@ _xfs_buf_lookup_pages(
 					__func__, gfp_mask);
 
 			XFS_STATS_INC(xb_page_retries);
-			xfsbufd_wakeup(0, gfp_mask);
+			xfsbufd_wakeup(NULL, NULL);
 			congestion_wait(BLK_RW_ASYNC, HZ/50);
 			goto retry;
 		}
@@ -1656,8 +1656,8 @@ xfs_buf_runall_queues(
 
 STATIC int
 xfsbufd_wakeup(
-	int			priority,
-	gfp_t			mask)
+	struct shrinker		*shrink,
+	struct shrink_control	*sc)
 {
 	xfs_buftarg_t		*btp;
 
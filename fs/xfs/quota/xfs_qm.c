@@ -71,7 +71,7 @@ STATIC void	xfs_qm_freelist_destroy(xfs_frlist_t *);
 
 STATIC int	xfs_qm_init_quotainos(xfs_mount_t *);
 STATIC int	xfs_qm_init_quotainfo(xfs_mount_t *);
-STATIC int	xfs_qm_shake(int, gfp_t);
+STATIC int	xfs_qm_shake(struct shrinker *, struct shrink_control *);
 
 static struct shrinker xfs_qm_shaker = {
 	.shrink = xfs_qm_shake,
@@ -2069,11 +2069,11 @@ xfs_qm_shake_freelist(
  */
 /* ARGSUSED */
 STATIC int
-xfs_qm_shake(int nr_to_scan, gfp_t gfp_mask)
+xfs_qm_shake(struct shrinker *shrink, struct shrink_control *sc)
 {
 	int	ndqused, nfree, n;
 
-	if (!kmem_shake_allow(gfp_mask))
+	if (!kmem_shake_allow(sc->gfp_mask))
 		return 0;
 	if (!xfs_Gqm)
 		return 0;
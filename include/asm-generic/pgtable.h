@@ -344,6 +344,35 @@ extern void untrack_pfn_vma(struct vm_area_struct *vma, unsigned long pfn,
 				unsigned long size);
 #endif
 
+#ifdef CONFIG_HAVE_ARCH_HUGE_VMAP
+/*
+ * Kernel page table helpers used by vmap and ioremap to install, query and
+ * tear down PMD-sized leaf mappings.  pmd_set_huge() returns 0 when the
+ * range cannot be mapped huge and the caller must fall back to ptes.
+ */
+extern int arch_vmap_pmd_supported(void);
+extern int pmd_set_huge(pmd_t *pmd, phys_addr_t addr, pgprot_t prot);
+extern int pmd_clear_huge(pmd_t *pmd);
+extern int pmd_huge_vmap(pmd_t pmd);
+#else
+static inline int arch_vmap_pmd_supported(void)
+{
+	return 0;
+}
+static inline int pmd_set_huge(pmd_t *pmd, phys_addr_t addr, pgprot_t prot)
+{
+	return 0;
+}
+static inline int pmd_clear_huge(pmd_t *pmd)
+{
+	return 0;
+}
+static inline int pmd_huge_vmap(pmd_t pmd)
+{
+	return 0;
+}
+#endif
+
 #endif /* !__ASSEMBLY__ */
 
 #endif /* _ASM_GENERIC_PGTABLE_H */
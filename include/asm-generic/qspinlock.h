@@ -0,0 +1,94 @@
+#ifndef __ASM_GENERIC_QSPINLOCK_H
+#define __ASM_GENERIC_QSPINLOCK_H
+/*
+ * Queued spinlocks
+ *
+ * An MCS-style lock squeezed into the 32-bit word of raw_spinlock_t:
+ * contending CPUs queue up and each spins on its own per-cpu node
+ * instead of on the lock, so that a release only touches the cache
+ * line of the next waiter.  The lock word holds
+ *
+ *  0- 7: locked byte
+ *     8: pending
+ *  9-15: not used
+ * 16-17: tail index (nesting level of the queued node)
+ * 18-31: tail cpu (+1)
+ *
+ * The first contender does not queue, it sets the pending bit and spins
+ * on the lock word; only from the second one on does the queue get
+ * used.  The tail encodes the last queued node; 0 means no queue.
+ *
+ * The architecture provides raw_spinlock_t as a single 32-bit word, and
+ * may provide its own queued_spin_cmpxchg() and queued_spin_unlock()
+ * before including this file.
+ *
+ * See kernel/qspinlock.c for the slow path.
+ */
+#include <asm/atomic.h>
+
+#define _Q_LOCKED_OFFSET	0
+#define _Q_LOCKED_BITS		8
+#define _Q_LOCKED_MASK		(((1U << _Q_LOCKED_BITS) - 1) << _Q_LOCKED_OFFSET)
+#define _Q_LOCKED_VAL		(1U << _Q_LOCKED_OFFSET)
+
+#define _Q_PENDING_OFFSET	8
+#define _Q_PENDING_VAL		(1U << _Q_PENDING_OFFSET)
+
+#define _Q_TAIL_IDX_OFFSET	16
+#define _Q_TAIL_IDX_BITS	2
+#define _Q_TAIL_IDX_MASK	(((1U << _Q_TAIL_IDX_BITS) - 1) << _Q_TAIL_IDX_OFFSET)
+
+#define _Q_TAIL_CPU_OFFSET	(_Q_TAIL_IDX_OFFSET + _Q_TAIL_IDX_BITS)
+#define _Q_TAIL_CPU_BITS	(32 - _Q_TAIL_CPU_OFFSET)
+#define _Q_TAIL_MASK		(~0U << _Q_TAIL_IDX_OFFSET)
+
+#define _Q_LOCKED_PENDING_MASK	(_Q_LOCKED_MASK | _Q_PENDING_VAL)
+
+#if NR_CPUS >= (1U << _Q_TAIL_CPU_BITS)
+#error "queued spinlocks support at most 16383 cpus"
+#endif
+
+#define __queued_spin_val(lock)	((atomic_t *)(lock))
+
+extern void queued_spin_lock_slowpath(raw_spinlock_t *lock, u32 val);
+
+#ifndef queued_spin_cmpxchg
+#define queued_spin_cmpxchg(lock, old, new)			\
+	((u32)atomic_cmpxchg(__queued_spin_val(lock), (old), (new)))
+#endif
+
+static inline int queued_spin_is_locked(raw_spinlock_t *lock)
+{
+	return atomic_read(__queued_spin_val(lock)) != 0;
+}
+
+static inline int queued_spin_is_contended(raw_spinlock_t *lock)
+{
+	return (atomic_read(__queued_spin_val(lock)) & ~_Q_LOCKED_MASK) != 0;
+}
+
+static __always_inline int queued_spin_trylock(raw_spinlock_t *lock)
+{
+	return !atomic_read(__queued_spin_val(lock)) &&
+	       queued_spin_cmpxchg(lock, 0, _Q_LOCKED_VAL) == 0;
+}
+
+static __always_inline void queued_spin_lock(raw_spinlock_t *lock)
+{
+	u32 val;
+
+	val = queued_spin_cmpxchg(lock, 0, _Q_LOCKED_VAL);
+	if (likely(val == 0))
+		return;
+	queued_spin_lock_slowpath(lock, val);
+}
+
+#ifndef queued_spin_unlock
+static __always_inline void queued_spin_unlock(raw_spinlock_t *lock)
+{
+	smp_mb__before_atomic_dec();
+	atomic_sub(_Q_LOCKED_VAL, __queued_spin_val(lock));
+}
+#endif
+
+#endif /* __ASM_GENERIC_QSPINLOCK_H */
@@ -24,6 +24,7 @@ struct cgroup_subsys;
 struct inode;
 struct cgroup;
 struct css_id;
+struct eventfd_ctx;
 
 extern int cgroup_init_early(void);
 extern int cgroup_init(void);
@@ -187,6 +188,10 @@ struct cgroup {
 
 	/* For RCU-protected deletion */
 	struct rcu_head rcu_head;
+
+	/* List of events userspace wants to receive */
+	struct list_head event_list;
+	spinlock_t event_list_lock;
 };
 
 /*
@@ -326,6 +331,22 @@ struct cftype {
 	int (*trigger)(struct cgroup *cgrp, unsigned int event);
 
 	int (*release)(struct inode *inode, struct file *file);
+
+	/*
+	 * register_event() adds a userspace waiter, through
+	 * cgroup.event_control, for changes related to this cftype;
+	 * @args is the rest of the line written there.  Notify the
+	 * waiter with eventfd_signal() on @eventfd.
+	 */
+	int (*register_event)(struct cgroup *cgrp, struct cftype *cft,
+			struct eventfd_ctx *eventfd, const char *args);
+	/*
+	 * unregister_event() is called when userspace closes the eventfd
+	 * or the cgroup is removed.  It must be implemented whenever
+	 * register_event() is, and cannot fail.
+	 */
+	void (*unregister_event)(struct cgroup *cgrp, struct cftype *cft,
+			struct eventfd_ctx *eventfd);
 };
 
 struct cgroup_scanner {
@@ -0,0 +1,130 @@
+#ifndef _LINUX_CLEANCACHE_H
+#define _LINUX_CLEANCACHE_H
+
+/*
+ * Cleancache: a second chance for clean page cache pages.
+ *
+ * When reclaim evicts a clean, uptodate page of a filesystem that opted
+ * in with cleancache_init_fs(), the page is offered to a backend, keyed by
+ * the filesystem's pool, the inode number and the page index.  The backend
+ * may keep a copy, or not, and may drop it again at any time.  A read of
+ * a page not in the page cache first asks the backend for it, and only
+ * goes to disk if it does not have it any more.
+ *
+ * A successful get removes the copy from the backend, so that a page is
+ * in the page cache or in cleancache, never in both.  Truncation and
+ * invalidation of an inode flush all of its pages from the backend.
+ */
+
+#include <linux/fs.h>
+#include <linux/mm.h>
+
+struct cleancache_ops {
+	/* Returns a pool id >= 0 for a new filesystem, or < 0 */
+	int (*init_fs)(size_t pagesize);
+	/* Returns 0 and fills @page if the backend has a copy, or < 0 */
+	int (*get_page)(int pool_id, ino_t ino, pgoff_t index,
+			struct page *page);
+	/* Called with the page locked, and interrupts disabled */
+	void (*put_page)(int pool_id, ino_t ino, pgoff_t index,
+			 struct page *page);
+	void (*flush_page)(int pool_id, ino_t ino, pgoff_t index);
+	void (*flush_inode)(int pool_id, ino_t ino);
+	void (*flush_fs)(int pool_id);
+};
+
+#ifdef CONFIG_CLEANCACHE
+
+extern int cleancache_enabled;
+
+extern int cleancache_register_ops(struct cleancache_ops *ops);
+extern void __cleancache_init_fs(struct super_block *sb);
+extern int __cleancache_get_page(struct page *page);
+extern void __cleancache_put_page(struct page *page);
+extern void __cleancache_flush_page(struct address_space *mapping,
+				    struct page *page);
+extern void __cleancache_flush_inode(struct address_space *mapping);
+extern void __cleancache_flush_fs(struct super_block *sb);
+
+static inline int cleancache_fs_enabled(struct address_space *mapping)
+{
+	return mapping->host->i_sb->cleancache_poolid >= 0;
+}
+
+#else
+
+#define cleancache_enabled	0
+
+static inline int cleancache_fs_enabled(struct address_space *mapping)
+{
+	return 0;
+}
+
+static inline void __cleancache_init_fs(struct super_block *sb)
+{
+}
+
+static inline int __cleancache_get_page(struct page *page)
+{
+	return -1;
+}
+
+static inline void __cleancache_put_page(struct page *page)
+{
+}
+
+static inline void __cleancache_flush_page(struct address_space *mapping,
+					   struct page *page)
+{
+}
+
+static inline void __cleancache_flush_inode(struct address_space *mapping)
+{
+}
+
+static inline void __cleancache_flush_fs(struct super_block *sb)
+{
+}
+
+#endif /* CONFIG_CLEANCACHE */
+
+/* Called by a filesystem from fill_super to use cleancache */
+static inline void cleancache_init_fs(struct super_block *sb)
+{
+	if (cleancache_enabled)
+		__cleancache_init_fs(sb);
+}
+
+static inline int cleancache_get_page(struct page *page)
+{
+	if (cleancache_enabled && cleancache_fs_enabled(page->mapping))
+		return __cleancache_get_page(page);
+	return -1;
+}
+
+static inline void cleancache_put_page(struct page *page)
+{
+	if (cleancache_enabled && cleancache_fs_enabled(page->mapping))
+		__cleancache_put_page(page);
+}
+
+static inline void cleancache_flush_page(struct address_space *mapping,
+					 struct page *page)
+{
+	if (cleancache_enabled && cleancache_fs_enabled(mapping))
+		__cleancache_flush_page(mapping, page);
+}
+
+static inline void cleancache_flush_inode(struct address_space *mapping)
+{
+	if (cleancache_enabled && cleancache_fs_enabled(mapping))
+		__cleancache_flush_inode(mapping);
+}
+
+static inline void cleancache_flush_fs(struct super_block *sb)
+{
+	if (cleancache_enabled && sb->cleancache_poolid >= 0)
+		__cleancache_flush_fs(sb);
+}
+
+#endif /* _LINUX_CLEANCACHE_H */
@@ -1310,6 +1310,15 @@ extern spinlock_t sb_lock;
 
 #define sb_entry(list)  list_entry((list), struct super_block, s_list)
 #define S_BIAS (1<<30)
+/*
+ * The unused dentries of a superblock that were allocated on one node,
+ * see fs/dcache.c.
+ */
+struct sb_dentry_lru {
+	struct list_head	list;
+	int			nr_unused;	/* # of dentry on lru */
+};
+
 struct super_block {
 	struct list_head	s_list;		/* Keep this first */
 	dev_t			s_dev;		/* search index; _not_ kdev_t */
@@ -1341,9 +1350,8 @@ struct super_block {
 	struct list_head	s_more_io;	/* parked for more writeback */
 	struct hlist_head	s_anon;		/* anonymous dentries for (nfs) exporting */
 	struct list_head	s_files;
-	/* s_dentry_lru and s_nr_dentry_unused are protected by dcache_lock */
-	struct list_head	s_dentry_lru;	/* unused dentry lru */
-	int			s_nr_dentry_unused;	/* # of dentry on lru */
+	/* s_dentry_lru is protected by dcache_lock */
+	struct sb_dentry_lru	*s_dentry_lru;	/* unused dentry lru, per node */
 
 	struct block_device	*s_bdev;
 	struct mtd_info		*s_mtd;
@@ -1379,6 +1387,12 @@ struct super_block {
 	 * generic_show_options()
 	 */
 	char *s_options;
+
+	/*
+	 * Cleancache pool of the filesystem, or -1 when it does not use
+	 * cleancache: see include/linux/cleancache.h
+	 */
+	int cleancache_poolid;
 };
 
 extern struct timespec current_fs_time(struct super_block *sb);
@@ -1543,6 +1557,9 @@ struct inode_operations {
 
 struct seq_file;
 
+/* rw_copy_check_uvector() type for an iovec of another address space */
+#define CHECK_IOVEC_ONLY -1
+
 ssize_t rw_copy_check_uvector(int type, const struct iovec __user * uvector,
 				unsigned long nr_segs, unsigned long fast_segs,
 				struct iovec *fast_pointer,
@@ -0,0 +1,116 @@
+#ifndef _LINUX_HUGE_MM_H
+#define _LINUX_HUGE_MM_H
+
+/*
+ * Page cache extents mapped into user space by a single pmd.
+ *
+ * The extent itself is HPAGE_PMD_NR ordinary page cache pages that happen
+ * to be physically contiguous and naturally aligned; only the mapping is
+ * huge.  Anything that needs to look at individual ptes splits the pmd
+ * back into a pte table first with split_huge_pmd().
+ */
+
+struct mmu_gather;
+
+#define HPAGE_PMD_SHIFT		PMD_SHIFT
+#define HPAGE_PMD_SIZE		(1UL << HPAGE_PMD_SHIFT)
+#define HPAGE_PMD_MASK		(~(HPAGE_PMD_SIZE - 1))
+#define HPAGE_PMD_ORDER		(HPAGE_PMD_SHIFT - PAGE_SHIFT)
+#define HPAGE_PMD_NR		(1 << HPAGE_PMD_ORDER)
+
+#ifdef CONFIG_SHMEM_HUGEPAGE
+
+extern int do_set_huge_pmd(struct vm_area_struct *vma, unsigned long address,
+			   pmd_t *pmd, struct page *page, unsigned int flags);
+extern int huge_pmd_fault(struct vm_area_struct *vma, unsigned long address,
+			  pmd_t *pmd, unsigned int flags);
+extern void __split_huge_pmd(struct mm_struct *mm, pmd_t *pmd,
+			     unsigned long address);
+extern int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
+			pmd_t *pmd, unsigned long address);
+extern struct page *follow_huge_pmd_page(struct vm_area_struct *vma,
+					 unsigned long address, pmd_t *pmd,
+					 unsigned int flags);
+extern pmd_t *page_check_huge_pmd(struct page *page, struct mm_struct *mm,
+				  unsigned long address);
+
+/* Replace a huge pmd by a pte table mapping the same pages */
+static inline void split_huge_pmd(struct mm_struct *mm, pmd_t *pmd,
+				  unsigned long address)
+{
+	if (pmd_trans_huge(*pmd))
+		__split_huge_pmd(mm, pmd, address);
+}
+
+/*
+ * Like pmd_none_or_clear_bad(), but leaves a huge pmd alone: a huge pmd
+ * looks bad to pmd_bad().  The pmd is read once, so a concurrent fault
+ * populating a none pmd with a huge one cannot be mistaken for a pte table.
+ */
+static inline int pmd_none_or_trans_huge_or_clear_bad(pmd_t *pmd)
+{
+	pmd_t pmdval = *pmd;
+
+	barrier();
+	if (pmd_none(pmdval) || pmd_trans_huge(pmdval))
+		return 1;
+	if (unlikely(pmd_bad(pmdval))) {
+		pmd_clear_bad(pmd);
+		return 1;
+	}
+	return 0;
+}
+
+#else /* !CONFIG_SHMEM_HUGEPAGE */
+
+static inline int pmd_trans_huge(pmd_t pmd)
+{
+	return 0;
+}
+
+/* Only ever referenced behind pmd_trans_huge(), so never linked */
+extern pte_t huge_pmd_pte(pmd_t pmd, unsigned long addr);
+extern int pmdp_clear_flush_young(struct vm_area_struct *vma,
+				  unsigned long address, pmd_t *pmdp);
+
+static inline int huge_pmd_fault(struct vm_area_struct *vma,
+				 unsigned long address, pmd_t *pmd,
+				 unsigned int flags)
+{
+	return VM_FAULT_FALLBACK;
+}
+
+static inline void split_huge_pmd(struct mm_struct *mm, pmd_t *pmd,
+				  unsigned long address)
+{
+}
+
+static inline int zap_huge_pmd(struct mmu_gather *tlb,
+			       struct vm_area_struct *vma, pmd_t *pmd,
+			       unsigned long address)
+{
+	return 0;
+}
+
+static inline struct page *follow_huge_pmd_page(struct vm_area_struct *vma,
+						unsigned long address,
+						pmd_t *pmd, unsigned int flags)
+{
+	return NULL;
+}
+
+static inline pmd_t *page_check_huge_pmd(struct page *page,
+					 struct mm_struct *mm,
+					 unsigned long address)
+{
+	return NULL;
+}
+
+static inline int pmd_none_or_trans_huge_or_clear_bad(pmd_t *pmd)
+{
+	return pmd_none_or_clear_bad(pmd);
+}
+
+#endif /* CONFIG_SHMEM_HUGEPAGE */
+
+#endif /* _LINUX_HUGE_MM_H */
@@ -118,6 +118,11 @@ static inline bool mem_cgroup_disabled(void)
 
 extern bool mem_cgroup_oom_called(struct task_struct *task);
 void mem_cgroup_update_mapped_file_stat(struct page *page, int val);
+extern void mem_cgroup_vmpressure(gfp_t gfp_mask, struct mem_cgroup *memcg,
+				  unsigned long scanned,
+				  unsigned long reclaimed);
+extern void mem_cgroup_vmpressure_prio(gfp_t gfp_mask,
+				       struct mem_cgroup *memcg, int prio);
 #else /* CONFIG_CGROUP_MEM_RES_CTLR */
 struct mem_cgroup;
 
@@ -276,6 +281,19 @@ static inline void mem_cgroup_update_mapped_file_stat(struct page *page,
 {
 }
 
+static inline void mem_cgroup_vmpressure(gfp_t gfp_mask,
+					 struct mem_cgroup *memcg,
+					 unsigned long scanned,
+					 unsigned long reclaimed)
+{
+}
+
+static inline void mem_cgroup_vmpressure_prio(gfp_t gfp_mask,
+					      struct mem_cgroup *memcg,
+					      int prio)
+{
+}
+
 #endif /* CONFIG_CGROUP_MEM_CONT */
 
 #endif /* _LINUX_MEMCONTROL_H */
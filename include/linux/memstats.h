@@ -0,0 +1,88 @@
+/* memstats.h - exporting per-process memory usage
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef _LINUX_MEMSTATS_H
+#define _LINUX_MEMSTATS_H
+
+#include <linux/types.h>
+#include <linux/cgroupstats.h>
+
+/*
+ * The counters of /proc/pid/smaps_rollup, in bytes, for one process.
+ * They are sent over the taskstats genetlink family, one process on
+ * MEMSTATS_CMD_GET with MEMSTATS_CMD_ATTR_PID, or every process the
+ * caller may see when the command is sent as a dump request.
+ *
+ * New fields go at the end, with MEMSTATS_VERSION incremented.
+ */
+#define MEMSTATS_VERSION	1
+
+struct memstats {
+	__u32	version;
+	__u32	pid;			/* Thread group id */
+	__u64	size;			/* Sum of the vma sizes */
+	__u64	rss;
+	__u64	pss;
+	__u64	shared_clean;
+	__u64	shared_dirty;
+	__u64	private_clean;
+	__u64	private_dirty;
+	__u64	referenced;
+	__u64	swap;
+	__u64	shmem_pmd_mapped;
+};
+
+/*
+ * Commands sent from userspace
+ * Not versioned. New commands should only be inserted at the enum's end
+ * prior to __MEMSTATS_CMD_MAX
+ */
+
+enum {
+	MEMSTATS_CMD_UNSPEC = __CGROUPSTATS_CMD_MAX,	/* Reserved */
+	MEMSTATS_CMD_GET,		/* user->kernel request/get-response */
+	MEMSTATS_CMD_NEW,		/* kernel->user reply */
+	__MEMSTATS_CMD_MAX,
+};
+
+#define MEMSTATS_CMD_MAX (__MEMSTATS_CMD_MAX - 1)
+
+enum {
+	MEMSTATS_TYPE_UNSPEC = 0,	/* Reserved */
+	MEMSTATS_TYPE_STATS,		/* contains a struct memstats */
+	__MEMSTATS_TYPE_MAX,
+};
+
+#define MEMSTATS_TYPE_MAX (__MEMSTATS_TYPE_MAX - 1)
+
+enum {
+	MEMSTATS_CMD_ATTR_UNSPEC = 0,
+	MEMSTATS_CMD_ATTR_PID,
+	__MEMSTATS_CMD_ATTR_MAX,
+};
+
+#define MEMSTATS_CMD_ATTR_MAX (__MEMSTATS_CMD_ATTR_MAX - 1)
+
+#ifdef __KERNEL__
+struct task_struct;
+
+#ifdef CONFIG_PROC_PAGE_MONITOR
+extern int memstats_build(struct memstats *stats, struct task_struct *task);
+#else
+static inline int memstats_build(struct memstats *stats,
+				 struct task_struct *task)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+#endif /* __KERNEL__ */
+
+#endif /* _LINUX_MEMSTATS_H */
@@ -103,6 +103,7 @@ extern unsigned int kobjsize(const void *objp);
 #define VM_MIXEDMAP	0x10000000	/* Can contain "struct page" and pure PFN pages */
 #define VM_SAO		0x20000000	/* Strong Access Ordering (powerpc) */
 #define VM_PFN_AT_MMAP	0x40000000	/* PFNMAP vma that is fully mapped at mmap time */
+#define VM_HUGEPAGE	0x80000000	/* MADV_HUGEPAGE: map with huge pmds if possible */
 
 #ifndef VM_STACK_DEFAULT_FLAGS		/* arch can override this */
 #define VM_STACK_DEFAULT_FLAGS VM_DATA_DEFAULT_FLAGS
@@ -184,6 +185,14 @@ struct vm_operations_struct {
 	void (*close)(struct vm_area_struct * area);
 	int (*fault)(struct vm_area_struct *vma, struct vm_fault *vmf);
 
+	/*
+	 * Called for a fault on an empty pmd: may map the whole pmd with a
+	 * huge page and return 0, or return VM_FAULT_FALLBACK to have the
+	 * fault handled with small ptes through ->fault.
+	 */
+	int (*pmd_fault)(struct vm_area_struct *vma, unsigned long address,
+			 pmd_t *pmd, unsigned int flags);
+
 	/* notification that a previously read-only page is about to become
 	 * writable, if an error is returned it will cause a SIGBUS */
 	int (*page_mkwrite)(struct vm_area_struct *vma, struct vm_fault *vmf);
@@ -688,6 +697,7 @@ static inline int page_mapped(struct page *page)
 
 #define VM_FAULT_NOPAGE	0x0100	/* ->fault installed the pte, not return page */
 #define VM_FAULT_LOCKED	0x0200	/* ->fault locked the returned page */
+#define VM_FAULT_FALLBACK 0x0400	/* ->pmd_fault declined, use ptes */
 
 #define VM_FAULT_ERROR	(VM_FAULT_OOM | VM_FAULT_SIGBUS)
 
@@ -702,12 +712,18 @@ extern void show_free_areas(void);
 
 #ifdef CONFIG_SHMEM
 extern int shmem_lock(struct file *file, int lock, struct user_struct *user);
+extern int shmem_mapping(struct address_space *mapping);
 #else
 static inline int shmem_lock(struct file *file, int lock,
 			    struct user_struct *user)
 {
 	return 0;
 }
+
+static inline int shmem_mapping(struct address_space *mapping)
+{
+	return 0;
+}
 #endif
 struct file *shmem_file_setup(const char *name, loff_t size, unsigned long flags);
 
@@ -844,30 +860,55 @@ extern int mprotect_fixup(struct vm_area_struct *vma,
 int __get_user_pages_fast(unsigned long start, int nr_pages, int write,
 			  struct page **pages);
 
+/*
+ * What a shrinker is asked to do: see struct shrinker.
+ */
+struct shrink_control {
+	gfp_t gfp_mask;
+
+	/* How many objects to scan, or 0 to query the cache size */
+	unsigned long nr_to_scan;
+
+	/* The node whose objects to scan, or -1 for any of them */
+	int nid;
+};
+
 /*
  * A callback you can register to apply pressure to ageable caches.
  *
- * 'shrink' is passed a count 'nr_to_scan' and a 'gfpmask'.  It should
- * look through the least-recently-used 'nr_to_scan' entries and
- * attempt to free them up.  It should return the number of objects
- * which remain in the cache.  If it returns -1, it means it cannot do
- * any scanning at this time (eg. there is a risk of deadlock).
+ * 'shrink' is passed a shrink_control with a count 'nr_to_scan' and a
+ * 'gfp_mask'.  It should look through the least-recently-used
+ * 'nr_to_scan' entries and attempt to free them up.  It should return
+ * the number of objects which remain in the cache.  If it returns -1,
+ * it means it cannot do any scanning at this time (eg. there is a risk
+ * of deadlock).
  *
- * The 'gfpmask' refers to the allocation we are currently trying to
+ * The 'gfp_mask' refers to the allocation we are currently trying to
  * fulfil.
  *
  * Note that 'shrink' will be passed nr_to_scan == 0 when the VM is
  * querying the cache size, so a fastpath for that case is appropriate.
+ *
+ * A shrinker with SHRINKER_NUMA_AWARE set keeps its objects on per-node
+ * lists: it is called for each node under reclaim with that node in
+ * 'nid', and must then only count and scan the objects on it.  Other
+ * shrinkers are called once per reclaim pass, with 'nid' -1.
  */
 struct shrinker {
-	int (*shrink)(int nr_to_scan, gfp_t gfp_mask);
+	int (*shrink)(struct shrinker *shrinker, struct shrink_control *sc);
 	int seeks;	/* seeks to recreate an obj */
+	unsigned long flags;
 
 	/* These are for internal use */
 	struct list_head list;
 	long nr;	/* objs pending delete */
+	long *nr_deferred;	/* per node, if SHRINKER_NUMA_AWARE */
 };
 #define DEFAULT_SEEKS 2 /* A good number if you don't know better. */
+
+/* Flags */
+#define SHRINKER_NUMA_AWARE	(1 << 0)
+
 extern void register_shrinker(struct shrinker *);
 extern void unregister_shrinker(struct shrinker *);
 
@@ -941,6 +982,9 @@ static inline pmd_t *pmd_alloc(struct mm_struct *mm, pud_t *pud, unsigned long a
 static inline void pgtable_page_ctor(struct page *page)
 {
 	pte_lock_init(page);
+#ifdef CONFIG_PTE_SHARING
+	page->index = 0;	/* see pte_table_uncounted() */
+#endif
 	inc_zone_page_state(page, NR_PAGETABLE);
 }
 
@@ -950,6 +994,97 @@ static inline void pgtable_page_dtor(struct page *page)
 	dec_zone_page_state(page, NR_PAGETABLE);
 }
 
+extern int vma_table_shareable(struct vm_area_struct *vma, unsigned long addr,
+			       unsigned long size);
+extern unsigned long page_table_shareable(struct vm_area_struct *svma,
+					  struct vm_area_struct *vma,
+					  unsigned long addr, pgoff_t idx,
+					  unsigned long size);
+
+#ifdef CONFIG_PTE_SHARING
+/*
+ * Fork may share a pte table of private anonymous memory with the child,
+ * instead of copying it: see share_pte_table().  Mappings of the same part
+ * of a file may share one too: see share_file_pte_table().  The mms sharing
+ * a table beyond the first are counted in its _mapcount, otherwise unused
+ * for page tables, and each holds a reference on the page.
+ */
+static inline int pte_table_shared(struct page *table)
+{
+	return atomic_read(&table->_mapcount) >= 0;
+}
+
+/* A shared table is mapped read-only, until copied on the first fault */
+static inline int pmd_cow_shared(pmd_t pmd)
+{
+	return !pmd_write(pmd);
+}
+
+/*
+ * Once another mm has taken up a file table, the pages it maps are not
+ * counted in the rss of any of the mms mapping it, as for hugetlb: the
+ * one that faulted a page in may be gone when it is unmapped.  This
+ * lasts until the table is freed, and is only changed under its lock.
+ */
+static inline int pte_table_uncounted(struct page *table)
+{
+	return table->index != 0;
+}
+
+static inline void set_pte_table_uncounted(struct page *table)
+{
+	table->index = 1;
+}
+
+extern int sysctl_fork_share_pte;
+extern int unshare_pte_table(struct vm_area_struct *vma, pmd_t *pmd,
+			     unsigned long address);
+extern int unshare_pte_range(struct vm_area_struct *vma,
+			     unsigned long start, unsigned long end);
+extern int unshare_pte_boundary(struct vm_area_struct *vma,
+				unsigned long address);
+extern void flush_shared_pte(struct vm_area_struct *vma, pte_t *pte,
+			     unsigned long address);
+#else
+static inline int pte_table_shared(struct page *table)
+{
+	return 0;
+}
+
+static inline int pmd_cow_shared(pmd_t pmd)
+{
+	return 0;
+}
+
+static inline int pte_table_uncounted(struct page *table)
+{
+	return 0;
+}
+
+static inline int unshare_pte_table(struct vm_area_struct *vma, pmd_t *pmd,
+				    unsigned long address)
+{
+	return 0;
+}
+
+static inline int unshare_pte_range(struct vm_area_struct *vma,
+				    unsigned long start, unsigned long end)
+{
+	return 0;
+}
+
+static inline int unshare_pte_boundary(struct vm_area_struct *vma,
+				       unsigned long address)
+{
+	return 0;
+}
+
+static inline void flush_shared_pte(struct vm_area_struct *vma, pte_t *pte,
+				    unsigned long address)
+{
+}
+#endif /* CONFIG_PTE_SHARING */
+
 #define pte_offset_map_lock(mm, pmd, address, ptlp)	\
 ({							\
 	spinlock_t *__ptl = pte_lockptr(mm, pmd);	\
@@ -976,6 +1111,8 @@ static inline void pgtable_page_dtor(struct page *page)
 	((unlikely(!pmd_present(*(pmd))) && __pte_alloc_kernel(pmd, address))? \
 		NULL: pte_offset_kernel(pmd, address))
 
+#include <linux/huge_mm.h>
+
 extern void free_area_init(unsigned long * zones_size);
 extern void free_area_init_node(int nid, unsigned long * zones_size,
 		unsigned long zone_start_pfn, unsigned long *zholes_size);
@@ -1277,7 +1414,7 @@ int in_gate_area_no_task(unsigned long addr);
 int drop_caches_sysctl_handler(struct ctl_table *, int, struct file *,
 					void __user *, size_t *, loff_t *);
 unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
-			unsigned long lru_pages);
+			unsigned long lru_pages, const nodemask_t *nodes);
 
 #ifndef CONFIG_MMU
 #define randomize_va_space 0
@@ -286,6 +286,10 @@ struct mm_struct {
 #ifdef CONFIG_MMU_NOTIFIER
 	struct mmu_notifier_mm *mmu_notifier_mm;
 #endif
+#ifdef CONFIG_SHMEM_HUGEPAGE
+	/* pte tables set aside for splitting huge pmds, page_table_lock */
+	struct list_head huge_pmd_ptes;
+#endif
 };
 
 /* Future-safe accessor for struct mm_struct's cpu_vm_mask. */
@@ -599,6 +599,10 @@ extern struct page *mem_map;
  * per-zone basis.
  */
 struct bootmem_data;
+
+/* Upper limit of kswapd threads per node, see /sys/kernel/mm/kswapd_threads */
+#define MAX_KSWAPD_THREADS	8
+
 typedef struct pglist_data {
 	struct zone node_zones[MAX_NR_ZONES];
 	struct zonelist node_zonelists[MAX_ZONELISTS];
@@ -626,8 +630,22 @@ typedef struct pglist_data {
 					     range, including holes */
 	int node_id;
 	wait_queue_head_t kswapd_wait;
-	struct task_struct *kswapd;
+	struct task_struct *kswapd[MAX_KSWAPD_THREADS];
+	int nr_kswapd;			/* kswapd threads running */
 	int kswapd_max_order;
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+	/*
+	 * Struct pages from first_deferred_pfn to deferred_end_pfn are not
+	 * initialised at boot: a kthread does them in chunks, or allocations
+	 * that run short before it is done.  deferred_lock protects the
+	 * cursor, the chunks in flight and the count of pages freed.
+	 */
+	spinlock_t deferred_lock;
+	unsigned long first_deferred_pfn;
+	unsigned long deferred_end_pfn;
+	unsigned long deferred_freed;
+	int deferred_inflight;
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
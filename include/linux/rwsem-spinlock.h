@@ -27,11 +27,15 @@ struct rwsem_waiter;
  * - if activity is +ve then that is the number of active readers
  * - if activity is -1 then there is one active writer
  * - if wait_list is not empty, then there are processes waiting for the semaphore
+ * - owner is the active writer, if any, for writers to spin on
  */
 struct rw_semaphore {
 	__s32			activity;
 	spinlock_t		wait_lock;
 	struct list_head	wait_list;
+#ifdef CONFIG_SMP
+	struct thread_info	*owner;
+#endif
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	struct lockdep_map dep_map;
 #endif
@@ -38,6 +38,7 @@
 #define SCHED_BATCH		3
 /* SCHED_ISO: reserved but not implemented yet */
 #define SCHED_IDLE		5
+#define SCHED_DEADLINE		6
 
 #ifdef __KERNEL__
 
@@ -92,6 +93,39 @@ struct sched_param {
 
 #include <asm/processor.h>
 
+/*
+ * Extended scheduling parameters, for sched_setattr() and sched_getattr().
+ *
+ * @size is the size of the structure as known to the caller, so that it
+ * can grow: a kernel handed a larger structure checks that the fields it
+ * does not know about are zero.
+ *
+ * For SCHED_DEADLINE, a task gets @sched_runtime nanoseconds of execution
+ * every @sched_period nanoseconds, and has them by @sched_deadline
+ * nanoseconds after the start of each period.  A zero @sched_period means
+ * the period is @sched_deadline.  @sched_nice is used by SCHED_NORMAL and
+ * SCHED_BATCH, @sched_priority by SCHED_FIFO and SCHED_RR.
+ */
+#define SCHED_ATTR_SIZE_VER0	48	/* sizeof first published struct */
+
+struct sched_attr {
+	u32 size;
+
+	u32 sched_policy;
+	u64 sched_flags;
+
+	/* SCHED_NORMAL, SCHED_BATCH */
+	s32 sched_nice;
+
+	/* SCHED_FIFO, SCHED_RR */
+	u32 sched_priority;
+
+	/* SCHED_DEADLINE */
+	u64 sched_runtime;
+	u64 sched_deadline;
+	u64 sched_period;
+};
+
 struct exec_domain;
 struct futex_pi_state;
 struct robust_list_head;
@@ -169,7 +203,7 @@ extern unsigned long long time_sync_thresh;
 
 /*
  * Task state bitmask. NOTE! These bits are also
- * encoded in fs/proc/array.c: get_task_state().
+ * encoded in kernel/sched.c: get_task_state().
  *
  * We have two separate sets of flags: task->state
  * is about runnability, while task->exit_state are
@@ -296,6 +330,7 @@ extern void update_process_times(int user);
 extern void scheduler_tick(void);
 
 extern void sched_show_task(struct task_struct *p);
+extern const char *get_task_state(struct task_struct *tsk);
 
 #ifdef CONFIG_DETECT_SOFTLOCKUP
 extern void softlockup_tick(void);
@@ -345,6 +380,8 @@ extern signed long schedule_timeout_uninterruptible(signed long timeout);
 asmlinkage void __schedule(void);
 asmlinkage void schedule(void);
 extern int mutex_spin_on_owner(struct mutex *lock, struct thread_info *owner);
+extern int rwsem_spin_on_owner(struct rw_semaphore *sem,
+			       struct thread_info *owner);
 
 struct nsproxy;
 struct user_namespace;
@@ -926,8 +963,6 @@ struct sched_domain {
 	unsigned int balance_interval;	/* initialise to 1. units in ms. */
 	unsigned int nr_balance_failed; /* initialise to 0 */
 
-	u64 last_update;
-
 #ifdef CONFIG_SCHEDSTATS
 	/* load_balance() stats */
 	unsigned int lb_count[CPU_MAX_IDLE_TYPES];
@@ -1027,6 +1062,7 @@ struct sched_class {
 	void (*enqueue_task) (struct rq *rq, struct task_struct *p, int wakeup);
 	void (*dequeue_task) (struct rq *rq, struct task_struct *p, int sleep);
 	void (*yield_task) (struct rq *rq);
+	int (*yield_to_task) (struct rq *rq, struct task_struct *p, int preempt);
 
 	void (*check_preempt_curr) (struct rq *rq, struct task_struct *p, int sync);
 
@@ -1066,6 +1102,7 @@ struct sched_class {
 			     int running);
 	void (*prio_changed) (struct rq *this_rq, struct task_struct *task,
 			     int oldprio, int running);
+	void (*task_dead) (struct task_struct *p);
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	void (*moved_group) (struct task_struct *p);
@@ -1076,6 +1113,16 @@ struct load_weight {
 	unsigned long weight, inv_weight;
 };
 
+/*
+ * Decayed history of the time an entity was runnable, see the per-entity
+ * load tracking in kernel/sched_fair.c.
+ */
+struct sched_avg {
+	u32 runnable_avg_sum, runnable_avg_period;
+	u64 last_runnable_update;
+	unsigned long load_avg_contrib;
+};
+
 /*
  * CFS stats for a schedulable entity (task, task-group etc)
  *
@@ -1105,6 +1152,10 @@ struct sched_entity {
 	u64			start_runtime;
 	u64			avg_wakeup;
 
+#ifdef CONFIG_SMP
+	struct sched_avg	avg;
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	u64			wait_start;
 	u64			wait_max;
@@ -1163,6 +1214,38 @@ struct sched_rt_entity {
 #endif
 };
 
+struct sched_dl_entity {
+	struct rb_node	rb_node;
+
+	/*
+	 * Original scheduling parameters, as set by sched_setattr():
+	 * @dl_runtime of execution every @dl_period, by @dl_deadline
+	 * into each period.  @dl_bw is dl_runtime / dl_period, in the
+	 * fixed point of to_ratio(), as charged to the root domain.
+	 */
+	u64 dl_runtime;
+	u64 dl_deadline;
+	u64 dl_period;
+	u64 dl_bw;
+
+	/*
+	 * The current instance: the runtime left and the absolute
+	 * deadline, as kept by the constant bandwidth server.
+	 */
+	s64 runtime;
+	u64 deadline;
+
+	/*
+	 * @dl_throttled: the runtime is exhausted, the task waits on
+	 * @dl_timer for its next period to be replenished.
+	 * @dl_new: the parameters are new, a fresh instance is set up
+	 * at the next enqueue.
+	 */
+	int dl_throttled, dl_new;
+
+	struct hrtimer dl_timer;
+};
+
 struct task_struct {
 	volatile long state;	/* -1 unrunnable, 0 runnable, >0 stopped */
 	void *stack;
@@ -1183,6 +1266,7 @@ struct task_struct {
 	const struct sched_class *sched_class;
 	struct sched_entity se;
 	struct sched_rt_entity rt;
+	struct sched_dl_entity dl;
 
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	/* list of struct preempt_notifier: */
@@ -1217,6 +1301,9 @@ struct task_struct {
 
 	struct list_head tasks;
 	struct plist_node pushable_tasks;
+#ifdef CONFIG_SMP
+	struct rb_node pushable_dl_tasks;
+#endif
 
 	struct mm_struct *mm, *active_mm;
 
@@ -1485,6 +1572,24 @@ struct task_struct {
 /* Future-safe accessor for struct task_struct's cpus_allowed. */
 #define tsk_cpumask(tsk) (&(tsk)->cpus_allowed)
 
+/*
+ * SCHED_DEADLINE tasks have a priority below every other: they are
+ * ordered among themselves by their deadlines, not by p->prio.
+ */
+#define MAX_DL_PRIO		0
+
+static inline int dl_prio(int prio)
+{
+	if (unlikely(prio < MAX_DL_PRIO))
+		return 1;
+	return 0;
+}
+
+static inline int dl_task(struct task_struct *p)
+{
+	return dl_prio(p->prio);
+}
+
 /*
  * Priority of a process goes from 0..MAX_PRIO-1, valid RT
  * priority is 0..MAX_RT_PRIO-1, and SCHED_NORMAL/SCHED_BATCH
@@ -1674,6 +1779,7 @@ extern cputime_t task_gtime(struct task_struct *p);
 #define PF_EXITING	0x00000004	/* getting shut down */
 #define PF_EXITPIDONE	0x00000008	/* pi exit done on shut down */
 #define PF_VCPU		0x00000010	/* I'm a virtual CPU */
+#define PF_WQ_WORKER	0x00000020	/* I'm a workqueue worker */
 #define PF_FORKNOEXEC	0x00000040	/* forked but didn't exec */
 #define PF_SUPERPRIV	0x00000100	/* used super-user privileges */
 #define PF_DUMPCORE	0x00000200	/* dumped core */
@@ -1808,6 +1914,10 @@ extern void wake_up_idle_cpu(int cpu);
 static inline void wake_up_idle_cpu(int cpu) { }
 #endif
 
+#ifdef CONFIG_NO_HZ_FULL
+extern int sched_can_stop_tick(void);
+#endif
+
 extern unsigned int sysctl_sched_latency;
 extern unsigned int sysctl_sched_min_granularity;
 extern unsigned int sysctl_sched_wakeup_granularity;
@@ -1844,6 +1954,10 @@ int sched_rt_handler(struct ctl_table *table, int write,
 
 extern unsigned int sysctl_sched_compat_yield;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+extern unsigned int sysctl_sched_cfs_bandwidth_slice;
+#endif
+
 #ifdef CONFIG_RT_MUTEXES
 extern int rt_mutex_getprio(struct task_struct *p);
 extern void rt_mutex_setprio(struct task_struct *p, int prio);
@@ -1865,11 +1979,14 @@ extern int idle_cpu(int cpu);
 extern int sched_setscheduler(struct task_struct *, int, struct sched_param *);
 extern int sched_setscheduler_nocheck(struct task_struct *, int,
 				      struct sched_param *);
+extern int sched_setattr(struct task_struct *,
+			 const struct sched_attr *);
 extern struct task_struct *idle_task(int cpu);
 extern struct task_struct *curr_task(int cpu);
 extern void set_curr_task(int cpu, struct task_struct *p);
 
 void yield(void);
+extern int yield_to(struct task_struct *p, int preempt);
 
 /*
  * The default (Linux) execution domain.
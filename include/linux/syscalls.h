@@ -33,6 +33,7 @@ struct pollfd;
 struct rlimit;
 struct rusage;
 struct sched_param;
+struct sched_attr;
 struct semaphore;
 struct sembuf;
 struct shmid_ds;
@@ -761,4 +762,25 @@ int kernel_execve(const char *filename, char *const argv[], char *const envp[]);
 asmlinkage long sys_perf_counter_open(
 		struct perf_counter_attr __user *attr_uptr,
 		pid_t pid, int cpu, int group_fd, unsigned long flags);
+
+asmlinkage long sys_process_vm_readv(pid_t pid,
+				     const struct iovec __user *lvec,
+				     unsigned long liovcnt,
+				     const struct iovec __user *rvec,
+				     unsigned long riovcnt,
+				     unsigned long flags);
+asmlinkage long sys_process_vm_writev(pid_t pid,
+				      const struct iovec __user *lvec,
+				      unsigned long liovcnt,
+				      const struct iovec __user *rvec,
+				      unsigned long riovcnt,
+				      unsigned long flags);
+asmlinkage long sys_sched_setattr(pid_t pid,
+				  struct sched_attr __user *attr,
+				  unsigned int flags);
+asmlinkage long sys_sched_getattr(pid_t pid,
+				  struct sched_attr __user *attr,
+				  unsigned int size,
+				  unsigned int flags);
+asmlinkage long sys_sched_yield_to(pid_t pid);
 #endif
@@ -33,7 +33,7 @@
  */
 
 
-#define TASKSTATS_VERSION	7
+#define TASKSTATS_VERSION	8
 #define TS_COMM_LEN		32	/* should be >= TASK_COMM_LEN
 					 * in linux/sched.h */
 
@@ -163,6 +163,13 @@ struct taskstats {
 	/* Delay waiting for memory reclaim */
 	__u64	freepages_count;
 	__u64	freepages_delay_total;
+
+	/* Current state of a live task, as in /proc/pid/status (v8) */
+	__u64	ac_rss;			/* Resident set size, in KB */
+	__u64	ac_vm;			/* Virtual memory size, in KB */
+	__u32	ac_nr_fds;		/* Open file descriptors */
+	__u8	ac_state;		/* 'R', 'S', 'D', 'T', 'Z' or 'X' */
+	__u8	ac_pad2[3];
 };
 
 
@@ -199,6 +206,8 @@ enum {
 	TASKSTATS_CMD_ATTR_TGID,
 	TASKSTATS_CMD_ATTR_REGISTER_CPUMASK,
 	TASKSTATS_CMD_ATTR_DEREGISTER_CPUMASK,
+	TASKSTATS_CMD_ATTR_DUMP_UID,	/* dump only the tasks of this uid */
+	TASKSTATS_CMD_ATTR_DUMP_LEADERS, /* dump only thread group leaders */
 	__TASKSTATS_CMD_ATTR_MAX,
 };
 
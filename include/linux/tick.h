@@ -43,6 +43,10 @@ enum tick_nohz_mode {
  * @idle_exittime:	Time when the idle state was left
  * @idle_sleeptime:	Sum of the time slept in idle with sched tick stopped
  * @sleep_length:	Duration of the current idle sleep
+ * @full_stopped:	Indicator that the tick has been stopped on a busy
+ *			full dynticks cpu
+ * @full_user:		The task was in user mode when the tick stopped
+ * @full_jiffies:	jiffies up to which the task's time is accounted
  */
 struct tick_sched {
 	struct hrtimer			sched_timer;
@@ -64,6 +68,11 @@ struct tick_sched {
 	unsigned long			last_jiffies;
 	unsigned long			next_jiffies;
 	ktime_t				idle_expires;
+#ifdef CONFIG_NO_HZ_FULL
+	int				full_stopped;
+	int				full_user;
+	unsigned long			full_jiffies;
+#endif
 };
 
 extern void __init tick_init(void);
@@ -131,4 +140,36 @@ static inline ktime_t tick_nohz_get_sleep_length(void)
 static inline u64 get_cpu_idle_time_us(int cpu, u64 *unused) { return -1; }
 # endif /* !NO_HZ */
 
+struct task_struct;
+
+# ifdef CONFIG_NO_HZ_FULL
+extern int tick_nohz_full_running;
+extern cpumask_var_t tick_nohz_full_mask;
+
+static inline int tick_nohz_full_enabled(void)
+{
+	return tick_nohz_full_running;
+}
+
+static inline int tick_nohz_full_cpu(int cpu)
+{
+	if (!tick_nohz_full_running)
+		return 0;
+
+	return cpumask_test_cpu(cpu, tick_nohz_full_mask);
+}
+
+extern void tick_nohz_full_kick(void);
+extern void tick_nohz_full_kick_cpu(int cpu);
+extern void tick_nohz_full_kick_all(void);
+extern void tick_nohz_task_switch(struct task_struct *prev);
+# else
+static inline int tick_nohz_full_enabled(void) { return 0; }
+static inline int tick_nohz_full_cpu(int cpu) { return 0; }
+static inline void tick_nohz_full_kick(void) { }
+static inline void tick_nohz_full_kick_cpu(int cpu) { }
+static inline void tick_nohz_full_kick_all(void) { }
+static inline void tick_nohz_task_switch(struct task_struct *prev) { }
+# endif /* !NO_HZ_FULL */
+
 #endif
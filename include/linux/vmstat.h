@@ -28,6 +28,10 @@
 
 #define FOR_ALL_ZONES(xx) DMA_ZONE(xx) DMA32_ZONE(xx) xx##_NORMAL HIGHMEM_ZONE(xx) , xx##_MOVABLE
 
+/* One event per kswapd thread index, up to MAX_KSWAPD_THREADS */
+#define FOR_ALL_KSWAPD_THREADS(xx) xx##_0, xx##_1, xx##_2, xx##_3, \
+		xx##_4, xx##_5, xx##_6, xx##_7
+
 enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		FOR_ALL_ZONES(PGALLOC),
 		PGFREE, PGACTIVATE, PGDEACTIVATE,
@@ -41,8 +45,14 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 #endif
 		PGINODESTEAL, SLABS_SCANNED, KSWAPD_STEAL, KSWAPD_INODESTEAL,
 		PAGEOUTRUN, ALLOCSTALL, PGROTATED,
+		FOR_ALL_KSWAPD_THREADS(KSWAPD_THREAD_SCAN),
+		FOR_ALL_KSWAPD_THREADS(KSWAPD_THREAD_STEAL),
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
+#endif
+#ifdef CONFIG_SHMEM_HUGEPAGE
+		SHMEM_HUGE_ALLOC, SHMEM_HUGE_FALLBACK,
+		SHMEM_HUGE_MAPPED, SHMEM_HUGE_SPLIT,
 #endif
 		UNEVICTABLE_PGCULLED,	/* culled to noreclaim list */
 		UNEVICTABLE_PGSCANNED,	/* scanned for reclaimability */
@@ -25,7 +25,10 @@ typedef void (*work_func_t)(struct work_struct *work);
 struct work_struct {
 	atomic_long_t data;
 #define WORK_STRUCT_PENDING 0		/* T if work item pending execution */
-#define WORK_STRUCT_FLAG_MASK (3UL)
+#define WORK_STRUCT_LINKED 1		/* T if next work is linked to this one */
+#define WORK_STRUCT_COLOR 2		/* flush color, see flush_workqueue() */
+#define WORK_STRUCT_INACTIVE 3		/* T if delayed, or a barrier */
+#define WORK_STRUCT_FLAG_MASK (15UL)
 #define WORK_STRUCT_WQ_DATA_MASK (~WORK_STRUCT_FLAG_MASK)
 	struct list_head entry;
 	work_func_t func;
@@ -11,7 +11,12 @@ struct backing_dev_info;
 
 extern spinlock_t inode_lock;
 extern struct list_head inode_in_use;
-extern struct list_head inode_unused;
+
+/*
+ * fs/inode.c: per-node lists of unused inodes
+ */
+extern void inode_lru_move(struct inode *inode);
+extern void inode_lru_count(struct inode *inode, int nr);
 
 /*
  * Yes, writeback.h requires sched.h
@@ -218,6 +218,19 @@ static int shm_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	return sfd->vm_ops->fault(vma, vmf);
 }
 
+#ifdef CONFIG_SHMEM_HUGEPAGE
+static int shm_pmd_fault(struct vm_area_struct *vma, unsigned long address,
+			 pmd_t *pmd, unsigned int flags)
+{
+	struct file *file = vma->vm_file;
+	struct shm_file_data *sfd = shm_file_data(file);
+
+	if (!sfd->vm_ops->pmd_fault)
+		return VM_FAULT_FALLBACK;
+	return sfd->vm_ops->pmd_fault(vma, address, pmd, flags);
+}
+#endif
+
 #ifdef CONFIG_NUMA
 static int shm_set_policy(struct vm_area_struct *vma, struct mempolicy *new)
 {
@@ -316,6 +329,9 @@ static struct vm_operations_struct shm_vm_ops = {
 	.open	= shm_open,	/* callback for a new vm-area open */
 	.close	= shm_close,	/* callback for when the vm-area is released */
 	.fault	= shm_fault,
+#ifdef CONFIG_SHMEM_HUGEPAGE
+	.pmd_fault = shm_pmd_fault,
+#endif
 #if defined(CONFIG_NUMA)
 	.set_policy = shm_set_policy,
 	.get_policy = shm_get_policy,
@@ -0,0 +1,542 @@
+/*
+ * Module-based torture test facility for locking
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * Based on kernel/rcutorture.c.
+ *
+ * Hammers one lock from a number of writer kthreads, checking that
+ * no two of them ever hold it at once, and reports how many times
+ * each got it: the total gives the throughput of the lock under
+ * contention, the spread between writers its fairness.  The raw
+ * "ticket_spin" and "queued_spin" types run the two x86 spinlock
+ * implementations side by side on the same kernel.
+ */
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kthread.h>
+#include <linux/err.h>
+#include <linux/spinlock.h>
+#include <linux/smp.h>
+#include <linux/interrupt.h>
+#include <linux/sched.h>
+#include <asm/atomic.h>
+#include <linux/moduleparam.h>
+#include <linux/notifier.h>
+#include <linux/reboot.h>
+#include <linux/delay.h>
+#include <linux/slab.h>
+#include <asm/byteorder.h>
+
+MODULE_LICENSE("GPL");
+
+static int nwriters_stress = -1; /* # writer threads, defaults to 2*ncpus */
+static int stat_interval;	/* Interval between stats, in seconds. */
+				/*  Defaults to "only at end of test". */
+static int verbose;		/* Print more debug info. */
+static int short_delay = 1;	/* Occasionally hold the lock for a few us. */
+static char *torture_type = "spin_lock"; /* What lock to torture. */
+
+module_param(nwriters_stress, int, 0444);
+MODULE_PARM_DESC(nwriters_stress, "Number of write-locking stress-test threads");
+module_param(stat_interval, int, 0444);
+MODULE_PARM_DESC(stat_interval, "Number of seconds between stats printk()s");
+module_param(verbose, bool, 0444);
+MODULE_PARM_DESC(verbose, "Enable verbose debugging printk()s");
+module_param(short_delay, bool, 0444);
+MODULE_PARM_DESC(short_delay, "Occasionally delay inside the critical section");
+module_param(torture_type, charp, 0444);
+MODULE_PARM_DESC(torture_type,
+		 "Type of lock to torture (spin_lock, spin_lock_irq, "
+		 "ticket_spin, queued_spin)");
+
+#define TORTURE_FLAG "-torture:"
+#define PRINTK_STRING(s) \
+	do { printk(KERN_ALERT "%s" TORTURE_FLAG s "\n", torture_type); } while (0)
+#define VERBOSE_PRINTK_STRING(s) \
+	do { if (verbose) printk(KERN_ALERT "%s" TORTURE_FLAG s "\n", torture_type); } while (0)
+#define VERBOSE_PRINTK_ERRSTRING(s) \
+	do { if (verbose) printk(KERN_ALERT "%s" TORTURE_FLAG "!!! " s "\n", torture_type); } while (0)
+
+static char printk_buf[4096];
+
+static struct task_struct **writer_tasks;
+static struct task_struct *stats_task;
+
+static int nrealwriters_stress;
+static unsigned long lock_torture_start;	/* jiffies at start of test */
+static int lock_is_write_held;
+
+struct lock_writer_stress_stats {
+	long n_write_lock_fail;
+	long n_write_lock_acquired;
+};
+static struct lock_writer_stress_stats *lwsa;
+
+/* Mediate rmmod and system shutdown.  Concurrent rmmod & shutdown illegal! */
+
+#define FULLSTOP_DONTSTOP 0	/* Normal operation. */
+#define FULLSTOP_SHUTDOWN 1	/* System shutdown with locktorture running. */
+#define FULLSTOP_RMMOD    2	/* Normal rmmod of locktorture. */
+static int fullstop = FULLSTOP_RMMOD;
+static DEFINE_MUTEX(fullstop_mutex);	/* Protect fullstop transitions and */
+					/*  spawning of kthreads. */
+
+/*
+ * Detect and respond to a system shutdown.
+ */
+static int
+locktorture_shutdown_notify(struct notifier_block *unused1,
+			    unsigned long unused2, void *unused3)
+{
+	mutex_lock(&fullstop_mutex);
+	if (fullstop == FULLSTOP_DONTSTOP)
+		fullstop = FULLSTOP_SHUTDOWN;
+	else
+		printk(KERN_WARNING /* but going down anyway, so... */
+		       "Concurrent 'rmmod locktorture' and shutdown illegal!\n");
+	mutex_unlock(&fullstop_mutex);
+	return NOTIFY_DONE;
+}
+
+/*
+ * Absorb kthreads into a kernel function that won't return, so that
+ * they won't ever access module text or data again.
+ */
+static void locktorture_shutdown_absorb(char *title)
+{
+	if (ACCESS_ONCE(fullstop) == FULLSTOP_SHUTDOWN) {
+		printk(KERN_NOTICE
+		       "locktorture thread %s parking due to system shutdown\n",
+		       title);
+		schedule_timeout_uninterruptible(MAX_SCHEDULE_TIMEOUT);
+	}
+}
+
+struct lock_random_state {
+	unsigned long lrs_state;
+	long lrs_count;
+};
+
+#define LOCK_RANDOM_MULT 39916801  /* prime */
+#define LOCK_RANDOM_ADD	479001701 /* prime */
+#define LOCK_RANDOM_REFRESH 10000
+
+#define DEFINE_LOCK_RANDOM(name) struct lock_random_state name = { 0, 0 }
+
+/*
+ * Crude but fast random-number generator, the one rcutorture uses.
+ */
+static unsigned long
+lock_random(struct lock_random_state *lrsp)
+{
+	if (--lrsp->lrs_count < 0) {
+		lrsp->lrs_state +=
+			(unsigned long)cpu_clock(raw_smp_processor_id());
+		lrsp->lrs_count = LOCK_RANDOM_REFRESH;
+	}
+	lrsp->lrs_state = lrsp->lrs_state * LOCK_RANDOM_MULT + LOCK_RANDOM_ADD;
+	return swahw32(lrsp->lrs_state);
+}
+
+/*
+ * Operations vector for selecting different types of tests.
+ */
+
+struct lock_torture_ops {
+	void (*init)(void);
+	int (*writelock)(void);
+	void (*write_delay)(struct lock_random_state *lrsp);
+	void (*writeunlock)(void);
+	unsigned long flags;
+	char *name;
+};
+
+static struct lock_torture_ops *cur_ops;
+
+/*
+ * Delay inside the critical section: mostly not at all, so that the
+ * lock hand-over dominates, but now and then long enough for waiters
+ * to pile up.
+ */
+static void torture_spin_lock_write_delay(struct lock_random_state *lrsp)
+{
+	const unsigned long shortdelay_us = 2;
+	const unsigned long longdelay_us = 100;
+
+	if (!short_delay)
+		return;
+	if (!(lock_random(lrsp) % (nrealwriters_stress * 2000)))
+		udelay(longdelay_us);
+	else if (!(lock_random(lrsp) % (nrealwriters_stress * 20)))
+		udelay(shortdelay_us);
+}
+
+/*
+ * Definitions for spin_lock torture testing.
+ */
+
+static DEFINE_SPINLOCK(torture_spinlock);
+
+static int torture_spin_lock_write_lock(void) __acquires(torture_spinlock)
+{
+	spin_lock(&torture_spinlock);
+	return 0;
+}
+
+static void torture_spin_lock_write_unlock(void) __releases(torture_spinlock)
+{
+	spin_unlock(&torture_spinlock);
+}
+
+static struct lock_torture_ops spin_lock_ops = {
+	.writelock	= torture_spin_lock_write_lock,
+	.write_delay	= torture_spin_lock_write_delay,
+	.writeunlock	= torture_spin_lock_write_unlock,
+	.name		= "spin_lock"
+};
+
+static int torture_spin_lock_write_lock_irq(void)
+	__acquires(torture_spinlock)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&torture_spinlock, flags);
+	cur_ops->flags = flags;
+	return 0;
+}
+
+static void torture_spin_lock_write_unlock_irq(void)
+	__releases(torture_spinlock)
+{
+	spin_unlock_irqrestore(&torture_spinlock, cur_ops->flags);
+}
+
+static struct lock_torture_ops spin_lock_irq_ops = {
+	.writelock	= torture_spin_lock_write_lock_irq,
+	.write_delay	= torture_spin_lock_write_delay,
+	.writeunlock	= torture_spin_lock_write_unlock_irq,
+	.name		= "spin_lock_irq"
+};
+
+#if defined(CONFIG_X86) && defined(CONFIG_SMP)
+
+/*
+ * Definitions for raw x86 ticket and queued spinlock testing: the lock
+ * operations are called directly, bypassing whichever of the two the
+ * kernel was built with, lockdep and the spinlock debugging code.
+ */
+
+static raw_spinlock_t torture_raw_spinlock = __RAW_SPIN_LOCK_UNLOCKED;
+
+static int torture_ticket_spin_write_lock(void)
+{
+	preempt_disable();
+	__ticket_spin_lock(&torture_raw_spinlock);
+	return 0;
+}
+
+static void torture_ticket_spin_write_unlock(void)
+{
+	__ticket_spin_unlock(&torture_raw_spinlock);
+	preempt_enable();
+}
+
+static struct lock_torture_ops ticket_spin_ops = {
+	.writelock	= torture_ticket_spin_write_lock,
+	.write_delay	= torture_spin_lock_write_delay,
+	.writeunlock	= torture_ticket_spin_write_unlock,
+	.name		= "ticket_spin"
+};
+
+#ifdef CONFIG_QUEUED_SPINLOCKS
+
+static int torture_queued_spin_write_lock(void)
+{
+	preempt_disable();
+	queued_spin_lock(&torture_raw_spinlock);
+	return 0;
+}
+
+static void torture_queued_spin_write_unlock(void)
+{
+	queued_spin_unlock(&torture_raw_spinlock);
+	preempt_enable();
+}
+
+static struct lock_torture_ops queued_spin_ops = {
+	.writelock	= torture_queued_spin_write_lock,
+	.write_delay	= torture_spin_lock_write_delay,
+	.writeunlock	= torture_queued_spin_write_unlock,
+	.name		= "queued_spin"
+};
+
+#endif /* CONFIG_QUEUED_SPINLOCKS */
+
+#endif /* CONFIG_X86 && CONFIG_SMP */
+
+/*
+ * Lock torture writer kthread.  Repeatedly acquires and releases
+ * the lock, checking for duplicate acquisitions.
+ */
+static int lock_torture_writer(void *arg)
+{
+	struct lock_writer_stress_stats *lwsp = arg;
+	DEFINE_LOCK_RANDOM(rand);
+
+	VERBOSE_PRINTK_STRING("lock_torture_writer task started");
+	set_user_nice(current, 19);
+
+	do {
+		cur_ops->writelock();
+		if (lock_is_write_held)
+			lwsp->n_write_lock_fail++;
+		lock_is_write_held = 1;
+		lwsp->n_write_lock_acquired++;
+		cur_ops->write_delay(&rand);
+		lock_is_write_held = 0;
+		cur_ops->writeunlock();
+		cond_resched();
+	} while (!kthread_should_stop() && fullstop == FULLSTOP_DONTSTOP);
+	VERBOSE_PRINTK_STRING("lock_torture_writer task stopping");
+	locktorture_shutdown_absorb("lock_torture_writer");
+	while (!kthread_should_stop())
+		schedule_timeout_uninterruptible(1);
+	return 0;
+}
+
+/*
+ * Create a lock-torture-statistics message in the specified buffer.
+ */
+static void lock_torture_printk(char *page)
+{
+	unsigned long elapsed = jiffies - lock_torture_start;
+	long max = 0, min = lwsa[0].n_write_lock_acquired;
+	long fail = 0, sum = 0;
+	int i;
+
+	for (i = 0; i < nrealwriters_stress; i++) {
+		if (lwsa[i].n_write_lock_fail)
+			fail = 1;
+		sum += lwsa[i].n_write_lock_acquired;
+		if (max < lwsa[i].n_write_lock_acquired)
+			max = lwsa[i].n_write_lock_acquired;
+		if (min > lwsa[i].n_write_lock_acquired)
+			min = lwsa[i].n_write_lock_acquired;
+	}
+	page += sprintf(page, "%s%s ", torture_type, TORTURE_FLAG);
+	page += sprintf(page,
+			"Writes:  Total: %ld  Max/Min: %ld/%ld %s  Fail: %ld %s",
+			sum, max, min, max / 2 > min ? "???" : "",
+			fail, fail ? "!!!" : "");
+	if (elapsed >= HZ)
+		page += sprintf(page, "  Rate: %ld/s", sum / (elapsed / HZ));
+	sprintf(page, "\n");
+	if (fail)
+		WARN_ON_ONCE(1);
+}
+
+/*
+ * Print torture statistics.  Caller must ensure that there is only
+ * one call to this function at a given time!!!  This is normally
+ * accomplished by relying on the module system to only have one copy
+ * of the module loaded, and then by giving the lock_torture_stats
+ * kthread full control (or the init/cleanup functions when
+ * lock_torture_stats thread is not running).
+ */
+static void lock_torture_stats_print(void)
+{
+	lock_torture_printk(printk_buf);
+	printk(KERN_ALERT "%s", printk_buf);
+}
+
+/*
+ * Periodically prints torture statistics, if periodic statistics printing
+ * was specified via the stat_interval module parameter.
+ *
+ * No need to worry about fullstop here, since this one doesn't reference
+ * volatile state or register callbacks.
+ */
+static int lock_torture_stats(void *arg)
+{
+	VERBOSE_PRINTK_STRING("lock_torture_stats task started");
+	do {
+		schedule_timeout_interruptible(stat_interval * HZ);
+		lock_torture_stats_print();
+		locktorture_shutdown_absorb("lock_torture_stats");
+	} while (!kthread_should_stop());
+	VERBOSE_PRINTK_STRING("lock_torture_stats task stopping");
+	return 0;
+}
+
+static inline void lock_torture_print_module_parms(const char *tag)
+{
+	printk(KERN_ALERT "%s" TORTURE_FLAG
+	       "--- %s: nwriters_stress=%d stat_interval=%d verbose=%d "
+	       "short_delay=%d\n",
+	       torture_type, tag, nrealwriters_stress, stat_interval, verbose,
+	       short_delay);
+}
+
+static struct notifier_block locktorture_nb = {
+	.notifier_call = locktorture_shutdown_notify,
+};
+
+static void lock_torture_cleanup(void)
+{
+	int i;
+
+	mutex_lock(&fullstop_mutex);
+	if (fullstop == FULLSTOP_SHUTDOWN) {
+		printk(KERN_WARNING /* but going down anyway, so... */
+		       "Concurrent 'rmmod locktorture' and shutdown illegal!\n");
+		mutex_unlock(&fullstop_mutex);
+		schedule_timeout_uninterruptible(10);
+		return;
+	}
+	fullstop = FULLSTOP_RMMOD;
+	mutex_unlock(&fullstop_mutex);
+	unregister_reboot_notifier(&locktorture_nb);
+
+	if (writer_tasks) {
+		for (i = 0; i < nrealwriters_stress; i++) {
+			if (writer_tasks[i]) {
+				VERBOSE_PRINTK_STRING(
+					"Stopping lock_torture_writer task");
+				kthread_stop(writer_tasks[i]);
+			}
+			writer_tasks[i] = NULL;
+		}
+		kfree(writer_tasks);
+		writer_tasks = NULL;
+	}
+
+	if (stats_task) {
+		VERBOSE_PRINTK_STRING("Stopping lock_torture_stats task");
+		kthread_stop(stats_task);
+	}
+	stats_task = NULL;
+
+	if (lwsa) {
+		/* -After- the stats thread is stopped! */
+		lock_torture_stats_print();
+		for (i = 0; i < nrealwriters_stress; i++)
+			if (lwsa[i].n_write_lock_fail)
+				break;
+		if (i < nrealwriters_stress)
+			lock_torture_print_module_parms("End of test: FAILURE");
+		else
+			lock_torture_print_module_parms("End of test: SUCCESS");
+		kfree(lwsa);
+		lwsa = NULL;
+	}
+}
+
+static int __init lock_torture_init(void)
+{
+	int i;
+	int firsterr = 0;
+	static struct lock_torture_ops *torture_ops[] = {
+		&spin_lock_ops, &spin_lock_irq_ops,
+#if defined(CONFIG_X86) && defined(CONFIG_SMP)
+		&ticket_spin_ops,
+#ifdef CONFIG_QUEUED_SPINLOCKS
+		&queued_spin_ops,
+#endif
+#endif
+	};
+
+	mutex_lock(&fullstop_mutex);
+
+	/* Process args and tell the world that the torturer is on the job. */
+	for (i = 0; i < ARRAY_SIZE(torture_ops); i++) {
+		cur_ops = torture_ops[i];
+		if (strcmp(torture_type, cur_ops->name) == 0)
+			break;
+	}
+	if (i == ARRAY_SIZE(torture_ops)) {
+		printk(KERN_ALERT "locktorture: invalid torture type: \"%s\"\n",
+		       torture_type);
+		mutex_unlock(&fullstop_mutex);
+		return -EINVAL;
+	}
+	if (cur_ops->init)
+		cur_ops->init(); /* no "goto unwind" prior to this point!!! */
+
+	if (nwriters_stress >= 0)
+		nrealwriters_stress = nwriters_stress;
+	else
+		nrealwriters_stress = 2 * num_online_cpus();
+	if (!nrealwriters_stress)
+		nrealwriters_stress = 1;
+	lock_torture_print_module_parms("Start of test");
+	fullstop = FULLSTOP_DONTSTOP;
+
+	/* Initialize the statistics so that each run gets its own numbers. */
+
+	lock_is_write_held = 0;
+	lwsa = kzalloc(sizeof(*lwsa) * nrealwriters_stress, GFP_KERNEL);
+	if (lwsa == NULL) {
+		VERBOSE_PRINTK_ERRSTRING("lwsa: Out of memory");
+		firsterr = -ENOMEM;
+		goto unwind;
+	}
+	lock_torture_start = jiffies;
+
+	/* Start up the kthreads. */
+
+	writer_tasks = kzalloc(nrealwriters_stress * sizeof(writer_tasks[0]),
+			       GFP_KERNEL);
+	if (writer_tasks == NULL) {
+		VERBOSE_PRINTK_ERRSTRING("writer_tasks: Out of memory");
+		firsterr = -ENOMEM;
+		goto unwind;
+	}
+	for (i = 0; i < nrealwriters_stress; i++) {
+		VERBOSE_PRINTK_STRING("Creating lock_torture_writer task");
+		writer_tasks[i] = kthread_run(lock_torture_writer, &lwsa[i],
+					      "lock_torture_writer");
+		if (IS_ERR(writer_tasks[i])) {
+			firsterr = PTR_ERR(writer_tasks[i]);
+			VERBOSE_PRINTK_ERRSTRING("Failed to create writer");
+			writer_tasks[i] = NULL;
+			goto unwind;
+		}
+	}
+	if (stat_interval > 0) {
+		VERBOSE_PRINTK_STRING("Creating lock_torture_stats task");
+		stats_task = kthread_run(lock_torture_stats, NULL,
+					 "lock_torture_stats");
+		if (IS_ERR(stats_task)) {
+			firsterr = PTR_ERR(stats_task);
+			VERBOSE_PRINTK_ERRSTRING("Failed to create stats");
+			stats_task = NULL;
+			goto unwind;
+		}
+	}
+	register_reboot_notifier(&locktorture_nb);
+	mutex_unlock(&fullstop_mutex);
+	return 0;
+
+unwind:
+	mutex_unlock(&fullstop_mutex);
+	lock_torture_cleanup();
+	return firsterr;
+}
+
+module_init(lock_torture_init);
+module_exit(lock_torture_cleanup);
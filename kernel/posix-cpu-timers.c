@@ -8,6 +8,7 @@
 #include <linux/math64.h>
 #include <asm/uaccess.h>
 #include <linux/kernel_stat.h>
+#include <linux/tick.h>
 
 /*
  * Called after updating RLIMIT_CPU to set timer expiration if necessary.
@@ -650,6 +651,9 @@ static void arm_timer(struct k_itimer *timer, union cpu_time_count now)
 		}
 	}
 
+	/* The timer is checked from the tick */
+	tick_nohz_full_kick_all();
+
 	spin_unlock(&p->sighand->siglock);
 }
 
@@ -1309,6 +1313,21 @@ static inline int task_cputime_zero(const struct task_cputime *cputime)
 	return 0;
 }
 
+/*
+ * A full dynticks cpu keeps the tick while its task, or the process
+ * of the task, has cpu timers armed: they are checked from the tick.
+ */
+int posix_cpu_timers_can_stop_tick(struct task_struct *tsk)
+{
+	if (!task_cputime_zero(&tsk->cputime_expires))
+		return 0;
+
+	if (tsk->signal->cputimer.running)
+		return 0;
+
+	return 1;
+}
+
 /**
  * task_cputime_expired - Compare two task_cputime entities.
  *
@@ -1452,6 +1471,7 @@ void set_process_cpu_timer(struct task_struct *tsk, unsigned int clock_idx,
 
 	BUG_ON(clock_idx == CPUCLOCK_SCHED);
 	cpu_timer_sample_group(clock_idx, tsk, &now);
+	tick_nohz_full_kick_all();
 
 	if (oldval) {
 		if (!cputime_eq(*oldval, cputime_zero)) {
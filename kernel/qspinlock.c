@@ -0,0 +1,262 @@
+/*
+ * Queued spinlock slow path
+ *
+ * This file contains the contended side of the queued spinlocks
+ * described in asm-generic/qspinlock.h: an MCS lock whose queue tail,
+ * together with a locked byte and a pending bit, fits in the 32-bit
+ * lock word.  A contending CPU takes one of its per-cpu queue nodes
+ * (one per context it can be interrupted in: task, softirq, hardirq,
+ * NMI), links it behind the current tail and spins on it until its
+ * predecessor hands over.  Only the CPU at the head of the queue ever
+ * spins on the lock word.
+ *
+ * Released under the GPL v2.
+ */
+
+#include <linux/smp.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
+#include <linux/prefetch.h>
+#include <linux/module.h>
+
+/*
+ * Ordering for the spins below: what follows a spin that grants us
+ * the lock (or the queue head) must not be done before it, and what
+ * precedes a hand-over must be visible after it.  x86 orders loads
+ * against later loads and stores and stores against stores, which
+ * smp_rmb()/smp_wmb() take care of for the odd CPUs that don't.
+ */
+#ifdef CONFIG_X86
+#define qspin_acquire()		smp_rmb()
+#define qspin_release()		smp_wmb()
+#else
+#define qspin_acquire()		smp_mb()
+#define qspin_release()		smp_mb()
+#endif
+
+#define MAX_NODES	4
+
+struct qnode {
+	struct qnode *next;
+	int locked;		/* 1 if the lock was handed to us */
+	int count;		/* nesting count, in node 0 only */
+};
+
+static DEFINE_PER_CPU_SHARED_ALIGNED(struct qnode, qnodes[MAX_NODES]);
+
+/*
+ * The tail holds cpu + 1, so that 0 means no queue.
+ */
+static inline u32 encode_tail(int cpu, int idx)
+{
+	return ((cpu + 1) << _Q_TAIL_CPU_OFFSET) | (idx << _Q_TAIL_IDX_OFFSET);
+}
+
+static inline struct qnode *decode_tail(u32 tail)
+{
+	int cpu = (tail >> _Q_TAIL_CPU_OFFSET) - 1;
+	int idx = (tail & _Q_TAIL_IDX_MASK) >> _Q_TAIL_IDX_OFFSET;
+
+	return &per_cpu(qnodes, cpu)[idx];
+}
+
+/*
+ * Put @tail in the lock word, returning the previous value.
+ */
+static inline u32 xchg_tail(atomic_t *v, u32 tail)
+{
+	u32 old, new, val = atomic_read(v);
+
+	for (;;) {
+		new = (val & ~_Q_TAIL_MASK) | tail;
+		old = atomic_cmpxchg(v, val, new);
+		if (old == val)
+			break;
+		val = old;
+	}
+	return old;
+}
+
+/**
+ * queued_spin_lock_slowpath - acquire a contended queued spinlock
+ * @lock: the lock
+ * @val: the lock word, as last seen by the fast path
+ *
+ * (queue tail, pending bit, lock value)
+ *
+ *              fast     :    slow                                  :    unlock
+ *                       :                                          :
+ * uncontended  (0,0,0) -:--> (0,0,1) ------------------------------:--> (*,*,0)
+ *                       :       | ^--------.------.             /  :
+ *                       :       v           \      \            |  :
+ * pending               :    (0,1,1) +--> (0,1,0)   \           |  :
+ *                       :       | ^--'              |           |  :
+ *                       :       v                   |           |  :
+ * uncontended           :    (n,x,y) +--> (n,0,0) --'           |  :
+ *   queue               :       | ^--'                          |  :
+ *                       :       v                               |  :
+ * contended             :    (*,x,y) +--> (*,0,0) ---> (*,0,1) -'  :
+ *   queue               :         ^--'                             :
+ */
+void queued_spin_lock_slowpath(raw_spinlock_t *lock, u32 val)
+{
+	atomic_t *v = __queued_spin_val(lock);
+	struct qnode *prev, *next, *node;
+	u32 new, old, tail;
+	int idx;
+
+	/*
+	 * Wait for an in-progress pending->locked hand-over:
+	 * 0,1,0 -> 0,0,1
+	 */
+	if (val == _Q_PENDING_VAL) {
+		while ((val = atomic_read(v)) == _Q_PENDING_VAL)
+			cpu_relax();
+	}
+
+	/*
+	 * trylock || pending
+	 *
+	 * 0,0,0 -> 0,0,1 ; trylock
+	 * 0,0,1 -> 0,1,1 ; pending
+	 */
+	for (;;) {
+		/* If we observe any contention, queue. */
+		if (val & ~_Q_LOCKED_MASK)
+			goto queue;
+
+		new = _Q_LOCKED_VAL;
+		if (val == new)
+			new |= _Q_PENDING_VAL;
+
+		old = atomic_cmpxchg(v, val, new);
+		if (old == val)
+			break;
+
+		val = old;
+	}
+
+	/* We won the trylock. */
+	if (new == _Q_LOCKED_VAL)
+		return;
+
+	/*
+	 * We're pending, wait for the owner to go away.
+	 *
+	 * *,1,1 -> *,1,0
+	 */
+	while (atomic_read(v) & _Q_LOCKED_MASK)
+		cpu_relax();
+	qspin_acquire();
+
+	/*
+	 * Take ownership and clear the pending bit:
+	 *
+	 * *,1,0 -> *,0,1
+	 */
+	atomic_add(_Q_LOCKED_VAL - _Q_PENDING_VAL, v);
+	return;
+
+	/*
+	 * End of pending bit optimistic spinning and beginning of MCS
+	 * queuing.
+	 */
+queue:
+	node = &__get_cpu_var(qnodes)[0];
+	idx = node->count++;
+	tail = encode_tail(smp_processor_id(), idx);
+
+	node += idx;
+	node->locked = 0;
+	node->next = NULL;
+
+	/*
+	 * We touched a (possibly) cold cacheline in the per-cpu queue
+	 * node; attempt the trylock once more in the hope someone let go
+	 * while we weren't watching.
+	 */
+	if (queued_spin_trylock(lock))
+		goto release;
+
+	/*
+	 * Publish the updated tail.  The cmpxchg orders the node
+	 * initialization above before it.
+	 *
+	 * p,*,* -> n,*,*
+	 */
+	old = xchg_tail(v, tail);
+	next = NULL;
+
+	/*
+	 * If there was a previous node, link it and wait until reaching
+	 * the head of the waitqueue.
+	 */
+	if (old & _Q_TAIL_MASK) {
+		prev = decode_tail(old);
+		ACCESS_ONCE(prev->next) = node;
+
+		while (!ACCESS_ONCE(node->locked))
+			cpu_relax();
+		qspin_acquire();
+
+		/*
+		 * While waiting for the lock word, we may as well make
+		 * sure the next node's cacheline is ours.
+		 */
+		next = ACCESS_ONCE(node->next);
+		if (next)
+			prefetchw(next);
+	}
+
+	/*
+	 * We're at the head of the waitqueue, wait for the owner and the
+	 * pending waiter to go away.
+	 *
+	 * *,x,y -> *,0,0
+	 */
+	while ((val = atomic_read(v)) & _Q_LOCKED_PENDING_MASK)
+		cpu_relax();
+	qspin_acquire();
+
+	/*
+	 * Claim the lock:
+	 *
+	 * n,0,0 -> 0,0,1 : lock, uncontended
+	 * *,0,0 -> *,0,1 : lock, contended
+	 *
+	 * If the queue head is the only one in the queue (lock value ==
+	 * tail), clear the tail code and grab the lock.  Otherwise, we
+	 * only need to grab the lock: nobody else can take it while the
+	 * queue is non-empty, so an atomic add of the locked byte is safe.
+	 */
+	for (;;) {
+		if ((val & _Q_TAIL_MASK) != tail) {
+			atomic_add(_Q_LOCKED_VAL, v);
+			break;
+		}
+		old = atomic_cmpxchg(v, val, _Q_LOCKED_VAL);
+		if (old == val)
+			goto release;	/* No contention */
+
+		val = old;
+	}
+
+	/*
+	 * Contended path; wait for next if not observed yet, then hand
+	 * it the queue head.
+	 */
+	if (!next) {
+		while (!(next = ACCESS_ONCE(node->next)))
+			cpu_relax();
+	}
+
+	qspin_release();
+	ACCESS_ONCE(next->locked) = 1;
+
+release:
+	/*
+	 * Release the node.
+	 */
+	__get_cpu_var(qnodes)[0].count--;
+}
+EXPORT_SYMBOL(queued_spin_lock_slowpath);
@@ -45,6 +45,7 @@
 #include <linux/cpu.h>
 #include <linux/mutex.h>
 #include <linux/time.h>
+#include <linux/tick.h>
 
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 static struct lock_class_key rcu_lock_key;
@@ -181,10 +182,15 @@ static int rcu_implicit_offline_qs(struct rcu_data *rdp)
 		return 1;
 	}
 
-	/* The CPU is online, so send it a reschedule IPI. */
-	if (rdp->cpu != smp_processor_id())
+	/*
+	 * The CPU is online, so send it a reschedule IPI. A full dynticks
+	 * CPU may also have its tick stopped: kick it, so that the tick
+	 * reports the quiescent state.
+	 */
+	if (rdp->cpu != smp_processor_id()) {
 		smp_send_reschedule(rdp->cpu);
-	else
+		tick_nohz_full_kick_cpu(rdp->cpu);
+	} else
 		set_need_resched();
 	rdp->resched_ipi++;
 	return 0;
@@ -1208,6 +1214,9 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	*rdp->nxttail[RCU_NEXT_TAIL] = head;
 	rdp->nxttail[RCU_NEXT_TAIL] = &head->next;
 
+	/* Callbacks are advanced from the tick */
+	tick_nohz_full_kick();
+
 	/* Start a new grace period if one not already started. */
 	if (ACCESS_ONCE(rsp->completed) == ACCESS_ONCE(rsp->gpnum)) {
 		unsigned long nestflag;
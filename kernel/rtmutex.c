@@ -105,11 +105,23 @@ static inline void mark_rt_mutex_waiters(struct rt_mutex *lock)
  */
 int rt_mutex_getprio(struct task_struct *task)
 {
+	int prio;
+
 	if (likely(!task_has_pi_waiters(task)))
 		return task->normal_prio;
 
-	return min(task_top_pi_waiter(task)->pi_list_entry.prio,
+	prio = min(task_top_pi_waiter(task)->pi_list_entry.prio,
 		   task->normal_prio);
+
+	/*
+	 * A SCHED_DEADLINE waiter has no priority to lend: running at
+	 * its level takes a bandwidth reservation of one's own. Boost
+	 * the owner to the highest RT priority instead.
+	 */
+	if (dl_prio(prio) && !dl_prio(task->normal_prio))
+		prio = 0;
+
+	return prio;
 }
 
 /*
@@ -77,6 +77,8 @@
 #include <asm/irq_regs.h>
 
 #include "sched_cpupri.h"
+#include "sched_cpudl.h"
+#include "workqueue_sched.h"
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/sched.h>
@@ -156,6 +158,24 @@ static inline int task_has_rt_policy(struct task_struct *p)
 	return rt_policy(p->policy);
 }
 
+static inline int dl_policy(int policy)
+{
+	if (unlikely(policy == SCHED_DEADLINE))
+		return 1;
+	return 0;
+}
+
+static inline int task_has_dl_policy(struct task_struct *p)
+{
+	return dl_policy(p->policy);
+}
+
+/*
+ * SCHED_DEADLINE runtimes are scaled down by this many bits in the CBS
+ * arithmetic, which bounds the smallest runtime that can be asked for.
+ */
+#define DL_SCALE		10
+
 /*
  * This is the priority-queue data structure of the RT scheduling class:
  */
@@ -215,33 +235,42 @@ static inline int rt_bandwidth_enabled(void)
 	return sysctl_sched_rt_runtime >= 0;
 }
 
-static void start_rt_bandwidth(struct rt_bandwidth *rt_b)
+/*
+ * (Re)arm a bandwidth period timer, unless it is already running, on the
+ * next period boundary: the caller serializes against the callback.
+ */
+static void start_bandwidth_timer(struct hrtimer *period_timer, ktime_t period)
 {
 	ktime_t now;
 
-	if (!rt_bandwidth_enabled() || rt_b->rt_runtime == RUNTIME_INF)
-		return;
-
-	if (hrtimer_active(&rt_b->rt_period_timer))
-		return;
-
-	spin_lock(&rt_b->rt_runtime_lock);
 	for (;;) {
 		unsigned long delta;
 		ktime_t soft, hard;
 
-		if (hrtimer_active(&rt_b->rt_period_timer))
+		if (hrtimer_active(period_timer))
 			break;
 
-		now = hrtimer_cb_get_time(&rt_b->rt_period_timer);
-		hrtimer_forward(&rt_b->rt_period_timer, now, rt_b->rt_period);
+		now = hrtimer_cb_get_time(period_timer);
+		hrtimer_forward(period_timer, now, period);
 
-		soft = hrtimer_get_softexpires(&rt_b->rt_period_timer);
-		hard = hrtimer_get_expires(&rt_b->rt_period_timer);
+		soft = hrtimer_get_softexpires(period_timer);
+		hard = hrtimer_get_expires(period_timer);
 		delta = ktime_to_ns(ktime_sub(hard, soft));
-		__hrtimer_start_range_ns(&rt_b->rt_period_timer, soft, delta,
+		__hrtimer_start_range_ns(period_timer, soft, delta,
 				HRTIMER_MODE_ABS_PINNED, 0);
 	}
+}
+
+static void start_rt_bandwidth(struct rt_bandwidth *rt_b)
+{
+	if (!rt_bandwidth_enabled() || rt_b->rt_runtime == RUNTIME_INF)
+		return;
+
+	if (hrtimer_active(&rt_b->rt_period_timer))
+		return;
+
+	spin_lock(&rt_b->rt_runtime_lock);
+	start_bandwidth_timer(&rt_b->rt_period_timer, rt_b->rt_period);
 	spin_unlock(&rt_b->rt_runtime_lock);
 }
 
@@ -252,6 +281,106 @@ static void destroy_rt_bandwidth(struct rt_bandwidth *rt_b)
 }
 #endif
 
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * The runtime a group may consume in each period, across all cpus.  Each
+ * cpu's cfs_rq of the group takes it from the pool in slices, and is
+ * throttled when it has used its slice up and the pool is empty; the
+ * period timer refills the pool and unthrottles them again.
+ */
+struct cfs_bandwidth {
+	/* nests inside the rq lock: */
+	spinlock_t		lock;
+	ktime_t			period;
+	u64			quota, runtime;
+	/* the quota normalized against the parent's, see tg_set_cfs_bandwidth */
+	s64			hierarchal_quota;
+	u64			runtime_expires;
+
+	/* timer_active: the period timer runs, or is about to be started */
+	int			idle, timer_active;
+	struct hrtimer		period_timer;
+	struct list_head	throttled_cfs_rq;
+
+	/* statistics, for cpu.stat */
+	int			nr_periods, nr_throttled;
+	u64			throttled_time;
+};
+
+static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun);
+
+/*
+ * The timer keeps itself going for as long as the group is not idle.  It
+ * stops only by returning HRTIMER_NORESTART once timer_active was cleared
+ * under cfs_b->lock, after which __start_cfs_bandwidth() may start it again
+ * even before the callback has returned: so never forward it after that.
+ */
+static enum hrtimer_restart sched_cfs_period_timer(struct hrtimer *timer)
+{
+	struct cfs_bandwidth *cfs_b =
+		container_of(timer, struct cfs_bandwidth, period_timer);
+	ktime_t now;
+	int overrun;
+	int idle = 0;
+
+	while (!idle) {
+		now = hrtimer_cb_get_time(timer);
+		overrun = hrtimer_forward(timer, now, cfs_b->period);
+
+		if (!overrun)
+			break;
+
+		idle = do_sched_cfs_period_timer(cfs_b, overrun);
+	}
+
+	return idle ? HRTIMER_NORESTART : HRTIMER_RESTART;
+}
+
+static inline u64 default_cfs_period(void)
+{
+	return 100000000ULL;	/* 100ms */
+}
+
+static void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	spin_lock_init(&cfs_b->lock);
+	cfs_b->runtime = 0;
+	cfs_b->quota = RUNTIME_INF;
+	cfs_b->period = ns_to_ktime(default_cfs_period());
+
+	INIT_LIST_HEAD(&cfs_b->throttled_cfs_rq);
+	hrtimer_init(&cfs_b->period_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cfs_b->period_timer.function = sched_cfs_period_timer;
+}
+
+/*
+ * Start the period timer if it is not running.  Called with cfs_b->lock
+ * held, and maybe the rq lock, which the callback takes to unthrottle: so
+ * this must not wait for the callback, which may be on its way out, and
+ * the timer is not enqueued once timer_active is clear.
+ */
+static void __start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	struct hrtimer *timer = &cfs_b->period_timer;
+	unsigned long delta;
+
+	if (cfs_b->timer_active)
+		return;
+
+	cfs_b->timer_active = 1;
+	hrtimer_forward_now(timer, cfs_b->period);
+	delta = ktime_to_ns(ktime_sub(hrtimer_get_expires(timer),
+				      hrtimer_get_softexpires(timer)));
+	__hrtimer_start_range_ns(timer, hrtimer_get_softexpires(timer), delta,
+				 HRTIMER_MODE_ABS_PINNED, 0);
+}
+
+static void destroy_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	hrtimer_cancel(&cfs_b->period_timer);
+}
+#endif
+
 /*
  * sched_domains_mutex serializes calls to arch_init_sched_domains,
  * detach_destroy_domains and partition_sched_domains.
@@ -282,6 +411,11 @@ struct task_group {
 	/* runqueue "owned" by this group on each cpu */
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
+
+#ifdef CONFIG_SMP
+	/* the sum of the tg_load_contrib of its cfs_rqs */
+	atomic_long_t load_avg;
+#endif
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -291,6 +425,10 @@ struct task_group {
 	struct rt_bandwidth rt_bandwidth;
 #endif
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	struct cfs_bandwidth cfs_bandwidth;
+#endif
+
 	struct rcu_head rcu;
 	struct list_head list;
 
@@ -334,13 +472,6 @@ static DEFINE_PER_CPU(struct rt_rq, init_rt_rq) ____cacheline_aligned_in_smp;
  */
 static DEFINE_SPINLOCK(task_group_lock);
 
-#ifdef CONFIG_SMP
-static int root_task_group_empty(void)
-{
-	return list_empty(&root_task_group.children);
-}
-#endif
-
 #ifdef CONFIG_FAIR_GROUP_SCHED
 #ifdef CONFIG_USER_SCHED
 # define INIT_TASK_GROUP_LOAD	(2*NICE_0_LOAD)
@@ -401,13 +532,6 @@ static inline void set_task_rq(struct task_struct *p, unsigned int cpu)
 
 #else
 
-#ifdef CONFIG_SMP
-static int root_task_group_empty(void)
-{
-	return 1;
-}
-#endif
-
 static inline void set_task_rq(struct task_struct *p, unsigned int cpu) { }
 static inline struct task_group *task_group(struct task_struct *p)
 {
@@ -419,7 +543,8 @@ static inline struct task_group *task_group(struct task_struct *p)
 /* CFS-related fields in a runqueue */
 struct cfs_rq {
 	struct load_weight load;
-	unsigned long nr_running;
+	/* h_nr_running counts the tasks queued below, in child groups too */
+	unsigned long nr_running, h_nr_running;
 
 	u64 exec_clock;
 	u64 min_vruntime;
@@ -430,11 +555,16 @@ struct cfs_rq {
 	struct list_head tasks;
 	struct list_head *balance_iterator;
 
+#ifdef CONFIG_SMP
+	/* the load_avg_contrib of the entities queued here */
+	unsigned long runnable_load_avg;
+#endif
+
 	/*
 	 * 'curr' points to currently running entity on this cfs_rq.
 	 * It is set to NULL otherwise (i.e when none are currently running).
 	 */
-	struct sched_entity *curr, *next, *last;
+	struct sched_entity *curr, *next, *last, *skip;
 
 	unsigned int nr_spread_over;
 
@@ -449,6 +579,7 @@ struct cfs_rq {
 	 * leaf_cfs_rq_list ties together list of leaf cfs_rq's in a cpu. This
 	 * list is used during load balance.
 	 */
+	int on_list;
 	struct list_head leaf_cfs_rq_list;
 	struct task_group *tg;	/* group that "owns" this runqueue */
 
@@ -465,16 +596,24 @@ struct cfs_rq {
 	 * this group.
 	 */
 	unsigned long h_load;
+	unsigned long last_h_load_update;
+	struct sched_entity *h_load_next;
 
 	/*
-	 * this cpu's part of tg->shares
+	 * this cpu's part of tg->load_avg
 	 */
-	unsigned long shares;
+	long tg_load_contrib;
+#endif
 
-	/*
-	 * load.weight at the time we set shares
-	 */
-	unsigned long rq_weight;
+#ifdef CONFIG_CFS_BANDWIDTH
+	int runtime_enabled;
+	u64 runtime_expires;
+	s64 runtime_remaining;
+
+	u64 throttled_timestamp;
+	/* throttle_count counts the throttled cfs_rqs from here up */
+	int throttled, throttle_count;
+	struct list_head throttled_list;
 #endif
 #endif
 };
@@ -513,6 +652,51 @@ struct rt_rq {
 #endif
 };
 
+/*
+ * The SCHED_DEADLINE bandwidth handed out to the tasks of a root
+ * domain (of the system on UP), in the fixed point of to_ratio():
+ * admission control keeps it within the RT limit of all its cpus.
+ */
+struct dl_bw {
+	spinlock_t lock;
+	u64 total_bw;
+};
+
+/* Deadline class' related fields in a runqueue */
+struct dl_rq {
+	/* runqueue is an rbtree, ordered by deadline */
+	struct rb_root rb_root;
+	struct rb_node *rb_leftmost;
+
+	unsigned long dl_nr_running;
+
+#ifdef CONFIG_SMP
+	/*
+	 * Deadline values of the currently executing and the
+	 * earliest ready task on this rq. Caching these facilitates
+	 * the decision wether or not a ready but not running task
+	 * should migrate somewhere else.
+	 */
+	struct {
+		u64 curr;
+	} earliest_dl;
+
+	unsigned long dl_nr_migratory;
+	unsigned long dl_nr_total;
+	int overloaded;
+
+	/*
+	 * Tasks on this rq that can be pushed away. They are kept in
+	 * an rb-tree, ordered by tasks' deadlines, with caching
+	 * of the leftmost (earliest deadline) element.
+	 */
+	struct rb_root pushable_dl_tasks_root;
+	struct rb_node *pushable_dl_tasks_leftmost;
+#else
+	struct dl_bw dl_bw;
+#endif
+};
+
 #ifdef CONFIG_SMP
 
 /*
@@ -537,6 +721,17 @@ struct root_domain {
 #ifdef CONFIG_SMP
 	struct cpupri cpupri;
 #endif
+
+	/*
+	 * The "DL overload" flag and the SCHED_DEADLINE bandwidth of
+	 * the domain: as for RT, the overload mask has the cpus with
+	 * more than one runnable -deadline task; cpudl orders the cpus
+	 * by their earliest deadline for the push logic.
+	 */
+	cpumask_var_t dlo_mask;
+	atomic_t dlo_count;
+	struct dl_bw dl_bw;
+	struct cpudl cpudl;
 #if defined(CONFIG_SCHED_MC) || defined(CONFIG_SCHED_SMT)
 	/*
 	 * Preferred wake up cpu nominated by sched_mc balance that will be
@@ -585,10 +780,12 @@ struct rq {
 
 	struct cfs_rq cfs;
 	struct rt_rq rt;
+	struct dl_rq dl;
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* list of leaf cfs_rq on this cpu: */
 	struct list_head leaf_cfs_rq_list;
+	u64 shares_update;
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	struct list_head leaf_rt_rq_list;
@@ -848,14 +1045,16 @@ late_initcall(sched_init_debug);
 const_debug unsigned int sysctl_sched_nr_migrate = 32;
 
 /*
- * ratelimit for updating the group shares.
+ * ratelimit for bringing the group shares of a cpu up to date, see
+ * update_shares().
  * default: 0.25ms
  */
 unsigned int sysctl_sched_shares_ratelimit = 250000;
 
 /*
  * Inject some fuzzyness into changing the per-cpu group shares
- * this avoids remote rq-locks at the expense of fairness.
+ * this avoids requeueing the group's entity on every small change
+ * of its load, at the expense of fairness.
  * default: 4
  */
 unsigned int sysctl_sched_shares_thresh = 4;
@@ -887,6 +1086,42 @@ static inline u64 global_rt_runtime(void)
 	return (u64)sysctl_sched_rt_runtime * NSEC_PER_USEC;
 }
 
+static unsigned long to_ratio(u64 period, u64 runtime)
+{
+	if (runtime == RUNTIME_INF)
+		return 1ULL << 20;
+
+	return div64_u64(runtime << 20, period);
+}
+
+static inline void init_dl_bw(struct dl_bw *dl_b)
+{
+	spin_lock_init(&dl_b->lock);
+	dl_b->total_bw = 0;
+}
+
+#ifdef CONFIG_SMP
+static inline struct dl_bw *dl_bw_of(int i)
+{
+	return &cpu_rq(i)->rd->dl_bw;
+}
+
+static inline int dl_bw_cpus(int i)
+{
+	return cpumask_weight(cpu_rq(i)->rd->span);
+}
+#else
+static inline struct dl_bw *dl_bw_of(int i)
+{
+	return &cpu_rq(i)->dl.dl_bw;
+}
+
+static inline int dl_bw_cpus(int i)
+{
+	return 1;
+}
+#endif
+
 #ifndef prepare_arch_switch
 # define prepare_arch_switch(next)	do { } while (0)
 #endif
@@ -1448,20 +1683,21 @@ static inline void dec_cpu_load(struct rq *rq, unsigned long load)
 	update_load_sub(&rq->load, load);
 }
 
-#if (defined(CONFIG_SMP) && defined(CONFIG_FAIR_GROUP_SCHED)) || defined(CONFIG_RT_GROUP_SCHED)
+#if defined(CONFIG_RT_GROUP_SCHED) || defined(CONFIG_CFS_BANDWIDTH)
 typedef int (*tg_visitor)(struct task_group *, void *);
 
 /*
- * Iterate the full tree, calling @down when first entering a node and @up when
- * leaving it for the final time.
+ * Iterate the subtree below @from, calling @down when first entering a node
+ * and @up when leaving it for the final time.
  */
-static int walk_tg_tree(tg_visitor down, tg_visitor up, void *data)
+static int walk_tg_tree_from(struct task_group *from,
+			     tg_visitor down, tg_visitor up, void *data)
 {
 	struct task_group *parent, *child;
 	int ret;
 
 	rcu_read_lock();
-	parent = &root_task_group;
+	parent = from;
 down:
 	ret = (*down)(parent, data);
 	if (ret)
@@ -1474,7 +1710,7 @@ up:
 		continue;
 	}
 	ret = (*up)(parent, data);
-	if (ret)
+	if (ret || parent == from)
 		goto out_unlock;
 
 	child = parent;
@@ -1487,6 +1723,14 @@ out_unlock:
 	return ret;
 }
 
+/*
+ * Iterate the full tree, see walk_tg_tree_from().
+ */
+static int walk_tg_tree(tg_visitor down, tg_visitor up, void *data)
+{
+	return walk_tg_tree_from(&root_task_group, down, up, data);
+}
+
 static int tg_nop(struct task_group *tg, void *data)
 {
 	return 0;
@@ -1496,6 +1740,7 @@ static int tg_nop(struct task_group *tg, void *data)
 #ifdef CONFIG_SMP
 static unsigned long source_load(int cpu, int type);
 static unsigned long target_load(int cpu, int type);
+static unsigned long weighted_cpuload(const int cpu);
 static int task_hot(struct task_struct *p, u64 now, struct sched_domain *sd);
 
 static unsigned long cpu_avg_load_per_task(int cpu)
@@ -1504,151 +1749,13 @@ static unsigned long cpu_avg_load_per_task(int cpu)
 	unsigned long nr_running = ACCESS_ONCE(rq->nr_running);
 
 	if (nr_running)
-		rq->avg_load_per_task = rq->load.weight / nr_running;
+		rq->avg_load_per_task = weighted_cpuload(cpu) / nr_running;
 	else
 		rq->avg_load_per_task = 0;
 
 	return rq->avg_load_per_task;
 }
 
-#ifdef CONFIG_FAIR_GROUP_SCHED
-
-static void __set_se_shares(struct sched_entity *se, unsigned long shares);
-
-/*
- * Calculate and set the cpu's group shares.
- */
-static void
-update_group_shares_cpu(struct task_group *tg, int cpu,
-			unsigned long sd_shares, unsigned long sd_rq_weight)
-{
-	unsigned long shares;
-	unsigned long rq_weight;
-
-	if (!tg->se[cpu])
-		return;
-
-	rq_weight = tg->cfs_rq[cpu]->rq_weight;
-
-	/*
-	 *           \Sum shares * rq_weight
-	 * shares =  -----------------------
-	 *               \Sum rq_weight
-	 *
-	 */
-	shares = (sd_shares * rq_weight) / sd_rq_weight;
-	shares = clamp_t(unsigned long, shares, MIN_SHARES, MAX_SHARES);
-
-	if (abs(shares - tg->se[cpu]->load.weight) >
-			sysctl_sched_shares_thresh) {
-		struct rq *rq = cpu_rq(cpu);
-		unsigned long flags;
-
-		spin_lock_irqsave(&rq->lock, flags);
-		tg->cfs_rq[cpu]->shares = shares;
-
-		__set_se_shares(tg->se[cpu], shares);
-		spin_unlock_irqrestore(&rq->lock, flags);
-	}
-}
-
-/*
- * Re-compute the task group their per cpu shares over the given domain.
- * This needs to be done in a bottom-up fashion because the rq weight of a
- * parent group depends on the shares of its child groups.
- */
-static int tg_shares_up(struct task_group *tg, void *data)
-{
-	unsigned long weight, rq_weight = 0;
-	unsigned long shares = 0;
-	struct sched_domain *sd = data;
-	int i;
-
-	for_each_cpu(i, sched_domain_span(sd)) {
-		/*
-		 * If there are currently no tasks on the cpu pretend there
-		 * is one of average load so that when a new task gets to
-		 * run here it will not get delayed by group starvation.
-		 */
-		weight = tg->cfs_rq[i]->load.weight;
-		if (!weight)
-			weight = NICE_0_LOAD;
-
-		tg->cfs_rq[i]->rq_weight = weight;
-		rq_weight += weight;
-		shares += tg->cfs_rq[i]->shares;
-	}
-
-	if ((!shares && rq_weight) || shares > tg->shares)
-		shares = tg->shares;
-
-	if (!sd->parent || !(sd->parent->flags & SD_LOAD_BALANCE))
-		shares = tg->shares;
-
-	for_each_cpu(i, sched_domain_span(sd))
-		update_group_shares_cpu(tg, i, shares, rq_weight);
-
-	return 0;
-}
-
-/*
- * Compute the cpu's hierarchical load factor for each task group.
- * This needs to be done in a top-down fashion because the load of a child
- * group is a fraction of its parents load.
- */
-static int tg_load_down(struct task_group *tg, void *data)
-{
-	unsigned long load;
-	long cpu = (long)data;
-
-	if (!tg->parent) {
-		load = cpu_rq(cpu)->load.weight;
-	} else {
-		load = tg->parent->cfs_rq[cpu]->h_load;
-		load *= tg->cfs_rq[cpu]->shares;
-		load /= tg->parent->cfs_rq[cpu]->load.weight + 1;
-	}
-
-	tg->cfs_rq[cpu]->h_load = load;
-
-	return 0;
-}
-
-static void update_shares(struct sched_domain *sd)
-{
-	u64 now = cpu_clock(raw_smp_processor_id());
-	s64 elapsed = now - sd->last_update;
-
-	if (elapsed >= (s64)(u64)sysctl_sched_shares_ratelimit) {
-		sd->last_update = now;
-		walk_tg_tree(tg_nop, tg_shares_up, sd);
-	}
-}
-
-static void update_shares_locked(struct rq *rq, struct sched_domain *sd)
-{
-	spin_unlock(&rq->lock);
-	update_shares(sd);
-	spin_lock(&rq->lock);
-}
-
-static void update_h_load(long cpu)
-{
-	walk_tg_tree(tg_load_down, tg_nop, (void *)cpu);
-}
-
-#else
-
-static inline void update_shares(struct sched_domain *sd)
-{
-}
-
-static inline void update_shares_locked(struct rq *rq, struct sched_domain *sd)
-{
-}
-
-#endif
-
 #ifdef CONFIG_PREEMPT
 
 /*
@@ -1721,42 +1828,42 @@ static inline void double_unlock_balance(struct rq *this_rq, struct rq *busiest)
 }
 #endif
 
-#ifdef CONFIG_FAIR_GROUP_SCHED
-static void cfs_rq_set_shares(struct cfs_rq *cfs_rq, unsigned long shares)
+static void calc_load_account_active(struct rq *this_rq);
+
+/*
+ * nr_running counts the tasks the classes have queued and not throttled:
+ * their enqueue and dequeue methods maintain it.
+ */
+static void inc_nr_running(struct rq *rq)
 {
-#ifdef CONFIG_SMP
-	cfs_rq->shares = shares;
-#endif
+	rq->nr_running++;
+
+	/* A second task needs the tick to preempt the first one */
+	if (rq->nr_running == 2)
+		tick_nohz_full_kick_cpu(cpu_of(rq));
 }
-#endif
 
-static void calc_load_account_active(struct rq *this_rq);
+static void dec_nr_running(struct rq *rq)
+{
+	rq->nr_running--;
+}
 
 #include "sched_stats.h"
 #include "sched_idletask.c"
 #include "sched_fair.c"
 #include "sched_rt.c"
+#include "sched_dl.c"
 #ifdef CONFIG_SCHED_DEBUG
 # include "sched_debug.c"
 #endif
 
-#define sched_class_highest (&rt_sched_class)
+#define sched_class_highest (&dl_sched_class)
 #define for_each_class(class) \
    for (class = sched_class_highest; class; class = class->next)
 
-static void inc_nr_running(struct rq *rq)
-{
-	rq->nr_running++;
-}
-
-static void dec_nr_running(struct rq *rq)
-{
-	rq->nr_running--;
-}
-
 static void set_load_weight(struct task_struct *p)
 {
-	if (task_has_rt_policy(p)) {
+	if (task_has_rt_policy(p) || task_has_dl_policy(p)) {
 		p->se.load.weight = prio_to_weight[0] * 2;
 		p->se.load.inv_weight = prio_to_wmult[0] >> 1;
 		return;
@@ -1828,7 +1935,9 @@ static inline int normal_prio(struct task_struct *p)
 {
 	int prio;
 
-	if (task_has_rt_policy(p))
+	if (task_has_dl_policy(p))
+		prio = MAX_DL_PRIO-1;
+	else if (task_has_rt_policy(p))
 		prio = MAX_RT_PRIO-1 - p->rt_priority;
 	else
 		prio = __normal_prio(p);
@@ -1864,7 +1973,6 @@ static void activate_task(struct rq *rq, struct task_struct *p, int wakeup)
 		rq->nr_uninterruptible--;
 
 	enqueue_task(rq, p, wakeup);
-	inc_nr_running(rq);
 }
 
 /*
@@ -1876,7 +1984,6 @@ static void deactivate_task(struct rq *rq, struct task_struct *p, int sleep)
 		rq->nr_uninterruptible++;
 
 	dequeue_task(rq, p, sleep);
-	dec_nr_running(rq);
 }
 
 /**
@@ -1916,10 +2023,23 @@ static inline void check_class_changed(struct rq *rq, struct task_struct *p,
 
 #ifdef CONFIG_SMP
 
-/* Used instead of source_load when we know the type == 0 */
+/*
+ * Used instead of source_load when we know the type == 0: the decayed
+ * runnable load of the cfs entities of the cpu, see the per-entity load
+ * tracking, plus the instantaneous weight of its rt and -deadline tasks,
+ * which are not tracked.
+ */
 static unsigned long weighted_cpuload(const int cpu)
 {
-	return cpu_rq(cpu)->load.weight;
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long load = rq->cfs.runnable_load_avg;
+
+	/* rq->load is the weight of the top cfs entities and the rt tasks */
+	load += rq->load.weight - rq->cfs.load.weight;
+	/* -deadline tasks weigh as much as rt ones, see set_load_weight() */
+	load += rq->dl.dl_nr_running * prio_to_weight[0] * 2;
+
+	return load;
 }
 
 /*
@@ -1972,6 +2092,7 @@ void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 	if (p->se.block_start)
 		p->se.block_start -= clock_offset;
 #endif
+	p->se.avg.last_runnable_update -= clock_offset;
 	if (old_cpu != new_cpu) {
 		p->se.nr_migrations++;
 		new_rq->nr_migrations_in++;
@@ -2334,9 +2455,6 @@ static int sched_balance_self(int cpu, int flag)
 			sd = tmp;
 	}
 
-	if (sd)
-		update_shares(sd);
-
 	while (sd) {
 		struct sched_group *group;
 		int new_cpu, weight;
@@ -2422,22 +2540,6 @@ static int try_to_wake_up(struct task_struct *p, unsigned int state, int sync)
 	if (!sched_feat(SYNC_WAKEUPS))
 		sync = 0;
 
-#ifdef CONFIG_SMP
-	if (sched_feat(LB_WAKEUP_UPDATE) && !root_task_group_empty()) {
-		struct sched_domain *sd;
-
-		this_cpu = raw_smp_processor_id();
-		cpu = task_cpu(p);
-
-		for_each_domain(this_cpu, sd) {
-			if (cpumask_test_cpu(cpu, sched_domain_span(sd))) {
-				update_shares(sd);
-				break;
-			}
-		}
-	}
-#endif
-
 	smp_wmb();
 	rq = task_rq_lock(p, &flags);
 	update_rq_clock(rq);
@@ -2501,6 +2603,13 @@ out_activate:
 	activate_task(rq, p, 1);
 	success = 1;
 
+	/*
+	 * A workqueue worker waking up counts as running again for its
+	 * pool.
+	 */
+	if (p->flags & PF_WQ_WORKER)
+		wq_worker_waking_up(p);
+
 	/*
 	 * Only attribute actual wakeups done by this task.
 	 */
@@ -2554,6 +2663,46 @@ int wake_up_state(struct task_struct *p, unsigned int state)
 	return try_to_wake_up(p, state, 0);
 }
 
+/**
+ * try_to_wake_up_local - try to wake up a local task with rq lock held
+ * @p: the thread to be awakened
+ *
+ * Put @p on the run-queue if it's not already there.  The caller must
+ * ensure that this_rq() is locked, @p is bound to this_rq() and not
+ * the current task.  this_rq() stays locked over invocation.
+ */
+static void try_to_wake_up_local(struct task_struct *p)
+{
+	struct rq *rq = task_rq(p);
+	int success = 0;
+
+	BUG_ON(rq != this_rq());
+	BUG_ON(p == current);
+
+	if (!(p->state & TASK_NORMAL))
+		return;
+
+	if (!p->se.on_rq) {
+		schedstat_inc(rq, ttwu_count);
+		schedstat_inc(rq, ttwu_local);
+		schedstat_inc(p, se.nr_wakeups);
+		schedstat_inc(p, se.nr_wakeups_local);
+		activate_task(rq, p, 1);
+		success = 1;
+		if (p->flags & PF_WQ_WORKER)
+			wq_worker_waking_up(p);
+	}
+
+	trace_sched_wakeup(rq, p, success);
+	check_preempt_curr(rq, p, 0);
+
+	p->state = TASK_RUNNING;
+#ifdef CONFIG_SMP
+	if (p->sched_class->task_wake_up)
+		p->sched_class->task_wake_up(rq, p);
+#endif
+}
+
 /*
  * Perform scheduler related setup for a newly forked process p.
  * p is forked by current.
@@ -2571,6 +2720,14 @@ static void __sched_fork(struct task_struct *p)
 	p->se.start_runtime		= 0;
 	p->se.avg_wakeup		= sysctl_sched_wakeup_granularity;
 
+#ifdef CONFIG_SMP
+	/* a new task counts as fully loaded until it has a history */
+	p->se.avg.runnable_avg_sum	= LOAD_AVG_MAX;
+	p->se.avg.runnable_avg_period	= LOAD_AVG_MAX;
+	p->se.avg.last_runnable_update	= 0;
+	p->se.avg.load_avg_contrib	= 0;
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	p->se.wait_start			= 0;
 	p->se.wait_max				= 0;
@@ -2609,6 +2766,18 @@ static void __sched_fork(struct task_struct *p)
 	p->se.on_rq = 0;
 	INIT_LIST_HEAD(&p->se.group_node);
 
+	RB_CLEAR_NODE(&p->dl.rb_node);
+	init_dl_task_timer(&p->dl);
+	p->dl.dl_runtime = p->dl.runtime = 0;
+	p->dl.dl_deadline = p->dl.deadline = 0;
+	p->dl.dl_period = 0;
+	p->dl.dl_bw = 0;
+	p->dl.dl_throttled = 0;
+	p->dl.dl_new = 1;
+#ifdef CONFIG_SMP
+	RB_CLEAR_NODE(&p->pushable_dl_tasks);
+#endif
+
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	INIT_HLIST_HEAD(&p->preempt_notifiers);
 #endif
@@ -2640,6 +2809,18 @@ void sched_fork(struct task_struct *p, int clone_flags)
 	 * Make sure we do not leak PI boosting priority to the child:
 	 */
 	p->prio = current->normal_prio;
+
+	/*
+	 * The bandwidth of a SCHED_DEADLINE parent is its own, and was
+	 * admitted for it alone: the child starts as SCHED_NORMAL.
+	 */
+	if (unlikely(task_has_dl_policy(p))) {
+		p->policy = SCHED_NORMAL;
+		p->normal_prio = p->static_prio;
+		p->prio = p->static_prio;
+		set_load_weight(p);
+	}
+
 	if (!rt_prio(p->prio))
 		p->sched_class = &fair_sched_class;
 
@@ -2685,7 +2866,6 @@ void wake_up_new_task(struct task_struct *p, unsigned long clone_flags)
 		 * management (if any):
 		 */
 		p->sched_class->task_new(rq, p);
-		inc_nr_running(rq);
 	}
 	trace_sched_wakeup_new(rq, p, 1);
 	check_preempt_curr(rq, p, 0);
@@ -2772,6 +2952,7 @@ prepare_task_switch(struct rq *rq, struct task_struct *prev,
 		    struct task_struct *next)
 {
 	fire_sched_out_preempt_notifiers(prev, next);
+	tick_nohz_task_switch(prev);
 	prepare_lock_switch(rq, next);
 	prepare_arch_switch(next);
 }
@@ -2829,6 +3010,9 @@ static void finish_task_switch(struct rq *rq, struct task_struct *prev)
 	if (mm)
 		mmdrop(mm);
 	if (unlikely(prev_state == TASK_DEAD)) {
+		if (prev->sched_class->task_dead)
+			prev->sched_class->task_dead(prev);
+
 		/*
 		 * Remove function-return probe instances associated with this
 		 * task and put them back on the free list.
@@ -3048,7 +3232,11 @@ u64 cpu_nr_migrations(int cpu)
  */
 static void update_cpu_load(struct rq *this_rq)
 {
+#ifdef CONFIG_SMP
+	unsigned long this_load = weighted_cpuload(cpu_of(this_rq));
+#else
 	unsigned long this_load = this_rq->load.weight;
+#endif
 	int i, scale;
 
 	this_rq->nr_load_updates++;
@@ -3261,7 +3449,7 @@ next:
 	if (!p || loops++ > sysctl_sched_nr_migrate)
 		goto out;
 
-	if ((p->se.load.weight >> 1) > rem_load_move ||
+	if ((p->se.avg.load_avg_contrib >> 1) > rem_load_move ||
 	    !can_migrate_task(p, busiest, this_cpu, sd, idle, &pinned)) {
 		p = iterator->next(iterator->arg);
 		goto next;
@@ -3269,7 +3457,7 @@ next:
 
 	pull_task(busiest, p, this_rq, this_cpu);
 	pulled++;
-	rem_load_move -= p->se.load.weight;
+	rem_load_move -= p->se.avg.load_avg_contrib;
 
 #ifdef CONFIG_PREEMPT
 	/*
@@ -4047,7 +4235,6 @@ static int load_balance(int this_cpu, struct rq *this_rq,
 	schedstat_inc(sd, lb_count[idle]);
 
 redo:
-	update_shares(sd);
 	group = find_busiest_group(sd, this_cpu, &imbalance, idle, &sd_idle,
 				   cpus, balance);
 
@@ -4172,8 +4359,6 @@ out_one_pinned:
 	else
 		ld_moved = 0;
 out:
-	if (ld_moved)
-		update_shares(sd);
 	return ld_moved;
 }
 
@@ -4209,7 +4394,6 @@ load_balance_newidle(int this_cpu, struct rq *this_rq, struct sched_domain *sd)
 
 	schedstat_inc(sd, lb_count[CPU_NEWLY_IDLE]);
 redo:
-	update_shares_locked(this_rq, sd);
 	group = find_busiest_group(sd, this_cpu, &imbalance, CPU_NEWLY_IDLE,
 				   &sd_idle, cpus, NULL);
 	if (!group) {
@@ -4312,7 +4496,6 @@ redo:
 	} else
 		sd->nr_balance_failed = 0;
 
-	update_shares_locked(this_rq, sd);
 	return ld_moved;
 
 out_balanced:
@@ -4646,6 +4829,8 @@ static void rebalance_domains(int cpu, enum cpu_idle_type idle)
 	int update_next_balance = 0;
 	int need_serialize;
 
+	update_shares(cpu);
+
 	for_each_domain(cpu, sd) {
 		if (!(sd->flags & SD_LOAD_BALANCE))
 			continue;
@@ -4821,6 +5006,29 @@ static inline void idle_balance(int cpu, struct rq *rq)
 {
 }
 
+/*
+ * double_rq_lock - on UP both runqueues are the one runqueue
+ */
+static void double_rq_lock(struct rq *rq1, struct rq *rq2)
+	__acquires(rq1->lock)
+	__acquires(rq2->lock)
+{
+	BUG_ON(!irqs_disabled());
+	BUG_ON(rq1 != rq2);
+	spin_lock(&rq1->lock);
+	__acquire(rq2->lock);	/* Fake it out ;) */
+	update_rq_clock(rq1);
+}
+
+static void double_rq_unlock(struct rq *rq1, struct rq *rq2)
+	__releases(rq1->lock)
+	__releases(rq2->lock)
+{
+	BUG_ON(rq1 != rq2);
+	spin_unlock(&rq1->lock);
+	__release(rq2->lock);
+}
+
 #endif
 
 DEFINE_PER_CPU(struct kernel_stat, kstat);
@@ -5044,6 +5252,27 @@ void account_process_tick(struct task_struct *p, int user_tick)
 		account_idle_time(one_jiffy);
 }
 
+/*
+ * Account multiple ticks of cpu time, for a task whose tick was stopped.
+ * @p: the process that the cpu time gets accounted to
+ * @user_tick: indicates if the ticks are user or system ticks
+ * @ticks: number of ticks
+ */
+void account_process_ticks(struct task_struct *p, int user_tick,
+			   unsigned long ticks)
+{
+	cputime_t cputime = jiffies_to_cputime(ticks);
+	cputime_t cputime_scaled = cputime_to_scaled(cputime);
+
+	if (user_tick)
+		account_user_time(p, cputime, cputime_scaled);
+	else if (p != this_rq()->idle)
+		account_system_time(p, hardirq_count(), cputime,
+				    cputime_scaled);
+	else
+		account_idle_time(cputime);
+}
+
 /*
  * Account multiple ticks of steal time.
  * @p: the process from which the cpu time has been stolen
@@ -5153,6 +5382,35 @@ void scheduler_tick(void)
 #endif
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Called from the tick of a full dynticks cpu, with interrupts disabled.
+ * The tick preempts a task for another one, slices SCHED_RR and charges
+ * SCHED_DEADLINE and CFS quota runtime: a SCHED_FIFO or fair task alone
+ * on its runqueue needs none of that.
+ */
+int sched_can_stop_tick(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *curr;
+	int ret = 0;
+
+	spin_lock(&rq->lock);
+	curr = rq->curr;
+	if (rq->nr_running != 1)
+		goto out;
+
+	if (curr->sched_class == &rt_sched_class)
+		ret = curr->policy == SCHED_FIFO;
+	else if (curr->sched_class == &fair_sched_class)
+		ret = !task_runtime_enabled(curr);
+out:
+	spin_unlock(&rq->lock);
+
+	return ret;
+}
+#endif
+
 notrace unsigned long get_parent_ip(unsigned long addr)
 {
 	if (in_lock_functions(addr)) {
@@ -5292,7 +5550,7 @@ pick_next_task(struct rq *rq)
 	 * Optimization: we know that if all tasks are in
 	 * the fair class we can call that function directly:
 	 */
-	if (likely(rq->nr_running == rq->cfs.nr_running)) {
+	if (likely(rq->nr_running == rq->cfs.h_nr_running)) {
 		p = fair_sched_class.pick_next_task(rq);
 		if (likely(p))
 			return p;
@@ -5344,8 +5602,21 @@ need_resched_nonpreemptible:
 	if (prev->state && !(preempt_count() & PREEMPT_ACTIVE)) {
 		if (unlikely(signal_pending_state(prev->state, prev)))
 			prev->state = TASK_RUNNING;
-		else
+		else {
+			/*
+			 * A workqueue worker blocking may leave works
+			 * behind with nobody running to execute them: let
+			 * the workqueue code hand them to an idle worker.
+			 */
+			if (prev->flags & PF_WQ_WORKER) {
+				struct task_struct *to_wakeup;
+
+				to_wakeup = wq_worker_sleeping(prev);
+				if (to_wakeup)
+					try_to_wake_up_local(to_wakeup);
+			}
 			deactivate_task(rq, prev, 1);
+		}
 		switch_count = &prev->nvcsw;
 	}
 
@@ -5392,7 +5663,8 @@ EXPORT_SYMBOL(schedule);
  * Look out! "owner" is an entirely speculative pointer
  * access and not reliable.
  */
-int mutex_spin_on_owner(struct mutex *lock, struct thread_info *owner)
+static int spin_on_owner(struct thread_info **ownerp,
+			 struct thread_info *owner)
 {
 	unsigned int cpu;
 	struct rq *rq;
@@ -5432,7 +5704,7 @@ int mutex_spin_on_owner(struct mutex *lock, struct thread_info *owner)
 		/*
 		 * Owner changed, break to re-assess state.
 		 */
-		if (lock->owner != owner)
+		if (ACCESS_ONCE(*ownerp) != owner)
 			break;
 
 		/*
@@ -5446,6 +5718,18 @@ int mutex_spin_on_owner(struct mutex *lock, struct thread_info *owner)
 out:
 	return 1;
 }
+
+int mutex_spin_on_owner(struct mutex *lock, struct thread_info *owner)
+{
+	return spin_on_owner(&lock->owner, owner);
+}
+
+#ifdef CONFIG_RWSEM_GENERIC_SPINLOCK
+int rwsem_spin_on_owner(struct rw_semaphore *sem, struct thread_info *owner)
+{
+	return spin_on_owner(&sem->owner, owner);
+}
+#endif
 #endif
 
 #ifdef CONFIG_PREEMPT
@@ -5888,7 +6172,7 @@ void rt_mutex_setprio(struct task_struct *p, int prio)
 	struct rq *rq;
 	const struct sched_class *prev_class = p->sched_class;
 
-	BUG_ON(prio < 0 || prio > MAX_PRIO);
+	BUG_ON(prio > MAX_PRIO);
 
 	rq = task_rq_lock(p, &flags);
 	update_rq_clock(rq);
@@ -5901,7 +6185,9 @@ void rt_mutex_setprio(struct task_struct *p, int prio)
 	if (running)
 		p->sched_class->put_prev_task(rq, p);
 
-	if (rt_prio(prio))
+	if (dl_prio(prio))
+		p->sched_class = &dl_sched_class;
+	else if (rt_prio(prio))
 		p->sched_class = &rt_sched_class;
 	else
 		p->sched_class = &fair_sched_class;
@@ -5938,9 +6224,9 @@ void set_user_nice(struct task_struct *p, long nice)
 	 * The RT priorities are set via sched_setscheduler(), but we still
 	 * allow the 'normal' nice value to be set - but as expected
 	 * it wont have any effect on scheduling until the task is
-	 * SCHED_FIFO/SCHED_RR:
+	 * SCHED_NORMAL/SCHED_BATCH again:
 	 */
-	if (task_has_rt_policy(p)) {
+	if (task_has_rt_policy(p) || task_has_dl_policy(p)) {
 		p->static_prio = NICE_TO_PRIO(nice);
 		goto out_unlock;
 	}
@@ -6091,7 +6377,12 @@ __setscheduler(struct rq *rq, struct task_struct *p, int policy, int prio)
 	case SCHED_RR:
 		p->sched_class = &rt_sched_class;
 		break;
+	case SCHED_DEADLINE:
+		p->sched_class = &dl_sched_class;
+		break;
 	}
+	if (!dl_policy(policy))
+		p->dl.dl_bw = 0;
 
 	p->rt_priority = prio;
 	p->normal_prio = normal_prio(p);
@@ -6100,6 +6391,110 @@ __setscheduler(struct rq *rq, struct task_struct *p, int policy, int prio)
 	set_load_weight(p);
 }
 
+/*
+ * Set the static parameters of a task becoming SCHED_DEADLINE, or of one
+ * given new ones; the actual runtime and absolute deadline are set up at
+ * the next enqueue.  A pending replenishment is stale: dl_task_timer()
+ * ignores it if the cancel loses the race.  Must hold rq lock.
+ */
+static void
+__setparam_dl(struct task_struct *p, const struct sched_attr *attr)
+{
+	struct sched_dl_entity *dl_se = &p->dl;
+
+	hrtimer_try_to_cancel(&dl_se->dl_timer);
+
+	dl_se->dl_runtime = attr->sched_runtime;
+	dl_se->dl_deadline = attr->sched_deadline;
+	dl_se->dl_period = attr->sched_period ?: dl_se->dl_deadline;
+	dl_se->dl_bw = to_ratio(dl_se->dl_period, dl_se->dl_runtime);
+	dl_se->dl_throttled = 0;
+	dl_se->dl_new = 1;
+}
+
+static void
+__getparam_dl(struct task_struct *p, struct sched_attr *attr)
+{
+	struct sched_dl_entity *dl_se = &p->dl;
+
+	attr->sched_priority = p->rt_priority;
+	attr->sched_runtime = dl_se->dl_runtime;
+	attr->sched_deadline = dl_se->dl_deadline;
+	attr->sched_period = dl_se->dl_period;
+}
+
+/*
+ * Validate the parameters of a SCHED_DEADLINE task: a non zero deadline,
+ * at least the runtime, and a period, if any, of at least the deadline.
+ * The runtime must be above the resolution of the CBS arithmetic, and
+ * the values below 2^63 ns, as the deadlines are compared as signed.
+ */
+static bool
+__checkparam_dl(const struct sched_attr *attr)
+{
+	if (attr->sched_deadline == 0)
+		return false;
+
+	if (attr->sched_runtime < (1ULL << DL_SCALE))
+		return false;
+
+	if (attr->sched_deadline & (1ULL << 63) ||
+	    attr->sched_period & (1ULL << 63))
+		return false;
+
+	if ((attr->sched_period != 0 &&
+	     attr->sched_period < attr->sched_deadline) ||
+	    attr->sched_deadline < attr->sched_runtime)
+		return false;
+
+	return true;
+}
+
+/*
+ * SCHED_DEADLINE admission control: a task may enter the class, or get
+ * new parameters, only if the bandwidth of all the -deadline tasks of
+ * its root domain stays within the RT bandwidth limit of each of its
+ * cpus, sched_rt_runtime_us / sched_rt_period_us.  Leaving the class
+ * always succeeds.  On success the domain's total is updated; returns
+ * -EBUSY otherwise.
+ *
+ * Called with p's rq->lock held.
+ */
+static int dl_overflow(struct task_struct *p, int policy,
+		       const struct sched_attr *attr)
+{
+	struct dl_bw *dl_b = dl_bw_of(task_cpu(p));
+	u64 new_bw = 0, total_bw, limit;
+	int err = 0;
+
+	if (dl_policy(policy))
+		new_bw = to_ratio(attr->sched_period ?: attr->sched_deadline,
+				  attr->sched_runtime);
+
+	if (new_bw == p->dl.dl_bw)
+		return 0;
+
+	spin_lock(&dl_b->lock);
+	if (global_rt_runtime() == RUNTIME_INF)
+		limit = ~0ULL;
+	else
+		limit = (u64)to_ratio(global_rt_period(), global_rt_runtime()) *
+			dl_bw_cpus(task_cpu(p));
+
+	/*
+	 * The bandwidth of the others: p's own may be missing from the
+	 * total, if the domains were rebuilt as it changed.
+	 */
+	total_bw = dl_b->total_bw - min(dl_b->total_bw, p->dl.dl_bw);
+	if (new_bw > p->dl.dl_bw && total_bw + new_bw > limit)
+		err = -EBUSY;
+	else
+		dl_b->total_bw = total_bw + new_bw;
+	spin_unlock(&dl_b->lock);
+
+	return err;
+}
+
 /*
  * check the target process has a UID that matches the current process's
  */
@@ -6116,10 +6511,14 @@ static bool check_same_owner(struct task_struct *p)
 	return match;
 }
 
-static int __sched_setscheduler(struct task_struct *p, int policy,
-				struct sched_param *param, bool user)
+static int __sched_setscheduler(struct task_struct *p,
+				const struct sched_attr *attr, bool user)
 {
 	int retval, oldprio, oldpolicy = -1, on_rq, running;
+	int policy = attr->sched_policy;
+	struct sched_param param = {
+		.sched_priority = attr->sched_priority,
+	};
 	unsigned long flags;
 	const struct sched_class *prev_class = p->sched_class;
 	struct rq *rq;
@@ -6132,24 +6531,30 @@ recheck:
 		policy = oldpolicy = p->policy;
 	else if (policy != SCHED_FIFO && policy != SCHED_RR &&
 			policy != SCHED_NORMAL && policy != SCHED_BATCH &&
-			policy != SCHED_IDLE)
+			policy != SCHED_IDLE && policy != SCHED_DEADLINE)
 		return -EINVAL;
 	/*
 	 * Valid priorities for SCHED_FIFO and SCHED_RR are
 	 * 1..MAX_USER_RT_PRIO-1, valid priority for SCHED_NORMAL,
-	 * SCHED_BATCH and SCHED_IDLE is 0.
+	 * SCHED_BATCH, SCHED_IDLE and SCHED_DEADLINE is 0.
 	 */
-	if (param->sched_priority < 0 ||
-	    (p->mm && param->sched_priority > MAX_USER_RT_PRIO-1) ||
-	    (!p->mm && param->sched_priority > MAX_RT_PRIO-1))
+	if ((p->mm && attr->sched_priority > MAX_USER_RT_PRIO-1) ||
+	    (!p->mm && attr->sched_priority > MAX_RT_PRIO-1))
 		return -EINVAL;
-	if (rt_policy(policy) != (param->sched_priority != 0))
+	if ((dl_policy(policy) && !__checkparam_dl(attr)) ||
+	    (rt_policy(policy) != (attr->sched_priority != 0)))
 		return -EINVAL;
 
 	/*
 	 * Allow unprivileged RT tasks to decrease priority:
 	 */
 	if (user && !capable(CAP_SYS_NICE)) {
+		if (!rt_policy(policy) && !dl_policy(policy)) {
+			if (attr->sched_nice < TASK_NICE(p) &&
+			    !can_nice(p, attr->sched_nice))
+				return -EPERM;
+		}
+
 		if (rt_policy(policy)) {
 			unsigned long rlim_rtprio;
 
@@ -6163,10 +6568,17 @@ recheck:
 				return -EPERM;
 
 			/* can't increase priority */
-			if (param->sched_priority > p->rt_priority &&
-			    param->sched_priority > rlim_rtprio)
+			if (attr->sched_priority > p->rt_priority &&
+			    attr->sched_priority > rlim_rtprio)
 				return -EPERM;
 		}
+
+		/*
+		 * A bandwidth reservation cannot be taken, or changed,
+		 * without privilege:
+		 */
+		if (dl_policy(policy))
+			return -EPERM;
 		/*
 		 * Like positive nice levels, dont allow tasks to
 		 * move out of SCHED_IDLE either:
@@ -6190,7 +6602,7 @@ recheck:
 			return -EPERM;
 #endif
 
-		retval = security_task_setscheduler(p, policy, param);
+		retval = security_task_setscheduler(p, policy, &param);
 		if (retval)
 			return retval;
 	}
@@ -6212,6 +6624,18 @@ recheck:
 		spin_unlock_irqrestore(&p->pi_lock, flags);
 		goto recheck;
 	}
+
+	/*
+	 * Entering SCHED_DEADLINE, or changing the parameters of a
+	 * SCHED_DEADLINE task, needs the bandwidth for it:
+	 */
+	if ((dl_policy(policy) || task_has_dl_policy(p)) &&
+	    dl_overflow(p, policy, attr)) {
+		__task_rq_unlock(rq);
+		spin_unlock_irqrestore(&p->pi_lock, flags);
+		return -EBUSY;
+	}
+
 	update_rq_clock(rq);
 	on_rq = p->se.on_rq;
 	running = task_current(rq, p);
@@ -6221,7 +6645,11 @@ recheck:
 		p->sched_class->put_prev_task(rq, p);
 
 	oldprio = p->prio;
-	__setscheduler(rq, p, policy, param->sched_priority);
+	if (!rt_policy(policy) && !dl_policy(policy))
+		p->static_prio = NICE_TO_PRIO(attr->sched_nice);
+	__setscheduler(rq, p, policy, attr->sched_priority);
+	if (dl_policy(policy))
+		__setparam_dl(p, attr);
 
 	if (running)
 		p->sched_class->set_curr_task(rq);
@@ -6230,6 +6658,8 @@ recheck:
 
 		check_class_changed(rq, p, prev_class, oldprio, running);
 	}
+	/* The new policy may need the tick */
+	tick_nohz_full_kick_cpu(cpu_of(rq));
 	__task_rq_unlock(rq);
 	spin_unlock_irqrestore(&p->pi_lock, flags);
 
@@ -6238,6 +6668,21 @@ recheck:
 	return 0;
 }
 
+static int _sched_setscheduler(struct task_struct *p, int policy,
+			       const struct sched_param *param, bool user)
+{
+	struct sched_attr attr = {
+		.sched_policy   = policy,
+		.sched_priority = param->sched_priority,
+		.sched_nice	= TASK_NICE(p),
+	};
+
+	if (param->sched_priority < 0)
+		return -EINVAL;
+
+	return __sched_setscheduler(p, &attr, user);
+}
+
 /**
  * sched_setscheduler - change the scheduling policy and/or RT priority of a thread.
  * @p: the task in question.
@@ -6249,10 +6694,24 @@ recheck:
 int sched_setscheduler(struct task_struct *p, int policy,
 		       struct sched_param *param)
 {
-	return __sched_setscheduler(p, policy, param, true);
+	return _sched_setscheduler(p, policy, param, true);
 }
 EXPORT_SYMBOL_GPL(sched_setscheduler);
 
+/**
+ * sched_setattr - change the scheduling policy and its parameters.
+ * @p: the task in question.
+ * @attr: the new policy and parameters.
+ *
+ * The only way to make a task SCHED_DEADLINE.
+ * NOTE that the task may be already dead.
+ */
+int sched_setattr(struct task_struct *p, const struct sched_attr *attr)
+{
+	return __sched_setscheduler(p, attr, true);
+}
+EXPORT_SYMBOL_GPL(sched_setattr);
+
 /**
  * sched_setscheduler_nocheck - change the scheduling policy and/or RT priority of a thread from kernelspace.
  * @p: the task in question.
@@ -6267,7 +6726,7 @@ EXPORT_SYMBOL_GPL(sched_setscheduler);
 int sched_setscheduler_nocheck(struct task_struct *p, int policy,
 			       struct sched_param *param)
 {
-	return __sched_setscheduler(p, policy, param, false);
+	return _sched_setscheduler(p, policy, param, false);
 }
 
 static int
@@ -6381,6 +6840,157 @@ out_unlock:
 	return retval;
 }
 
+/*
+ * Copy in a struct sched_attr of any size: a shorter one is what an
+ * older userspace knows of, the rest is left zero; a longer one must
+ * have only zeroes past what this kernel knows of.
+ */
+static int sched_copy_attr(struct sched_attr __user *uattr,
+			   struct sched_attr *attr)
+{
+	u32 size;
+	int ret;
+
+	if (!access_ok(VERIFY_WRITE, uattr, SCHED_ATTR_SIZE_VER0))
+		return -EFAULT;
+
+	/*
+	 * zero the full structure, so that a short copy will be nice.
+	 */
+	memset(attr, 0, sizeof(*attr));
+
+	ret = get_user(size, &uattr->size);
+	if (ret)
+		return ret;
+
+	if (size > PAGE_SIZE)	/* silly large */
+		goto err_size;
+
+	if (!size)		/* abi compat */
+		size = SCHED_ATTR_SIZE_VER0;
+
+	if (size < SCHED_ATTR_SIZE_VER0)
+		goto err_size;
+
+	if (size > sizeof(*attr)) {
+		unsigned char __user *addr;
+		unsigned char __user *end;
+		unsigned char val;
+
+		addr = (void __user *)uattr + sizeof(*attr);
+		end  = (void __user *)uattr + size;
+
+		for (; addr < end; addr++) {
+			ret = get_user(val, addr);
+			if (ret)
+				return ret;
+			if (val)
+				goto err_size;
+		}
+		size = sizeof(*attr);
+	}
+
+	if (copy_from_user(attr, uattr, size))
+		return -EFAULT;
+
+	/* out of range nice values are clamped, as by setpriority() */
+	attr->sched_nice = clamp(attr->sched_nice, -20, 19);
+
+	return 0;
+
+err_size:
+	put_user(sizeof(*attr), &uattr->size);
+	return -E2BIG;
+}
+
+/**
+ * sys_sched_setattr - same as above, but with extended sched_attr
+ * @pid: the pid in question.
+ * @uattr: structure containing the extended parameters.
+ * @flags: for future extension, must be zero.
+ */
+SYSCALL_DEFINE3(sched_setattr, pid_t, pid, struct sched_attr __user *, uattr,
+		unsigned int, flags)
+{
+	struct sched_attr attr;
+	struct task_struct *p;
+	int retval;
+
+	if (!uattr || pid < 0 || flags)
+		return -EINVAL;
+
+	retval = sched_copy_attr(uattr, &attr);
+	if (retval)
+		return retval;
+
+	/* negative values for policy are not valid */
+	if ((int)attr.sched_policy < 0)
+		return -EINVAL;
+
+	rcu_read_lock();
+	retval = -ESRCH;
+	p = find_process_by_pid(pid);
+	if (p != NULL)
+		retval = sched_setattr(p, &attr);
+	rcu_read_unlock();
+
+	return retval;
+}
+
+/**
+ * sys_sched_getattr - similar to sched_getparam, but with sched_attr
+ * @pid: the pid in question.
+ * @uattr: structure containing the extended parameters.
+ * @size: sizeof(attr) as known to the caller.
+ * @flags: for future extension, must be zero.
+ */
+SYSCALL_DEFINE4(sched_getattr, pid_t, pid, struct sched_attr __user *, uattr,
+		unsigned int, size, unsigned int, flags)
+{
+	struct sched_attr attr = {
+		.size = sizeof(struct sched_attr),
+	};
+	struct task_struct *p;
+	int retval;
+
+	if (!uattr || pid < 0 || size > PAGE_SIZE ||
+	    size < SCHED_ATTR_SIZE_VER0 || flags)
+		return -EINVAL;
+
+	read_lock(&tasklist_lock);
+	p = find_process_by_pid(pid);
+	retval = -ESRCH;
+	if (!p)
+		goto out_unlock;
+
+	retval = security_task_getscheduler(p);
+	if (retval)
+		goto out_unlock;
+
+	attr.sched_policy = p->policy;
+	if (task_has_dl_policy(p))
+		__getparam_dl(p, &attr);
+	else if (task_has_rt_policy(p))
+		attr.sched_priority = p->rt_priority;
+	else
+		attr.sched_nice = TASK_NICE(p);
+	read_unlock(&tasklist_lock);
+
+	/*
+	 * A caller knowing of a larger structure gets the part of it
+	 * we know of, and its size.
+	 */
+	attr.size = min_t(unsigned int, size, sizeof(attr));
+	if (copy_to_user(uattr, &attr, attr.size))
+		return -EFAULT;
+
+	return 0;
+
+out_unlock:
+	read_unlock(&tasklist_lock);
+	return retval;
+}
+
 long sched_setaffinity(pid_t pid, const struct cpumask *in_mask)
 {
 	cpumask_var_t cpus_allowed, new_mask;
@@ -6423,6 +7033,18 @@ long sched_setaffinity(pid_t pid, const struct cpumask *in_mask)
 
 	cpuset_cpus_allowed(p, cpus_allowed);
 	cpumask_and(new_mask, in_mask, cpus_allowed);
+
+#ifdef CONFIG_SMP
+	/*
+	 * The bandwidth of a SCHED_DEADLINE task was admitted against
+	 * all the cpus of its root domain: it can't be confined to fewer.
+	 */
+	if (task_has_dl_policy(p) &&
+	    !cpumask_subset(task_rq(p)->rd->span, new_mask)) {
+		retval = -EBUSY;
+		goto out_unlock;
+	}
+#endif
  again:
 	retval = set_cpus_allowed_ptr(p, new_mask);
 
@@ -6649,6 +7271,110 @@ void __sched yield(void)
 }
 EXPORT_SYMBOL(yield);
 
+/**
+ * yield_to - yield the current processor to another thread
+ * @p: the thread to run instead
+ * @preempt: whether @p may preempt the current task of its cpu
+ *
+ * Hands the rest of the current timeslice to @p, which must be runnable
+ * but not running, and of the same scheduling class: on this cpu @p is
+ * picked next, on another one it is picked at the next reschedule there,
+ * which @preempt forces.
+ *
+ * It's the caller's job to ensure that the target task struct
+ * can't go away on us before we can do any checks.
+ *
+ * Returns 1 if the timeslice was handed over, 0 otherwise.
+ */
+int __sched yield_to(struct task_struct *p, int preempt)
+{
+	struct task_struct *curr = current;
+	struct rq *rq, *p_rq;
+	unsigned long flags;
+	int yielded = 0;
+
+	local_irq_save(flags);
+	rq = this_rq();
+
+again:
+	p_rq = task_rq(p);
+	double_rq_lock(rq, p_rq);
+	if (task_rq(p) != p_rq) {
+		double_rq_unlock(rq, p_rq);
+		goto again;
+	}
+
+	if (!curr->sched_class->yield_to_task)
+		goto out;
+
+	if (curr->sched_class != p->sched_class)
+		goto out;
+
+	if (task_running(p_rq, p) || p->state)
+		goto out;
+
+	yielded = curr->sched_class->yield_to_task(rq, p, preempt);
+	if (yielded) {
+		schedstat_inc(rq, yld_count);
+		/*
+		 * Make p's cpu reschedule; pick_next_entity() takes care
+		 * of fairness.
+		 */
+		if (preempt && rq != p_rq)
+			resched_task(p_rq->curr);
+	}
+
+out:
+	double_rq_unlock(rq, p_rq);
+	local_irq_restore(flags);
+
+	if (yielded)
+		schedule();
+
+	return yielded;
+}
+EXPORT_SYMBOL_GPL(yield_to);
+
+/**
+ * sys_sched_yield_to - yield the current processor to another thread.
+ * @pid: the thread to run instead
+ *
+ * For lock and queue implementations which know the thread they wait
+ * for: the rest of the caller's timeslice goes to @pid, see yield_to().
+ * Returns -EAGAIN when @pid cannot take it right now.
+ */
+SYSCALL_DEFINE1(sched_yield_to, pid_t, pid)
+{
+	struct task_struct *p;
+	int retval;
+
+	if (pid <= 0)
+		return -EINVAL;
+
+	read_lock(&tasklist_lock);
+	p = find_process_by_pid(pid);
+	if (!p) {
+		read_unlock(&tasklist_lock);
+		return -ESRCH;
+	}
+	get_task_struct(p);
+	read_unlock(&tasklist_lock);
+
+	retval = -EINVAL;
+	if (p == current)
+		goto out;
+
+	retval = -EPERM;
+	if (!check_same_owner(p))
+		goto out;
+
+	retval = yield_to(p, 1) ? 0 : -EAGAIN;
+out:
+	put_task_struct(p);
+
+	return retval;
+}
+
 /*
  * This task is about to go to sleep on IO. Increment rq->nr_iowait so
  * that process accounting knows that this is a task in IO wait state.
@@ -6697,6 +7423,7 @@ SYSCALL_DEFINE1(sched_get_priority_max, int, policy)
 	case SCHED_RR:
 		ret = MAX_USER_RT_PRIO-1;
 		break;
+	case SCHED_DEADLINE:
 	case SCHED_NORMAL:
 	case SCHED_BATCH:
 	case SCHED_IDLE:
@@ -6722,6 +7449,7 @@ SYSCALL_DEFINE1(sched_get_priority_min, int, policy)
 	case SCHED_RR:
 		ret = 1;
 		break;
+	case SCHED_DEADLINE:
 	case SCHED_NORMAL:
 	case SCHED_BATCH:
 	case SCHED_IDLE:
@@ -6760,13 +7488,13 @@ SYSCALL_DEFINE2(sched_rr_get_interval, pid_t, pid,
 		goto out_unlock;
 
 	/*
-	 * Time slice is 0 for SCHED_FIFO tasks and for SCHED_OTHER
-	 * tasks that are on an otherwise idle runqueue:
+	 * Time slice is 0 for SCHED_FIFO and SCHED_DEADLINE tasks, and
+	 * for SCHED_OTHER tasks that are on an otherwise idle runqueue:
 	 */
 	time_slice = 0;
 	if (p->policy == SCHED_RR) {
 		time_slice = DEF_TIMESLICE;
-	} else if (p->policy != SCHED_FIFO) {
+	} else if (p->policy != SCHED_FIFO && p->policy != SCHED_DEADLINE) {
 		struct sched_entity *se = &p->se;
 		unsigned long flags;
 		struct rq *rq;
@@ -6786,6 +7514,34 @@ out_unlock:
 	return retval;
 }
 
+/*
+ * The task state array is a strange "bitmap" of
+ * reasons to sleep. Thus "running" is zero, and
+ * you can test for combinations of others with
+ * simple bit tests.
+ */
+static const char *task_state_array[] = {
+	"R (running)",		/*  0 */
+	"S (sleeping)",		/*  1 */
+	"D (disk sleep)",	/*  2 */
+	"T (stopped)",		/*  4 */
+	"T (tracing stop)",	/*  8 */
+	"Z (zombie)",		/* 16 */
+	"X (dead)"		/* 32 */
+};
+
+const char *get_task_state(struct task_struct *tsk)
+{
+	unsigned int state = (tsk->state & TASK_REPORT) | tsk->exit_state;
+	const char **p = &task_state_array[0];
+
+	while (state) {
+		p++;
+		state >>= 1;
+	}
+	return *p;
+}
+
 static const char stat_nam[] = TASK_STATE_TO_CHAR_STR;
 
 void sched_show_task(struct task_struct *p)
@@ -7806,7 +8562,9 @@ sd_parent_degenerate(struct sched_domain *sd, struct sched_domain *parent)
 static void free_rootdomain(struct root_domain *rd)
 {
 	cpupri_cleanup(&rd->cpupri);
+	cpudl_cleanup(&rd->cpudl);
 
+	free_cpumask_var(rd->dlo_mask);
 	free_cpumask_var(rd->rto_mask);
 	free_cpumask_var(rd->online);
 	free_cpumask_var(rd->span);
@@ -7865,11 +8623,21 @@ static int init_rootdomain(struct root_domain *rd, bool bootmem)
 		goto free_span;
 	if (!alloc_cpumask_var(&rd->rto_mask, gfp))
 		goto free_online;
+	if (!alloc_cpumask_var(&rd->dlo_mask, gfp))
+		goto free_rto_mask;
+
+	init_dl_bw(&rd->dl_bw);
+	if (cpudl_init(&rd->cpudl, bootmem) != 0)
+		goto free_dlo_mask;
 
 	if (cpupri_init(&rd->cpupri, bootmem) != 0)
-		goto free_rto_mask;
+		goto free_cpudl;
 	return 0;
 
+free_cpudl:
+	cpudl_cleanup(&rd->cpudl);
+free_dlo_mask:
+	free_cpumask_var(rd->dlo_mask);
 free_rto_mask:
 	free_cpumask_var(rd->rto_mask);
 free_online:
@@ -8001,74 +8769,69 @@ init_sched_build_groups(const struct cpumask *span,
 	last->next = first;
 }
 
-#define SD_NODES_PER_DOMAIN 16
-
 #ifdef CONFIG_NUMA
 
-/**
- * find_next_best_node - find the next node to include in a sched_domain
- * @node: node whose sched_domain we're building
- * @used_nodes: nodes already in the sched_domain
- *
- * Find the next node to include in a given scheduling domain. Simply
- * finds the closest node not already in the @used_nodes map.
- *
- * Should use nodemask_t.
+/*
+ * NUMA sched domains: one level per distinct distance between the nodes
+ * of the machine, each spanning the nodes up to that distance from the
+ * cpu's own. The farthest level spans the whole machine.
  */
-static int find_next_best_node(int node, nodemask_t *used_nodes)
-{
-	int i, n, val, min_val, best_node = 0;
-
-	min_val = INT_MAX;
-
-	for (i = 0; i < nr_node_ids; i++) {
-		/* Start at @node */
-		n = (node + i) % nr_node_ids;
-
-		if (!nr_cpus_node(n))
-			continue;
-
-		/* Skip already used nodes */
-		if (node_isset(n, *used_nodes))
-			continue;
+#define SD_MAX_NUMA_LEVELS	4
 
-		/* Simple min distance search */
-		val = node_distance(node, n);
+static int sched_domains_numa_levels;
+static int sched_domains_numa_distance[SD_MAX_NUMA_LEVELS];
 
-		if (val < min_val) {
-			min_val = val;
-			best_node = n;
+/**
+ * sched_init_numa - find the distance of each NUMA sched domain level
+ *
+ * Collects the distinct node_distance() values between the nodes with
+ * cpus, nearest first. Should there be more of them than levels, the
+ * last level gets the farthest distance.
+ */
+static void __init sched_init_numa(void)
+{
+	int i, j, d, next, prev = 0, max = 0, nr = 0;
+
+	while (nr < SD_MAX_NUMA_LEVELS - 1) {
+		next = INT_MAX;
+		for_each_node_with_cpus(i) {
+			for_each_node_with_cpus(j) {
+				if (j == i)
+					continue;
+
+				d = node_distance(i, j);
+				if (d > prev && d < next)
+					next = d;
+				if (d > max)
+					max = d;
+			}
 		}
+		if (next == INT_MAX)
+			break;
+
+		sched_domains_numa_distance[nr++] = next;
+		prev = next;
 	}
 
-	node_set(best_node, *used_nodes);
-	return best_node;
+	if (max > prev)
+		sched_domains_numa_distance[nr++] = max;
+	sched_domains_numa_levels = nr;
 }
 
 /**
- * sched_domain_node_span - get a cpumask for a node's sched_domain
+ * sched_domain_numa_span - get a cpumask for a node's NUMA sched_domain
  * @node: node whose cpumask we're constructing
+ * @level: NUMA level of the sched_domain
  * @span: resulting cpumask
- *
- * Given a node, construct a good cpumask for its sched_domain to span. It
- * should be one that prevents unnecessary balancing, but also spreads tasks
- * out optimally.
  */
-static void sched_domain_node_span(int node, struct cpumask *span)
+static void sched_domain_numa_span(int node, int level, struct cpumask *span)
 {
-	nodemask_t used_nodes;
-	int i;
+	int n;
 
 	cpumask_clear(span);
-	nodes_clear(used_nodes);
-
-	cpumask_or(span, span, cpumask_of_node(node));
-	node_set(node, used_nodes);
-
-	for (i = 1; i < SD_NODES_PER_DOMAIN; i++) {
-		int next_node = find_next_best_node(node, &used_nodes);
-
-		cpumask_or(span, span, cpumask_of_node(next_node));
+	for (n = 0; n < nr_node_ids; n++) {
+		if (node_distance(node, n) <= sched_domains_numa_distance[level])
+			cpumask_or(span, span, cpumask_of_node(n));
 	}
 }
 #endif /* CONFIG_NUMA */
@@ -8168,26 +8931,10 @@ cpu_to_phys_group(int cpu, const struct cpumask *cpu_map,
  * groups, so roll our own. Now each node has its own list of groups which
  * gets dynamically allocated.
  */
-static DEFINE_PER_CPU(struct static_sched_domain, node_domains);
+static DEFINE_PER_CPU(struct static_sched_domain,
+		      node_domains[SD_MAX_NUMA_LEVELS]);
 static struct sched_group ***sched_group_nodes_bycpu;
 
-static DEFINE_PER_CPU(struct static_sched_domain, allnodes_domains);
-static DEFINE_PER_CPU(struct static_sched_group, sched_group_allnodes);
-
-static int cpu_to_allnodes_group(int cpu, const struct cpumask *cpu_map,
-				 struct sched_group **sg,
-				 struct cpumask *nodemask)
-{
-	int group;
-
-	cpumask_and(nodemask, cpumask_of_node(cpu_to_node(cpu)), cpu_map);
-	group = cpumask_first(nodemask);
-
-	if (sg)
-		*sg = &per_cpu(sched_group_allnodes, group).sg;
-	return group;
-}
-
 static void init_numa_sched_groups_power(struct sched_group *group_head)
 {
 	struct sched_group *sg = group_head;
@@ -8229,10 +8976,12 @@ static void free_sched_groups(const struct cpumask *cpu_map,
 		if (!sched_group_nodes)
 			continue;
 
-		for (i = 0; i < nr_node_ids; i++) {
+		/* One list of groups per node and NUMA level */
+		for (i = 0; i < sched_domains_numa_levels * nr_node_ids; i++) {
 			struct sched_group *oldsg, *sg = sched_group_nodes[i];
 
-			cpumask_and(nodemask, cpumask_of_node(i), cpu_map);
+			cpumask_and(nodemask, cpumask_of_node(i % nr_node_ids),
+				    cpu_map);
 			if (cpumask_empty(nodemask))
 				continue;
 
@@ -8333,7 +9082,6 @@ static noinline void sd_init_##type(struct sched_domain *sd)	\
 
 SD_INIT_FUNC(CPU)
 #ifdef CONFIG_NUMA
- SD_INIT_FUNC(ALLNODES)
  SD_INIT_FUNC(NODE)
 #endif
 #ifdef CONFIG_SCHED_SMT
@@ -8343,6 +9091,35 @@ SD_INIT_FUNC(CPU)
  SD_INIT_FUNC(MC)
 #endif
 
+#ifdef CONFIG_NUMA
+/*
+ * NUMA levels start from SD_NODE_INIT, which is tuned for nodes at
+ * REMOTE_DISTANCE, and scale the balancing intervals and the imbalance
+ * needed to move tasks with the distance: the farther the nodes, the
+ * less often and the more reluctantly they are balanced.
+ */
+static noinline void sd_init_numa(struct sched_domain *sd, int level)
+{
+	int distance = sched_domains_numa_distance[level];
+
+	SD_INIT(sd, NODE);
+	if (level)
+		sd->level = SD_LV_ALLNODES;
+
+	sd->min_interval = max(1UL, sd->min_interval * distance /
+				  REMOTE_DISTANCE);
+	sd->max_interval = max(1UL, sd->max_interval * distance /
+				  REMOTE_DISTANCE);
+	sd->imbalance_pct = 100 + (sd->imbalance_pct - 100) * distance /
+				  REMOTE_DISTANCE;
+
+	/* Do not spread new tasks, or pull wakees, across far links */
+	if (distance > RECLAIM_DISTANCE)
+		sd->flags &= ~(SD_BALANCE_EXEC | SD_BALANCE_FORK |
+			       SD_WAKE_AFFINE);
+}
+#endif
+
 static int default_relax_domain_level = -1;
 
 static int __init setup_relax_domain_level(char *str)
@@ -8392,7 +9169,7 @@ static int __build_sched_domains(const struct cpumask *cpu_map,
 #ifdef CONFIG_NUMA
 	cpumask_var_t domainspan, covered, notcovered;
 	struct sched_group **sched_group_nodes = NULL;
-	int sd_allnodes = 0;
+	int level;
 
 	if (!alloc_cpumask_var(&domainspan, GFP_KERNEL))
 		goto out;
@@ -8415,10 +9192,10 @@ static int __build_sched_domains(const struct cpumask *cpu_map,
 
 #ifdef CONFIG_NUMA
 	/*
-	 * Allocate the per-node list of sched groups
+	 * Allocate the per-node and per-level list of sched groups
 	 */
-	sched_group_nodes = kcalloc(nr_node_ids, sizeof(struct sched_group *),
-				    GFP_KERNEL);
+	sched_group_nodes = kcalloc(sched_domains_numa_levels * nr_node_ids,
+				    sizeof(struct sched_group *), GFP_KERNEL);
 	if (!sched_group_nodes) {
 		printk(KERN_WARNING "Can not alloc sched group node list\n");
 		goto free_tmpmask;
@@ -8439,32 +9216,25 @@ static int __build_sched_domains(const struct cpumask *cpu_map,
 	 * Set up domains for cpus specified by the cpu_map.
 	 */
 	for_each_cpu(i, cpu_map) {
-		struct sched_domain *sd = NULL, *p;
-
-		cpumask_and(nodemask, cpumask_of_node(cpu_to_node(i)), cpu_map);
-
-#ifdef CONFIG_NUMA
-		if (cpumask_weight(cpu_map) >
-				SD_NODES_PER_DOMAIN*cpumask_weight(nodemask)) {
-			sd = &per_cpu(allnodes_domains, i).sd;
-			SD_INIT(sd, ALLNODES);
-			set_domain_attribute(sd, attr);
-			cpumask_copy(sched_domain_span(sd), cpu_map);
-			cpu_to_allnodes_group(i, cpu_map, &sd->groups, tmpmask);
-			p = sd;
-			sd_allnodes = 1;
-		} else
-			p = NULL;
-
-		sd = &per_cpu(node_domains, i).sd;
-		SD_INIT(sd, NODE);
-		set_domain_attribute(sd, attr);
-		sched_domain_node_span(cpu_to_node(i), sched_domain_span(sd));
-		sd->parent = p;
-		if (p)
-			p->child = sd;
-		cpumask_and(sched_domain_span(sd),
-			    sched_domain_span(sd), cpu_map);
+		struct sched_domain *sd = NULL, *p;
+
+		cpumask_and(nodemask, cpumask_of_node(cpu_to_node(i)), cpu_map);
+
+#ifdef CONFIG_NUMA
+		for (level = sched_domains_numa_levels - 1; level >= 0;
+		     level--) {
+			p = sd;
+			sd = &per_cpu(node_domains, i)[level].sd;
+			sd_init_numa(sd, level);
+			set_domain_attribute(sd, attr);
+			sched_domain_numa_span(cpu_to_node(i), level,
+					       sched_domain_span(sd));
+			cpumask_and(sched_domain_span(sd),
+				    sched_domain_span(sd), cpu_map);
+			sd->parent = p;
+			if (p)
+				p->child = sd;
+		}
 #endif
 
 		p = sd;
@@ -8541,75 +9311,72 @@ static int __build_sched_domains(const struct cpumask *cpu_map,
 	}
 
 #ifdef CONFIG_NUMA
-	/* Set up node groups */
-	if (sd_allnodes) {
-		init_sched_build_groups(cpu_map, cpu_map,
-					&cpu_to_allnodes_group,
-					send_covered, tmpmask);
-	}
-
-	for (i = 0; i < nr_node_ids; i++) {
-		/* Set up node groups */
-		struct sched_group *sg, *prev;
-		int j;
-
-		cpumask_clear(covered);
-		cpumask_and(nodemask, cpumask_of_node(i), cpu_map);
-		if (cpumask_empty(nodemask)) {
-			sched_group_nodes[i] = NULL;
-			continue;
-		}
-
-		sched_domain_node_span(i, domainspan);
-		cpumask_and(domainspan, domainspan, cpu_map);
-
-		sg = kmalloc_node(sizeof(struct sched_group) + cpumask_size(),
-				  GFP_KERNEL, i);
-		if (!sg) {
-			printk(KERN_WARNING "Can not alloc domain group for "
-				"node %d\n", i);
-			goto error;
-		}
-		sched_group_nodes[i] = sg;
-		for_each_cpu(j, nodemask) {
-			struct sched_domain *sd;
-
-			sd = &per_cpu(node_domains, j).sd;
-			sd->groups = sg;
-		}
-		sg->__cpu_power = 0;
-		cpumask_copy(sched_group_cpus(sg), nodemask);
-		sg->next = sg;
-		cpumask_or(covered, covered, nodemask);
-		prev = sg;
-
-		for (j = 0; j < nr_node_ids; j++) {
-			int n = (i + j) % nr_node_ids;
-
-			cpumask_complement(notcovered, covered);
-			cpumask_and(tmpmask, notcovered, cpu_map);
-			cpumask_and(tmpmask, tmpmask, domainspan);
-			if (cpumask_empty(tmpmask))
-				break;
+	/*
+	 * Set up node groups: at each NUMA level, a node's domains have one
+	 * group per node in their span, starting with their own.
+	 */
+	for (level = 0; level < sched_domains_numa_levels; level++) {
+		for (i = 0; i < nr_node_ids; i++) {
+			struct sched_group *sg, *prev;
+			int j;
 
-			cpumask_and(tmpmask, tmpmask, cpumask_of_node(n));
-			if (cpumask_empty(tmpmask))
+			cpumask_clear(covered);
+			cpumask_and(nodemask, cpumask_of_node(i), cpu_map);
+			if (cpumask_empty(nodemask))
 				continue;
 
+			sched_domain_numa_span(i, level, domainspan);
+			cpumask_and(domainspan, domainspan, cpu_map);
+
 			sg = kmalloc_node(sizeof(struct sched_group) +
-					  cpumask_size(),
-					  GFP_KERNEL, i);
+					  cpumask_size(), GFP_KERNEL, i);
 			if (!sg) {
-				printk(KERN_WARNING
-				"Can not alloc domain group for node %d\n", j);
+				printk(KERN_WARNING "Can not alloc domain "
+					"group for node %d\n", i);
 				goto error;
 			}
+			sched_group_nodes[level * nr_node_ids + i] = sg;
+			for_each_cpu(j, nodemask) {
+				struct sched_domain *sd;
+
+				sd = &per_cpu(node_domains, j)[level].sd;
+				sd->groups = sg;
+			}
 			sg->__cpu_power = 0;
-			cpumask_copy(sched_group_cpus(sg), tmpmask);
-			sg->next = prev->next;
-			cpumask_or(covered, covered, tmpmask);
-			prev->next = sg;
+			cpumask_copy(sched_group_cpus(sg), nodemask);
+			sg->next = sg;
+			cpumask_or(covered, covered, nodemask);
 			prev = sg;
+
+			for (j = 0; j < nr_node_ids; j++) {
+				int n = (i + j) % nr_node_ids;
+
+				cpumask_complement(notcovered, covered);
+				cpumask_and(tmpmask, notcovered, cpu_map);
+				cpumask_and(tmpmask, tmpmask, domainspan);
+				if (cpumask_empty(tmpmask))
+					break;
+
+				cpumask_and(tmpmask, tmpmask,
+					    cpumask_of_node(n));
+				if (cpumask_empty(tmpmask))
+					continue;
+
+				sg = kmalloc_node(sizeof(struct sched_group) +
+						  cpumask_size(),
+						  GFP_KERNEL, i);
+				if (!sg) {
+					printk(KERN_WARNING "Can not alloc "
+					"domain group for node %d\n", j);
+					goto error;
+				}
+				sg->__cpu_power = 0;
+				cpumask_copy(sched_group_cpus(sg), tmpmask);
+				sg->next = prev->next;
+				cpumask_or(covered, covered, tmpmask);
+				prev->next = sg;
+				prev = sg;
+			}
 		}
 	}
 #endif
@@ -8637,16 +9404,8 @@ static int __build_sched_domains(const struct cpumask *cpu_map,
 	}
 
 #ifdef CONFIG_NUMA
-	for (i = 0; i < nr_node_ids; i++)
+	for (i = 0; i < sched_domains_numa_levels * nr_node_ids; i++)
 		init_numa_sched_groups_power(sched_group_nodes[i]);
-
-	if (sd_allnodes) {
-		struct sched_group *sg;
-
-		cpu_to_allnodes_group(cpumask_first(cpu_map), cpu_map, &sg,
-								tmpmask);
-		init_numa_sched_groups_power(sg);
-	}
 #endif
 
 	/* Attach the domains */
@@ -8786,6 +9545,42 @@ static int dattrs_equal(struct sched_domain_attr *cur, int idx_cur,
 			sizeof(struct sched_domain_attr));
 }
 
+/*
+ * Each rebuild attaches the cpus to new root domains, which start with
+ * none of the -deadline bandwidth of the tasks already on them: add it
+ * up again from the tasks.  A task is read under its rq lock, as
+ * dl_overflow() updates its bandwidth; one changing its parameters in
+ * between may still be counted twice, until the next rebuild.
+ */
+static void dl_rebuild_bw(void)
+{
+	struct task_struct *g, *p;
+	struct dl_bw *dl_b;
+	unsigned long flags;
+	struct rq *rq;
+	int i;
+
+	for_each_possible_cpu(i) {
+		dl_b = dl_bw_of(i);
+		spin_lock_irqsave(&dl_b->lock, flags);
+		dl_b->total_bw = 0;
+		spin_unlock_irqrestore(&dl_b->lock, flags);
+	}
+
+	read_lock(&tasklist_lock);
+	do_each_thread(g, p) {
+		if (!task_has_dl_policy(p))
+			continue;
+		rq = task_rq_lock(p, &flags);
+		dl_b = dl_bw_of(task_cpu(p));
+		spin_lock(&dl_b->lock);
+		dl_b->total_bw += p->dl.dl_bw;
+		spin_unlock(&dl_b->lock);
+		task_rq_unlock(rq, &flags);
+	} while_each_thread(g, p);
+	read_unlock(&tasklist_lock);
+}
+
 /*
  * Partition sched domains as specified by the 'ndoms_new'
  * cpumasks in the array doms_new[] of cpumasks. This compares
@@ -8871,6 +9666,8 @@ match2:
 	dattr_cur = dattr_new;
 	ndoms_cur = ndoms_new;
 
+	dl_rebuild_bw();
+
 	register_sched_domain_sysctl();
 
 	mutex_unlock(&sched_domains_mutex);
@@ -9020,6 +9817,7 @@ void __init sched_init_smp(void)
 	sched_group_nodes_bycpu = kzalloc(nr_cpu_ids * sizeof(void **),
 								GFP_KERNEL);
 	BUG_ON(sched_group_nodes_bycpu == NULL);
+	sched_init_numa();
 #endif
 	get_online_cpus();
 	mutex_lock(&sched_domains_mutex);
@@ -9048,6 +9846,7 @@ void __init sched_init_smp(void)
 
 	alloc_cpumask_var(&fallback_doms, GFP_KERNEL);
 	init_sched_rt_class();
+	init_sched_dl_class();
 }
 #else
 void __init sched_init_smp(void)
@@ -9071,6 +9870,10 @@ static void init_cfs_rq(struct cfs_rq *cfs_rq, struct rq *rq)
 	INIT_LIST_HEAD(&cfs_rq->tasks);
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	cfs_rq->rq = rq;
+#endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	cfs_rq->runtime_enabled = 0;
+	INIT_LIST_HEAD(&cfs_rq->throttled_list);
 #endif
 	cfs_rq->min_vruntime = (u64)(-(1LL << 20));
 }
@@ -9111,17 +9914,33 @@ static void init_rt_rq(struct rt_rq *rt_rq, struct rq *rq)
 #endif
 }
 
+static void init_dl_rq(struct dl_rq *dl_rq, struct rq *rq)
+{
+	dl_rq->rb_root = RB_ROOT;
+	dl_rq->rb_leftmost = NULL;
+	dl_rq->dl_nr_running = 0;
+
+#ifdef CONFIG_SMP
+	dl_rq->earliest_dl.curr = 0;
+	dl_rq->dl_nr_migratory = 0;
+	dl_rq->dl_nr_total = 0;
+	dl_rq->overloaded = 0;
+	dl_rq->pushable_dl_tasks_root = RB_ROOT;
+	dl_rq->pushable_dl_tasks_leftmost = NULL;
+#else
+	init_dl_bw(&dl_rq->dl_bw);
+#endif
+}
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 static void init_tg_cfs_entry(struct task_group *tg, struct cfs_rq *cfs_rq,
-				struct sched_entity *se, int cpu, int add,
+				struct sched_entity *se, int cpu,
 				struct sched_entity *parent)
 {
 	struct rq *rq = cpu_rq(cpu);
 	tg->cfs_rq[cpu] = cfs_rq;
 	init_cfs_rq(cfs_rq, rq);
 	cfs_rq->tg = tg;
-	if (add)
-		list_add(&cfs_rq->leaf_cfs_rq_list, &rq->leaf_cfs_rq_list);
 
 	tg->se[cpu] = se;
 	/* se could be NULL for init_task_group */
@@ -9248,6 +10067,10 @@ void __init sched_init(void)
 #endif /* CONFIG_USER_SCHED */
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	init_cfs_bandwidth(&init_task_group.cfs_bandwidth);
+#endif
+
 #ifdef CONFIG_GROUP_SCHED
 	list_add(&init_task_group.list, &task_groups);
 	INIT_LIST_HEAD(&init_task_group.children);
@@ -9269,6 +10092,7 @@ void __init sched_init(void)
 		rq->calc_load_update = jiffies + LOAD_FREQ;
 		init_cfs_rq(&rq->cfs, rq);
 		init_rt_rq(&rq->rt, rq);
+		init_dl_rq(&rq->dl, rq);
 #ifdef CONFIG_FAIR_GROUP_SCHED
 		init_task_group.shares = init_task_group_load;
 		INIT_LIST_HEAD(&rq->leaf_cfs_rq_list);
@@ -9292,10 +10116,10 @@ void __init sched_init(void)
 		 * We achieve this by letting init_task_group's tasks sit
 		 * directly in rq->cfs (i.e init_task_group->se[] = NULL).
 		 */
-		init_tg_cfs_entry(&init_task_group, &rq->cfs, NULL, i, 1, NULL);
+		init_tg_cfs_entry(&init_task_group, &rq->cfs, NULL, i, NULL);
 #elif defined CONFIG_USER_SCHED
 		root_task_group.shares = NICE_0_LOAD;
-		init_tg_cfs_entry(&root_task_group, &rq->cfs, NULL, i, 0, NULL);
+		init_tg_cfs_entry(&root_task_group, &rq->cfs, NULL, i, NULL);
 		/*
 		 * In case of task-groups formed thr' the user id of tasks,
 		 * init_task_group represents tasks belonging to root user.
@@ -9309,7 +10133,7 @@ void __init sched_init(void)
 		 */
 		init_tg_cfs_entry(&init_task_group,
 				&per_cpu(init_cfs_rq, i),
-				&per_cpu(init_sched_entity, i), i, 1,
+				&per_cpu(init_sched_entity, i), i,
 				root_task_group.se[i]);
 
 #endif
@@ -9433,6 +10257,9 @@ static void normalize_task(struct rq *rq, struct task_struct *p)
 	int on_rq;
 
 	update_rq_clock(rq);
+	/* a -deadline task gives its bandwidth back, that always works */
+	if (task_has_dl_policy(p))
+		dl_overflow(p, SCHED_NORMAL, NULL);
 	on_rq = p->se.on_rq;
 	if (on_rq)
 		deactivate_task(rq, p, 0);
@@ -9537,6 +10364,10 @@ static void free_fair_sched_group(struct task_group *tg)
 {
 	int i;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	destroy_cfs_bandwidth(tg_cfs_bandwidth(tg));
+#endif
+
 	for_each_possible_cpu(i) {
 		if (tg->cfs_rq)
 			kfree(tg->cfs_rq[i]);
@@ -9565,6 +10396,10 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 
 	tg->shares = NICE_0_LOAD;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+	init_cfs_bandwidth(tg_cfs_bandwidth(tg));
+#endif
+
 	for_each_possible_cpu(i) {
 		rq = cpu_rq(i);
 
@@ -9578,7 +10413,7 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 		if (!se)
 			goto err;
 
-		init_tg_cfs_entry(tg, cfs_rq, se, i, 0, parent->se[i]);
+		init_tg_cfs_entry(tg, cfs_rq, se, i, parent->se[i]);
 	}
 
 	return 1;
@@ -9587,15 +10422,18 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 	return 0;
 }
 
-static inline void register_fair_sched_group(struct task_group *tg, int cpu)
+/*
+ * The cfs_rqs of a group go on the leaf lists as they get tasks, see
+ * list_add_leaf_cfs_rq(); one may still be there when the group goes.
+ */
+static void unregister_fair_sched_group(struct task_group *tg, int cpu)
 {
-	list_add_rcu(&tg->cfs_rq[cpu]->leaf_cfs_rq_list,
-			&cpu_rq(cpu)->leaf_cfs_rq_list);
-}
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
 
-static inline void unregister_fair_sched_group(struct task_group *tg, int cpu)
-{
-	list_del_rcu(&tg->cfs_rq[cpu]->leaf_cfs_rq_list);
+	spin_lock_irqsave(&rq->lock, flags);
+	list_del_leaf_cfs_rq(tg->cfs_rq[cpu]);
+	spin_unlock_irqrestore(&rq->lock, flags);
 }
 #else /* !CONFG_FAIR_GROUP_SCHED */
 static inline void free_fair_sched_group(struct task_group *tg)
@@ -9608,10 +10446,6 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 	return 1;
 }
 
-static inline void register_fair_sched_group(struct task_group *tg, int cpu)
-{
-}
-
 static inline void unregister_fair_sched_group(struct task_group *tg, int cpu)
 {
 }
@@ -9731,10 +10565,8 @@ struct task_group *sched_create_group(struct task_group *parent)
 		goto err;
 
 	spin_lock_irqsave(&task_group_lock, flags);
-	for_each_possible_cpu(i) {
-		register_fair_sched_group(tg, i);
+	for_each_possible_cpu(i)
 		register_rt_sched_group(tg, i);
-	}
 	list_add_rcu(&tg->list, &task_groups);
 
 	WARN_ON(!parent); /* root should already exist */
@@ -9817,33 +10649,6 @@ void sched_move_task(struct task_struct *tsk)
 #endif /* CONFIG_GROUP_SCHED */
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
-static void __set_se_shares(struct sched_entity *se, unsigned long shares)
-{
-	struct cfs_rq *cfs_rq = se->cfs_rq;
-	int on_rq;
-
-	on_rq = se->on_rq;
-	if (on_rq)
-		dequeue_entity(cfs_rq, se, 0);
-
-	se->load.weight = shares;
-	se->load.inv_weight = 0;
-
-	if (on_rq)
-		enqueue_entity(cfs_rq, se, 0);
-}
-
-static void set_se_shares(struct sched_entity *se, unsigned long shares)
-{
-	struct cfs_rq *cfs_rq = se->cfs_rq;
-	struct rq *rq = cfs_rq->rq;
-	unsigned long flags;
-
-	spin_lock_irqsave(&rq->lock, flags);
-	__set_se_shares(se, shares);
-	spin_unlock_irqrestore(&rq->lock, flags);
-}
-
 static DEFINE_MUTEX(shares_mutex);
 
 int sched_group_set_shares(struct task_group *tg, unsigned long shares)
@@ -9866,37 +10671,17 @@ int sched_group_set_shares(struct task_group *tg, unsigned long shares)
 	if (tg->shares == shares)
 		goto done;
 
-	spin_lock_irqsave(&task_group_lock, flags);
-	for_each_possible_cpu(i)
-		unregister_fair_sched_group(tg, i);
-	list_del_rcu(&tg->siblings);
-	spin_unlock_irqrestore(&task_group_lock, flags);
-
-	/* wait for any ongoing reference to this group to finish */
-	synchronize_sched();
-
-	/*
-	 * Now we are free to modify the group's share on each cpu
-	 * w/o tripping rebalance_share or load_balance_fair.
-	 */
 	tg->shares = shares;
 	for_each_possible_cpu(i) {
-		/*
-		 * force a rebalance
-		 */
-		cfs_rq_set_shares(tg->cfs_rq[i], 0);
-		set_se_shares(tg->se[i], shares);
+		struct rq *rq = cpu_rq(i);
+
+		/* each cpu's entity takes its part of the new shares */
+		spin_lock_irqsave(&rq->lock, flags);
+		update_rq_clock(rq);
+		update_cfs_shares(tg->cfs_rq[i]);
+		spin_unlock_irqrestore(&rq->lock, flags);
 	}
 
-	/*
-	 * Enable load balance activity on this group, by inserting it back on
-	 * each cpu's rq->leaf_cfs_rq_list.
-	 */
-	spin_lock_irqsave(&task_group_lock, flags);
-	for_each_possible_cpu(i)
-		register_fair_sched_group(tg, i);
-	list_add_rcu(&tg->siblings, &tg->parent->children);
-	spin_unlock_irqrestore(&task_group_lock, flags);
 done:
 	mutex_unlock(&shares_mutex);
 	return 0;
@@ -9914,14 +10699,6 @@ unsigned long sched_group_shares(struct task_group *tg)
  */
 static DEFINE_MUTEX(rt_constraints_mutex);
 
-static unsigned long to_ratio(u64 period, u64 runtime)
-{
-	if (runtime == RUNTIME_INF)
-		return 1ULL << 20;
-
-	return div64_u64(runtime << 20, period);
-}
-
 /* Must be called with tasklist_lock held */
 static inline int tg_has_rt_tasks(struct task_group *tg)
 {
@@ -10259,6 +11036,230 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * Serializes changes to the bandwidth of all groups, which are checked
+ * against each other.
+ */
+static DEFINE_MUTEX(cfs_constraints_mutex);
+
+static const u64 max_cfs_quota_period = 1 * NSEC_PER_SEC; /* 1s */
+static const u64 min_cfs_quota_period = 1 * NSEC_PER_MSEC; /* 1ms */
+
+static int __cfs_schedulable(struct task_group *tg, u64 period, u64 runtime);
+
+static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
+{
+	int i, ret = 0, runtime_enabled;
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(tg);
+
+	if (tg == &init_task_group)
+		return -EINVAL;
+
+	/*
+	 * Ensure we have some amount of bandwidth every period, so that a
+	 * group throttled from the tick never falls too far in arrears.
+	 */
+	if (quota < min_cfs_quota_period || period < min_cfs_quota_period)
+		return -EINVAL;
+
+	/* and bound the period, which also keeps to_ratio() from overflowing */
+	if (period > max_cfs_quota_period)
+		return -EINVAL;
+
+	mutex_lock(&cfs_constraints_mutex);
+	ret = __cfs_schedulable(tg, period, quota);
+	if (ret)
+		goto out_unlock;
+
+	runtime_enabled = quota != RUNTIME_INF;
+	spin_lock_irq(&cfs_b->lock);
+	cfs_b->period = ns_to_ktime(period);
+	cfs_b->quota = quota;
+
+	__refill_cfs_bandwidth_runtime(cfs_b);
+	/* a running timer moves to the new period at its next expiry */
+	if (runtime_enabled)
+		__start_cfs_bandwidth(cfs_b);
+	spin_unlock_irq(&cfs_b->lock);
+
+	for_each_possible_cpu(i) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+		struct rq *rq = rq_of(cfs_rq);
+
+		spin_lock_irq(&rq->lock);
+		cfs_rq->runtime_enabled = runtime_enabled;
+		cfs_rq->runtime_remaining = 0;
+
+		if (cfs_rq_throttled(cfs_rq))
+			unthrottle_cfs_rq(cfs_rq);
+		spin_unlock_irq(&rq->lock);
+	}
+out_unlock:
+	mutex_unlock(&cfs_constraints_mutex);
+
+	return ret;
+}
+
+static int tg_set_cfs_quota(struct task_group *tg, long cfs_quota_us)
+{
+	u64 quota, period;
+
+	period = ktime_to_ns(tg_cfs_bandwidth(tg)->period);
+	if (cfs_quota_us < 0)
+		quota = RUNTIME_INF;
+	else
+		quota = (u64)cfs_quota_us * NSEC_PER_USEC;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+static long tg_get_cfs_quota(struct task_group *tg)
+{
+	u64 quota_us;
+
+	if (tg_cfs_bandwidth(tg)->quota == RUNTIME_INF)
+		return -1;
+
+	quota_us = tg_cfs_bandwidth(tg)->quota;
+	do_div(quota_us, NSEC_PER_USEC);
+
+	return quota_us;
+}
+
+static int tg_set_cfs_period(struct task_group *tg, long cfs_period_us)
+{
+	u64 quota, period;
+
+	period = (u64)cfs_period_us * NSEC_PER_USEC;
+	quota = tg_cfs_bandwidth(tg)->quota;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+static long tg_get_cfs_period(struct task_group *tg)
+{
+	u64 cfs_period_us;
+
+	cfs_period_us = ktime_to_ns(tg_cfs_bandwidth(tg)->period);
+	do_div(cfs_period_us, NSEC_PER_USEC);
+
+	return cfs_period_us;
+}
+
+static s64 cpu_cfs_quota_read_s64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return tg_get_cfs_quota(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_quota_write_s64(struct cgroup *cgrp, struct cftype *cftype,
+				   s64 cfs_quota_us)
+{
+	return tg_set_cfs_quota(cgroup_tg(cgrp), cfs_quota_us);
+}
+
+static u64 cpu_cfs_period_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return tg_get_cfs_period(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_period_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+				    u64 cfs_period_us)
+{
+	return tg_set_cfs_period(cgroup_tg(cgrp), cfs_period_us);
+}
+
+struct cfs_schedulable_data {
+	struct task_group *tg;
+	u64 period, quota;
+};
+
+/*
+ * normalize group quota/period to be quota/max_period
+ * note: units are usecs
+ */
+static u64 normalize_cfs_quota(struct task_group *tg,
+			       struct cfs_schedulable_data *d)
+{
+	u64 quota, period;
+
+	if (tg == d->tg) {
+		period = d->period;
+		quota = d->quota;
+	} else {
+		period = tg_get_cfs_period(tg);
+		quota = tg_get_cfs_quota(tg);
+	}
+
+	/* note: these should typically be equivalent */
+	if (quota == RUNTIME_INF || quota == -1)
+		return RUNTIME_INF;
+
+	return to_ratio(period, quota);
+}
+
+/*
+ * A group may not be given more bandwidth than its parent; one without a
+ * limit of its own inherits the parent's for the children to check against.
+ */
+static int tg_cfs_schedulable_down(struct task_group *tg, void *data)
+{
+	struct cfs_schedulable_data *d = data;
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(tg);
+	s64 quota = 0, parent_quota = -1;
+
+	if (!tg->parent) {
+		quota = RUNTIME_INF;
+	} else {
+		struct cfs_bandwidth *parent_b = tg_cfs_bandwidth(tg->parent);
+
+		quota = normalize_cfs_quota(tg, d);
+		parent_quota = parent_b->hierarchal_quota;
+
+		/*
+		 * ensure max(child_quota) <= parent_quota, inherit when no
+		 * limit is set
+		 */
+		if (quota == RUNTIME_INF)
+			quota = parent_quota;
+		else if (parent_quota != RUNTIME_INF && quota > parent_quota)
+			return -EINVAL;
+	}
+	cfs_b->hierarchal_quota = quota;
+
+	return 0;
+}
+
+static int __cfs_schedulable(struct task_group *tg, u64 period, u64 quota)
+{
+	struct cfs_schedulable_data data = {
+		.tg = tg,
+		.period = period,
+		.quota = quota,
+	};
+
+	if (quota != RUNTIME_INF) {
+		do_div(data.period, NSEC_PER_USEC);
+		do_div(data.quota, NSEC_PER_USEC);
+	}
+
+	return walk_tg_tree(tg_cfs_schedulable_down, tg_nop, &data);
+}
+
+static int cpu_stats_show(struct cgroup *cgrp, struct cftype *cft,
+			  struct cgroup_map_cb *cb)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(tg);
+
+	cb->fill(cb, "nr_periods", cfs_b->nr_periods);
+	cb->fill(cb, "nr_throttled", cfs_b->nr_throttled);
+	cb->fill(cb, "throttled_time", cfs_b->throttled_time);
+
+	return 0;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 #ifdef CONFIG_RT_GROUP_SCHED
 static int cpu_rt_runtime_write(struct cgroup *cgrp, struct cftype *cft,
 				s64 val)
@@ -10291,6 +11292,22 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_shares_write_u64,
 	},
 #endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	{
+		.name = "cfs_quota_us",
+		.read_s64 = cpu_cfs_quota_read_s64,
+		.write_s64 = cpu_cfs_quota_write_s64,
+	},
+	{
+		.name = "cfs_period_us",
+		.read_u64 = cpu_cfs_period_read_u64,
+		.write_u64 = cpu_cfs_period_write_u64,
+	},
+	{
+		.name = "stat",
+		.read_map = cpu_stats_show,
+	},
+#endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
 		.name = "rt_runtime_us",
@@ -0,0 +1,40 @@
+#ifndef _LINUX_CPUDL_H
+#define _LINUX_CPUDL_H
+
+#include <linux/sched.h>
+
+#define IDX_INVALID     -1
+
+/* Deadlines are compared as in time_before(), to survive wrapping */
+static inline int dl_time_before(u64 a, u64 b)
+{
+	return (s64)(a - b) < 0;
+}
+
+struct cpudl_item {
+	u64 dl;
+	int cpu;
+};
+
+struct cpudl {
+	spinlock_t lock;
+	int size;
+	int cpu_to_idx[NR_CPUS];
+	struct cpudl_item elements[NR_CPUS];
+	cpumask_var_t free_cpus;
+};
+
+#ifdef CONFIG_SMP
+int cpudl_find(struct cpudl *cp, struct task_struct *p,
+	       struct cpumask *later_mask);
+void cpudl_set(struct cpudl *cp, int cpu, u64 dl, int is_valid);
+void cpudl_set_freecpu(struct cpudl *cp, int cpu);
+void cpudl_clear_freecpu(struct cpudl *cp, int cpu);
+int cpudl_init(struct cpudl *cp, bool bootmem);
+void cpudl_cleanup(struct cpudl *cp);
+#else
+#define cpudl_set(cp, cpu, dl, is_valid) do { } while (0)
+#define cpudl_init() do { } while (0)
+#endif
+
+#endif /* _LINUX_CPUDL_H */
@@ -73,6 +73,15 @@ unsigned int sysctl_sched_wakeup_granularity = 5000000UL;
 
 const_debug unsigned int sysctl_sched_migration_cost = 500000UL;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * The amount of runtime a cfs_rq takes from its group's global pool at a
+ * time, so that the pool's lock is not taken on every update_curr().
+ * (default: 5 msec, units: microseconds)
+ */
+unsigned int sysctl_sched_cfs_bandwidth_slice = 5000UL;
+#endif
+
 static const struct sched_class fair_sched_class;
 
 /**************************************************************
@@ -124,6 +133,41 @@ static inline struct cfs_rq *cpu_cfs_rq(struct cfs_rq *cfs_rq, int this_cpu)
 	return cfs_rq->tg->cfs_rq[this_cpu];
 }
 
+/*
+ * A cfs_rq is put on the leaf list of its runqueue when it gets its first
+ * entity, and taken off by update_shares() once it is empty again, so that
+ * the walks over the list only see the groups active on the cpu.
+ */
+static inline void list_add_leaf_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+
+	if (cfs_rq->on_list)
+		return;
+
+	/*
+	 * Children go before their parent, so that a walk of the list
+	 * sees them first.  Enqueueing goes bottom up: either the parent is
+	 * on the list already and we go in front, or it will go in behind
+	 * us when it gets its first entity, right after this one.
+	 */
+	if (cfs_rq->tg->parent &&
+	    cfs_rq->tg->parent->cfs_rq[cpu_of(rq)]->on_list)
+		list_add_rcu(&cfs_rq->leaf_cfs_rq_list, &rq->leaf_cfs_rq_list);
+	else
+		list_add_tail_rcu(&cfs_rq->leaf_cfs_rq_list,
+				  &rq->leaf_cfs_rq_list);
+	cfs_rq->on_list = 1;
+}
+
+static inline void list_del_leaf_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	if (cfs_rq->on_list) {
+		list_del_rcu(&cfs_rq->leaf_cfs_rq_list);
+		cfs_rq->on_list = 0;
+	}
+}
+
 /* Iterate thr' all leaf cfs_rq's on a runqueue */
 #define for_each_leaf_cfs_rq(rq, cfs_rq) \
 	list_for_each_entry_rcu(cfs_rq, &rq->leaf_cfs_rq_list, leaf_cfs_rq_list)
@@ -222,6 +266,14 @@ static inline struct cfs_rq *cpu_cfs_rq(struct cfs_rq *cfs_rq, int this_cpu)
 	return &cpu_rq(this_cpu)->cfs;
 }
 
+static inline void list_add_leaf_cfs_rq(struct cfs_rq *cfs_rq)
+{
+}
+
+static inline void list_del_leaf_cfs_rq(struct cfs_rq *cfs_rq)
+{
+}
+
 #define for_each_leaf_cfs_rq(rq, cfs_rq) \
 		for (cfs_rq = &rq->cfs; cfs_rq; cfs_rq = NULL)
 
@@ -481,6 +533,9 @@ __update_curr(struct cfs_rq *cfs_rq, struct sched_entity *curr,
 	update_min_vruntime(cfs_rq);
 }
 
+static void account_cfs_rq_runtime(struct cfs_rq *cfs_rq,
+				   unsigned long delta_exec);
+
 static void update_curr(struct cfs_rq *cfs_rq)
 {
 	struct sched_entity *curr = cfs_rq->curr;
@@ -508,6 +563,8 @@ static void update_curr(struct cfs_rq *cfs_rq)
 		cpuacct_charge(curtask, delta_exec);
 		account_group_exec_runtime(curtask, delta_exec);
 	}
+
+	account_cfs_rq_runtime(cfs_rq, delta_exec);
 }
 
 static inline void
@@ -580,6 +637,228 @@ add_cfs_task_weight(struct cfs_rq *cfs_rq, unsigned long weight)
 }
 #endif
 
+#ifdef CONFIG_SMP
+/*
+ * Per-entity load tracking.
+ *
+ * Each entity keeps a geometric series of the time it was runnable, in
+ * periods of 1024us, p_0 being the current one:
+ *
+ *   runnable_avg_sum = u_0 + u_1*y + u_2*y^2 + ...
+ *
+ * u_i being the part of p_i it was runnable for, and y such that
+ * y^32 = 1/2: what it did 32ms ago counts half as much as what it does
+ * now.  runnable_avg_period is the same series with every period counted
+ * in full, so sum/period is the fraction of recent time the entity was
+ * runnable; that fraction of its weight, load_avg_contrib, is what it
+ * adds to the runnable_load_avg of its cfs_rq while it is queued there.
+ */
+#define LOAD_AVG_PERIOD	32
+#define LOAD_AVG_MAX	47742	/* the largest runnable_avg_sum can get */
+#define LOAD_AVG_MAX_N	348	/* the periods it takes to get there */
+
+/* 2^32 * y^n, for n in [0, LOAD_AVG_PERIOD) */
+static const u32 runnable_avg_yN_inv[] = {
+	0xffffffff, 0xfa83b2db, 0xf5257d15, 0xefe4b99b, 0xeac0c6e7, 0xe5b906e7,
+	0xe0ccdeec, 0xdbfbb797, 0xd744fcca, 0xd2a81d91, 0xce248c15, 0xc9b9bd86,
+	0xc5672a11, 0xc12c4cca, 0xbd08a39f, 0xb8fbaf47, 0xb504f333, 0xb123f581,
+	0xad583eea, 0xa9a15ab4, 0xa5fed6a9, 0xa2704303, 0x9ef53260, 0x9b8d39b9,
+	0x9837f051, 0x94f4efa8, 0x91c3d373, 0x8ea4398b, 0x8b95c1e3, 0x88980e80,
+	0x85aac367, 0x82cd8698,
+};
+
+/* 1024 * (y + y^2 + ... + y^n), for n in [0, LOAD_AVG_PERIOD] */
+static const u32 runnable_avg_yN_sum[] = {
+	    0,  1002,  1982,  2942,  3881,  4800,  5699,  6579,  7440,  8282,
+	 9107,  9914, 10704, 11476, 12232, 12972, 13696, 14405, 15098, 15777,
+	16441, 17091, 17726, 18349, 18957, 19553, 20136, 20707, 21265, 21812,
+	22346, 22870, 23382,
+};
+
+/* val * y^n */
+static u64 decay_load(u64 val, u64 n)
+{
+	unsigned int local_n;
+
+	if (!n)
+		return val;
+	if (n > LOAD_AVG_PERIOD * 63)
+		return 0;
+
+	local_n = n;
+	val >>= local_n / LOAD_AVG_PERIOD;
+	local_n %= LOAD_AVG_PERIOD;
+
+	return (val * runnable_avg_yN_inv[local_n]) >> 32;
+}
+
+/* What n full periods add to the series: 1024 * (y + ... + y^n) */
+static u32 __compute_runnable_contrib(u64 n)
+{
+	u32 contrib = 0;
+
+	if (n <= LOAD_AVG_PERIOD)
+		return runnable_avg_yN_sum[n];
+	if (n >= LOAD_AVG_MAX_N)
+		return LOAD_AVG_MAX;
+
+	/* each LOAD_AVG_PERIOD halves the periods before it */
+	do {
+		contrib /= 2;
+		contrib += runnable_avg_yN_sum[LOAD_AVG_PERIOD];
+		n -= LOAD_AVG_PERIOD;
+	} while (n > LOAD_AVG_PERIOD);
+
+	contrib = decay_load(contrib, n);
+	return contrib + runnable_avg_yN_sum[n];
+}
+
+/*
+ * Account the time since the last update, as runnable or not; returns
+ * whether a period boundary was crossed, that is whether the average
+ * has changed by more than the time just added.
+ */
+static int __update_entity_runnable_avg(u64 now, struct sched_avg *sa,
+					int runnable)
+{
+	u64 delta, periods;
+	u32 delta_w, contrib;
+	int decayed = 0;
+
+	delta = now - sa->last_runnable_update;
+	/* the clock of another cpu, on a migration, may lag behind ours */
+	if ((s64)delta < 0) {
+		sa->last_runnable_update = now;
+		return 0;
+	}
+
+	/* in units of 1024ns, near enough to a microsecond */
+	delta >>= 10;
+	if (!delta)
+		return 0;
+	sa->last_runnable_update = now;
+
+	delta_w = sa->runnable_avg_period % 1024;
+	if (delta + delta_w >= 1024) {
+		decayed = 1;
+
+		/* complete the current period, then decay it with the rest */
+		delta_w = 1024 - delta_w;
+		if (runnable)
+			sa->runnable_avg_sum += delta_w;
+		sa->runnable_avg_period += delta_w;
+		delta -= delta_w;
+
+		periods = delta >> 10;
+		delta &= 1023;
+
+		sa->runnable_avg_sum = decay_load(sa->runnable_avg_sum,
+						  periods + 1);
+		sa->runnable_avg_period = decay_load(sa->runnable_avg_period,
+						     periods + 1);
+
+		/* the whole periods in between */
+		contrib = __compute_runnable_contrib(periods);
+		if (runnable)
+			sa->runnable_avg_sum += contrib;
+		sa->runnable_avg_period += contrib;
+	}
+
+	/* and what there is of the new one */
+	if (runnable)
+		sa->runnable_avg_sum += delta;
+	sa->runnable_avg_period += delta;
+
+	return decayed;
+}
+
+/* Recompute load_avg_contrib, and return by how much it moved */
+static long __update_entity_load_avg_contrib(struct sched_entity *se)
+{
+	long old_contrib = se->avg.load_avg_contrib;
+	u64 contrib;
+
+	contrib = (u64)se->avg.runnable_avg_sum * se->load.weight;
+	se->avg.load_avg_contrib = div_u64(contrib,
+					   se->avg.runnable_avg_period + 1);
+
+	return (long)se->avg.load_avg_contrib - old_contrib;
+}
+
+#ifdef CONFIG_FAIR_GROUP_SCHED
+/*
+ * Fold the change in the load of this cfs_rq into its group's total, once
+ * it has moved by more than an eighth: tg->load_avg is shared by all the
+ * cpus the group runs on.
+ */
+static void update_cfs_rq_tg_contrib(struct cfs_rq *cfs_rq, int force)
+{
+	long delta = (long)cfs_rq->runnable_load_avg - cfs_rq->tg_load_contrib;
+
+	/* nobody asks the root group for its load */
+	if (!cfs_rq->tg->parent)
+		return;
+
+	if (force || delta > cfs_rq->tg_load_contrib / 8 ||
+	    -delta > cfs_rq->tg_load_contrib / 8) {
+		atomic_long_add(delta, &cfs_rq->tg->load_avg);
+		cfs_rq->tg_load_contrib += delta;
+	}
+}
+#else
+static inline void update_cfs_rq_tg_contrib(struct cfs_rq *cfs_rq, int force)
+{
+}
+#endif
+
+/*
+ * Bring the average of an entity up to date; if it is queued and
+ * @update_cfs_rq is set, carry the change of its contribution over to
+ * its cfs_rq.
+ */
+static void update_entity_load_avg(struct sched_entity *se, int update_cfs_rq)
+{
+	struct cfs_rq *cfs_rq = cfs_rq_of(se);
+	long contrib_delta;
+
+	if (!__update_entity_runnable_avg(rq_of(cfs_rq)->clock, &se->avg,
+					  se->on_rq))
+		return;
+
+	contrib_delta = __update_entity_load_avg_contrib(se);
+	if (update_cfs_rq && se->on_rq)
+		cfs_rq->runnable_load_avg += contrib_delta;
+}
+
+/* Called before the entity is accounted as queued */
+static void
+enqueue_entity_load_avg(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	/* the time it was away counts as not runnable */
+	update_entity_load_avg(se, 0);
+	cfs_rq->runnable_load_avg += se->avg.load_avg_contrib;
+	update_cfs_rq_tg_contrib(cfs_rq, 0);
+}
+
+/* Called before the entity is accounted as dequeued */
+static void
+dequeue_entity_load_avg(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+	update_entity_load_avg(se, 1);
+	cfs_rq->runnable_load_avg -= se->avg.load_avg_contrib;
+	update_cfs_rq_tg_contrib(cfs_rq, 0);
+}
+#else
+static inline void update_entity_load_avg(struct sched_entity *se,
+					  int update_cfs_rq) {}
+static inline void update_cfs_rq_tg_contrib(struct cfs_rq *cfs_rq,
+					    int force) {}
+static inline void
+enqueue_entity_load_avg(struct cfs_rq *cfs_rq, struct sched_entity *se) {}
+static inline void
+dequeue_entity_load_avg(struct cfs_rq *cfs_rq, struct sched_entity *se) {}
+#endif /* CONFIG_SMP */
+
 static void
 account_entity_enqueue(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
@@ -608,6 +887,99 @@ account_entity_dequeue(struct cfs_rq *cfs_rq, struct sched_entity *se)
 	se->on_rq = 0;
 }
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+static inline int throttled_hierarchy(struct cfs_rq *cfs_rq);
+
+static void
+reweight_entity(struct cfs_rq *cfs_rq, struct sched_entity *se,
+		unsigned long weight)
+{
+	int on_rq = se->on_rq;
+
+	if (on_rq) {
+		/* commit outstanding execution time at the old weight */
+		if (cfs_rq->curr == se)
+			update_curr(cfs_rq);
+		account_entity_dequeue(cfs_rq, se);
+	}
+
+	se->load.weight = weight;
+	se->load.inv_weight = 0;
+
+	if (on_rq)
+		account_entity_enqueue(cfs_rq, se);
+}
+
+#ifdef CONFIG_SMP
+/*
+ * The load of the group over all cpus, with the current weight of this
+ * cpu's part rather than its average: that one is the one that changes.
+ */
+static unsigned long calc_tg_weight(struct task_group *tg,
+				    struct cfs_rq *cfs_rq)
+{
+	long tg_weight;
+
+	tg_weight = atomic_long_read(&tg->load_avg);
+	tg_weight -= cfs_rq->tg_load_contrib;
+	tg_weight += cfs_rq->load.weight;
+
+	return max(tg_weight, 0L);
+}
+
+/*
+ *                  tg->shares * cfs_rq->load.weight
+ *   shares = --------------------------------------------
+ *             \Sum of the group's load over all cpus
+ */
+static unsigned long calc_cfs_shares(struct cfs_rq *cfs_rq,
+				     struct task_group *tg)
+{
+	unsigned long tg_weight = calc_tg_weight(tg, cfs_rq);
+	u64 shares = (u64)tg->shares * cfs_rq->load.weight;
+
+	if (tg_weight)
+		shares = div64_u64(shares, tg_weight);
+	else
+		shares = tg->shares;
+
+	return clamp_t(unsigned long, shares, MIN_SHARES, tg->shares);
+}
+#else
+static inline unsigned long calc_cfs_shares(struct cfs_rq *cfs_rq,
+					    struct task_group *tg)
+{
+	return tg->shares;
+}
+#endif
+
+/*
+ * Give the group's entity on this cpu the part of the group's shares
+ * that this cpu's part of its load calls for.  Only this cpu's runqueue
+ * is touched: the other cpus catch up from tg->load_avg when their own
+ * load changes, or on their next tick.
+ */
+static void update_cfs_shares(struct cfs_rq *cfs_rq)
+{
+	struct task_group *tg = cfs_rq->tg;
+	struct sched_entity *se = tg->se[cpu_of(rq_of(cfs_rq))];
+	unsigned long shares;
+
+	if (!se || throttled_hierarchy(cfs_rq))
+		return;
+
+	shares = calc_cfs_shares(cfs_rq, tg);
+	if (abs(shares - se->load.weight) <= sysctl_sched_shares_thresh)
+		return;
+
+	reweight_entity(cfs_rq_of(se), se, shares);
+}
+#else
+static inline void update_cfs_shares(struct cfs_rq *cfs_rq)
+{
+}
+#endif
+
 static void enqueue_sleeper(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
 #ifdef CONFIG_SCHEDSTATS
@@ -713,6 +1085,8 @@ place_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int initial)
 	se->vruntime = vruntime;
 }
 
+static void check_enqueue_throttle(struct cfs_rq *cfs_rq);
+
 static void
 enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int wakeup)
 {
@@ -720,7 +1094,9 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int wakeup)
 	 * Update run-time statistics of the 'current'.
 	 */
 	update_curr(cfs_rq);
+	enqueue_entity_load_avg(cfs_rq, se);
 	account_entity_enqueue(cfs_rq, se);
+	update_cfs_shares(cfs_rq);
 
 	if (wakeup) {
 		place_entity(cfs_rq, se, 0);
@@ -731,6 +1107,11 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int wakeup)
 	check_spread(cfs_rq, se);
 	if (se != cfs_rq->curr)
 		__enqueue_entity(cfs_rq, se);
+
+	if (cfs_rq->nr_running == 1) {
+		list_add_leaf_cfs_rq(cfs_rq);
+		check_enqueue_throttle(cfs_rq);
+	}
 }
 
 static void __clear_buddies(struct cfs_rq *cfs_rq, struct sched_entity *se)
@@ -740,6 +1121,9 @@ static void __clear_buddies(struct cfs_rq *cfs_rq, struct sched_entity *se)
 
 	if (cfs_rq->next == se)
 		cfs_rq->next = NULL;
+
+	if (cfs_rq->skip == se)
+		cfs_rq->skip = NULL;
 }
 
 static void clear_buddies(struct cfs_rq *cfs_rq, struct sched_entity *se)
@@ -774,8 +1158,10 @@ dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int sleep)
 
 	if (se != cfs_rq->curr)
 		__dequeue_entity(cfs_rq, se);
+	dequeue_entity_load_avg(cfs_rq, se);
 	account_entity_dequeue(cfs_rq, se);
 	update_min_vruntime(cfs_rq);
+	update_cfs_shares(cfs_rq);
 }
 
 /*
@@ -810,6 +1196,7 @@ set_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 		 */
 		update_stats_wait_end(cfs_rq, se);
 		__dequeue_entity(cfs_rq, se);
+		update_entity_load_avg(se, 1);
 	}
 
 	update_stats_curr_start(cfs_rq, se);
@@ -833,17 +1220,37 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se);
 
 static struct sched_entity *pick_next_entity(struct cfs_rq *cfs_rq)
 {
-	struct sched_entity *se = __pick_next_entity(cfs_rq);
+	struct sched_entity *left = __pick_next_entity(cfs_rq);
+	struct sched_entity *se = left;
 
-	if (cfs_rq->next && wakeup_preempt_entity(cfs_rq->next, se) < 1)
+	if (cfs_rq->next && wakeup_preempt_entity(cfs_rq->next, left) < 1)
 		return cfs_rq->next;
 
-	if (cfs_rq->last && wakeup_preempt_entity(cfs_rq->last, se) < 1)
+	if (cfs_rq->last && wakeup_preempt_entity(cfs_rq->last, left) < 1)
 		return cfs_rq->last;
 
+	/*
+	 * Avoid running the skip buddy, if running something else can
+	 * be done without getting too unfair.
+	 */
+	if (cfs_rq->skip == left) {
+		struct rb_node *next_node = rb_next(&left->run_node);
+
+		if (next_node) {
+			struct sched_entity *second;
+
+			second = rb_entry(next_node, struct sched_entity,
+					  run_node);
+			if (wakeup_preempt_entity(second, left) < 1)
+				se = second;
+		}
+	}
+
 	return se;
 }
 
+static void check_cfs_rq_runtime(struct cfs_rq *cfs_rq);
+
 static void put_prev_entity(struct cfs_rq *cfs_rq, struct sched_entity *prev)
 {
 	/*
@@ -853,11 +1260,15 @@ static void put_prev_entity(struct cfs_rq *cfs_rq, struct sched_entity *prev)
 	if (prev->on_rq)
 		update_curr(cfs_rq);
 
+	/* throttle cfs_rqs exceeding runtime */
+	check_cfs_rq_runtime(cfs_rq);
+
 	check_spread(cfs_rq, prev);
 	if (prev->on_rq) {
 		update_stats_wait_start(cfs_rq, prev);
 		/* Put 'current' back into the tree. */
 		__enqueue_entity(cfs_rq, prev);
+		update_entity_load_avg(prev, 1);
 	}
 	cfs_rq->curr = NULL;
 }
@@ -870,6 +1281,13 @@ entity_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr, int queued)
 	 */
 	update_curr(cfs_rq);
 
+	/*
+	 * Ensure that runnable average is periodically updated.
+	 */
+	update_entity_load_avg(curr, 1);
+	update_cfs_rq_tg_contrib(cfs_rq, 0);
+	update_cfs_shares(cfs_rq);
+
 #ifdef CONFIG_SCHED_HRTICK
 	/*
 	 * queued ticks are scheduled to match the slice, so don't bother
@@ -891,6 +1309,464 @@ entity_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr, int queued)
 		check_preempt_tick(cfs_rq, curr);
 }
 
+/**************************************************
+ * CFS bandwidth control machinery
+ */
+
+#ifdef CONFIG_CFS_BANDWIDTH
+static inline struct cfs_bandwidth *tg_cfs_bandwidth(struct task_group *tg)
+{
+	return &tg->cfs_bandwidth;
+}
+
+static inline u64 sched_cfs_bandwidth_slice(void)
+{
+	return (u64)sysctl_sched_cfs_bandwidth_slice * NSEC_PER_USEC;
+}
+
+/*
+ * Refill the global pool to the quota at the start of a new period.
+ * Called with cfs_b->lock held.
+ */
+static void __refill_cfs_bandwidth_runtime(struct cfs_bandwidth *cfs_b)
+{
+	u64 now;
+
+	if (cfs_b->quota == RUNTIME_INF)
+		return;
+
+	now = sched_clock_cpu(smp_processor_id());
+	cfs_b->runtime = cfs_b->quota;
+	cfs_b->runtime_expires = now + ktime_to_ns(cfs_b->period);
+}
+
+static void __start_cfs_bandwidth(struct cfs_bandwidth *cfs_b);
+
+/* Take a slice from the global pool; returns whether runtime is left */
+static int assign_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	u64 amount = 0, min_amount, expires;
+
+	/* note: this is a positive sum, as runtime_remaining <= 0 */
+	min_amount = sched_cfs_bandwidth_slice() - cfs_rq->runtime_remaining;
+
+	spin_lock(&cfs_b->lock);
+	if (cfs_b->quota == RUNTIME_INF)
+		amount = min_amount;
+	else {
+		/*
+		 * An inactive timer means at least one period went by with
+		 * nothing consumed: refill the pool and start it again.
+		 */
+		if (!cfs_b->timer_active) {
+			__refill_cfs_bandwidth_runtime(cfs_b);
+			__start_cfs_bandwidth(cfs_b);
+		}
+
+		if (cfs_b->runtime > 0) {
+			amount = min(cfs_b->runtime, min_amount);
+			cfs_b->runtime -= amount;
+			cfs_b->idle = 0;
+		}
+	}
+	expires = cfs_b->runtime_expires;
+	spin_unlock(&cfs_b->lock);
+
+	cfs_rq->runtime_remaining += amount;
+	/*
+	 * The local expiry may have been pushed out to allow for drift
+	 * between our clock and the one the pool was refilled on.
+	 */
+	if ((s64)(expires - cfs_rq->runtime_expires) > 0)
+		cfs_rq->runtime_expires = expires;
+
+	return cfs_rq->runtime_remaining > 0;
+}
+
+/* Runtime left over from a previous period does not carry over */
+static void expire_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	struct rq *rq = rq_of(cfs_rq);
+
+	if (likely((s64)(rq->clock - cfs_rq->runtime_expires) < 0))
+		return;
+
+	if (cfs_rq->runtime_remaining < 0)
+		return;
+
+	/*
+	 * Our clock may run ahead of the one the pool was refilled on: the
+	 * runtime has only truly expired once the pool's expiry moved on.
+	 */
+	if ((s64)(cfs_rq->runtime_expires - cfs_b->runtime_expires) >= 0) {
+		/* extend local deadline, drift is bounded above by 2 ticks */
+		cfs_rq->runtime_expires += TICK_NSEC;
+	} else {
+		/* global deadline is ahead, expiration has passed */
+		cfs_rq->runtime_remaining = 0;
+	}
+}
+
+static void account_cfs_rq_runtime(struct cfs_rq *cfs_rq,
+				   unsigned long delta_exec)
+{
+	if (!cfs_rq->runtime_enabled)
+		return;
+
+	/* dock delta_exec before expiring quota, as it could span periods */
+	cfs_rq->runtime_remaining -= delta_exec;
+	expire_cfs_rq_runtime(cfs_rq);
+
+	if (likely(cfs_rq->runtime_remaining > 0))
+		return;
+
+	/*
+	 * If we cannot extend our runtime, resched so that put_prev_entity()
+	 * throttles the running hierarchy.
+	 */
+	if (!assign_cfs_rq_runtime(cfs_rq) && likely(cfs_rq->curr))
+		resched_task(rq_of(cfs_rq)->curr);
+}
+
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return cfs_rq->throttled;
+}
+
+/* check whether cfs_rq, or any parent, is throttled */
+static inline int throttled_hierarchy(struct cfs_rq *cfs_rq)
+{
+	return cfs_rq->throttle_count;
+}
+
+static int tg_throttle_down(struct task_group *tg, void *data)
+{
+	struct rq *rq = data;
+
+	tg->cfs_rq[cpu_of(rq)]->throttle_count++;
+	return 0;
+}
+
+static int tg_unthrottle_up(struct task_group *tg, void *data)
+{
+	struct rq *rq = data;
+
+	tg->cfs_rq[cpu_of(rq)]->throttle_count--;
+	return 0;
+}
+
+/*
+ * Take the group's entity, and those above it that have nothing else
+ * queued, off the runqueue: the tasks below stay queued on cfs_rq and do
+ * not count in rq->nr_running until it is unthrottled.
+ */
+static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	struct sched_entity *se;
+	long task_delta, dequeue = 1;
+
+	se = cfs_rq->tg->se[cpu_of(rq)];
+
+	walk_tg_tree_from(cfs_rq->tg, tg_throttle_down, tg_nop, (void *)rq);
+
+	task_delta = cfs_rq->h_nr_running;
+	for_each_sched_entity(se) {
+		struct cfs_rq *qcfs_rq = cfs_rq_of(se);
+
+		/* throttled entity or throttle-on-deactivate */
+		if (!se->on_rq)
+			break;
+
+		if (dequeue)
+			dequeue_entity(qcfs_rq, se, 1);
+		qcfs_rq->h_nr_running -= task_delta;
+
+		if (qcfs_rq->load.weight)
+			dequeue = 0;
+	}
+
+	if (!se)
+		rq->nr_running -= task_delta;
+
+	cfs_rq->throttled = 1;
+	cfs_rq->throttled_timestamp = rq->clock;
+	spin_lock(&cfs_b->lock);
+	list_add_tail_rcu(&cfs_rq->throttled_list, &cfs_b->throttled_cfs_rq);
+	spin_unlock(&cfs_b->lock);
+}
+
+static void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	struct sched_entity *se;
+	int enqueue = 1;
+	long task_delta;
+
+	se = cfs_rq->tg->se[cpu_of(rq)];
+
+	cfs_rq->throttled = 0;
+	update_rq_clock(rq);
+
+	spin_lock(&cfs_b->lock);
+	cfs_b->throttled_time += rq->clock - cfs_rq->throttled_timestamp;
+	list_del_rcu(&cfs_rq->throttled_list);
+	spin_unlock(&cfs_b->lock);
+
+	walk_tg_tree_from(cfs_rq->tg, tg_nop, tg_unthrottle_up, (void *)rq);
+
+	if (!cfs_rq->load.weight)
+		return;
+
+	task_delta = cfs_rq->h_nr_running;
+	for_each_sched_entity(se) {
+		if (se->on_rq)
+			enqueue = 0;
+
+		cfs_rq = cfs_rq_of(se);
+		if (enqueue)
+			enqueue_entity(cfs_rq, se, 1);
+		cfs_rq->h_nr_running += task_delta;
+
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	if (!se)
+		rq->nr_running += task_delta;
+
+	/* determine whether we need to wake up a potentially idle cpu */
+	if (rq->curr == rq->idle && rq->cfs.nr_running)
+		resched_task(rq->curr);
+}
+
+/*
+ * Hand the runtime of a new period to the throttled cfs_rqs, paying each
+ * one's debt first; returns what is left.
+ */
+static u64 distribute_cfs_runtime(struct cfs_bandwidth *cfs_b,
+				  u64 remaining, u64 expires)
+{
+	struct cfs_rq *cfs_rq;
+	u64 runtime;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(cfs_rq, &cfs_b->throttled_cfs_rq,
+				throttled_list) {
+		struct rq *rq = rq_of(cfs_rq);
+
+		spin_lock(&rq->lock);
+		if (!cfs_rq_throttled(cfs_rq))
+			goto next;
+
+		runtime = -cfs_rq->runtime_remaining + 1;
+		if (runtime > remaining)
+			runtime = remaining;
+		remaining -= runtime;
+
+		cfs_rq->runtime_remaining += runtime;
+		cfs_rq->runtime_expires = expires;
+
+		/* we check whether we're throttled above */
+		if (cfs_rq->runtime_remaining > 0)
+			unthrottle_cfs_rq(cfs_rq);
+
+next:
+		spin_unlock(&rq->lock);
+
+		if (!remaining)
+			break;
+	}
+	rcu_read_unlock();
+
+	return remaining;
+}
+
+/*
+ * Called from the period timer, with overrun the number of periods that
+ * elapsed; returns whether the timer can stop, the group having been idle
+ * for a whole period.
+ */
+static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
+{
+	u64 runtime, runtime_expires;
+	int idle = 1, throttled;
+
+	spin_lock(&cfs_b->lock);
+	/* no need to continue the timer with no bandwidth constraint */
+	if (cfs_b->quota == RUNTIME_INF)
+		goto out_unlock;
+
+	throttled = !list_empty(&cfs_b->throttled_cfs_rq);
+	/* idle depends on !throttled, in the case of a large deficit */
+	idle = cfs_b->idle && !throttled;
+	cfs_b->nr_periods += overrun;
+
+	/* if we're going inactive then everything else can be deferred */
+	if (idle)
+		goto out_unlock;
+
+	__refill_cfs_bandwidth_runtime(cfs_b);
+
+	if (!throttled) {
+		/* mark as potentially idle for the upcoming period */
+		cfs_b->idle = 1;
+		goto out_unlock;
+	}
+
+	/* account preceding periods in which throttling occurred */
+	cfs_b->nr_throttled += overrun;
+
+	/*
+	 * Pay the debts of the throttled cfs_rqs out of the new runtime
+	 * before making it available to the others.  The pool lock cannot
+	 * nest inside the rq locks taken to unthrottle, and a cfs_rq that
+	 * is unthrottled meanwhile may be throttled again: loop.
+	 */
+	runtime = cfs_b->runtime;
+	runtime_expires = cfs_b->runtime_expires;
+	cfs_b->runtime = 0;
+
+	while (throttled && runtime > 0) {
+		spin_unlock(&cfs_b->lock);
+		runtime = distribute_cfs_runtime(cfs_b, runtime,
+						 runtime_expires);
+		spin_lock(&cfs_b->lock);
+
+		throttled = !list_empty(&cfs_b->throttled_cfs_rq);
+	}
+
+	/* return (any) remaining runtime */
+	cfs_b->runtime = runtime;
+	/*
+	 * Keep the timer going while anything is throttled, even if the new
+	 * runtime did not cover the deficit.
+	 */
+	cfs_b->idle = 0;
+out_unlock:
+	if (idle)
+		cfs_b->timer_active = 0;
+	spin_unlock(&cfs_b->lock);
+
+	return idle;
+}
+
+/*
+ * When a group wakes up we want to make sure that its quota is not already
+ * expired, otherwise it may be allowed to steal additional ticks of runtime
+ * since update_curr() throttling can not trigger until it's on-rq.
+ */
+static void check_enqueue_throttle(struct cfs_rq *cfs_rq)
+{
+	/* an active group must be handled by the update_curr()->put() path */
+	if (!cfs_rq->runtime_enabled || cfs_rq->curr)
+		return;
+
+	/* ensure the group is not already throttled */
+	if (cfs_rq_throttled(cfs_rq))
+		return;
+
+	/* update runtime allocation */
+	account_cfs_rq_runtime(cfs_rq, 0);
+	if (cfs_rq->runtime_remaining <= 0)
+		throttle_cfs_rq(cfs_rq);
+}
+
+/* conditionally throttle active cfs_rq's from put_prev_entity() */
+static void check_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	if (likely(!cfs_rq->runtime_enabled || cfs_rq->runtime_remaining > 0))
+		return;
+
+	/*
+	 * it's possible for a throttled entity to be forced into a running
+	 * state (e.g. set_curr_task), in this case we're finished.
+	 */
+	if (cfs_rq_throttled(cfs_rq))
+		return;
+
+	throttle_cfs_rq(cfs_rq);
+}
+
+/*
+ * Neither pull tasks from a throttled hierarchy, where they do not run,
+ * nor push them into one.
+ */
+static inline int throttled_lb_pair(struct task_group *tg,
+				    int src_cpu, int dest_cpu)
+{
+	return throttled_hierarchy(tg->cfs_rq[src_cpu]) ||
+	       throttled_hierarchy(tg->cfs_rq[dest_cpu]);
+}
+
+#ifdef CONFIG_SMP
+/*
+ * A cpu going away must not keep tasks throttled, out of sight of
+ * migrate_dead_tasks(), until a period timer elsewhere gets to them.
+ */
+static void unthrottle_offline_cfs_rqs(struct rq *rq)
+{
+	struct cfs_rq *cfs_rq;
+
+	for_each_leaf_cfs_rq(rq, cfs_rq) {
+		if (!cfs_rq->runtime_enabled)
+			continue;
+
+		/* nothing will run here again, any positive amount will do */
+		cfs_rq->runtime_remaining = 1;
+		if (cfs_rq_throttled(cfs_rq))
+			unthrottle_cfs_rq(cfs_rq);
+	}
+}
+#endif
+
+/* Runtime under a quota is charged from the tick. */
+static inline int task_runtime_enabled(struct task_struct *p)
+{
+	struct sched_entity *se = &p->se;
+
+	for_each_sched_entity(se) {
+		if (cfs_rq_of(se)->runtime_enabled)
+			return 1;
+	}
+	return 0;
+}
+#else /* CONFIG_CFS_BANDWIDTH */
+static inline void account_cfs_rq_runtime(struct cfs_rq *cfs_rq,
+					  unsigned long delta_exec) {}
+static inline void check_enqueue_throttle(struct cfs_rq *cfs_rq) {}
+static inline void check_cfs_rq_runtime(struct cfs_rq *cfs_rq) {}
+
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return 0;
+}
+
+static inline int throttled_hierarchy(struct cfs_rq *cfs_rq)
+{
+	return 0;
+}
+
+static inline int throttled_lb_pair(struct task_group *tg,
+				    int src_cpu, int dest_cpu)
+{
+	return 0;
+}
+
+#ifdef CONFIG_SMP
+static inline void unthrottle_offline_cfs_rqs(struct rq *rq) {}
+#endif
+
+static inline int task_runtime_enabled(struct task_struct *p)
+{
+	return 0;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 /**************************************************
  * CFS operations on tasks:
  */
@@ -966,9 +1842,29 @@ static void enqueue_task_fair(struct rq *rq, struct task_struct *p, int wakeup)
 			break;
 		cfs_rq = cfs_rq_of(se);
 		enqueue_entity(cfs_rq, se, wakeup);
+
+		/*
+		 * end evaluation on encountering a throttled cfs_rq: the
+		 * final h_nr_running increment is posted below.
+		 */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+		cfs_rq->h_nr_running++;
 		wakeup = 1;
 	}
 
+	/* the levels already queued, up to a throttled one if any */
+	for_each_sched_entity(se) {
+		cfs_rq = cfs_rq_of(se);
+		cfs_rq->h_nr_running++;
+
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	/* a task in a throttled hierarchy does not count as running */
+	if (!se)
+		inc_nr_running(rq);
 	hrtick_update(rq);
 }
 
@@ -985,12 +1881,30 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int sleep)
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, sleep);
+
+		/* as in enqueue_task_fair(), stop at a throttled cfs_rq */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+		cfs_rq->h_nr_running--;
+
 		/* Don't dequeue parent if it has other entities besides us */
-		if (cfs_rq->load.weight)
+		if (cfs_rq->load.weight) {
+			se = parent_entity(se);
 			break;
+		}
 		sleep = 1;
 	}
 
+	for_each_sched_entity(se) {
+		cfs_rq = cfs_rq_of(se);
+		cfs_rq->h_nr_running--;
+
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	if (!se)
+		dec_nr_running(rq);
 	hrtick_update(rq);
 }
 
@@ -1115,6 +2029,59 @@ static inline int wake_idle(int cpu, struct task_struct *p)
 
 #ifdef CONFIG_SMP
 
+/*
+ * Upper bound on the cpus select_idle_sibling() looks at, so that the
+ * cost of a wakeup does not grow with the size of the cache domain.
+ */
+#define SCHED_IDLE_SIBLING_SCAN	16
+
+/*
+ * If @target is busy, look for an idle cpu that shares its cache: first
+ * among its SMT siblings, then in the wider SD_SHARE_PKG_RESOURCES
+ * domains.  Such a cpu is as good as @target for the cache footprint
+ * of the wakee and the waker, and it can run the task right away
+ * instead of queueing it behind the current one.
+ *
+ * Returns @target if it is idle or nothing idle was found in budget.
+ */
+static int select_idle_sibling(struct task_struct *p, int target, int sync)
+{
+	struct sched_domain *sd;
+	int budget = SCHED_IDLE_SIBLING_SCAN;
+	int i;
+
+	if (!sched_feat(IDLE_SIBLING) || idle_cpu(target))
+		return target;
+
+	/*
+	 * A sync waker is about to sleep: its cpu will be idle by the time
+	 * the wakee gets to run, if the waker is all there is on it.
+	 */
+	if (sync && target == smp_processor_id() &&
+	    cpu_rq(target)->nr_running == 1)
+		return target;
+
+	for_each_domain(target, sd) {
+		if (!(sd->flags & SD_SHARE_PKG_RESOURCES))
+			break;
+
+		for_each_cpu_and(i, sched_domain_span(sd), &p->cpus_allowed) {
+			/* the child domain has been scanned already */
+			if (sd->child &&
+			    cpumask_test_cpu(i, sched_domain_span(sd->child)))
+				continue;
+			if (!budget--)
+				return target;
+			if (cpu_active(i) && idle_cpu(i)) {
+				if (i != task_cpu(p))
+					schedstat_inc(p, se.nr_wakeups_idle);
+				return i;
+			}
+		}
+	}
+	return target;
+}
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 /*
  * effective_load() calculates the load change as seen from the root_task_group
@@ -1123,13 +2090,8 @@ static inline int wake_idle(int cpu, struct task_struct *p)
  * of group shares between cpus. Assuming the shares were perfectly aligned one
  * can calculate the shift in shares.
  *
- * The problem is that perfectly aligning the shares is rather expensive, hence
- * we try to avoid doing that too often - see update_shares(), which ratelimits
- * this change.
- *
- * We compensate this by not only taking the current delta into account, but
- * also considering the delta between when the shares were last adjusted and
- * now.
+ * The shares are computed as update_cfs_shares() does it, from the group's
+ * load on the other cpus as it stands in tg->load_avg.
  *
  * We still saw a performance dip, some tracing learned us that between
  * cgroup:/ and cgroup:/foo balancing the number of affine wakeups increased
@@ -1153,28 +2115,27 @@ static long effective_load(struct task_group *tg, int cpu,
 		return wl;
 
 	for_each_sched_entity(se) {
-		long S, rw, s, a, b;
-		long more_w;
+		long w, W;
 
-		/*
-		 * Instead of using this increment, also add the difference
-		 * between when the shares were last updated and now.
-		 */
-		more_w = se->my_q->load.weight - se->my_q->rq_weight;
-		wl += more_w;
-		wg += more_w;
+		tg = se->my_q->tg;
 
-		S = se->my_q->tg->shares;
-		s = se->my_q->shares;
-		rw = se->my_q->rq_weight;
+		/* the group's load, and this cpu's part of it, after the change */
+		W = wg + calc_tg_weight(tg, se->my_q);
+		w = se->my_q->load.weight + wl;
 
-		a = S*(rw + wl);
-		b = S*rw + s*wg;
+		/* wl = the new shares of this cpu, as calc_cfs_shares() */
+		if (w <= 0)
+			wl = 0;
+		else if (w < W)
+			wl = div64_u64((u64)w * tg->shares, W);
+		else
+			wl = tg->shares;
 
-		wl = s*(a-b);
+		if (wl < MIN_SHARES)
+			wl = MIN_SHARES;
 
-		if (likely(b))
-			wl /= b;
+		/* and how much the group's entity gains by it */
+		wl -= se->load.weight;
 
 		/*
 		 * Assume the group is already running and will
@@ -1309,7 +2270,7 @@ static int select_task_rq_fair(struct task_struct *p, int sync)
 
 	if (wake_affine(this_sd, this_rq, p, prev_cpu, this_cpu, sync, idx,
 				     load, this_load, imbalance))
-		return this_cpu;
+		return select_idle_sibling(p, this_cpu, sync);
 
 	/*
 	 * Start passive balancing when half the imbalance_pct
@@ -1319,11 +2280,12 @@ static int select_task_rq_fair(struct task_struct *p, int sync)
 		if (imbalance*this_load <= 100*load) {
 			schedstat_inc(this_sd, ttwu_move_balance);
 			schedstat_inc(p, se.nr_wakeups_passive);
-			return this_cpu;
+			return select_idle_sibling(p, this_cpu, 0);
 		}
 	}
 
 out:
+	new_cpu = select_idle_sibling(p, new_cpu, sync);
 	return wake_idle(new_cpu, p);
 }
 #endif /* CONFIG_SMP */
@@ -1434,6 +2396,34 @@ static void set_next_buddy(struct sched_entity *se)
 	}
 }
 
+static void set_skip_buddy(struct sched_entity *se)
+{
+	for_each_sched_entity(se)
+		cfs_rq_of(se)->skip = se;
+}
+
+/*
+ * yield_to() support: ask for @p to be picked next, and for the yielding
+ * current task not to be, as far as fairness allows.
+ */
+static int yield_to_task_fair(struct rq *rq, struct task_struct *p, int preempt)
+{
+	struct sched_entity *curr = &rq->curr->se;
+	struct sched_entity *se = &p->se;
+
+	/* throttled hierarchies are not runnable */
+	if (!se->on_rq || throttled_hierarchy(cfs_rq_of(se)))
+		return 0;
+
+	clear_buddies(cfs_rq_of(curr), curr);
+	update_curr(cfs_rq_of(curr));
+
+	set_next_buddy(se);
+	set_skip_buddy(curr);
+
+	return 1;
+}
+
 /*
  * Preempt the current task with a newly woken task if needed:
  */
@@ -1607,6 +2597,87 @@ __load_balance_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 }
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
+/*
+ * Bring the averages and shares of the groups active on @cpu up to date:
+ * the enqueue, dequeue and tick paths only refresh the entities they
+ * touch, this catches up with those that have been waiting.  The cfs_rqs
+ * that went empty are taken off the leaf list.
+ */
+static void update_shares(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	struct cfs_rq *cfs_rq;
+	unsigned long flags;
+	u64 now = cpu_clock(cpu);
+
+	if ((s64)(now - rq->shares_update) <
+	    (s64)(u64)sysctl_sched_shares_ratelimit)
+		return;
+	rq->shares_update = now;
+
+	spin_lock_irqsave(&rq->lock, flags);
+	update_rq_clock(rq);
+	/* children come first, see list_add_leaf_cfs_rq() */
+	for_each_leaf_cfs_rq(rq, cfs_rq) {
+		struct sched_entity *se = cfs_rq->tg->se[cpu];
+
+		update_cfs_rq_tg_contrib(cfs_rq, 0);
+		update_cfs_shares(cfs_rq);
+		if (se && se->on_rq)
+			update_entity_load_avg(se, 1);
+
+		if (!cfs_rq->nr_running) {
+			update_cfs_rq_tg_contrib(cfs_rq, 1);
+			list_del_leaf_cfs_rq(cfs_rq);
+		}
+	}
+	spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+/*
+ * Compute the hierarchical load factor of a cfs_rq: the part of the cpu's
+ * load that comes through it,
+ *
+ *   h_load = root load * \Prod over the levels (se contrib / cfs_rq load)
+ *
+ * Only the path up to the root is walked, and a level already done in
+ * this jiffy is not done again.
+ */
+static void update_cfs_rq_h_load(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq)];
+	unsigned long now = jiffies;
+	unsigned long load;
+
+	if (cfs_rq->last_h_load_update == now)
+		return;
+
+	/* go up to the root, or a level done already, noting the way */
+	cfs_rq->h_load_next = NULL;
+	for_each_sched_entity(se) {
+		cfs_rq = cfs_rq_of(se);
+		cfs_rq->h_load_next = se;
+		if (cfs_rq->last_h_load_update == now)
+			break;
+	}
+
+	if (!se) {
+		cfs_rq->h_load = cfs_rq->runnable_load_avg;
+		cfs_rq->last_h_load_update = now;
+	}
+
+	/* and back down */
+	while ((se = cfs_rq->h_load_next) != NULL) {
+		load = cfs_rq->h_load;
+		load = div64_u64((u64)load * se->avg.load_avg_contrib,
+				 cfs_rq->runnable_load_avg + 1);
+		cfs_rq = group_cfs_rq(se);
+		cfs_rq->h_load = load;
+		cfs_rq->last_h_load_update = now;
+	}
+}
+
 static unsigned long
 load_balance_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 		  unsigned long max_load_move,
@@ -1615,15 +2686,14 @@ load_balance_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 {
 	long rem_load_move = max_load_move;
 	int busiest_cpu = cpu_of(busiest);
-	struct task_group *tg;
+	struct cfs_rq *busiest_cfs_rq;
 
 	rcu_read_lock();
-	update_h_load(busiest_cpu);
 
-	list_for_each_entry_rcu(tg, &task_groups, list) {
-		struct cfs_rq *busiest_cfs_rq = tg->cfs_rq[busiest_cpu];
-		unsigned long busiest_h_load = busiest_cfs_rq->h_load;
-		unsigned long busiest_weight = busiest_cfs_rq->load.weight;
+	/* only the groups active on the busiest cpu are on its leaf list */
+	for_each_leaf_cfs_rq(busiest, busiest_cfs_rq) {
+		unsigned long busiest_h_load;
+		unsigned long busiest_weight;
 		u64 rem_load, moved_load;
 
 		/*
@@ -1632,12 +2702,19 @@ load_balance_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 		if (!busiest_cfs_rq->task_weight)
 			continue;
 
+		if (throttled_lb_pair(busiest_cfs_rq->tg, busiest_cpu, this_cpu))
+			continue;
+
+		update_cfs_rq_h_load(busiest_cfs_rq);
+		busiest_h_load = busiest_cfs_rq->h_load;
+		busiest_weight = busiest_cfs_rq->runnable_load_avg;
+
 		rem_load = (u64)rem_load_move * busiest_weight;
 		rem_load = div_u64(rem_load, busiest_h_load + 1);
 
 		moved_load = __load_balance_fair(this_rq, this_cpu, busiest,
 				rem_load, sd, idle, all_pinned, this_best_prio,
-				tg->cfs_rq[busiest_cpu]);
+				busiest_cfs_rq);
 
 		if (!moved_load)
 			continue;
@@ -1654,6 +2731,10 @@ load_balance_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 	return max_load_move - rem_load_move;
 }
 #else
+static inline void update_shares(int cpu)
+{
+}
+
 static unsigned long
 load_balance_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 		  unsigned long max_load_move,
@@ -1677,6 +2758,9 @@ move_one_task_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 	cfs_rq_iterator.next = load_balance_next_fair;
 
 	for_each_leaf_cfs_rq(busiest, busy_cfs_rq) {
+		if (throttled_hierarchy(busy_cfs_rq))
+			continue;
+
 		/*
 		 * pass busy_cfs_rq argument into
 		 * load_balance_[start|next]_fair iterators
@@ -1689,6 +2773,11 @@ move_one_task_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 
 	return 0;
 }
+
+static void rq_offline_fair(struct rq *rq)
+{
+	unthrottle_offline_cfs_rqs(rq);
+}
 #endif /* CONFIG_SMP */
 
 /*
@@ -1720,6 +2809,12 @@ static void task_new_fair(struct rq *rq, struct task_struct *p)
 
 	sched_info_queued(p);
 
+#ifdef CONFIG_SMP
+	/* its history, as __sched_fork() made it up, starts now */
+	se->avg.last_runnable_update = rq->clock;
+	__update_entity_load_avg_contrib(se);
+#endif
+
 	update_curr(cfs_rq);
 	place_entity(cfs_rq, se, 1);
 
@@ -1804,6 +2899,7 @@ static const struct sched_class fair_sched_class = {
 	.enqueue_task		= enqueue_task_fair,
 	.dequeue_task		= dequeue_task_fair,
 	.yield_task		= yield_task_fair,
+	.yield_to_task		= yield_to_task_fair,
 
 	.check_preempt_curr	= check_preempt_wakeup,
 
@@ -1815,6 +2911,7 @@ static const struct sched_class fair_sched_class = {
 
 	.load_balance		= load_balance_fair,
 	.move_one_task		= move_one_task_fair,
+	.rq_offline		= rq_offline_fair,
 #endif
 
 	.set_curr_task          = set_curr_task_fair,
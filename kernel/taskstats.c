@@ -23,9 +23,12 @@
 #include <linux/cpumask.h>
 #include <linux/percpu.h>
 #include <linux/cgroupstats.h>
+#include <linux/memstats.h>
 #include <linux/cgroup.h>
 #include <linux/fs.h>
 #include <linux/file.h>
+#include <linux/pid_namespace.h>
+#include <linux/ptrace.h>
 #include <net/genetlink.h>
 #include <asm/atomic.h>
 
@@ -51,13 +54,20 @@ __read_mostly = {
 	[TASKSTATS_CMD_ATTR_PID]  = { .type = NLA_U32 },
 	[TASKSTATS_CMD_ATTR_TGID] = { .type = NLA_U32 },
 	[TASKSTATS_CMD_ATTR_REGISTER_CPUMASK] = { .type = NLA_STRING },
-	[TASKSTATS_CMD_ATTR_DEREGISTER_CPUMASK] = { .type = NLA_STRING },};
+	[TASKSTATS_CMD_ATTR_DEREGISTER_CPUMASK] = { .type = NLA_STRING },
+	[TASKSTATS_CMD_ATTR_DUMP_UID] = { .type = NLA_U32 },
+	[TASKSTATS_CMD_ATTR_DUMP_LEADERS] = { .type = NLA_FLAG },};
 
 static struct nla_policy
 cgroupstats_cmd_get_policy[CGROUPSTATS_CMD_ATTR_MAX+1] __read_mostly = {
 	[CGROUPSTATS_CMD_ATTR_FD] = { .type = NLA_U32 },
 };
 
+static struct nla_policy
+memstats_cmd_get_policy[MEMSTATS_CMD_ATTR_MAX+1] __read_mostly = {
+	[MEMSTATS_CMD_ATTR_PID] = { .type = NLA_U32 },
+};
+
 struct listener {
 	struct list_head list;
 	pid_t pid;
@@ -425,6 +435,119 @@ err:
 	return rc;
 }
 
+static int memstats_user_cmd(struct sk_buff *skb, struct genl_info *info)
+{
+	struct sk_buff *rep_skb;
+	struct task_struct *tsk;
+	struct memstats *stats;
+	struct nlattr *na;
+	size_t size;
+	u32 pid;
+	int rc;
+
+	na = info->attrs[MEMSTATS_CMD_ATTR_PID];
+	if (!na)
+		return -EINVAL;
+
+	pid = nla_get_u32(na);
+	rcu_read_lock();
+	tsk = find_task_by_vpid(pid);
+	if (tsk)
+		get_task_struct(tsk);
+	rcu_read_unlock();
+	if (!tsk)
+		return -ESRCH;
+
+	size = nla_total_size(sizeof(struct memstats));
+	rc = prepare_reply(info, MEMSTATS_CMD_NEW, &rep_skb, size);
+	if (rc < 0)
+		goto err;
+
+	rc = -EINVAL;
+	na = nla_reserve(rep_skb, MEMSTATS_TYPE_STATS, sizeof(struct memstats));
+	if (!na)
+		goto err_free;
+	stats = nla_data(na);
+
+	rc = memstats_build(stats, tsk);
+	if (rc < 0)
+		goto err_free;
+
+	rc = send_reply(rep_skb, info->snd_pid);
+	put_task_struct(tsk);
+	return rc;
+
+err_free:
+	nlmsg_free(rep_skb);
+err:
+	put_task_struct(tsk);
+	return rc;
+}
+
+/*
+ * Find the first thread group leader with a tgid >= *@tgid in @ns, and
+ * return it with a reference held, or NULL when there are no more.
+ */
+static struct task_struct *dump_next_tgid(struct pid_namespace *ns, int *tgid)
+{
+	struct task_struct *tsk = NULL;
+	struct pid *pid;
+
+	rcu_read_lock();
+	while ((pid = find_ge_pid(*tgid, ns)) != NULL) {
+		*tgid = pid_nr_ns(pid, ns);
+		tsk = pid_task(pid, PIDTYPE_PID);
+		if (tsk && has_group_leader_pid(tsk)) {
+			get_task_struct(tsk);
+			break;
+		}
+		tsk = NULL;
+		*tgid += 1;
+	}
+	rcu_read_unlock();
+	return tsk;
+}
+
+/*
+ * A dump request for MEMSTATS_CMD_GET returns one MEMSTATS_CMD_NEW message
+ * per process in the caller's pid namespace, as many as fit in each skb:
+ * cb->args[0] is the tgid to resume from.  Processes without an mm, or
+ * whose maps the caller may not read, are skipped.
+ */
+static int memstats_user_dump(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct pid_namespace *ns = task_active_pid_ns(current);
+	struct task_struct *tsk;
+	struct memstats stats;
+	int tgid = cb->args[0];
+	void *reply;
+
+	while ((tsk = dump_next_tgid(ns, &tgid)) != NULL) {
+		int rc = memstats_build(&stats, tsk);
+
+		put_task_struct(tsk);
+		if (rc < 0) {
+			tgid++;
+			continue;
+		}
+
+		reply = genlmsg_put(skb, NETLINK_CB(cb->skb).pid,
+				    cb->nlh->nlmsg_seq, &family, NLM_F_MULTI,
+				    MEMSTATS_CMD_NEW);
+		if (!reply)
+			break;
+		if (nla_put(skb, MEMSTATS_TYPE_STATS, sizeof(stats), &stats)) {
+			genlmsg_cancel(skb, reply);
+			break;
+		}
+		genlmsg_end(skb, reply);
+		tgid++;
+	}
+
+	cb->args[0] = tgid;
+	return skb->len;
+}
+
 static int taskstats_user_cmd(struct sk_buff *skb, struct genl_info *info)
 {
 	int rc;
@@ -493,6 +616,151 @@ err:
 	return rc;
 }
 
+/* Return the @idx'th thread of @leader's group, with a reference held */
+static struct task_struct *dump_nth_thread(struct task_struct *leader, long idx)
+{
+	struct task_struct *tsk = NULL;
+
+	rcu_read_lock();
+	if (pid_alive(leader)) {
+		tsk = leader;
+		while (idx--) {
+			tsk = next_thread(tsk);
+			if (tsk == leader) {
+				tsk = NULL;
+				break;
+			}
+		}
+		if (tsk)
+			get_task_struct(tsk);
+	}
+	rcu_read_unlock();
+	return tsk;
+}
+
+/* Return the thread after @tsk in its group, with a reference held */
+static struct task_struct *dump_next_thread(struct task_struct *tsk)
+{
+	struct task_struct *next = NULL;
+
+	rcu_read_lock();
+	if (pid_alive(tsk)) {
+		next = next_thread(tsk);
+		if (thread_group_leader(next))
+			next = NULL;
+		else
+			get_task_struct(next);
+	}
+	rcu_read_unlock();
+	return next;
+}
+
+static int dump_task_uid_match(struct task_struct *tsk, struct nlattr *na)
+{
+	int match;
+
+	if (!na)
+		return 1;
+	rcu_read_lock();
+	match = __task_cred(tsk)->uid == nla_get_u32(na);
+	rcu_read_unlock();
+	return match;
+}
+
+/*
+ * Dumps nothing if the caller could not ptrace tsk for reading.  As for
+ * /proc/<pid>/maps, cred_guard_mutex keeps tsk from changing credentials
+ * in exec between the check and the filling of its stats.
+ */
+static int taskstats_dump_task(struct sk_buff *skb, struct netlink_callback *cb,
+			       struct task_struct *tsk, u32 pid)
+{
+	struct taskstats *stats;
+	void *reply;
+	int rc;
+
+	rc = mutex_lock_killable(&tsk->cred_guard_mutex);
+	if (rc)
+		return rc;
+	rc = 0;
+	if (!ptrace_may_access(tsk, PTRACE_MODE_READ))
+		goto out;
+	rc = -EMSGSIZE;
+	reply = genlmsg_put(skb, NETLINK_CB(cb->skb).pid, cb->nlh->nlmsg_seq,
+			    &family, NLM_F_MULTI, TASKSTATS_CMD_NEW);
+	if (!reply)
+		goto out;
+	stats = mk_reply(skb, TASKSTATS_TYPE_PID, pid);
+	if (!stats) {
+		genlmsg_cancel(skb, reply);
+		goto out;
+	}
+	fill_pid(pid, tsk, stats);
+	rc = genlmsg_end(skb, reply);
+out:
+	mutex_unlock(&tsk->cred_guard_mutex);
+	return rc;
+}
+
+/*
+ * A dump request for TASKSTATS_CMD_GET returns one TASKSTATS_CMD_NEW
+ * message per task of the caller's pid namespace, each carrying the same
+ * TASKSTATS_TYPE_AGGR_PID attribute as the reply for a single pid, so that
+ * a collector gets the stats of all tasks without opening any file.  The
+ * request may restrict the dump to the tasks of one uid with
+ * TASKSTATS_CMD_ATTR_DUMP_UID, and to one task per process with
+ * TASKSTATS_CMD_ATTR_DUMP_LEADERS.  Tasks the caller could not ptrace for
+ * reading are left out, as a dump is open to any user.
+ *
+ * cb->args[0] is the tgid to resume from, cb->args[1] the index of the
+ * next thread in that group.  Threads created or exiting in between may
+ * be missed or reported twice, as with a readdir of /proc.
+ */
+static int taskstats_user_dump(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct pid_namespace *ns = task_active_pid_ns(current);
+	struct nlattr *attrs[TASKSTATS_CMD_ATTR_MAX+1];
+	struct task_struct *leader, *tsk, *next;
+	int tgid = cb->args[0];
+	long idx = cb->args[1];
+	int rc;
+
+	rc = nlmsg_parse(cb->nlh, GENL_HDRLEN, attrs, TASKSTATS_CMD_ATTR_MAX,
+			 taskstats_cmd_get_policy);
+	if (rc < 0)
+		return rc;
+
+	while ((leader = dump_next_tgid(ns, &tgid)) != NULL) {
+		tsk = dump_nth_thread(leader, idx);
+		put_task_struct(leader);
+		while (tsk) {
+			if (dump_task_uid_match(tsk,
+					attrs[TASKSTATS_CMD_ATTR_DUMP_UID])) {
+				rc = taskstats_dump_task(skb, cb, tsk,
+						task_pid_nr_ns(tsk, ns));
+				if (rc < 0) {
+					put_task_struct(tsk);
+					goto out;
+				}
+			}
+			idx++;
+			if (attrs[TASKSTATS_CMD_ATTR_DUMP_LEADERS]) {
+				put_task_struct(tsk);
+				break;
+			}
+			next = dump_next_thread(tsk);
+			put_task_struct(tsk);
+			tsk = next;
+		}
+		tgid++;
+		idx = 0;
+	}
+out:
+	cb->args[0] = tgid;
+	cb->args[1] = idx;
+	return skb->len;
+}
+
 static struct taskstats *taskstats_tgid_alloc(struct task_struct *tsk)
 {
 	struct signal_struct *sig = tsk->signal;
@@ -582,6 +850,7 @@ err:
 static struct genl_ops taskstats_ops = {
 	.cmd		= TASKSTATS_CMD_GET,
 	.doit		= taskstats_user_cmd,
+	.dumpit		= taskstats_user_dump,
 	.policy		= taskstats_cmd_get_policy,
 };
 
@@ -591,6 +860,13 @@ static struct genl_ops cgroupstats_ops = {
 	.policy		= cgroupstats_cmd_get_policy,
 };
 
+static struct genl_ops memstats_ops = {
+	.cmd		= MEMSTATS_CMD_GET,
+	.doit		= memstats_user_cmd,
+	.dumpit		= memstats_user_dump,
+	.policy		= memstats_cmd_get_policy,
+};
+
 /* Needed early in initialization */
 void __init taskstats_init_early(void)
 {
@@ -619,9 +895,15 @@ static int __init taskstats_init(void)
 	if (rc < 0)
 		goto err_cgroup_ops;
 
+	rc = genl_register_ops(&family, &memstats_ops);
+	if (rc < 0)
+		goto err_memstats_ops;
+
 	family_registered = 1;
 	printk("registered taskstats version %d\n", TASKSTATS_GENL_VERSION);
 	return 0;
+err_memstats_ops:
+	genl_unregister_ops(&family, &cgroupstats_ops);
 err_cgroup_ops:
 	genl_unregister_ops(&family, &taskstats_ops);
 err:
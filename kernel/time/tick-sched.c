@@ -17,8 +17,10 @@
 #include <linux/interrupt.h>
 #include <linux/kernel_stat.h>
 #include <linux/percpu.h>
+#include <linux/posix-timers.h>
 #include <linux/profile.h>
 #include <linux/sched.h>
+#include <linux/smp.h>
 #include <linux/tick.h>
 #include <linux/module.h>
 
@@ -301,10 +303,14 @@ void tick_nohz_stop_sched_tick(int inidle)
 		 * cpu which runs the tick timer next, which might be
 		 * this cpu as well. If we don't drop this here the
 		 * jiffies might be stale and do_timer() never
-		 * invoked.
+		 * invoked. Full dynticks cpus rely on it to keep
+		 * jiffies going while busy, so there it keeps the tick.
 		 */
-		if (cpu == tick_do_timer_cpu)
+		if (cpu == tick_do_timer_cpu) {
+			if (tick_nohz_full_enabled())
+				goto out;
 			tick_do_timer_cpu = TICK_DO_TIMER_NONE;
+		}
 
 		if (delta_jiffies > 1)
 			cpumask_set_cpu(cpu, nohz_cpu_mask);
@@ -332,6 +338,10 @@ void tick_nohz_stop_sched_tick(int inidle)
 			ts->idle_tick = hrtimer_get_expires(&ts->sched_timer);
 			ts->tick_stopped = 1;
 			ts->idle_jiffies = last_jiffies;
+#ifdef CONFIG_NO_HZ_FULL
+			/* From here on the ticks go to idle accounting */
+			ts->full_stopped = 0;
+#endif
 			rcu_enter_nohz();
 		}
 
@@ -500,7 +510,8 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 	 * this duty, then the jiffies update is still serialized by
 	 * xtime_lock.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 
 	/* Check, if the jiffies need an update */
@@ -622,6 +633,233 @@ void tick_check_idle(int cpu)
 #endif
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Full dynticks: the cpus in tick_nohz_full_mask stop the tick not only
+ * when idle but also while they run a single task which does not need
+ * it. The tick is then deferred to the next timer wheel event, but at
+ * most a second, and brought back by a kick when something changes.
+ */
+cpumask_var_t tick_nohz_full_mask;
+int tick_nohz_full_running;
+
+static DEFINE_PER_CPU(struct call_single_data, tick_nohz_full_csd);
+static DEFINE_PER_CPU(unsigned long, tick_nohz_full_kicked);
+
+static int __init tick_nohz_full_setup(char *str)
+{
+	char buf[64];
+
+	alloc_bootmem_cpumask_var(&tick_nohz_full_mask);
+	if (cpulist_parse(str, tick_nohz_full_mask) < 0) {
+		printk(KERN_WARNING "NOHZ: Incorrect nohz_full cpumask\n");
+		return 1;
+	}
+
+	/* The boot cpu keeps the tick and the timekeeping duty */
+	cpumask_clear_cpu(smp_processor_id(), tick_nohz_full_mask);
+	if (cpumask_empty(tick_nohz_full_mask))
+		return 1;
+
+	cpulist_scnprintf(buf, sizeof(buf), tick_nohz_full_mask);
+	printk(KERN_INFO "NOHZ: Full dynticks CPUs: %s.\n", buf);
+	tick_nohz_full_running = 1;
+	return 1;
+}
+
+__setup("nohz_full=", tick_nohz_full_setup);
+
+/*
+ * Account the ticks @p missed while the tick was stopped to the mode it
+ * was in when the tick stopped.
+ */
+static void tick_nohz_full_account(struct tick_sched *ts,
+				   struct task_struct *p)
+{
+	unsigned long ticks = jiffies - ts->full_jiffies;
+
+	/*
+	 * We might be one off. Do not randomly account a huge number of ticks!
+	 */
+	if (ticks && ticks < LONG_MAX)
+		account_process_ticks(p, ts->full_user, ticks);
+	ts->full_jiffies = jiffies;
+}
+
+/*
+ * Called from the tick when it was stopped on a busy cpu: account what
+ * the running task missed, this tick itself is accounted by the caller.
+ */
+static void tick_nohz_full_restart_tick(struct tick_sched *ts)
+{
+	if (!ts->full_stopped)
+		return;
+
+	ts->full_jiffies++;
+	tick_nohz_full_account(ts, current);
+	ts->full_stopped = 0;
+}
+
+/*
+ * Called from the tick with interrupts disabled. If this full dynticks
+ * cpu runs a single task which does not need the tick, set the tick
+ * timer to the next timer wheel event, but at most a second away, and
+ * return 1.
+ */
+static int tick_nohz_full_stop_tick(struct tick_sched *ts, int cpu, int user)
+{
+	unsigned long seq, last_jiffies, next_jiffies, delta_jiffies;
+	ktime_t last_update;
+
+	if (!tick_nohz_full_cpu(cpu) || ts->nohz_mode != NOHZ_MODE_HIGHRES)
+		return 0;
+
+	if (ts->inidle || idle_cpu(cpu) || local_softirq_pending())
+		return 0;
+
+	if (rcu_pending(cpu) || rcu_needs_cpu(cpu) || printk_needs_cpu(cpu))
+		return 0;
+
+	if (!posix_cpu_timers_can_stop_tick(current))
+		return 0;
+
+	/*
+	 * Mark the tick stopped before the scheduler and the timer wheel
+	 * are looked at: whoever queues a task or a timer on this cpu
+	 * afterwards sees it and kicks the tick.
+	 */
+	ts->full_stopped = 1;
+
+	if (!sched_can_stop_tick())
+		goto restart;
+
+	do {
+		seq = read_seqbegin(&xtime_lock);
+		last_update = last_jiffies_update;
+		last_jiffies = jiffies;
+	} while (read_seqretry(&xtime_lock, seq));
+
+	next_jiffies = get_next_timer_interrupt(last_jiffies);
+	delta_jiffies = next_jiffies - last_jiffies;
+	if ((long)delta_jiffies <= 1)
+		goto restart;
+	if (delta_jiffies > HZ)
+		delta_jiffies = HZ;
+
+	hrtimer_set_expires(&ts->sched_timer,
+			    ktime_add_ns(last_update,
+					 tick_period.tv64 * delta_jiffies));
+	ts->full_user = user;
+	ts->full_jiffies = last_jiffies;
+	return 1;
+
+restart:
+	ts->full_stopped = 0;
+	return 0;
+}
+
+/**
+ * tick_nohz_full_kick - bring a stopped tick back on this cpu
+ *
+ * Programs the tick timer one tick from now, where the tick checks again
+ * whether it may stay stopped. Called with interrupts disabled, possibly
+ * with the runqueue lock held, so the hrtimer softirq is not woken.
+ */
+void tick_nohz_full_kick(void)
+{
+	struct tick_sched *ts = &__get_cpu_var(tick_cpu_sched);
+	ktime_t expires;
+
+	if (!ts->full_stopped)
+		return;
+
+	expires = ktime_add(ktime_get(), tick_period);
+	if (hrtimer_get_expires_tv64(&ts->sched_timer) <= expires.tv64)
+		return;
+
+	__hrtimer_start_range_ns(&ts->sched_timer, expires, 0,
+				 HRTIMER_MODE_ABS_PINNED, 0);
+}
+
+static void tick_nohz_full_kick_ipi(void *info)
+{
+	clear_bit(0, &__get_cpu_var(tick_nohz_full_kicked));
+	tick_nohz_full_kick();
+}
+
+/**
+ * tick_nohz_full_kick_cpu - bring a stopped tick back on @cpu
+ * @cpu:	the cpu which gets a task, a timer or work to do
+ *
+ * Must be called with preemption disabled; does not wait for the
+ * kick to be done on another cpu.
+ */
+void tick_nohz_full_kick_cpu(int cpu)
+{
+	struct call_single_data *csd;
+
+	if (!tick_nohz_full_cpu(cpu))
+		return;
+
+	if (cpu == smp_processor_id()) {
+		tick_nohz_full_kick();
+		return;
+	}
+
+	if (!per_cpu(tick_cpu_sched, cpu).full_stopped)
+		return;
+
+	/* A kick is already on its way */
+	if (test_and_set_bit(0, &per_cpu(tick_nohz_full_kicked, cpu)))
+		return;
+
+	csd = &per_cpu(tick_nohz_full_csd, cpu);
+	csd->func = tick_nohz_full_kick_ipi;
+	__smp_call_function_single(cpu, csd, 0);
+}
+
+/**
+ * tick_nohz_full_kick_all - bring the stopped ticks back on all cpus
+ */
+void tick_nohz_full_kick_all(void)
+{
+	int cpu;
+
+	if (!tick_nohz_full_running)
+		return;
+
+	preempt_disable();
+	for_each_cpu_and(cpu, tick_nohz_full_mask, cpu_online_mask)
+		tick_nohz_full_kick_cpu(cpu);
+	preempt_enable();
+}
+
+/**
+ * tick_nohz_task_switch - account a task leaving a stopped tick
+ * @prev:	the task being switched out
+ *
+ * Called from the scheduler with the runqueue locked. The task switched
+ * in gets the tick back, until the tick decides it does not need it.
+ */
+void tick_nohz_task_switch(struct task_struct *prev)
+{
+	struct tick_sched *ts = &__get_cpu_var(tick_cpu_sched);
+
+	if (!ts->full_stopped)
+		return;
+
+	tick_nohz_full_account(ts, prev);
+	tick_nohz_full_kick();
+}
+#else
+static inline void tick_nohz_full_restart_tick(struct tick_sched *ts) { }
+static inline int
+tick_nohz_full_stop_tick(struct tick_sched *ts, int cpu, int user)
+{
+	return 0;
+}
+#endif /* NO_HZ_FULL */
+
 /*
  * High resolution timer specific code
  */
@@ -646,7 +884,8 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 	 * this duty, then the jiffies update is still serialized by
 	 * xtime_lock.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 #endif
 
@@ -671,8 +910,12 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 			touch_softlockup_watchdog();
 			ts->idle_jiffies++;
 		}
+		tick_nohz_full_restart_tick(ts);
 		update_process_times(user_mode(regs));
 		profile_tick(CPU_PROFILING);
+
+		if (tick_nohz_full_stop_tick(ts, cpu, user_mode(regs)))
+			return HRTIMER_RESTART;
 	}
 
 	hrtimer_forward(timer, now, tick_period);
@@ -665,6 +665,10 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	timer->expires = expires;
 	internal_add_timer(base, timer);
 
+	/* A full dynticks cpu only looks at its timer wheel from the tick */
+	if (base == new_base)
+		tick_nohz_full_kick_cpu(cpu);
+
 out_unlock:
 	spin_unlock_irqrestore(&base->lock, flags);
 
@@ -791,6 +795,7 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	 * the timer wheel.
 	 */
 	wake_up_idle_cpu(cpu);
+	tick_nohz_full_kick_cpu(cpu);
 	spin_unlock_irqrestore(&base->lock, flags);
 }
 EXPORT_SYMBOL_GPL(add_timer_on);
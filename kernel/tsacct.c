@@ -21,6 +21,25 @@
 #include <linux/tsacct_kern.h>
 #include <linux/acct.h>
 #include <linux/jiffies.h>
+#include <linux/fdtable.h>
+
+static unsigned int task_nr_fds(struct task_struct *tsk)
+{
+	struct files_struct *files;
+	struct fdtable *fdt;
+	unsigned int nr = 0;
+
+	task_lock(tsk);
+	files = tsk->files;
+	if (files) {
+		rcu_read_lock();
+		fdt = files_fdtable(files);
+		nr = bitmap_weight(fdt->open_fds->fds_bits, fdt->max_fds);
+		rcu_read_unlock();
+	}
+	task_unlock(tsk);
+	return nr;
+}
 
 /*
  * fill in basic accounting fields
@@ -29,6 +48,7 @@ void bacct_add_tsk(struct taskstats *stats, struct task_struct *tsk)
 {
 	const struct cred *tcred;
 	struct timespec uptime, ts;
+	struct mm_struct *mm;
 	u64 ac_etime;
 
 	BUILD_BUG_ON(TS_COMM_LEN < TASK_COMM_LEN);
@@ -72,6 +92,16 @@ void bacct_add_tsk(struct taskstats *stats, struct task_struct *tsk)
 	stats->ac_majflt = tsk->maj_flt;
 
 	strncpy(stats->ac_comm, tsk->comm, sizeof(stats->ac_comm));
+
+	/* the state letter of /proc/<pid>/stat */
+	stats->ac_state = *get_task_state(tsk);
+	stats->ac_nr_fds = task_nr_fds(tsk);
+	mm = get_task_mm(tsk);
+	if (mm) {
+		stats->ac_rss = get_mm_rss(mm) * (PAGE_SIZE / 1024);
+		stats->ac_vm = mm->total_vm * (PAGE_SIZE / 1024);
+		mmput(mm);
+	}
 }
 
 
@@ -14,6 +14,15 @@
  *   Theodore Ts'o <tytso@mit.edu>
  *
  * Made to use alloc_percpu by Christoph Lameter.
+ *
+ * Per-cpu workqueues don't have threads of their own: the works queued
+ * on them on a cpu are all served by that cpu's global cwq (gcwq), a
+ * pool of workers shared by every per-cpu workqueue.  The scheduler
+ * tells the gcwq when one of its workers blocks or wakes up, and the
+ * gcwq keeps a single worker running as long as there's work to do,
+ * waking an idle worker, or creating a new one, only when the running
+ * one blocks.  Single threaded, freezeable and rt workqueues keep
+ * their thread(s), each in a gcwq of its own.
  */
 
 #include <linux/module.h>
@@ -33,23 +42,114 @@
 #include <linux/kallsyms.h>
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
+#include <linux/idr.h>
+#include <linux/hash.h>
+#include <linux/rcupdate.h>
 #define CREATE_TRACE_POINTS
 #include <trace/events/workqueue.h>
 
+#include "workqueue_sched.h"
+
+enum {
+	/* global_cwq flags */
+	GCWQ_MANAGE_WORKERS	= 1 << 0,	/* idle workers need reaping */
+	GCWQ_DISASSOCIATED	= 1 << 1,	/* workers aren't bound to cpu */
+	GCWQ_DEDICATED		= 1 << 2,	/* serves a single workqueue */
+	GCWQ_DRAINING		= 1 << 3,	/* someone waits on drain_wait */
+
+	/* worker flags */
+	WORKER_STARTED		= 1 << 0,	/* counted in nr_workers */
+	WORKER_DIE		= 1 << 1,	/* told to exit */
+	WORKER_IDLE		= 1 << 2,	/* on the idle list */
+	WORKER_PREP		= 1 << 3,	/* not processing works */
+	WORKER_ROGUE		= 1 << 4,	/* not bound to the gcwq's cpu */
+
+	WORKER_NOT_RUNNING	= WORKER_PREP | WORKER_ROGUE,
+
+	BUSY_WORKER_HASH_ORDER	= 5,
+	BUSY_WORKER_HASH_SIZE	= 1 << BUSY_WORKER_HASH_ORDER,
+
+	MAX_IDLE_WORKERS_RATIO	= 4,		/* 1/4 of busy can be idle */
+	IDLE_WORKER_TIMEOUT	= 300 * HZ,	/* keep idle ones for 5 mins */
+
+	MAYDAY_INITIAL_TIMEOUT	= HZ / 100 + 1,	/* call for help after 10ms */
+	MAYDAY_INTERVAL		= HZ / 10,	/* and then every 100ms */
+	CREATE_COOLDOWN		= HZ,		/* time to breathe after fail */
+
+	WORKER_NICE_LEVEL	= -5,
+};
+
+struct global_cwq;
+
 /*
- * The per-CPU workqueue (if single thread, we always use the first
- * possible cpu).
+ * A worker thread.  It sits on its gcwq's idle list while idle and in
+ * its busy hash while executing a work.
  */
-struct cpu_workqueue_struct {
+struct worker {
+	union {
+		struct list_head	entry;
+		struct hlist_node	hentry;
+	};
+	struct work_struct	*current_work;
+	struct cpu_workqueue_struct *current_cwq;
+	struct list_head	scheduled;	/* works to run next */
+	struct task_struct	*task;
+	struct global_cwq	*gcwq;
+	unsigned long		last_active;	/* when it last went idle */
+	unsigned int		flags;
+	int			id;
+};
 
-	spinlock_t lock;
+/*
+ * The pool of workers of a cpu.  Everything but nr_running is
+ * protected by ->lock; nr_running is the number of workers executing
+ * works and not blocked, it is changed by the scheduler hooks from the
+ * cpu the workers run on.
+ */
+struct global_cwq {
+	spinlock_t		lock;
+	struct list_head	worklist;	/* works to be executed */
+	unsigned int		cpu;
+	unsigned int		flags;
+
+	int			nr_workers;
+	int			nr_idle;
+
+	struct list_head	idle_list;	/* LIFO */
+	struct hlist_head	busy_hash[BUSY_WORKER_HASH_SIZE];
+
+	struct timer_list	idle_timer;	/* reaps idle workers */
+	struct timer_list	mayday_timer;	/* calls the rescuers */
+
+	struct ida		worker_ida;
+	struct mutex		manager_mutex;	/* one manager at a time */
+	struct worker		*first_worker;	/* from CPU_UP_PREPARE */
+	wait_queue_head_t	drain_wait;
+	struct workqueue_struct	*wq;		/* if GCWQ_DEDICATED */
+
+	atomic_t		nr_running ____cacheline_aligned_in_smp;
+} ____cacheline_aligned_in_smp;
 
-	struct list_head worklist;
-	wait_queue_head_t more_work;
-	struct work_struct *current_work;
+/*
+ * The per-CPU workqueue (if single thread, we always use the first
+ * possible cpu).  It keeps track of the works of its workqueue in
+ * flight for flush_workqueue(), the works themselves are queued on the
+ * gcwq: at most max_active of them at once, the others wait on
+ * delayed_works for their turn, so that the works of a workqueue other
+ * than keventd are executed one at a time and in order on each cpu, as
+ * they were by its own thread.
+ */
+struct cpu_workqueue_struct {
 
+	struct global_cwq *gcwq;
 	struct workqueue_struct *wq;
-	struct task_struct *thread;
+
+	int work_color;			/* color of newly queued works */
+	int flush_color;		/* color being flushed, or -1 */
+	int nr_in_flight[2];		/* queued or running, by color */
+	int nr_active;			/* on the gcwq or running */
+	int max_active;
+	struct list_head delayed_works;
 } ____cacheline_aligned;
 
 /*
@@ -63,36 +163,57 @@ struct workqueue_struct {
 	int singlethread;
 	int freezeable;		/* Freeze threads during suspend */
 	int rt;
+
+	struct mutex flush_mutex;	/* serializes flush_workqueue() */
+	atomic_t nr_cwqs_to_flush;
+	struct completion *flush_done;
+
+	struct worker *rescuer;		/* if served by the shared gcwqs */
+	cpumask_var_t mayday_mask;	/* cpus asking for the rescuer */
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map lockdep_map;
 #endif
 };
 
-/* Serializes the accesses to the list of workqueues. */
+/*
+ * Serializes the accesses to the list of workqueues.  Only the ones
+ * with per-cpu threads of their own (rt workqueues) are on it, the
+ * others either are served by the shared gcwqs or have a single,
+ * unbound, thread.
+ */
 static DEFINE_SPINLOCK(workqueue_lock);
 static LIST_HEAD(workqueues);
 
+static DEFINE_PER_CPU_SHARED_ALIGNED(struct global_cwq, global_cwq);
+
 static int singlethread_cpu __read_mostly;
 static const struct cpumask *cpu_singlethread_map __read_mostly;
-/*
- * _cpu_down() first removes CPU from cpu_online_map, then CPU_DEAD
- * flushes cwq->worklist. This means that flush_workqueue/wait_on_work
- * which comes in between can't use for_each_online_cpu(). We could
- * use cpu_possible_map, the cpumask below is more a documentation
- * than optimization.
- */
-static cpumask_var_t cpu_populated_map __read_mostly;
 
-/* If it's single threaded, it isn't in the list of workqueues. */
+static struct global_cwq *get_gcwq(unsigned int cpu)
+{
+	return &per_cpu(global_cwq, cpu);
+}
+
+/* Single threaded, freezeable and rt workqueues have threads of their own */
+static inline int is_wq_shared(struct workqueue_struct *wq)
+{
+	return !wq->singlethread && !wq->freezeable && !wq->rt;
+}
+
 static inline int is_wq_single_threaded(struct workqueue_struct *wq)
 {
 	return wq->singlethread;
 }
 
+/*
+ * _cpu_down() first removes CPU from cpu_online_map, then CPU_POST_DEAD
+ * drains the gcwq, so flush_workqueue/wait_on_work which come in
+ * between can't use for_each_online_cpu().
+ */
 static const struct cpumask *wq_cpu_map(struct workqueue_struct *wq)
 {
 	return is_wq_single_threaded(wq)
-		? cpu_singlethread_map : cpu_populated_map;
+		? cpu_singlethread_map : cpu_possible_mask;
 }
 
 static
@@ -108,14 +229,14 @@ struct cpu_workqueue_struct *wq_per_cpu(struct workqueue_struct *wq, int cpu)
  * - Must *only* be called if the pending flag is set
  */
 static inline void set_wq_data(struct work_struct *work,
-				struct cpu_workqueue_struct *cwq)
+				struct cpu_workqueue_struct *cwq,
+				unsigned long extra_flags)
 {
 	unsigned long new;
 
 	BUG_ON(!work_pending(work));
 
-	new = (unsigned long) cwq | (1UL << WORK_STRUCT_PENDING);
-	new |= WORK_STRUCT_FLAG_MASK & *work_data_bits(work);
+	new = (unsigned long) cwq | (1UL << WORK_STRUCT_PENDING) | extra_flags;
 	atomic_long_set(&work->data, new);
 }
 
@@ -125,29 +246,251 @@ struct cpu_workqueue_struct *get_wq_data(struct work_struct *work)
 	return (void *) (atomic_long_read(&work->data) & WORK_STRUCT_WQ_DATA_MASK);
 }
 
+static inline unsigned long work_color_to_flags(int color)
+{
+	return (unsigned long)color << WORK_STRUCT_COLOR;
+}
+
+static inline int get_work_color(struct work_struct *work)
+{
+	return (*work_data_bits(work) >> WORK_STRUCT_COLOR) & 1;
+}
+
+/*
+ * Policy functions.  These decide what the workers of a gcwq do, and
+ * are all called with gcwq->lock held.  A disassociated gcwq doesn't
+ * do concurrency management: its workers may run anywhere.
+ */
+static bool __need_more_worker(struct global_cwq *gcwq)
+{
+	return !atomic_read(&gcwq->nr_running) ||
+		(gcwq->flags & GCWQ_DISASSOCIATED);
+}
+
+/* Is there work to do and nobody running to do it? */
+static bool need_more_worker(struct global_cwq *gcwq)
+{
+	return !list_empty(&gcwq->worklist) && __need_more_worker(gcwq);
+}
+
+/*
+ * A worker may only start processing works while there's another one
+ * idle to take over if it blocks.
+ */
+static bool may_start_working(struct global_cwq *gcwq)
+{
+	return gcwq->nr_idle;
+}
+
+/* Should a worker done with a work go on with the next one? */
+static bool keep_working(struct global_cwq *gcwq)
+{
+	return !list_empty(&gcwq->worklist) &&
+		(atomic_read(&gcwq->nr_running) <= 1 ||
+		 (gcwq->flags & GCWQ_DISASSOCIATED));
+}
+
+static bool need_to_create_worker(struct global_cwq *gcwq)
+{
+	return need_more_worker(gcwq) && !may_start_working(gcwq);
+}
+
+static bool need_to_manage_workers(struct global_cwq *gcwq)
+{
+	return need_to_create_worker(gcwq) ||
+		(gcwq->flags & GCWQ_MANAGE_WORKERS);
+}
+
+static bool too_many_workers(struct global_cwq *gcwq)
+{
+	/* the manager counts as idle */
+	int nr_idle = gcwq->nr_idle + mutex_is_locked(&gcwq->manager_mutex);
+	int nr_busy = gcwq->nr_workers - nr_idle;
+
+	return nr_idle > 2 && (nr_idle - 2) * MAX_IDLE_WORKERS_RATIO >= nr_busy;
+}
+
+static bool gcwq_drained(struct global_cwq *gcwq)
+{
+	return list_empty(&gcwq->worklist) && gcwq->nr_idle == gcwq->nr_workers;
+}
+
+static struct worker *first_worker(struct global_cwq *gcwq)
+{
+	if (unlikely(list_empty(&gcwq->idle_list)))
+		return NULL;
+
+	return list_first_entry(&gcwq->idle_list, struct worker, entry);
+}
+
+static void wake_up_worker(struct global_cwq *gcwq)
+{
+	struct worker *worker = first_worker(gcwq);
+
+	if (likely(worker))
+		wake_up_process(worker->task);
+}
+
+/**
+ * wq_worker_waking_up - a worker is waking up
+ * @task: the task waking up
+ *
+ * Called from try_to_wake_up() with the runqueue of @task locked.
+ */
+void wq_worker_waking_up(struct task_struct *task)
+{
+	struct worker *worker = kthread_data(task);
+
+	if (!(worker->flags & WORKER_NOT_RUNNING))
+		atomic_inc(&worker->gcwq->nr_running);
+}
+
+/**
+ * wq_worker_sleeping - a worker is going to sleep
+ * @task: the task going to sleep
+ *
+ * Called from schedule() with the local runqueue locked, when @task,
+ * running on the local cpu, blocks.  Returns the idle worker to wake
+ * up if there's work left and nobody else running to do it.
+ *
+ * @task isn't rogue, so its gcwq is the local one and the only ones
+ * to touch the idle list are its workers and the local cpu: it can be
+ * looked at without gcwq->lock.
+ */
+struct task_struct *wq_worker_sleeping(struct task_struct *task)
+{
+	struct worker *worker = kthread_data(task), *to_wakeup = NULL;
+	struct global_cwq *gcwq = worker->gcwq;
+
+	if (worker->flags & WORKER_NOT_RUNNING)
+		return NULL;
+
+	/* pairs with the smp_mb() in insert_work() */
+	if (atomic_dec_and_test(&gcwq->nr_running) &&
+	    !list_empty(&gcwq->worklist))
+		to_wakeup = first_worker(gcwq);
+	return to_wakeup ? to_wakeup->task : NULL;
+}
+
+/*
+ * Flags the worker as processing works or not; these are the only
+ * transitions of nr_running not done by the scheduler hooks.
+ */
+static void worker_set_flags(struct worker *worker, unsigned int flags)
+{
+	if ((flags & WORKER_NOT_RUNNING) &&
+	    !(worker->flags & WORKER_NOT_RUNNING))
+		atomic_dec(&worker->gcwq->nr_running);
+	worker->flags |= flags;
+}
+
+static void worker_clr_flags(struct worker *worker, unsigned int flags)
+{
+	unsigned int oflags = worker->flags;
+
+	worker->flags &= ~flags;
+	if ((oflags & WORKER_NOT_RUNNING) &&
+	    !(worker->flags & WORKER_NOT_RUNNING))
+		atomic_inc(&worker->gcwq->nr_running);
+}
+
+static void worker_enter_idle(struct worker *worker)
+{
+	struct global_cwq *gcwq = worker->gcwq;
+
+	BUG_ON(worker->flags & WORKER_IDLE);
+	BUG_ON(!list_empty(&worker->entry));
+
+	worker->flags |= WORKER_IDLE;
+	gcwq->nr_idle++;
+	worker->last_active = jiffies;
+	list_add(&worker->entry, &gcwq->idle_list);
+
+	if (!(worker->flags & WORKER_ROGUE) && too_many_workers(gcwq) &&
+	    !timer_pending(&gcwq->idle_timer))
+		mod_timer(&gcwq->idle_timer, jiffies + IDLE_WORKER_TIMEOUT);
+
+	if (unlikely(gcwq->flags & GCWQ_DRAINING))
+		wake_up_all(&gcwq->drain_wait);
+}
+
+static void worker_leave_idle(struct worker *worker)
+{
+	struct global_cwq *gcwq = worker->gcwq;
+
+	BUG_ON(!(worker->flags & WORKER_IDLE));
+	worker->flags &= ~WORKER_IDLE;
+	gcwq->nr_idle--;
+	list_del_init(&worker->entry);
+}
+
+static struct hlist_head *busy_worker_head(struct global_cwq *gcwq,
+					   struct work_struct *work)
+{
+	return &gcwq->busy_hash[hash_ptr(work, BUSY_WORKER_HASH_ORDER)];
+}
+
+static struct worker *
+__find_worker_executing_work(struct global_cwq *gcwq, struct hlist_head *bwh,
+			     struct work_struct *work)
+{
+	struct worker *worker;
+	struct hlist_node *tmp;
+
+	hlist_for_each_entry(worker, tmp, bwh, hentry)
+		if (worker->current_work == work)
+			return worker;
+	return NULL;
+}
+
+static struct worker *find_worker_executing_work(struct global_cwq *gcwq,
+						 struct work_struct *work)
+{
+	return __find_worker_executing_work(gcwq, busy_worker_head(gcwq, work),
+					    work);
+}
+
 static void insert_work(struct cpu_workqueue_struct *cwq,
-			struct work_struct *work, struct list_head *head)
+			struct work_struct *work, struct list_head *head,
+			unsigned long extra_flags)
 {
-	trace_workqueue_insertion(cwq->thread, work);
+	struct global_cwq *gcwq = cwq->gcwq;
+	int color = cwq->work_color;
 
-	set_wq_data(work, cwq);
+	cwq->nr_in_flight[color]++;
+	set_wq_data(work, cwq, work_color_to_flags(color) | extra_flags);
 	/*
 	 * Ensure that we get the right work->data if we see the
 	 * result of list_add() below, see try_to_grab_pending().
 	 */
 	smp_wmb();
 	list_add_tail(&work->entry, head);
-	wake_up(&cwq->more_work);
+	/*
+	 * Either wq_worker_sleeping() sees the work on the list, or we
+	 * see its nr_running drop to zero and wake somebody up.
+	 */
+	smp_mb();
+	if (__need_more_worker(gcwq))
+		wake_up_worker(gcwq);
 }
 
 static void __queue_work(struct cpu_workqueue_struct *cwq,
 			 struct work_struct *work)
 {
+	struct global_cwq *gcwq = cwq->gcwq;
+	struct list_head *worklist = &gcwq->worklist;
+	unsigned long work_flags = 0;
 	unsigned long flags;
 
-	spin_lock_irqsave(&cwq->lock, flags);
-	insert_work(cwq, work, &cwq->worklist);
-	spin_unlock_irqrestore(&cwq->lock, flags);
+	spin_lock_irqsave(&gcwq->lock, flags);
+	if (likely(cwq->nr_active < cwq->max_active))
+		cwq->nr_active++;
+	else {
+		worklist = &cwq->delayed_works;
+		work_flags = 1UL << WORK_STRUCT_INACTIVE;
+	}
+	insert_work(cwq, work, worklist, work_flags);
+	spin_unlock_irqrestore(&gcwq->lock, flags);
 }
 
 /**
@@ -246,7 +589,7 @@ int queue_delayed_work_on(int cpu, struct workqueue_struct *wq,
 		timer_stats_timer_set_start_info(&dwork->timer);
 
 		/* This stores cwq for the moment, for the timer_fn */
-		set_wq_data(work, wq_per_cpu(wq, raw_smp_processor_id()));
+		set_wq_data(work, wq_per_cpu(wq, raw_smp_processor_id()), 0);
 		timer->expires = jiffies + delay;
 		timer->data = (unsigned long)dwork;
 		timer->function = delayed_work_timer_fn;
@@ -261,81 +604,552 @@ int queue_delayed_work_on(int cpu, struct workqueue_struct *wq,
 }
 EXPORT_SYMBOL_GPL(queue_delayed_work_on);
 
-static void run_workqueue(struct cpu_workqueue_struct *cwq)
+/*
+ * Move @work, and the barriers linked to it, to @head.  If @nextp is
+ * given, it is updated to point past them.
+ */
+static void move_linked_works(struct work_struct *work, struct list_head *head,
+			      struct work_struct **nextp)
 {
-	spin_lock_irq(&cwq->lock);
-	while (!list_empty(&cwq->worklist)) {
-		struct work_struct *work = list_entry(cwq->worklist.next,
-						struct work_struct, entry);
-		work_func_t f = work->func;
+	struct work_struct *n;
+
+	/* a chain of linked works always ends before the list head */
+	list_for_each_entry_safe_from(work, n, NULL, entry) {
+		list_move_tail(&work->entry, head);
+		if (!test_bit(WORK_STRUCT_LINKED, work_data_bits(work)))
+			break;
+	}
+
+	if (nextp)
+		*nextp = n;
+}
+
+/* Give the first delayed work of @cwq its turn on the gcwq */
+static void cwq_activate_first_delayed(struct cpu_workqueue_struct *cwq)
+{
+	struct global_cwq *gcwq = cwq->gcwq;
+	struct work_struct *work = list_first_entry(&cwq->delayed_works,
+						    struct work_struct, entry);
+
+	move_linked_works(work, &gcwq->worklist, NULL);
+	__clear_bit(WORK_STRUCT_INACTIVE, work_data_bits(work));
+	cwq->nr_active++;
+
+	if (__need_more_worker(gcwq))
+		wake_up_worker(gcwq);
+}
+
+/*
+ * A work of @cwq of color @color is done (or was cancelled): unless
+ * @inactive, it makes room for a delayed one.  If it was the last one
+ * flush_workqueue() waited for on @cwq, tell it.
+ */
+static void cwq_dec_nr_in_flight(struct cpu_workqueue_struct *cwq, int color,
+				 bool inactive)
+{
+	cwq->nr_in_flight[color]--;
+
+	if (!inactive) {
+		cwq->nr_active--;
+		if (!list_empty(&cwq->delayed_works) &&
+		    cwq->nr_active < cwq->max_active)
+			cwq_activate_first_delayed(cwq);
+	}
+
+	if (likely(cwq->flush_color != color) || cwq->nr_in_flight[color])
+		return;
+
+	cwq->flush_color = -1;
+	if (atomic_dec_and_test(&cwq->wq->nr_cwqs_to_flush))
+		complete(cwq->wq->flush_done);
+}
+
+/*
+ * Execute @work, called and returning with gcwq->lock held.  A work is
+ * never executed by two workers of the same gcwq at once: if somebody
+ * is already at it, @work is handed over to them.
+ */
+static void process_one_work(struct worker *worker, struct work_struct *work)
+{
+	struct cpu_workqueue_struct *cwq = get_wq_data(work);
+	struct global_cwq *gcwq = cwq->gcwq;
+	struct hlist_head *bwh = busy_worker_head(gcwq, work);
+	work_func_t f = work->func;
+	struct worker *collision;
+	bool inactive;
+	int color;
 #ifdef CONFIG_LOCKDEP
-		/*
-		 * It is permissible to free the struct work_struct
-		 * from inside the function that is called from it,
-		 * this we need to take into account for lockdep too.
-		 * To avoid bogus "held lock freed" warnings as well
-		 * as problems when looking into work->lockdep_map,
-		 * make a copy and use that here.
-		 */
-		struct lockdep_map lockdep_map = work->lockdep_map;
+	/*
+	 * It is permissible to free the struct work_struct
+	 * from inside the function that is called from it,
+	 * this we need to take into account for lockdep too.
+	 * To avoid bogus "held lock freed" warnings as well
+	 * as problems when looking into work->lockdep_map,
+	 * make a copy and use that here.
+	 */
+	struct lockdep_map lockdep_map = work->lockdep_map;
 #endif
-		trace_workqueue_execution(cwq->thread, work);
-		cwq->current_work = work;
-		list_del_init(cwq->worklist.next);
-		spin_unlock_irq(&cwq->lock);
-
-		BUG_ON(get_wq_data(work) != cwq);
-		work_clear_pending(work);
-		lock_map_acquire(&cwq->wq->lockdep_map);
-		lock_map_acquire(&lockdep_map);
-		f(work);
-		lock_map_release(&lockdep_map);
-		lock_map_release(&cwq->wq->lockdep_map);
-
-		if (unlikely(in_atomic() || lockdep_depth(current) > 0)) {
-			printk(KERN_ERR "BUG: workqueue leaked lock or atomic: "
-					"%s/0x%08x/%d\n",
-					current->comm, preempt_count(),
-				       	task_pid_nr(current));
-			printk(KERN_ERR "    last function: ");
-			print_symbol("%s\n", (unsigned long)f);
-			debug_show_held_locks(current);
-			dump_stack();
-		}
 
-		spin_lock_irq(&cwq->lock);
-		cwq->current_work = NULL;
+	collision = __find_worker_executing_work(gcwq, bwh, work);
+	if (unlikely(collision)) {
+		move_linked_works(work, &collision->scheduled, NULL);
+		return;
+	}
+
+	hlist_add_head(&worker->hentry, bwh);
+	worker->current_work = work;
+	worker->current_cwq = cwq;
+	color = get_work_color(work);
+	inactive = test_bit(WORK_STRUCT_INACTIVE, work_data_bits(work));
+	list_del_init(&work->entry);
+
+	/* works aren't tied to a thread until one picks them up */
+	trace_workqueue_insertion(worker->task, work);
+	trace_workqueue_execution(worker->task, work);
+	spin_unlock_irq(&gcwq->lock);
+
+	BUG_ON(get_wq_data(work) != cwq);
+	work_clear_pending(work);
+	lock_map_acquire(&cwq->wq->lockdep_map);
+	lock_map_acquire(&lockdep_map);
+	f(work);
+	lock_map_release(&lockdep_map);
+	lock_map_release(&cwq->wq->lockdep_map);
+
+	if (unlikely(in_atomic() || lockdep_depth(current) > 0)) {
+		printk(KERN_ERR "BUG: workqueue leaked lock or atomic: "
+				"%s/0x%08x/%d\n",
+				current->comm, preempt_count(),
+			       	task_pid_nr(current));
+		printk(KERN_ERR "    last function: ");
+		print_symbol("%s\n", (unsigned long)f);
+		debug_show_held_locks(current);
+		dump_stack();
 	}
-	spin_unlock_irq(&cwq->lock);
+
+	spin_lock_irq(&gcwq->lock);
+
+	hlist_del_init(&worker->hentry);
+	worker->current_work = NULL;
+	worker->current_cwq = NULL;
+	cwq_dec_nr_in_flight(cwq, color, inactive);
 }
 
-static int worker_thread(void *__cwq)
+static void process_scheduled_works(struct worker *worker)
 {
-	struct cpu_workqueue_struct *cwq = __cwq;
-	DEFINE_WAIT(wait);
+	while (!list_empty(&worker->scheduled)) {
+		struct work_struct *work = list_first_entry(&worker->scheduled,
+						struct work_struct, entry);
+		process_one_work(worker, work);
+	}
+}
 
-	if (cwq->wq->freezeable)
-		set_freezable();
+static struct worker *alloc_worker(void)
+{
+	struct worker *worker;
+
+	worker = kzalloc(sizeof(*worker), GFP_KERNEL);
+	if (worker) {
+		INIT_LIST_HEAD(&worker->entry);
+		INIT_LIST_HEAD(&worker->scheduled);
+		worker->flags = WORKER_PREP;
+	}
+	return worker;
+}
+
+static int worker_thread(void *__worker);
+
+/*
+ * Create a worker for @gcwq, bound to its cpu if @bind, and rogue
+ * otherwise.  It isn't started, see start_worker().
+ */
+static struct worker *create_worker(struct global_cwq *gcwq, bool bind)
+{
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
+	struct workqueue_struct *wq = gcwq->wq;
+	struct worker *worker = NULL;
+	struct task_struct *p;
+	int id = -1;
+
+	spin_lock_irq(&gcwq->lock);
+	while (ida_get_new(&gcwq->worker_ida, &id)) {
+		spin_unlock_irq(&gcwq->lock);
+		if (!ida_pre_get(&gcwq->worker_ida, GFP_KERNEL))
+			goto fail;
+		spin_lock_irq(&gcwq->lock);
+	}
+	spin_unlock_irq(&gcwq->lock);
+
+	worker = alloc_worker();
+	if (!worker)
+		goto fail;
+	worker->gcwq = gcwq;
+	worker->id = id;
+
+	if (!wq)
+		p = kthread_create(worker_thread, worker, "kworker/%u:%d",
+				   gcwq->cpu, id);
+	else if (is_wq_single_threaded(wq))
+		p = kthread_create(worker_thread, worker, "%s", wq->name);
+	else
+		p = kthread_create(worker_thread, worker, "%s/%d",
+				   wq->name, gcwq->cpu);
+	if (IS_ERR(p))
+		goto fail;
+	worker->task = p;
+
+	if (wq && wq->rt)
+		sched_setscheduler_nocheck(p, SCHED_FIFO, &param);
+	if (bind)
+		kthread_bind(p, gcwq->cpu);
+	else
+		worker->flags |= WORKER_ROGUE;
+
+	trace_workqueue_creation(p, gcwq->cpu);
+	return worker;
+
+fail:
+	if (id >= 0) {
+		spin_lock_irq(&gcwq->lock);
+		ida_remove(&gcwq->worker_ida, id);
+		spin_unlock_irq(&gcwq->lock);
+	}
+	kfree(worker);
+	return NULL;
+}
+
+/* Make a newly created worker part of its gcwq, with gcwq->lock held */
+static void start_worker(struct worker *worker)
+{
+	worker->flags |= WORKER_STARTED;
+	worker->gcwq->nr_workers++;
+	worker_enter_idle(worker);
+	wake_up_process(worker->task);
+}
+
+/*
+ * Destroy an idle, or never started, worker.  Called with gcwq->lock
+ * held, which is dropped while waiting for the worker to exit.
+ */
+static void destroy_worker(struct worker *worker)
+{
+	struct global_cwq *gcwq = worker->gcwq;
+	int id = worker->id;
+
+	BUG_ON(worker->current_work);
+	BUG_ON(!list_empty(&worker->scheduled));
+
+	if (worker->flags & WORKER_STARTED)
+		gcwq->nr_workers--;
+	if (worker->flags & WORKER_IDLE)
+		gcwq->nr_idle--;
+
+	list_del_init(&worker->entry);
+	worker->flags |= WORKER_DIE;
+
+	spin_unlock_irq(&gcwq->lock);
+
+	trace_workqueue_destruction(worker->task);
+	kthread_stop(worker->task);
+	kfree(worker);
+
+	spin_lock_irq(&gcwq->lock);
+	ida_remove(&gcwq->worker_ida, id);
+}
+
+static void idle_worker_timeout(unsigned long __gcwq)
+{
+	struct global_cwq *gcwq = (void *)__gcwq;
+
+	spin_lock_irq(&gcwq->lock);
+	if (too_many_workers(gcwq)) {
+		struct worker *worker;
+		unsigned long expires;
+
+		/* the idle list is LIFO, the last one has idled longest */
+		worker = list_entry(gcwq->idle_list.prev, struct worker, entry);
+		expires = worker->last_active + IDLE_WORKER_TIMEOUT;
+
+		if (time_before(jiffies, expires))
+			mod_timer(&gcwq->idle_timer, expires);
+		else {
+			gcwq->flags |= GCWQ_MANAGE_WORKERS;
+			wake_up_worker(gcwq);
+		}
+	}
+	spin_unlock_irq(&gcwq->lock);
+}
+
+static void send_mayday(struct work_struct *work)
+{
+	struct cpu_workqueue_struct *cwq = get_wq_data(work);
+	struct workqueue_struct *wq = cwq->wq;
+
+	if (!wq->rescuer)
+		return;
+
+	if (!cpumask_test_and_set_cpu(cwq->gcwq->cpu, wq->mayday_mask))
+		wake_up_process(wq->rescuer->task);
+}
+
+/*
+ * The manager has been trying to create a worker for a while: memory
+ * may be short, with the works that would free some stuck behind the
+ * blocked workers.  Call the rescuers of the workqueues with works
+ * pending.
+ */
+static void gcwq_mayday_timeout(unsigned long __gcwq)
+{
+	struct global_cwq *gcwq = (void *)__gcwq;
+	struct work_struct *work;
+
+	spin_lock_irq(&gcwq->lock);
+	if (need_to_create_worker(gcwq))
+		list_for_each_entry(work, &gcwq->worklist, entry)
+			send_mayday(work);
+	spin_unlock_irq(&gcwq->lock);
 
-	set_user_nice(current, -5);
+	mod_timer(&gcwq->mayday_timer, jiffies + MAYDAY_INTERVAL);
+}
+
+/*
+ * Create a worker if there is work pending and none idle to do it.
+ * Called with gcwq->lock held, which is dropped while creating it;
+ * returns true if it was.
+ */
+static bool maybe_create_worker(struct global_cwq *gcwq)
+{
+	if (!need_to_create_worker(gcwq))
+		return false;
+restart:
+	spin_unlock_irq(&gcwq->lock);
+
+	mod_timer(&gcwq->mayday_timer, jiffies + MAYDAY_INITIAL_TIMEOUT);
 
 	for (;;) {
-		prepare_to_wait(&cwq->more_work, &wait, TASK_INTERRUPTIBLE);
-		if (!freezing(current) &&
-		    !kthread_should_stop() &&
-		    list_empty(&cwq->worklist))
-			schedule();
-		finish_wait(&cwq->more_work, &wait);
+		struct worker *worker;
+
+		worker = create_worker(gcwq,
+				!(gcwq->flags & GCWQ_DISASSOCIATED));
+		if (worker) {
+			del_timer_sync(&gcwq->mayday_timer);
+			spin_lock_irq(&gcwq->lock);
+			start_worker(worker);
+			return true;
+		}
+
+		if (!need_to_create_worker(gcwq))
+			break;
 
-		try_to_freeze();
+		__set_current_state(TASK_INTERRUPTIBLE);
+		schedule_timeout(CREATE_COOLDOWN);
 
-		if (kthread_should_stop())
+		if (!need_to_create_worker(gcwq))
 			break;
+	}
+
+	del_timer_sync(&gcwq->mayday_timer);
+	spin_lock_irq(&gcwq->lock);
+	if (need_to_create_worker(gcwq))
+		goto restart;
+	return true;
+}
+
+/* Reap the workers idle for too long, with gcwq->lock held */
+static bool maybe_destroy_workers(struct global_cwq *gcwq)
+{
+	bool ret = false;
+
+	while (too_many_workers(gcwq)) {
+		struct worker *worker;
+		unsigned long expires;
+
+		worker = list_entry(gcwq->idle_list.prev, struct worker, entry);
+		expires = worker->last_active + IDLE_WORKER_TIMEOUT;
 
-		run_workqueue(cwq);
+		if (time_before(jiffies, expires)) {
+			mod_timer(&gcwq->idle_timer, expires);
+			break;
+		}
+
+		destroy_worker(worker);
+		ret = true;
 	}
+	return ret;
+}
 
-	return 0;
+/*
+ * Become the manager of the gcwq, unless someone else is, and create
+ * or destroy workers as needed.  Called with gcwq->lock held; returns
+ * true if it was dropped, so that the caller rechecks what to do.
+ */
+static bool manage_workers(struct worker *worker)
+{
+	struct global_cwq *gcwq = worker->gcwq;
+	bool ret = false;
+
+	if ((gcwq->flags & GCWQ_DEDICATED) ||
+	    !mutex_trylock(&gcwq->manager_mutex))
+		return ret;
+
+	gcwq->flags &= ~GCWQ_MANAGE_WORKERS;
+
+	ret |= maybe_destroy_workers(gcwq);
+	ret |= maybe_create_worker(gcwq);
+
+	mutex_unlock(&gcwq->manager_mutex);
+	return ret;
+}
+
+/*
+ * A rogue worker left over from before the gcwq got its cpu back.
+ * Its replacement is bound, it just goes away.
+ */
+static void worker_retire(struct worker *worker)
+{
+	struct global_cwq *gcwq = worker->gcwq;
+
+	gcwq->nr_workers--;
+	ida_remove(&gcwq->worker_ida, worker->id);
+	spin_unlock_irq(&gcwq->lock);
+
+	current->flags &= ~PF_WQ_WORKER;
+	trace_workqueue_destruction(current);
+	kfree(worker);
+}
+
+static int worker_thread(void *__worker)
+{
+	struct worker *worker = __worker;
+	struct global_cwq *gcwq = worker->gcwq;
+
+	if (!(gcwq->flags & GCWQ_DEDICATED))
+		current->flags |= PF_WQ_WORKER;
+	else if (gcwq->wq->freezeable)
+		set_freezable();
+
+	set_user_nice(current, WORKER_NICE_LEVEL);
+woke_up:
+	spin_lock_irq(&gcwq->lock);
+
+	/* DIE is only set while we're idle, checking here is enough */
+	if (unlikely(worker->flags & WORKER_DIE)) {
+		spin_unlock_irq(&gcwq->lock);
+		current->flags &= ~PF_WQ_WORKER;
+		return 0;
+	}
+
+	worker_leave_idle(worker);
+recheck:
+	if (!need_more_worker(gcwq))
+		goto sleep;
+
+	/* make sure somebody is left to take over if we block */
+	if (unlikely(!may_start_working(gcwq)) && manage_workers(worker))
+		goto recheck;
+
+	/* only filled while we're processing works */
+	BUG_ON(!list_empty(&worker->scheduled));
+
+	worker_clr_flags(worker, WORKER_PREP);
+
+	do {
+		struct work_struct *work =
+			list_first_entry(&gcwq->worklist,
+					 struct work_struct, entry);
+
+		if (likely(!test_bit(WORK_STRUCT_LINKED, work_data_bits(work)))) {
+			process_one_work(worker, work);
+			if (unlikely(!list_empty(&worker->scheduled)))
+				process_scheduled_works(worker);
+		} else {
+			move_linked_works(work, &worker->scheduled, NULL);
+			process_scheduled_works(worker);
+		}
+	} while (keep_working(gcwq));
+
+	worker_set_flags(worker, WORKER_PREP);
+sleep:
+	if (unlikely(need_to_manage_workers(gcwq)) && manage_workers(worker))
+		goto recheck;
+
+	if (unlikely(worker->flags & WORKER_ROGUE) &&
+	    !(gcwq->flags & (GCWQ_DISASSOCIATED | GCWQ_DEDICATED))) {
+		worker_retire(worker);
+		return 0;
+	}
+
+	/*
+	 * Workers are only woken up with gcwq->lock held or from the
+	 * local cpu, setting the state before dropping it is enough not
+	 * to miss a wakeup.
+	 */
+	worker_enter_idle(worker);
+	__set_current_state(TASK_INTERRUPTIBLE);
+	spin_unlock_irq(&gcwq->lock);
+	if (!freezing(current))
+		schedule();
+	__set_current_state(TASK_RUNNING);
+	try_to_freeze();
+	goto woke_up;
+}
+
+/*
+ * Bind the rescuer to the cpu of @gcwq, if it has one, and lock it.
+ */
+static void rescuer_bind_and_lock(struct worker *rescuer,
+				  struct global_cwq *gcwq)
+{
+	rescuer->gcwq = gcwq;
+	if (!(gcwq->flags & GCWQ_DISASSOCIATED))
+		set_cpus_allowed_ptr(current, cpumask_of(gcwq->cpu));
+	else
+		set_cpus_allowed_ptr(current, cpu_all_mask);
+	spin_lock_irq(&gcwq->lock);
+}
+
+/*
+ * Each workqueue served by the shared gcwqs has a rescuer, so that its
+ * works make progress when no worker can be created: when told to by a
+ * gcwq, it takes the works of its workqueue off the gcwq and runs them
+ * itself.
+ */
+static int rescuer_thread(void *__wq)
+{
+	struct workqueue_struct *wq = __wq;
+	struct worker *rescuer = wq->rescuer;
+	unsigned int cpu;
+
+	set_user_nice(current, WORKER_NICE_LEVEL);
+repeat:
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	if (kthread_should_stop()) {
+		__set_current_state(TASK_RUNNING);
+		return 0;
+	}
+
+	for_each_cpu(cpu, wq->mayday_mask) {
+		struct cpu_workqueue_struct *cwq = per_cpu_ptr(wq->cpu_wq, cpu);
+		struct global_cwq *gcwq = cwq->gcwq;
+		struct work_struct *work, *n;
+
+		__set_current_state(TASK_RUNNING);
+		cpumask_clear_cpu(cpu, wq->mayday_mask);
+
+		rescuer_bind_and_lock(rescuer, gcwq);
+
+		BUG_ON(!list_empty(&rescuer->scheduled));
+		list_for_each_entry_safe(work, n, &gcwq->worklist, entry)
+			if (get_wq_data(work) == cwq)
+				move_linked_works(work, &rescuer->scheduled, &n);
+
+		process_scheduled_works(rescuer);
+		spin_unlock_irq(&gcwq->lock);
+	}
+
+	schedule();
+	goto repeat;
 }
 
 struct wq_barrier {
@@ -349,35 +1163,40 @@ static void wq_barrier_func(struct work_struct *work)
 	complete(&barr->done);
 }
 
+/*
+ * Queue a barrier that completes once @target has been executed.  If
+ * @worker is executing @target, the barrier goes first on its list of
+ * works to run next; otherwise, @target is pending and the barrier is
+ * linked right after it, so that whoever executes @target executes the
+ * barrier next.  A barrier is never counted in the cwq's nr_active, so
+ * it can't wait for a turn behind its own target.  Called with
+ * gcwq->lock held.
+ */
 static void insert_wq_barrier(struct cpu_workqueue_struct *cwq,
-			struct wq_barrier *barr, struct list_head *head)
+			struct wq_barrier *barr, struct work_struct *target,
+			struct worker *worker)
 {
+	unsigned long linked = 0;
+	struct list_head *head;
+
 	INIT_WORK(&barr->work, wq_barrier_func);
 	__set_bit(WORK_STRUCT_PENDING, work_data_bits(&barr->work));
 
 	init_completion(&barr->done);
 
-	insert_work(cwq, &barr->work, head);
-}
-
-static int flush_cpu_workqueue(struct cpu_workqueue_struct *cwq)
-{
-	int active = 0;
-	struct wq_barrier barr;
+	if (worker)
+		head = worker->scheduled.next;
+	else {
+		unsigned long *bits = work_data_bits(target);
 
-	WARN_ON(cwq->thread == current);
-
-	spin_lock_irq(&cwq->lock);
-	if (!list_empty(&cwq->worklist) || cwq->current_work != NULL) {
-		insert_wq_barrier(cwq, &barr, &cwq->worklist);
-		active = 1;
+		head = target->entry.next;
+		/* there may be barriers linked already, chain after them */
+		linked = *bits & (1UL << WORK_STRUCT_LINKED);
+		__set_bit(WORK_STRUCT_LINKED, bits);
 	}
-	spin_unlock_irq(&cwq->lock);
 
-	if (active)
-		wait_for_completion(&barr.done);
-
-	return active;
+	insert_work(cwq, &barr->work, head,
+		    linked | (1UL << WORK_STRUCT_INACTIVE));
 }
 
 /**
@@ -392,17 +1211,45 @@ static int flush_cpu_workqueue(struct cpu_workqueue_struct *cwq)
  *
  * This function used to run the workqueues itself.  Now we just wait for the
  * helper threads to do it.
+ *
+ * The works of each cwq are colored by the flush they belong to: a
+ * flush switches newly queued works to the other color, and waits for
+ * the works of the old one to be done.  Flushes are serialized, so the
+ * new color is never in use when the switch happens.
  */
 void flush_workqueue(struct workqueue_struct *wq)
 {
-	const struct cpumask *cpu_map = wq_cpu_map(wq);
+	DECLARE_COMPLETION_ONSTACK(done);
 	int cpu;
 
 	might_sleep();
 	lock_map_acquire(&wq->lockdep_map);
 	lock_map_release(&wq->lockdep_map);
-	for_each_cpu(cpu, cpu_map)
-		flush_cpu_workqueue(per_cpu_ptr(wq->cpu_wq, cpu));
+
+	mutex_lock(&wq->flush_mutex);
+	atomic_set(&wq->nr_cwqs_to_flush, 1);
+	wq->flush_done = &done;
+
+	for_each_cpu(cpu, wq_cpu_map(wq)) {
+		struct cpu_workqueue_struct *cwq = per_cpu_ptr(wq->cpu_wq, cpu);
+		struct global_cwq *gcwq = cwq->gcwq;
+
+		if (!gcwq)
+			continue;
+
+		spin_lock_irq(&gcwq->lock);
+		BUG_ON(cwq->flush_color != -1);
+		if (cwq->nr_in_flight[cwq->work_color]) {
+			cwq->flush_color = cwq->work_color;
+			atomic_inc(&wq->nr_cwqs_to_flush);
+		}
+		cwq->work_color = !cwq->work_color;
+		spin_unlock_irq(&gcwq->lock);
+	}
+
+	if (!atomic_dec_and_test(&wq->nr_cwqs_to_flush))
+		wait_for_completion(&done);
+	mutex_unlock(&wq->flush_mutex);
 }
 EXPORT_SYMBOL_GPL(flush_workqueue);
 
@@ -418,20 +1265,21 @@ EXPORT_SYMBOL_GPL(flush_workqueue);
  */
 int flush_work(struct work_struct *work)
 {
+	struct worker *worker = NULL;
 	struct cpu_workqueue_struct *cwq;
-	struct list_head *prev;
+	struct global_cwq *gcwq;
 	struct wq_barrier barr;
 
 	might_sleep();
 	cwq = get_wq_data(work);
 	if (!cwq)
 		return 0;
+	gcwq = cwq->gcwq;
 
 	lock_map_acquire(&cwq->wq->lockdep_map);
 	lock_map_release(&cwq->wq->lockdep_map);
 
-	prev = NULL;
-	spin_lock_irq(&cwq->lock);
+	spin_lock_irq(&gcwq->lock);
 	if (!list_empty(&work->entry)) {
 		/*
 		 * See the comment near try_to_grab_pending()->smp_rmb().
@@ -439,21 +1287,22 @@ int flush_work(struct work_struct *work)
 		 */
 		smp_rmb();
 		if (unlikely(cwq != get_wq_data(work)))
-			goto out;
-		prev = &work->entry;
+			goto already_gone;
 	} else {
-		if (cwq->current_work != work)
-			goto out;
-		prev = &cwq->worklist;
-	}
-	insert_wq_barrier(cwq, &barr, prev->next);
-out:
-	spin_unlock_irq(&cwq->lock);
-	if (!prev)
-		return 0;
+		worker = find_worker_executing_work(gcwq, work);
+		if (!worker)
+			goto already_gone;
+		cwq = worker->current_cwq;
+	}
+	insert_wq_barrier(cwq, &barr, work, worker);
+	spin_unlock_irq(&gcwq->lock);
 
 	wait_for_completion(&barr.done);
 	return 1;
+
+already_gone:
+	spin_unlock_irq(&gcwq->lock);
+	return 0;
 }
 EXPORT_SYMBOL_GPL(flush_work);
 
@@ -464,6 +1313,7 @@ EXPORT_SYMBOL_GPL(flush_work);
 static int try_to_grab_pending(struct work_struct *work)
 {
 	struct cpu_workqueue_struct *cwq;
+	struct global_cwq *gcwq;
 	int ret = -1;
 
 	if (!test_and_set_bit(WORK_STRUCT_PENDING, work_data_bits(work)))
@@ -477,8 +1327,9 @@ static int try_to_grab_pending(struct work_struct *work)
 	cwq = get_wq_data(work);
 	if (!cwq)
 		return ret;
+	gcwq = cwq->gcwq;
 
-	spin_lock_irq(&cwq->lock);
+	spin_lock_irq(&gcwq->lock);
 	if (!list_empty(&work->entry)) {
 		/*
 		 * This work is queued, but perhaps we locked the wrong cwq.
@@ -488,28 +1339,28 @@ static int try_to_grab_pending(struct work_struct *work)
 		smp_rmb();
 		if (cwq == get_wq_data(work)) {
 			list_del_init(&work->entry);
+			cwq_dec_nr_in_flight(cwq, get_work_color(work),
+				test_bit(WORK_STRUCT_INACTIVE, work_data_bits(work)));
 			ret = 1;
 		}
 	}
-	spin_unlock_irq(&cwq->lock);
+	spin_unlock_irq(&gcwq->lock);
 
 	return ret;
 }
 
-static void wait_on_cpu_work(struct cpu_workqueue_struct *cwq,
-				struct work_struct *work)
+static void wait_on_cpu_work(struct global_cwq *gcwq, struct work_struct *work)
 {
+	struct worker *worker;
 	struct wq_barrier barr;
-	int running = 0;
 
-	spin_lock_irq(&cwq->lock);
-	if (unlikely(cwq->current_work == work)) {
-		insert_wq_barrier(cwq, &barr, cwq->worklist.next);
-		running = 1;
-	}
-	spin_unlock_irq(&cwq->lock);
+	spin_lock_irq(&gcwq->lock);
+	worker = find_worker_executing_work(gcwq, work);
+	if (unlikely(worker))
+		insert_wq_barrier(worker->current_cwq, &barr, work, worker);
+	spin_unlock_irq(&gcwq->lock);
 
-	if (unlikely(running))
+	if (unlikely(worker))
 		wait_for_completion(&barr.done);
 }
 
@@ -532,8 +1383,12 @@ static void wait_on_work(struct work_struct *work)
 	wq = cwq->wq;
 	cpu_map = wq_cpu_map(wq);
 
-	for_each_cpu(cpu, cpu_map)
-		wait_on_cpu_work(per_cpu_ptr(wq->cpu_wq, cpu), work);
+	for_each_cpu(cpu, cpu_map) {
+		struct global_cwq *gcwq = per_cpu_ptr(wq->cpu_wq, cpu)->gcwq;
+
+		if (gcwq)
+			wait_on_cpu_work(gcwq, work);
+	}
 }
 
 static int __cancel_work_timer(struct work_struct *work,
@@ -723,69 +1578,263 @@ int keventd_up(void)
 
 int current_is_keventd(void)
 {
-	struct cpu_workqueue_struct *cwq;
-	int cpu = raw_smp_processor_id(); /* preempt-safe: keventd is per-cpu */
-	int ret = 0;
+	struct worker *worker;
 
 	BUG_ON(!keventd_wq);
 
-	cwq = per_cpu_ptr(keventd_wq->cpu_wq, cpu);
-	if (current == cwq->thread)
-		ret = 1;
+	if (current == keventd_wq->rescuer->task)
+		return 1;
+	if (!(current->flags & PF_WQ_WORKER))
+		return 0;
 
-	return ret;
+	/* only we change our current_cwq */
+	worker = kthread_data(current);
+	return worker->current_cwq && worker->current_cwq->wq == keventd_wq;
+}
 
+static void init_gcwq(struct global_cwq *gcwq, unsigned int cpu,
+		      struct workqueue_struct *wq)
+{
+	int i;
+
+	spin_lock_init(&gcwq->lock);
+	INIT_LIST_HEAD(&gcwq->worklist);
+	gcwq->cpu = cpu;
+	gcwq->flags = GCWQ_DISASSOCIATED;
+	if (wq)
+		gcwq->flags |= GCWQ_DEDICATED;
+	gcwq->wq = wq;
+
+	INIT_LIST_HEAD(&gcwq->idle_list);
+	for (i = 0; i < BUSY_WORKER_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&gcwq->busy_hash[i]);
+
+	setup_timer(&gcwq->idle_timer, idle_worker_timeout,
+		    (unsigned long)gcwq);
+	setup_timer(&gcwq->mayday_timer, gcwq_mayday_timeout,
+		    (unsigned long)gcwq);
+
+	ida_init(&gcwq->worker_ida);
+	mutex_init(&gcwq->manager_mutex);
+	init_waitqueue_head(&gcwq->drain_wait);
+	atomic_set(&gcwq->nr_running, 0);
 }
 
-static struct cpu_workqueue_struct *
-init_cpu_workqueue(struct workqueue_struct *wq, int cpu)
+/*
+ * The cpu of @gcwq is going down: its workers are flagged rogue, so
+ * that the scheduler hooks leave them alone, and as nr_running doesn't
+ * mean anything anymore the gcwq lets them all run.
+ */
+static void gcwq_disassociate(struct global_cwq *gcwq)
 {
-	struct cpu_workqueue_struct *cwq = per_cpu_ptr(wq->cpu_wq, cpu);
+	bool shared = !(gcwq->flags & GCWQ_DEDICATED);
+	struct worker *worker;
+	struct hlist_node *pos;
+	int i;
+
+	mutex_lock(&gcwq->manager_mutex);
+	spin_lock_irq(&gcwq->lock);
+	gcwq->flags |= GCWQ_DISASSOCIATED;
+	if (shared) {
+		list_for_each_entry(worker, &gcwq->idle_list, entry)
+			worker->flags |= WORKER_ROGUE;
+		for (i = 0; i < BUSY_WORKER_HASH_SIZE; i++)
+			hlist_for_each_entry(worker, pos, &gcwq->busy_hash[i],
+					     hentry)
+				worker->flags |= WORKER_ROGUE;
+	}
+	spin_unlock_irq(&gcwq->lock);
 
-	cwq->wq = wq;
-	spin_lock_init(&cwq->lock);
-	INIT_LIST_HEAD(&cwq->worklist);
-	init_waitqueue_head(&cwq->more_work);
+	if (shared) {
+		/*
+		 * The scheduler hooks run with irqs off: once they have
+		 * all seen the rogue flags, nr_running is ours to reset.
+		 */
+		synchronize_sched();
+		atomic_set(&gcwq->nr_running, 0);
+	}
+	mutex_unlock(&gcwq->manager_mutex);
+}
 
-	return cwq;
+/*
+ * The cpu of @gcwq didn't go down after all.  Its rogue workers are
+ * replaced by a bound one: the idle ones right away, the busy ones
+ * retire once done.
+ */
+static void gcwq_reassociate(struct global_cwq *gcwq)
+{
+	struct worker *worker = NULL, *rogue;
+
+	mutex_lock(&gcwq->manager_mutex);
+	if (!(gcwq->flags & GCWQ_DEDICATED)) {
+		worker = create_worker(gcwq, true);
+		if (!worker) {
+			printk(KERN_ERR "workqueue: can't rebind the workers "
+			       "of cpu %u\n", gcwq->cpu);
+			mutex_unlock(&gcwq->manager_mutex);
+			return;
+		}
+	}
+
+	spin_lock_irq(&gcwq->lock);
+	if (worker) {
+		while ((rogue = first_worker(gcwq)))
+			destroy_worker(rogue);
+		start_worker(worker);
+	}
+	gcwq->flags &= ~GCWQ_DISASSOCIATED;
+	spin_unlock_irq(&gcwq->lock);
+	mutex_unlock(&gcwq->manager_mutex);
 }
 
-static int create_workqueue_thread(struct cpu_workqueue_struct *cwq, int cpu)
+/*
+ * Wait for the works left on @gcwq to be done and destroy its workers,
+ * once its cpu is dead or its workqueue destroyed.  Nobody can queue
+ * works on it anymore.
+ */
+static void gcwq_drain(struct global_cwq *gcwq)
 {
-	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
-	struct workqueue_struct *wq = cwq->wq;
-	const char *fmt = is_wq_single_threaded(wq) ? "%s" : "%s/%d";
-	struct task_struct *p;
+	del_timer_sync(&gcwq->idle_timer);
 
-	p = kthread_create(worker_thread, cwq, fmt, wq->name, cpu);
-	/*
-	 * Nobody can add the work_struct to this cwq,
-	 *	if (caller is __create_workqueue)
-	 *		nobody should see this wq
-	 *	else // caller is CPU_UP_PREPARE
-	 *		cpu is not on cpu_online_map
-	 * so we can abort safely.
-	 */
-	if (IS_ERR(p))
-		return PTR_ERR(p);
-	if (cwq->wq->rt)
-		sched_setscheduler_nocheck(p, SCHED_FIFO, &param);
-	cwq->thread = p;
+	spin_lock_irq(&gcwq->lock);
+	gcwq->flags |= GCWQ_DRAINING;
+	for (;;) {
+		wake_up_worker(gcwq);
+		spin_unlock_irq(&gcwq->lock);
+		wait_event(gcwq->drain_wait, gcwq_drained(gcwq));
+
+		/* keep the manager from creating workers behind our back */
+		mutex_lock(&gcwq->manager_mutex);
+		spin_lock_irq(&gcwq->lock);
+		if (gcwq_drained(gcwq))
+			break;
+		mutex_unlock(&gcwq->manager_mutex);
+	}
+
+	while (gcwq->nr_workers) {
+		struct worker *worker = first_worker(gcwq);
+
+		if (likely(worker)) {
+			destroy_worker(worker);
+			continue;
+		}
+		spin_unlock_irq(&gcwq->lock);
+		wait_event(gcwq->drain_wait, gcwq->nr_idle);
+		spin_lock_irq(&gcwq->lock);
+	}
+	gcwq->flags &= ~GCWQ_DRAINING;
+	WARN_ON(!list_empty(&gcwq->worklist));
+	spin_unlock_irq(&gcwq->lock);
+	mutex_unlock(&gcwq->manager_mutex);
+}
+
+static int gcwq_cpu_callback(struct global_cwq *gcwq, unsigned long action)
+{
+	switch (action) {
+	case CPU_UP_PREPARE:
+		BUG_ON(gcwq->first_worker || gcwq->nr_workers);
+		gcwq->first_worker = create_worker(gcwq, true);
+		if (!gcwq->first_worker)
+			return -ENOMEM;
+		break;
+
+	case CPU_ONLINE:
+		spin_lock_irq(&gcwq->lock);
+		gcwq->flags &= ~GCWQ_DISASSOCIATED;
+		start_worker(gcwq->first_worker);
+		gcwq->first_worker = NULL;
+		spin_unlock_irq(&gcwq->lock);
+		break;
+
+	case CPU_UP_CANCELED:
+		if (gcwq->first_worker) {
+			spin_lock_irq(&gcwq->lock);
+			destroy_worker(gcwq->first_worker);
+			gcwq->first_worker = NULL;
+			spin_unlock_irq(&gcwq->lock);
+		}
+		break;
+
+	case CPU_DOWN_PREPARE:
+		gcwq_disassociate(gcwq);
+		break;
+
+	case CPU_DOWN_FAILED:
+		gcwq_reassociate(gcwq);
+		break;
+
+	case CPU_POST_DEAD:
+		gcwq_drain(gcwq);
+		break;
+	}
+	return 0;
+}
+
+/*
+ * Set up the cwq of @wq on @cpu and, if @wq has threads of its own, its
+ * gcwq.  Those of a per-cpu workqueue are only started once @cpu is
+ * online.
+ */
+static int init_cpu_workqueue(struct workqueue_struct *wq, int cpu)
+{
+	struct cpu_workqueue_struct *cwq = per_cpu_ptr(wq->cpu_wq, cpu);
+	struct global_cwq *gcwq;
+	struct worker *worker;
+	int err;
+
+	cwq->wq = wq;
+	cwq->flush_color = -1;
+	cwq->max_active = 1;
+	INIT_LIST_HEAD(&cwq->delayed_works);
 
-	trace_workqueue_creation(cwq->thread, cpu);
+	if (is_wq_shared(wq)) {
+		cwq->gcwq = get_gcwq(cpu);
+		return 0;
+	}
 
+	gcwq = kzalloc(sizeof(*gcwq), GFP_KERNEL);
+	if (!gcwq)
+		return -ENOMEM;
+	init_gcwq(gcwq, cpu, wq);
+	cwq->gcwq = gcwq;
+
+	if (!is_wq_single_threaded(wq)) {
+		if (!cpu_online(cpu))
+			return 0;
+		err = gcwq_cpu_callback(gcwq, CPU_UP_PREPARE);
+		if (!err)
+			gcwq_cpu_callback(gcwq, CPU_ONLINE);
+		return err;
+	}
+
+	/* a single thread isn't bound to any cpu */
+	worker = create_worker(gcwq, false);
+	if (!worker)
+		return -ENOMEM;
+	spin_lock_irq(&gcwq->lock);
+	start_worker(worker);
+	spin_unlock_irq(&gcwq->lock);
 	return 0;
 }
 
-static void start_workqueue_thread(struct cpu_workqueue_struct *cwq, int cpu)
+static int create_rescuer(struct workqueue_struct *wq)
 {
-	struct task_struct *p = cwq->thread;
+	struct worker *rescuer;
+	struct task_struct *p;
 
-	if (p != NULL) {
-		if (cpu >= 0)
-			kthread_bind(p, cpu);
-		wake_up_process(p);
+	rescuer = alloc_worker();
+	if (!rescuer)
+		return -ENOMEM;
+
+	p = kthread_create(rescuer_thread, wq, "%s", wq->name);
+	if (IS_ERR(p)) {
+		kfree(rescuer);
+		return PTR_ERR(p);
 	}
+	rescuer->task = p;
+	wq->rescuer = rescuer;
+	wake_up_process(p);
+	return 0;
 }
 
 struct workqueue_struct *__create_workqueue_key(const char *name,
@@ -796,7 +1845,6 @@ struct workqueue_struct *__create_workqueue_key(const char *name,
 						const char *lock_name)
 {
 	struct workqueue_struct *wq;
-	struct cpu_workqueue_struct *cwq;
 	int err = 0, cpu;
 
 	wq = kzalloc(sizeof(*wq), GFP_KERNEL);
@@ -804,7 +1852,8 @@ struct workqueue_struct *__create_workqueue_key(const char *name,
 		return NULL;
 
 	wq->cpu_wq = alloc_percpu(struct cpu_workqueue_struct);
-	if (!wq->cpu_wq) {
+	if (!wq->cpu_wq || !zalloc_cpumask_var(&wq->mayday_mask, GFP_KERNEL)) {
+		free_percpu(wq->cpu_wq);
 		kfree(wq);
 		return NULL;
 	}
@@ -814,37 +1863,34 @@ struct workqueue_struct *__create_workqueue_key(const char *name,
 	wq->singlethread = singlethread;
 	wq->freezeable = freezeable;
 	wq->rt = rt;
+	mutex_init(&wq->flush_mutex);
 	INIT_LIST_HEAD(&wq->list);
 
 	if (singlethread) {
-		cwq = init_cpu_workqueue(wq, singlethread_cpu);
-		err = create_workqueue_thread(cwq, singlethread_cpu);
-		start_workqueue_thread(cwq, -1);
+		err = init_cpu_workqueue(wq, singlethread_cpu);
 	} else {
 		cpu_maps_update_begin();
-		/*
-		 * We must place this wq on list even if the code below fails.
-		 * cpu_down(cpu) can remove cpu from cpu_populated_map before
-		 * destroy_workqueue() takes the lock, in that case we leak
-		 * cwq[cpu]->thread.
-		 */
-		spin_lock(&workqueue_lock);
-		list_add(&wq->list, &workqueues);
-		spin_unlock(&workqueue_lock);
 		/*
 		 * We must initialize cwqs for each possible cpu even if we
-		 * are going to call destroy_workqueue() finally. Otherwise
-		 * cpu_up() can hit the uninitialized cwq once we drop the
-		 * lock.
+		 * are going to call destroy_workqueue() finally, which
+		 * looks at all of them.
 		 */
 		for_each_possible_cpu(cpu) {
-			cwq = init_cpu_workqueue(wq, cpu);
-			if (err || !cpu_online(cpu))
-				continue;
-			err = create_workqueue_thread(cwq, cpu);
-			start_workqueue_thread(cwq, cpu);
+			if (!err)
+				err = init_cpu_workqueue(wq, cpu);
+			else
+				per_cpu_ptr(wq->cpu_wq, cpu)->flush_color = -1;
+		}
+		/* the per-cpu threads follow the cpus up and down */
+		if (!err && !is_wq_shared(wq)) {
+			spin_lock(&workqueue_lock);
+			list_add(&wq->list, &workqueues);
+			spin_unlock(&workqueue_lock);
 		}
 		cpu_maps_update_done();
+
+		if (!err && is_wq_shared(wq))
+			err = create_rescuer(wq);
 	}
 
 	if (err) {
@@ -855,32 +1901,21 @@ struct workqueue_struct *__create_workqueue_key(const char *name,
 }
 EXPORT_SYMBOL_GPL(__create_workqueue_key);
 
-static void cleanup_workqueue_thread(struct cpu_workqueue_struct *cwq)
+static bool wq_has_works(struct workqueue_struct *wq)
 {
-	/*
-	 * Our caller is either destroy_workqueue() or CPU_POST_DEAD,
-	 * cpu_add_remove_lock protects cwq->thread.
-	 */
-	if (cwq->thread == NULL)
-		return;
+	bool ret = false;
+	int cpu;
 
-	lock_map_acquire(&cwq->wq->lockdep_map);
-	lock_map_release(&cwq->wq->lockdep_map);
+	for_each_cpu(cpu, wq_cpu_map(wq)) {
+		struct cpu_workqueue_struct *cwq = per_cpu_ptr(wq->cpu_wq, cpu);
 
-	flush_cpu_workqueue(cwq);
-	/*
-	 * If the caller is CPU_POST_DEAD and cwq->worklist was not empty,
-	 * a concurrent flush_workqueue() can insert a barrier after us.
-	 * However, in that case run_workqueue() won't return and check
-	 * kthread_should_stop() until it flushes all work_struct's.
-	 * When ->worklist becomes empty it is safe to exit because no
-	 * more work_structs can be queued on this cwq: flush_workqueue
-	 * checks list_empty(), and a "normal" queue_work() can't use
-	 * a dead CPU.
-	 */
-	trace_workqueue_destruction(cwq->thread);
-	kthread_stop(cwq->thread);
-	cwq->thread = NULL;
+		if (!cwq->gcwq)
+			continue;
+		spin_lock_irq(&cwq->gcwq->lock);
+		ret |= cwq->nr_in_flight[0] || cwq->nr_in_flight[1];
+		spin_unlock_irq(&cwq->gcwq->lock);
+	}
+	return ret;
 }
 
 /**
@@ -891,18 +1926,41 @@ static void cleanup_workqueue_thread(struct cpu_workqueue_struct *cwq)
  */
 void destroy_workqueue(struct workqueue_struct *wq)
 {
-	const struct cpumask *cpu_map = wq_cpu_map(wq);
 	int cpu;
 
+	lock_map_acquire(&wq->lockdep_map);
+	lock_map_release(&wq->lockdep_map);
+
+	/* works may requeue themselves, they are all done before we go */
+	if (is_wq_shared(wq))
+		while (wq_has_works(wq))
+			flush_workqueue(wq);
+
 	cpu_maps_update_begin();
 	spin_lock(&workqueue_lock);
 	list_del(&wq->list);
 	spin_unlock(&workqueue_lock);
 
-	for_each_cpu(cpu, cpu_map)
-		cleanup_workqueue_thread(per_cpu_ptr(wq->cpu_wq, cpu));
+	for_each_cpu(cpu, wq_cpu_map(wq)) {
+		struct global_cwq *gcwq = per_cpu_ptr(wq->cpu_wq, cpu)->gcwq;
+
+		if (!gcwq || !(gcwq->flags & GCWQ_DEDICATED))
+			continue;
+
+		if (gcwq->first_worker)
+			gcwq_cpu_callback(gcwq, CPU_UP_CANCELED);
+		gcwq_drain(gcwq);
+		del_timer_sync(&gcwq->mayday_timer);
+		ida_destroy(&gcwq->worker_ida);
+		kfree(gcwq);
+	}
  	cpu_maps_update_done();
 
+	if (wq->rescuer) {
+		kthread_stop(wq->rescuer->task);
+		kfree(wq->rescuer);
+	}
+	free_cpumask_var(wq->mayday_mask);
 	free_percpu(wq->cpu_wq);
 	kfree(wq);
 }
@@ -913,49 +1971,30 @@ static int __devinit workqueue_cpu_callback(struct notifier_block *nfb,
 						void *hcpu)
 {
 	unsigned int cpu = (unsigned long)hcpu;
-	struct cpu_workqueue_struct *cwq;
 	struct workqueue_struct *wq;
-	int ret = NOTIFY_OK;
+	int err;
 
 	action &= ~CPU_TASKS_FROZEN;
 
-	switch (action) {
-	case CPU_UP_PREPARE:
-		cpumask_set_cpu(cpu, cpu_populated_map);
-	}
-undo:
+	err = gcwq_cpu_callback(get_gcwq(cpu), action);
 	list_for_each_entry(wq, &workqueues, list) {
-		cwq = per_cpu_ptr(wq->cpu_wq, cpu);
-
-		switch (action) {
-		case CPU_UP_PREPARE:
-			if (!create_workqueue_thread(cwq, cpu))
-				break;
-			printk(KERN_ERR "workqueue [%s] for %i failed\n",
-				wq->name, cpu);
-			action = CPU_UP_CANCELED;
-			ret = NOTIFY_BAD;
-			goto undo;
-
-		case CPU_ONLINE:
-			start_workqueue_thread(cwq, cpu);
-			break;
-
-		case CPU_UP_CANCELED:
-			start_workqueue_thread(cwq, -1);
-		case CPU_POST_DEAD:
-			cleanup_workqueue_thread(cwq);
+		if (err)
 			break;
-		}
+		err = gcwq_cpu_callback(per_cpu_ptr(wq->cpu_wq, cpu)->gcwq,
+					action);
 	}
 
-	switch (action) {
-	case CPU_UP_CANCELED:
-	case CPU_POST_DEAD:
-		cpumask_clear_cpu(cpu, cpu_populated_map);
+	if (err) {
+		/* only CPU_UP_PREPARE can fail, undo it */
+		printk(KERN_ERR "workqueue: workers for cpu %u failed\n", cpu);
+		gcwq_cpu_callback(get_gcwq(cpu), CPU_UP_CANCELED);
+		list_for_each_entry(wq, &workqueues, list)
+			gcwq_cpu_callback(per_cpu_ptr(wq->cpu_wq, cpu)->gcwq,
+					  CPU_UP_CANCELED);
+		return NOTIFY_BAD;
 	}
 
-	return ret;
+	return NOTIFY_OK;
 }
 
 #ifdef CONFIG_SMP
@@ -1007,12 +2046,27 @@ EXPORT_SYMBOL_GPL(work_on_cpu);
 
 void __init init_workqueues(void)
 {
-	alloc_cpumask_var(&cpu_populated_map, GFP_KERNEL);
+	int cpu, err;
 
-	cpumask_copy(cpu_populated_map, cpu_online_mask);
 	singlethread_cpu = cpumask_first(cpu_possible_mask);
 	cpu_singlethread_map = cpumask_of(singlethread_cpu);
 	hotcpu_notifier(workqueue_cpu_callback, 0);
+
+	for_each_possible_cpu(cpu)
+		init_gcwq(get_gcwq(cpu), cpu, NULL);
+
+	for_each_online_cpu(cpu) {
+		struct global_cwq *gcwq = get_gcwq(cpu);
+
+		err = gcwq_cpu_callback(gcwq, CPU_UP_PREPARE);
+		BUG_ON(err);
+		gcwq_cpu_callback(gcwq, CPU_ONLINE);
+	}
+
 	keventd_wq = create_workqueue("events");
 	BUG_ON(!keventd_wq);
+
+	/* nobody depends on the order of the works of keventd */
+	for_each_possible_cpu(cpu)
+		per_cpu_ptr(keventd_wq->cpu_wq, cpu)->max_active = INT_MAX;
 }
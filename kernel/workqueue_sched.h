@@ -0,0 +1,8 @@
+/*
+ * kernel/workqueue_sched.h
+ *
+ * Scheduler hooks for the workers of the shared per-cpu workqueues,
+ * only to be included from sched.c and workqueue.c.
+ */
+void wq_worker_waking_up(struct task_struct *task);
+struct task_struct *wq_worker_sleeping(struct task_struct *task);
@@ -42,6 +42,15 @@ static inline int ioremap_pmd_range(pud_t *pud, unsigned long addr,
 		return -ENOMEM;
 	do {
 		next = pmd_addr_end(addr, end);
+		/*
+		 * Map whole, suitably aligned PMD ranges with a single
+		 * large page if the architecture lets us.  Only do this
+		 * on an empty pmd so that we never leak a pte page.
+		 */
+		if (next - addr == PMD_SIZE && pmd_none(*pmd) &&
+		    IS_ALIGNED(phys_addr + addr, PMD_SIZE) &&
+		    pmd_set_huge(pmd, phys_addr + addr, prot))
+			continue;
 		if (ioremap_pte_range(pmd, addr, next, phys_addr + addr, prot))
 			return -ENOMEM;
 	} while (pmd++, addr = next, addr != end);
@@ -17,6 +17,26 @@ struct rwsem_waiter {
 #define RWSEM_WAITING_FOR_WRITE	0x00000002
 };
 
+#ifdef CONFIG_SMP
+static inline void rwsem_set_owner(struct rw_semaphore *sem)
+{
+	sem->owner = current_thread_info();
+}
+
+static inline void rwsem_clear_owner(struct rw_semaphore *sem)
+{
+	sem->owner = NULL;
+}
+#else
+static inline void rwsem_set_owner(struct rw_semaphore *sem)
+{
+}
+
+static inline void rwsem_clear_owner(struct rw_semaphore *sem)
+{
+}
+#endif
+
 /*
  * initialise the semaphore
  */
@@ -33,6 +53,7 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 	sem->activity = 0;
 	spin_lock_init(&sem->wait_lock);
 	INIT_LIST_HEAD(&sem->wait_list);
+	rwsem_clear_owner(sem);
 }
 
 /*
@@ -41,8 +62,10 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
  *   - the 'active count' _reached_ zero
  *   - the 'waiting count' is non-zero
  * - the spinlock must be held by the caller
- * - woken process blocks are discarded from the list after having task zeroed
- * - writers are only woken if wakewrite is non-zero
+ * - woken reader blocks are discarded from the list after having task zeroed
+ * - writers are only woken if wakewrite is non-zero, and are not granted
+ *   the lock: they take it themselves, unless a running writer beat them
+ *   to it (see __rwsem_try_write_lock())
  */
 static inline struct rw_semaphore *
 __rwsem_do_wake(struct rw_semaphore *sem, int wakewrite)
@@ -59,20 +82,11 @@ __rwsem_do_wake(struct rw_semaphore *sem, int wakewrite)
 		goto dont_wake_writers;
 	}
 
-	/* if we are allowed to wake writers try to grant a single write lock
-	 * if there's a writer at the front of the queue
-	 * - we leave the 'waiting count' incremented to signify potential
-	 *   contention
+	/* if we are allowed to wake writers, wake the writer at the front
+	 * of the queue to compete for the lock
 	 */
 	if (waiter->flags & RWSEM_WAITING_FOR_WRITE) {
-		sem->activity = -1;
-		list_del(&waiter->list);
-		tsk = waiter->task;
-		/* Don't touch waiter after ->task has been NULLed */
-		smp_mb();
-		waiter->task = NULL;
-		wake_up_process(tsk);
-		put_task_struct(tsk);
+		wake_up_process(waiter->task);
 		goto out;
 	}
 
@@ -107,21 +121,82 @@ static inline struct rw_semaphore *
 __rwsem_wake_one_writer(struct rw_semaphore *sem)
 {
 	struct rwsem_waiter *waiter;
-	struct task_struct *tsk;
-
-	sem->activity = -1;
 
 	waiter = list_entry(sem->wait_list.next, struct rwsem_waiter, list);
-	list_del(&waiter->list);
+	wake_up_process(waiter->task);
 
-	tsk = waiter->task;
-	smp_mb();
-	waiter->task = NULL;
-	wake_up_process(tsk);
-	put_task_struct(tsk);
 	return sem;
 }
 
+/*
+ * take the write lock if nobody holds it, waiters or not
+ * - the spinlock must be held by the caller
+ */
+static inline int __rwsem_try_write_lock(struct rw_semaphore *sem)
+{
+	if (sem->activity != 0)
+		return 0;
+
+	sem->activity = -1;
+	rwsem_set_owner(sem);
+	return 1;
+}
+
+#if defined(CONFIG_SMP) && !defined(CONFIG_HAVE_DEFAULT_NO_SPIN_MUTEXES)
+/*
+ * Optimistic spinning, as for mutexes: while the write lock is held by a
+ * writer that is running on another cpu, it is likely to be released
+ * soon, and spinning for it is cheaper than sleeping and being woken.
+ * Readers don't record themselves as owners, so there is no spinning
+ * on them.
+ */
+static int rwsem_optimistic_spin(struct rw_semaphore *sem)
+{
+	int taken = 0;
+
+	preempt_disable();
+	for (;;) {
+		struct thread_info *owner;
+
+		/*
+		 * If there's an owner, wait for it to either
+		 * release the lock or go to sleep.
+		 */
+		owner = ACCESS_ONCE(sem->owner);
+		if (owner && !rwsem_spin_on_owner(sem, owner))
+			break;
+
+		if (ACCESS_ONCE(sem->activity) == 0) {
+			spin_lock_irq(&sem->wait_lock);
+			taken = __rwsem_try_write_lock(sem);
+			spin_unlock_irq(&sem->wait_lock);
+			if (taken)
+				break;
+		}
+
+		/*
+		 * When there's no owner, the lock is either held by readers,
+		 * or we preempted a writer between acquiring the lock and
+		 * setting the owner field: an RT task would live-lock
+		 * waiting for the latter.
+		 */
+		if (!owner && (ACCESS_ONCE(sem->activity) > 0 ||
+			       need_resched() || rt_task(current)))
+			break;
+
+		cpu_relax();
+	}
+	preempt_enable();
+
+	return taken;
+}
+#else
+static inline int rwsem_optimistic_spin(struct rw_semaphore *sem)
+{
+	return 0;
+}
+#endif
+
 /*
  * get a read lock on the semaphore
  */
@@ -189,46 +264,47 @@ int __down_read_trylock(struct rw_semaphore *sem)
 
 /*
  * get a write lock on the semaphore
- * - we increment the waiting count anyway to indicate an exclusive lock
+ * - a free lock is taken even if there are waiters: waiting writers are
+ *   only woken to compete for it, so a writer that is already running
+ *   gets it without waiting for them to be scheduled
  */
 void __sched __down_write_nested(struct rw_semaphore *sem, int subclass)
 {
 	struct rwsem_waiter waiter;
 	struct task_struct *tsk;
 
+	if (rwsem_optimistic_spin(sem))
+		return;
+
 	spin_lock_irq(&sem->wait_lock);
 
-	if (sem->activity == 0 && list_empty(&sem->wait_list)) {
+	if (__rwsem_try_write_lock(sem)) {
 		/* granted */
-		sem->activity = -1;
 		spin_unlock_irq(&sem->wait_lock);
-		goto out;
+		return;
 	}
 
 	tsk = current;
-	set_task_state(tsk, TASK_UNINTERRUPTIBLE);
 
 	/* set up my own style of waitqueue */
 	waiter.task = tsk;
 	waiter.flags = RWSEM_WAITING_FOR_WRITE;
-	get_task_struct(tsk);
 
 	list_add_tail(&waiter.list, &sem->wait_list);
 
-	/* we don't need to touch the semaphore struct anymore */
-	spin_unlock_irq(&sem->wait_lock);
-
-	/* wait to be given the lock */
+	/* wait to be woken when the lock is released, and try to take it */
 	for (;;) {
-		if (!waiter.task)
-			break;
-		schedule();
 		set_task_state(tsk, TASK_UNINTERRUPTIBLE);
+		spin_unlock_irq(&sem->wait_lock);
+		schedule();
+		spin_lock_irq(&sem->wait_lock);
+		if (__rwsem_try_write_lock(sem))
+			break;
 	}
 
+	list_del(&waiter.list);
+	spin_unlock_irq(&sem->wait_lock);
 	tsk->state = TASK_RUNNING;
- out:
-	;
 }
 
 void __sched __down_write(struct rw_semaphore *sem)
@@ -242,15 +318,12 @@ void __sched __down_write(struct rw_semaphore *sem)
 int __down_write_trylock(struct rw_semaphore *sem)
 {
 	unsigned long flags;
-	int ret = 0;
+	int ret;
 
 	spin_lock_irqsave(&sem->wait_lock, flags);
 
-	if (sem->activity == 0 && list_empty(&sem->wait_list)) {
-		/* granted */
-		sem->activity = -1;
-		ret = 1;
-	}
+	/* granted if free */
+	ret = __rwsem_try_write_lock(sem);
 
 	spin_unlock_irqrestore(&sem->wait_lock, flags);
 
@@ -281,6 +354,7 @@ void __up_write(struct rw_semaphore *sem)
 
 	spin_lock_irqsave(&sem->wait_lock, flags);
 
+	rwsem_clear_owner(sem);
 	sem->activity = 0;
 	if (!list_empty(&sem->wait_list))
 		sem = __rwsem_do_wake(sem, 1);
@@ -298,6 +372,7 @@ void __downgrade_write(struct rw_semaphore *sem)
 
 	spin_lock_irqsave(&sem->wait_lock, flags);
 
+	rwsem_clear_owner(sem);
 	sem->activity = 1;
 	if (!list_empty(&sem->wait_list))
 		sem = __rwsem_do_wake(sem, 0);
@@ -143,35 +143,28 @@ unsigned long __init init_bootmem(unsigned long start, unsigned long pages)
 	return init_bootmem_core(NODE_DATA(0)->bdata, start, 0, pages);
 }
 
-static unsigned long __init free_all_bootmem_core(bootmem_data_t *bdata)
+/* Release the pages of [start, end) that are free in the bitmap */
+static unsigned long __init free_bootmem_range(bootmem_data_t *bdata,
+					       unsigned long start,
+					       unsigned long end)
 {
-	int aligned;
 	struct page *page;
-	unsigned long start, end, pages, count = 0;
-
-	if (!bdata->node_bootmem_map)
-		return 0;
-
-	start = bdata->node_min_pfn;
-	end = bdata->node_low_pfn;
-
-	/*
-	 * If the start is aligned to the machines wordsize, we might
-	 * be able to free pages in bulks of that order.
-	 */
-	aligned = !(start & (BITS_PER_LONG - 1));
-
-	bdebug("nid=%td start=%lx end=%lx aligned=%d\n",
-		bdata - bootmem_node_data, start, end, aligned);
+	unsigned long count = 0;
 
 	while (start < end) {
-		unsigned long *map, idx, vec;
+		unsigned long *map, idx, vec, shift;
 
 		map = bdata->node_bootmem_map;
 		idx = start - bdata->node_min_pfn;
-		vec = ~map[idx / BITS_PER_LONG];
+		shift = idx & (BITS_PER_LONG - 1);
+		vec = ~map[idx / BITS_PER_LONG] >> shift;
 
-		if (aligned && vec == ~0UL && start + BITS_PER_LONG < end) {
+		/*
+		 * If the start is aligned to the machines wordsize, we might
+		 * be able to free pages in bulks of that order.
+		 */
+		if (!shift && !(start & (BITS_PER_LONG - 1)) &&
+		    vec == ~0UL && start + BITS_PER_LONG < end) {
 			int order = ilog2(BITS_PER_LONG);
 
 			__free_pages_bootmem(pfn_to_page(start), order);
@@ -179,7 +172,8 @@ static unsigned long __init free_all_bootmem_core(bootmem_data_t *bdata)
 		} else {
 			unsigned long off = 0;
 
-			while (vec && off < BITS_PER_LONG) {
+			while (vec && off < BITS_PER_LONG - shift &&
+			       start + off < end) {
 				if (vec & 1) {
 					page = pfn_to_page(start + off);
 					__free_pages_bootmem(page, 0);
@@ -189,15 +183,56 @@ static unsigned long __init free_all_bootmem_core(bootmem_data_t *bdata)
 				off++;
 			}
 		}
-		start += BITS_PER_LONG;
+		start += BITS_PER_LONG - shift;
 	}
+	return count;
+}
+
+/* Release the pages of the bitmap itself */
+static unsigned long __init free_bootmem_map(bootmem_data_t *bdata)
+{
+	struct page *page;
+	unsigned long i, pages;
 
 	page = virt_to_page(bdata->node_bootmem_map);
 	pages = bdata->node_low_pfn - bdata->node_min_pfn;
 	pages = bootmem_bootmap_pages(pages);
-	count += pages;
-	while (pages--)
+	for (i = 0; i < pages; i++)
 		__free_pages_bootmem(page++, 0);
+	return pages;
+}
+
+static unsigned long __init free_all_bootmem_core(pg_data_t *pgdat)
+{
+	bootmem_data_t *bdata = pgdat->bdata;
+	unsigned long start, end, count;
+
+	if (!bdata->node_bootmem_map)
+		return 0;
+
+	start = bdata->node_min_pfn;
+	end = bdata->node_low_pfn;
+
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+	/*
+	 * The struct pages beyond first_deferred_pfn are not initialised
+	 * yet: free_bootmem_deferred() releases those pages later, and the
+	 * bitmap has to stay until it is done.
+	 */
+	if (pgdat->first_deferred_pfn < end) {
+		end = max(start, pgdat->first_deferred_pfn);
+		count = free_bootmem_range(bdata, start, end);
+		bdebug("nid=%td released=%lx deferred=%lx\n",
+			bdata - bootmem_node_data, count, end);
+		return count;
+	}
+#endif
+
+	bdebug("nid=%td start=%lx end=%lx\n",
+		bdata - bootmem_node_data, start, end);
+
+	count = free_bootmem_range(bdata, start, end);
+	count += free_bootmem_map(bdata);
 
 	bdebug("nid=%td released=%lx\n", bdata - bootmem_node_data, count);
 
@@ -213,7 +248,7 @@ static unsigned long __init free_all_bootmem_core(bootmem_data_t *bdata)
 unsigned long __init free_all_bootmem_node(pg_data_t *pgdat)
 {
 	register_page_bootmem_info_node(pgdat);
-	return free_all_bootmem_core(pgdat->bdata);
+	return free_all_bootmem_core(pgdat);
 }
 
 /**
@@ -223,9 +258,50 @@ unsigned long __init free_all_bootmem_node(pg_data_t *pgdat)
  */
 unsigned long __init free_all_bootmem(void)
 {
-	return free_all_bootmem_core(NODE_DATA(0)->bdata);
+	return free_all_bootmem_core(NODE_DATA(0));
 }
 
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+/**
+ * free_bootmem_deferred - release free pages whose struct pages were deferred
+ * @pgdat: node the pages belong to
+ * @start: first pfn of the range
+ * @end: pfn after the range
+ *
+ * The struct pages of the range must have been initialised by now.
+ * Returns the number of pages actually released.
+ */
+unsigned long __init free_bootmem_deferred(pg_data_t *pgdat,
+					   unsigned long start,
+					   unsigned long end)
+{
+	bootmem_data_t *bdata = pgdat->bdata;
+
+	if (!bdata->node_bootmem_map)
+		return 0;
+	start = max(start, bdata->node_min_pfn);
+	end = min(end, bdata->node_low_pfn);
+	if (start >= end)
+		return 0;
+	return free_bootmem_range(bdata, start, end);
+}
+
+/**
+ * free_bootmem_map_deferred - release the bitmap of a deferred node
+ * @pgdat: node whose deferred pages have all been released
+ *
+ * Returns the number of pages actually released.
+ */
+unsigned long __init free_bootmem_map_deferred(pg_data_t *pgdat)
+{
+	bootmem_data_t *bdata = pgdat->bdata;
+
+	if (!bdata->node_bootmem_map)
+		return 0;
+	return free_bootmem_map(bdata);
+}
+#endif
+
 static void __init __free(bootmem_data_t *bdata,
 			unsigned long sidx, unsigned long eidx)
 {
@@ -0,0 +1,145 @@
+/*
+ *  linux/mm/cleancache.c
+ *
+ *  Hand clean page cache pages evicted by reclaim to a backend, and ask
+ *  the backend for them before reading them from disk again.  See
+ *  include/linux/cleancache.h and Documentation/vm/cleancache.txt.
+ */
+
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/cleancache.h>
+
+/*
+ * Set once a backend has registered: until then, and for the filesystems
+ * mounted before, the hooks cost a test of this flag.
+ */
+int cleancache_enabled __read_mostly;
+EXPORT_SYMBOL(cleancache_enabled);
+
+static struct cleancache_ops *cleancache_ops __read_mostly;
+
+/* Statistics, for /sys/kernel/mm/cleancache; not exact */
+static unsigned long cleancache_succ_gets;
+static unsigned long cleancache_failed_gets;
+static unsigned long cleancache_puts;
+static unsigned long cleancache_flushes;
+
+/**
+ * cleancache_register_ops - install the cleancache backend
+ * @ops: the backend operations
+ *
+ * There can be only one backend, and it cannot be removed again.
+ * Returns 0, or -EBUSY if a backend is already registered.
+ */
+int cleancache_register_ops(struct cleancache_ops *ops)
+{
+	if (cmpxchg(&cleancache_ops, NULL, ops) != NULL)
+		return -EBUSY;
+	/* The ops must be visible before any hook can see the flag */
+	smp_wmb();
+	cleancache_enabled = 1;
+	return 0;
+}
+EXPORT_SYMBOL(cleancache_register_ops);
+
+void __cleancache_init_fs(struct super_block *sb)
+{
+	sb->cleancache_poolid = cleancache_ops->init_fs(PAGE_SIZE);
+}
+EXPORT_SYMBOL(__cleancache_init_fs);
+
+int __cleancache_get_page(struct page *page)
+{
+	struct address_space *mapping = page->mapping;
+	int ret;
+
+	VM_BUG_ON(!PageLocked(page));
+	ret = cleancache_ops->get_page(mapping->host->i_sb->cleancache_poolid,
+				       mapping->host->i_ino, page->index, page);
+	if (ret == 0)
+		cleancache_succ_gets++;
+	else
+		cleancache_failed_gets++;
+	return ret;
+}
+EXPORT_SYMBOL(__cleancache_get_page);
+
+void __cleancache_put_page(struct page *page)
+{
+	struct address_space *mapping = page->mapping;
+
+	VM_BUG_ON(!PageLocked(page));
+	cleancache_puts++;
+	cleancache_ops->put_page(mapping->host->i_sb->cleancache_poolid,
+				 mapping->host->i_ino, page->index, page);
+}
+EXPORT_SYMBOL(__cleancache_put_page);
+
+void __cleancache_flush_page(struct address_space *mapping, struct page *page)
+{
+	VM_BUG_ON(!PageLocked(page));
+	cleancache_flushes++;
+	cleancache_ops->flush_page(mapping->host->i_sb->cleancache_poolid,
+				   mapping->host->i_ino, page->index);
+}
+EXPORT_SYMBOL(__cleancache_flush_page);
+
+void __cleancache_flush_inode(struct address_space *mapping)
+{
+	cleancache_ops->flush_inode(mapping->host->i_sb->cleancache_poolid,
+				    mapping->host->i_ino);
+}
+EXPORT_SYMBOL(__cleancache_flush_inode);
+
+void __cleancache_flush_fs(struct super_block *sb)
+{
+	cleancache_ops->flush_fs(sb->cleancache_poolid);
+	sb->cleancache_poolid = -1;
+}
+EXPORT_SYMBOL(__cleancache_flush_fs);
+
+#ifdef CONFIG_SYSFS
+
+#define CLEANCACHE_ATTR_RO(_name)					\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%lu\n", cleancache_##_name);		\
+}									\
+static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+
+CLEANCACHE_ATTR_RO(succ_gets);
+CLEANCACHE_ATTR_RO(failed_gets);
+CLEANCACHE_ATTR_RO(puts);
+CLEANCACHE_ATTR_RO(flushes);
+
+static struct attribute *cleancache_attrs[] = {
+	&succ_gets_attr.attr,
+	&failed_gets_attr.attr,
+	&puts_attr.attr,
+	&flushes_attr.attr,
+	NULL,
+};
+
+static struct attribute_group cleancache_attr_group = {
+	.attrs = cleancache_attrs,
+	.name = "cleancache",
+};
+
+static int __init cleancache_init(void)
+{
+	int err;
+
+	err = sysfs_create_group(mm_kobj, &cleancache_attr_group);
+	if (err)
+		printk(KERN_ERR "cleancache: register sysfs failed\n");
+	return 0;
+}
+module_init(cleancache_init);
+
+#endif /* CONFIG_SYSFS */
@@ -34,6 +34,7 @@
 #include <linux/hardirq.h> /* for BUG_ON(!in_atomic()) only */
 #include <linux/memcontrol.h>
 #include <linux/mm_inline.h> /* for page_is_file_cache() */
+#include <linux/cleancache.h>
 #include "internal.h"
 
 /*
@@ -116,6 +117,16 @@ void __remove_from_page_cache(struct page *page)
 {
 	struct address_space *mapping = page->mapping;
 
+	/*
+	 * An uptodate page with all its blocks on disk can be offered to
+	 * cleancache, to be read back from there instead of from disk;
+	 * otherwise any stale copy kept earlier has to go.
+	 */
+	if (PageUptodate(page) && PageMappedToDisk(page))
+		cleancache_put_page(page);
+	else
+		cleancache_flush_page(mapping, page);
+
 	radix_tree_delete(&mapping->page_tree, page->index);
 	page->mapping = NULL;
 	mapping->nrpages--;
@@ -1157,6 +1168,18 @@ page_not_up_to_date_locked:
 		}
 
 readpage:
+		/*
+		 * If a clean copy of the page was kept in cleancache when it
+		 * was evicted, that saves the read.  Not if the page has
+		 * buffers: those may be newer than the copy.
+		 */
+		if (!page_has_private(page) && cleancache_get_page(page) == 0) {
+			SetPageUptodate(page);
+			SetPageMappedToDisk(page);
+			unlock_page(page);
+			goto page_ok;
+		}
+
 		/* Start the actual read. The read will unlock the page. */
 		error = mapping->a_ops->readpage(filp, page);
 
@@ -0,0 +1,255 @@
+/*
+ *  mm/huge_memory.c
+ *
+ *  Map naturally aligned, physically contiguous page cache extents into
+ *  user space with a single pmd.
+ *
+ *  The pages of an extent stay ordinary small pages with their own
+ *  refcount, mapcount and page cache slot; only the mapping is huge.  So
+ *  whenever anything needs per-page state in the page tables - a partial
+ *  unmap, mprotect, reclaim unmapping one page - the pmd is split back
+ *  into a pte table mapping the same pages.  The pte table for that is
+ *  allocated when the huge pmd is installed and kept on the mm, so that
+ *  splitting can never fail.
+ */
+
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/rmap.h>
+#include <linux/swap.h>
+#include <linux/highmem.h>
+#include <asm/tlb.h>
+#include <asm/pgalloc.h>
+
+/* Set aside a pte table for splitting a huge pmd: page_table_lock held */
+static void deposit_pte_table(struct mm_struct *mm, pgtable_t pgtable)
+{
+	list_add(&pgtable->lru, &mm->huge_pmd_ptes);
+}
+
+static pgtable_t withdraw_pte_table(struct mm_struct *mm)
+{
+	pgtable_t pgtable;
+
+	BUG_ON(list_empty(&mm->huge_pmd_ptes));
+	pgtable = list_entry(mm->huge_pmd_ptes.next, struct page, lru);
+	list_del(&pgtable->lru);
+	return pgtable;
+}
+
+/**
+ * do_set_huge_pmd - map a page cache extent with a huge pmd
+ * @vma: the shared mapping faulting
+ * @address: the faulting address
+ * @pmd: the pmd covering @address, found empty by the caller
+ * @page: the first of HPAGE_PMD_NR contiguous, naturally aligned pages
+ * @flags: the FAULT_FLAG_xxx of the fault
+ *
+ * The caller holds the pages locked and has checked that they are still
+ * in the page cache backing @vma at the right offsets.  Returns 0 if the
+ * extent was mapped, or if someone else populated the pmd meanwhile.
+ */
+int do_set_huge_pmd(struct vm_area_struct *vma, unsigned long address,
+		    pmd_t *pmd, struct page *page, unsigned int flags)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	pgtable_t pgtable;
+	pmd_t entry;
+	int i;
+
+	pgtable = pte_alloc_one(mm, address & HPAGE_PMD_MASK);
+	if (unlikely(!pgtable))
+		return VM_FAULT_OOM;
+
+	spin_lock(&mm->page_table_lock);
+	if (unlikely(!pmd_none(*pmd))) {
+		spin_unlock(&mm->page_table_lock);
+		pte_free(mm, pgtable);
+		return 0;
+	}
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		get_page(page + i);
+		page_add_file_rmap(page + i);
+	}
+	add_mm_counter(mm, file_rss, HPAGE_PMD_NR);
+
+	entry = mk_huge_pmd(page, vma->vm_page_prot);
+	entry = pmd_mkyoung(entry);
+	if (flags & FAULT_FLAG_WRITE)
+		entry = pmd_mkdirty(entry);
+	deposit_pte_table(mm, pgtable);
+	mm->nr_ptes++;
+	set_pmd(pmd, entry);
+	spin_unlock(&mm->page_table_lock);
+
+	count_vm_event(SHMEM_HUGE_MAPPED);
+	return 0;
+}
+
+/*
+ * A fault on an address already mapped by a huge pmd: either a racing
+ * fault mapped it meanwhile, and the access just has to be retried, or
+ * this is a write the pmd does not allow and has to be handled per pte.
+ */
+int huge_pmd_fault(struct vm_area_struct *vma, unsigned long address,
+		   pmd_t *pmd, unsigned int flags)
+{
+	if (!(flags & FAULT_FLAG_WRITE) ||
+	    pte_write(huge_pmd_pte(*pmd, address)))
+		return 0;
+
+	__split_huge_pmd(vma->vm_mm, pmd, address);
+	return VM_FAULT_FALLBACK;
+}
+
+void __split_huge_pmd(struct mm_struct *mm, pmd_t *pmd, unsigned long address)
+{
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+	pgtable_t pgtable;
+	pmd_t orig, _pmd;
+	pte_t *pte;
+	int i;
+
+	spin_lock(&mm->page_table_lock);
+	if (unlikely(!pmd_trans_huge(*pmd))) {
+		spin_unlock(&mm->page_table_lock);
+		return;
+	}
+
+	/*
+	 * Clear the pmd before copying it, so that the hardware cannot set
+	 * the dirty bit in it behind our back; faults on the range wait on
+	 * page_table_lock meanwhile.
+	 */
+	orig = pmdp_get_and_clear(mm, haddr, pmd);
+	flush_tlb_mm(mm);
+
+	pgtable = withdraw_pte_table(mm);
+	pmd_populate(mm, &_pmd, pgtable);
+	pte = pte_offset_map(&_pmd, haddr);
+	for (i = 0; i < HPAGE_PMD_NR; i++, haddr += PAGE_SIZE)
+		set_pte_at(mm, haddr, pte + i, huge_pmd_pte(orig, haddr));
+	pte_unmap(pte);
+
+	smp_wmb(); /* See comment in __pte_alloc */
+	pmd_populate(mm, pmd, pgtable);
+	spin_unlock(&mm->page_table_lock);
+
+	count_vm_event(SHMEM_HUGE_SPLIT);
+}
+
+/**
+ * zap_huge_pmd - unmap a whole huge pmd
+ * @tlb: the mmu_gather of the unmap
+ * @vma: the vma being unmapped
+ * @pmd: the pmd to clear
+ * @address: an address inside the huge pmd
+ *
+ * Returns 1 if the huge pmd was unmapped, or 0 if it was split under us
+ * and the caller has to zap the ptes instead.
+ */
+int zap_huge_pmd(struct mmu_gather *tlb, struct vm_area_struct *vma,
+		 pmd_t *pmd, unsigned long address)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+	pgtable_t pgtable;
+	struct page *page;
+	pmd_t orig;
+	pte_t pte;
+	int i;
+
+	spin_lock(&mm->page_table_lock);
+	if (unlikely(!pmd_trans_huge(*pmd))) {
+		spin_unlock(&mm->page_table_lock);
+		return 0;
+	}
+	orig = pmdp_get_and_clear(mm, haddr, pmd);
+	pgtable = withdraw_pte_table(mm);
+	mm->nr_ptes--;
+	add_mm_counter(mm, file_rss, -HPAGE_PMD_NR);
+	spin_unlock(&mm->page_table_lock);
+
+	pte = huge_pmd_pte(orig, haddr);
+	page = pte_page(pte);
+	for (i = 0; i < HPAGE_PMD_NR; i++, page++) {
+		if (pte_dirty(pte))
+			set_page_dirty(page);
+		if (pte_young(pte) && likely(!VM_SequentialReadHint(vma)))
+			mark_page_accessed(page);
+		page_remove_rmap(page);
+		tlb_remove_page(tlb, page);
+	}
+	pte_free(mm, pgtable);
+
+	return 1;
+}
+
+/*
+ * follow_page() for an address mapped by a huge pmd.  Returns NULL if the
+ * pmd is no longer huge, or has been split for a write it did not allow.
+ */
+struct page *follow_huge_pmd_page(struct vm_area_struct *vma,
+				  unsigned long address, pmd_t *pmd,
+				  unsigned int flags)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	struct page *page = NULL;
+	pte_t pte;
+
+	spin_lock(&mm->page_table_lock);
+	if (unlikely(!pmd_trans_huge(*pmd)))
+		goto out;
+
+	pte = huge_pmd_pte(*pmd, address);
+	if ((flags & FOLL_WRITE) && !pte_write(pte)) {
+		spin_unlock(&mm->page_table_lock);
+		__split_huge_pmd(mm, pmd, address);
+		return NULL;
+	}
+
+	page = pte_page(pte);
+	if (flags & FOLL_GET)
+		get_page(page);
+	if (flags & FOLL_TOUCH) {
+		if ((flags & FOLL_WRITE) &&
+		    !pte_dirty(pte) && !PageDirty(page))
+			set_page_dirty(page);
+		mark_page_accessed(page);
+	}
+out:
+	spin_unlock(&mm->page_table_lock);
+	return page;
+}
+
+/*
+ * If @page is mapped into @mm at @address by a huge pmd, return that pmd
+ * with page_table_lock held.
+ */
+pmd_t *page_check_huge_pmd(struct page *page, struct mm_struct *mm,
+			   unsigned long address)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	pgd = pgd_offset(mm, address);
+	if (!pgd_present(*pgd))
+		return NULL;
+
+	pud = pud_offset(pgd, address);
+	if (!pud_present(*pud))
+		return NULL;
+
+	pmd = pmd_offset(pud, address);
+	if (!pmd_trans_huge(*pmd))
+		return NULL;
+
+	spin_lock(&mm->page_table_lock);
+	if (pmd_trans_huge(*pmd) &&
+	    pte_page(huge_pmd_pte(*pmd, address)) == page)
+		return pmd;
+	spin_unlock(&mm->page_table_lock);
+	return NULL;
+}
@@ -50,6 +50,15 @@ extern unsigned long highest_memmap_pfn;
 extern void __free_pages_bootmem(struct page *page, unsigned int order);
 extern void prep_compound_page(struct page *page, unsigned long order);
 
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+/*
+ * in mm/bootmem.c
+ */
+extern unsigned long free_bootmem_deferred(pg_data_t *pgdat,
+					   unsigned long start,
+					   unsigned long end);
+extern unsigned long free_bootmem_map_deferred(pg_data_t *pgdat);
+#endif
 
 /*
  * function for dealing with page's order in buddy system.
@@ -41,7 +41,7 @@ static long madvise_behavior(struct vm_area_struct * vma,
 	struct mm_struct * mm = vma->vm_mm;
 	int error = 0;
 	pgoff_t pgoff;
-	int new_flags = vma->vm_flags;
+	unsigned long new_flags = vma->vm_flags;
 
 	switch (behavior) {
 	case MADV_NORMAL:
@@ -59,6 +59,12 @@ static long madvise_behavior(struct vm_area_struct * vma,
 	case MADV_DOFORK:
 		new_flags &= ~VM_DONTCOPY;
 		break;
+	case MADV_HUGEPAGE:
+		new_flags |= VM_HUGEPAGE;
+		break;
+	case MADV_NOHUGEPAGE:
+		new_flags &= ~VM_HUGEPAGE;
+		break;
 	}
 
 	if (new_flags == vma->vm_flags) {
@@ -154,6 +160,9 @@ static long madvise_dontneed(struct vm_area_struct * vma,
 	if (vma->vm_flags & (VM_LOCKED|VM_HUGETLB|VM_PFNMAP))
 		return -EINVAL;
 
+	if (unshare_pte_boundary(vma, start) || unshare_pte_boundary(vma, end))
+		return -ENOMEM;
+
 	if (unlikely(vma->vm_flags & VM_NONLINEAR)) {
 		struct zap_details details = {
 			.nonlinear_vma = vma,
@@ -223,6 +232,8 @@ madvise_vma(struct vm_area_struct *vma, struct vm_area_struct **prev,
 	case MADV_NORMAL:
 	case MADV_SEQUENTIAL:
 	case MADV_RANDOM:
+	case MADV_HUGEPAGE:
+	case MADV_NOHUGEPAGE:
 		error = madvise_behavior(vma, prev, start, end, behavior);
 		break;
 	case MADV_REMOVE:
@@ -256,6 +267,10 @@ madvise_behavior_valid(int behavior)
 	case MADV_REMOVE:
 	case MADV_WILLNEED:
 	case MADV_DONTNEED:
+#ifdef CONFIG_SHMEM_HUGEPAGE
+	case MADV_HUGEPAGE:
+	case MADV_NOHUGEPAGE:
+#endif
 		return 1;
 
 	default:
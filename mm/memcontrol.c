@@ -37,6 +37,10 @@
 #include <linux/vmalloc.h>
 #include <linux/mm_inline.h>
 #include <linux/page_cgroup.h>
+#include <linux/eventfd.h>
+#include <linux/sort.h>
+#include <linux/log2.h>
+#include <linux/ctype.h>
 #include "internal.h"
 
 #include <asm/uaccess.h>
@@ -54,6 +58,21 @@ static int really_do_swap_account __initdata = 1; /* for remember boot option*/
 
 static DEFINE_MUTEX(memcg_tasklist);	/* can be hold under cgroup_mutex */
 
+/* Check the usage thresholds every this many page charge events */
+#define THRESHOLDS_EVENTS_THRESH	(100)
+
+/* Pages to scan before a reclaim pressure level is computed */
+#define VMPRESSURE_WIN			(SWAP_CLUSTER_MAX * 16)
+/* Percentage of the scanned pages not reclaimed for each level */
+#define VMPRESSURE_LEVEL_MED		60
+#define VMPRESSURE_LEVEL_CRITICAL	95
+/*
+ * Reclaim priority at which pressure is reported critical whatever the
+ * reclaim efficiency: at priority 3 each pass scans 1/8 of the LRUs,
+ * i.e. reclaim has gone past a tenth of them and still falls short.
+ */
+#define VMPRESSURE_CRITICAL_PRIO	ilog2(100 / 10)
+
 /*
  * Statistics for memory cgroup.
  */
@@ -66,6 +85,7 @@ enum mem_cgroup_stat_index {
 	MEM_CGROUP_STAT_MAPPED_FILE,  /* # of pages charged as file rss */
 	MEM_CGROUP_STAT_PGPGIN_COUNT,	/* # of pages paged in */
 	MEM_CGROUP_STAT_PGPGOUT_COUNT,	/* # of pages paged out */
+	MEM_CGROUP_STAT_EVENTS,	/* sum of pagein + pageout for internal use */
 
 	MEM_CGROUP_STAT_NSTATS,
 };
@@ -129,6 +149,67 @@ struct mem_cgroup_lru_info {
 	struct mem_cgroup_per_node *nodeinfo[MAX_NUMNODES];
 };
 
+struct mem_cgroup_threshold {
+	struct eventfd_ctx *eventfd;
+	u64 threshold;
+};
+
+struct mem_cgroup_threshold_ary {
+	/* index of the highest threshold at or below the usage, or -1 */
+	atomic_t current_threshold;
+	/* size of entries[] */
+	unsigned int size;
+	/* thresholds, sorted ascending */
+	struct mem_cgroup_threshold entries[0];
+};
+
+struct mem_cgroup_thresholds {
+	/* primary thresholds array, RCU-protected */
+	struct mem_cgroup_threshold_ary *primary;
+	/*
+	 * Spare array, at least as large as the primary one minus an
+	 * entry, so that unregistering a threshold never has to allocate.
+	 */
+	struct mem_cgroup_threshold_ary *spare;
+};
+
+/*
+ * Reclaim pressure levels, from the share of scanned pages that reclaim
+ * could not free: at low, reclaim is dropping cold caches; at medium,
+ * it is swapping or evicting working set; at critical, it is barely
+ * making progress and the OOM killer is close.
+ */
+enum mem_cgroup_pressure_level {
+	MEMCG_PRESSURE_LOW,
+	MEMCG_PRESSURE_MEDIUM,
+	MEMCG_PRESSURE_CRITICAL,
+	MEMCG_PRESSURE_NR_LEVELS,
+};
+
+static const char *mem_cgroup_pressure_names[MEMCG_PRESSURE_NR_LEVELS] = {
+	[MEMCG_PRESSURE_LOW]		= "low",
+	[MEMCG_PRESSURE_MEDIUM]		= "medium",
+	[MEMCG_PRESSURE_CRITICAL]	= "critical",
+};
+
+struct mem_cgroup_pressure {
+	/* pages scanned and reclaimed in the current window */
+	unsigned long scanned;
+	unsigned long reclaimed;
+	spinlock_t sr_lock;
+	/* registered mem_cgroup_pressure_events */
+	struct list_head events;
+	struct mutex events_lock;
+	/* signals the listeners outside of the reclaim path */
+	struct work_struct work;
+};
+
+struct mem_cgroup_pressure_event {
+	struct eventfd_ctx *eventfd;
+	enum mem_cgroup_pressure_level level;
+	struct list_head node;
+};
+
 /*
  * The memory controller data structure. The memory controller controls both
  * page cache and RSS per cgroup. We would eventually like to provide
@@ -180,6 +261,21 @@ struct mem_cgroup {
 	/* set when res.limit == memsw.limit */
 	bool		memsw_is_minimum;
 
+	/* pages reclaimed through memory.reclaim */
+	atomic_long_t	proactive_reclaimed;
+
+	/* protect arrays of thresholds */
+	struct mutex thresholds_lock;
+
+	/* thresholds for memory usage */
+	struct mem_cgroup_thresholds thresholds;
+
+	/* thresholds for mem+swap usage */
+	struct mem_cgroup_thresholds memsw_thresholds;
+
+	/* reclaim pressure level notification */
+	struct mem_cgroup_pressure pressure;
+
 	/*
 	 * statistics. This must be placed at the end of memcg.
 	 */
@@ -218,6 +314,10 @@ pcg_default_flags[NR_CHARGE_TYPE] = {
 static void mem_cgroup_get(struct mem_cgroup *mem);
 static void mem_cgroup_put(struct mem_cgroup *mem);
 static struct mem_cgroup *parent_mem_cgroup(struct mem_cgroup *mem);
+static void memcg_check_events(struct mem_cgroup *mem);
+
+/* Global reclaim is accounted as pressure on the root cgroup */
+static struct mem_cgroup *root_mem_cgroup __read_mostly;
 
 static void mem_cgroup_charge_statistics(struct mem_cgroup *mem,
 					 struct page_cgroup *pc,
@@ -240,6 +340,7 @@ static void mem_cgroup_charge_statistics(struct mem_cgroup *mem,
 	else
 		__mem_cgroup_stat_add_safe(cpustat,
 				MEM_CGROUP_STAT_PGPGOUT_COUNT, 1);
+	__mem_cgroup_stat_add_safe(cpustat, MEM_CGROUP_STAT_EVENTS, 1);
 	put_cpu();
 }
 
@@ -1132,6 +1233,7 @@ static void __mem_cgroup_commit_charge(struct mem_cgroup *mem,
 	mem_cgroup_charge_statistics(mem, pc, true);
 
 	unlock_page_cgroup(pc);
+	memcg_check_events(mem);
 }
 
 /**
@@ -1554,6 +1656,8 @@ __mem_cgroup_uncharge_common(struct page *page, enum charge_type ctype)
 	mz = page_cgroup_zoneinfo(pc);
 	unlock_page_cgroup(pc);
 
+	memcg_check_events(mem);
+
 	/* at swapout, this memcg will be accessed to record to swap */
 	if (ctype != MEM_CGROUP_CHARGE_TYPE_SWAPOUT)
 		css_put(&mem->css);
@@ -2007,6 +2111,106 @@ int mem_cgroup_force_empty_write(struct cgroup *cont, unsigned int event)
 	return mem_cgroup_force_empty(mem_cgroup_from_cont(cont), true);
 }
 
+/*
+ * Reclaim the number of bytes written from the group, and its children if
+ * it uses hierarchy, without changing its limit.  The size may be followed
+ * by "swappiness=<0-200>" for this request only, or by "type=file", which
+ * does not swap, or "type=anon", which reclaims anon pages in preference.
+ * Succeeds once anything was reclaimed, even short of the size, and returns
+ * -EAGAIN if nothing could be.  The bytes this write reclaimed can be read
+ * back from the same open file.
+ */
+static ssize_t mem_cgroup_reclaim_write(struct cgroup *cont,
+					struct cftype *cft, struct file *file,
+					const char __user *userbuf,
+					size_t nbytes, loff_t *ppos)
+{
+	struct mem_cgroup *mem = mem_cgroup_from_cont(cont);
+	unsigned int swappiness = get_swappiness(mem);
+	unsigned long nr_to_reclaim, nr_reclaimed = 0;
+	int nr_retries;
+	bool noswap = false;
+	char buf[64], *opts, *opt, *end;
+	int ret = 0;
+
+	if (nbytes >= sizeof(buf))
+		return -E2BIG;
+	if (copy_from_user(buf, userbuf, nbytes))
+		return -EFAULT;
+	buf[nbytes] = 0;
+	opts = strstrip(buf);
+	nr_to_reclaim = memparse(opts, &end) >> PAGE_SHIFT;
+	if (end == opts || (*end && !isspace(*end)))
+		ret = -EINVAL;
+	opts = end;
+	while (!ret && (opt = strsep(&opts, " \t")) != NULL) {
+		unsigned long val;
+
+		if (!*opt)
+			continue;
+		if (!strncmp(opt, "swappiness=", 11)) {
+			if (strict_strtoul(opt + 11, 10, &val) || val > 200)
+				ret = -EINVAL;
+			swappiness = val;
+		} else if (!strcmp(opt, "type=file"))
+			noswap = true;
+		else if (!strcmp(opt, "type=anon"))
+			swappiness = 200;
+		else
+			ret = -EINVAL;
+	}
+	if (ret)
+		return ret;
+
+	/* If memsw_is_minimum==1, swap-out is of-no-use. */
+	if (mem->memsw_is_minimum)
+		noswap = true;
+
+	nr_retries = MEM_CGROUP_RECLAIM_RETRIES * mem_cgroup_count_children(mem);
+	lru_add_drain_all();
+	while (nr_reclaimed < nr_to_reclaim) {
+		struct mem_cgroup *victim;
+		unsigned long progress;
+
+		if (signal_pending(current)) {
+			ret = -EINTR;
+			break;
+		}
+		victim = mem_cgroup_select_victim(mem);
+		progress = try_to_free_mem_cgroup_pages(victim, GFP_KERNEL,
+							noswap, swappiness);
+		css_put(&victim->css);
+		nr_reclaimed += progress;
+		if (!progress) {
+			if (!--nr_retries)
+				break;
+			/* maybe some writeback is necessary */
+			congestion_wait(BLK_RW_ASYNC, HZ/10);
+		}
+		cond_resched();
+	}
+	atomic_long_add(nr_reclaimed, &mem->proactive_reclaimed);
+	file->private_data = (void *)nr_reclaimed;
+
+	if (nr_reclaimed)
+		return nbytes;
+	return ret ? ret : -EAGAIN;
+}
+
+/* The bytes reclaimed by the last write to this open file */
+static ssize_t mem_cgroup_reclaim_read(struct cgroup *cont,
+				       struct cftype *cft, struct file *file,
+				       char __user *userbuf,
+				       size_t nbytes, loff_t *ppos)
+{
+	unsigned long nr_reclaimed = (unsigned long)file->private_data;
+	char tmp[32];
+	int len;
+
+	len = sprintf(tmp, "%llu\n", (u64)nr_reclaimed << PAGE_SHIFT);
+	return simple_read_from_buffer(userbuf, nbytes, ppos, tmp, len);
+}
+
 
 static u64 mem_cgroup_hierarchy_read(struct cgroup *cont, struct cftype *cft)
 {
@@ -2247,6 +2451,9 @@ static int mem_control_stat_show(struct cgroup *cont, struct cftype *cft,
 		if (do_swap_account)
 			cb->fill(cb, "hierarchical_memsw_limit", memsw_limit);
 	}
+	cb->fill(cb, "proactive_reclaimed",
+		 (u64)atomic_long_read(&mem_cont->proactive_reclaimed) <<
+		 PAGE_SHIFT);
 
 	memset(&mystat, 0, sizeof(mystat));
 	mem_cgroup_get_total_stat(mem_cont, &mystat);
@@ -2325,12 +2532,458 @@ static int mem_cgroup_swappiness_write(struct cgroup *cgrp, struct cftype *cft,
 	return 0;
 }
 
+static u64 mem_cgroup_usage(struct mem_cgroup *mem, bool swap)
+{
+	if (!swap)
+		return res_counter_read_u64(&mem->res, RES_USAGE);
+	return res_counter_read_u64(&mem->memsw, RES_USAGE);
+}
+
+/*
+ * Usage thresholds are checked only every THRESHOLDS_EVENTS_THRESH page
+ * charges and uncharges on a cpu, to keep the charge path cheap.
+ */
+static bool mem_cgroup_threshold_check(struct mem_cgroup *mem)
+{
+	struct mem_cgroup_stat_cpu *cpustat;
+	bool ret = false;
+	int cpu;
+
+	cpu = get_cpu();
+	cpustat = &mem->stat.cpustat[cpu];
+	if (unlikely(cpustat->count[MEM_CGROUP_STAT_EVENTS] >
+		     THRESHOLDS_EVENTS_THRESH)) {
+		cpustat->count[MEM_CGROUP_STAT_EVENTS] = 0;
+		ret = true;
+	}
+	put_cpu();
+	return ret;
+}
+
+static void __mem_cgroup_threshold(struct mem_cgroup *memcg, bool swap)
+{
+	struct mem_cgroup_threshold_ary *t;
+	u64 usage;
+	int i;
+
+	rcu_read_lock();
+	if (!swap)
+		t = rcu_dereference(memcg->thresholds.primary);
+	else
+		t = rcu_dereference(memcg->memsw_thresholds.primary);
+
+	if (!t)
+		goto unlock;
+
+	usage = mem_cgroup_usage(memcg, swap);
+
+	/*
+	 * current_threshold points to the threshold just below usage.
+	 * If it's not true, a threshold was crossed after the last
+	 * call of __mem_cgroup_threshold().
+	 */
+	i = atomic_read(&t->current_threshold);
+
+	/*
+	 * Iterate backward over array of thresholds starting from
+	 * current_threshold and check if a threshold is crossed.
+	 * If none of thresholds below usage is crossed, we read
+	 * only one element of the array here.
+	 */
+	for (; i >= 0 && unlikely(t->entries[i].threshold > usage); i--)
+		eventfd_signal(t->entries[i].eventfd, 1);
+
+	/* i = current_threshold + 1 */
+	i++;
+
+	/*
+	 * Iterate forward over array of thresholds starting from
+	 * current_threshold+1 and check if a threshold is crossed.
+	 * If none of thresholds above usage is crossed, we read
+	 * only one element of the array here.
+	 */
+	for (; i < t->size && unlikely(t->entries[i].threshold <= usage); i++)
+		eventfd_signal(t->entries[i].eventfd, 1);
+
+	/* Update current_threshold */
+	atomic_set(&t->current_threshold, i - 1);
+unlock:
+	rcu_read_unlock();
+}
+
+/* A charge in a hierarchy moves the usage of all the ancestors too */
+static void mem_cgroup_threshold(struct mem_cgroup *memcg)
+{
+	while (memcg) {
+		__mem_cgroup_threshold(memcg, false);
+		if (do_swap_account)
+			__mem_cgroup_threshold(memcg, true);
+		memcg = parent_mem_cgroup(memcg);
+	}
+}
+
+static void memcg_check_events(struct mem_cgroup *mem)
+{
+	if (unlikely(mem_cgroup_threshold_check(mem)))
+		mem_cgroup_threshold(mem);
+}
+
+static int compare_thresholds(const void *a, const void *b)
+{
+	const struct mem_cgroup_threshold *_a = a;
+	const struct mem_cgroup_threshold *_b = b;
+
+	if (_a->threshold > _b->threshold)
+		return 1;
+	if (_a->threshold < _b->threshold)
+		return -1;
+	return 0;
+}
+
+/*
+ * Publish @new as the primary array of thresholds and keep the old one
+ * as the spare: thresholds_lock held.
+ */
+static void mem_cgroup_replace_thresholds(struct mem_cgroup_thresholds *t,
+					  struct mem_cgroup_threshold_ary *new)
+{
+	t->spare = t->primary;
+	rcu_assign_pointer(t->primary, new);
+
+	/* To be sure that nobody uses the spare before it gets reused */
+	synchronize_rcu();
+}
+
+static int mem_cgroup_usage_register_event(struct cgroup *cgrp,
+		struct cftype *cft, struct eventfd_ctx *eventfd,
+		const char *args)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+	struct mem_cgroup_threshold_ary *thresholds, *thresholds_new;
+	struct mem_cgroup_thresholds *t;
+	int type = MEMFILE_TYPE(cft->private);
+	u64 threshold, usage;
+	int size;
+	int i, ret;
+
+	ret = res_counter_memparse_write_strategy(args, &threshold);
+	if (ret)
+		return ret;
+
+	mutex_lock(&memcg->thresholds_lock);
+	if (type == _MEM)
+		t = &memcg->thresholds;
+	else
+		t = &memcg->memsw_thresholds;
+	thresholds = t->primary;
+
+	usage = mem_cgroup_usage(memcg, type == _MEMSWAP);
+
+	/* Check if a threshold crossed before adding a new one */
+	if (thresholds)
+		__mem_cgroup_threshold(memcg, type == _MEMSWAP);
+
+	size = thresholds ? thresholds->size + 1 : 1;
+
+	thresholds_new = kmalloc(sizeof(*thresholds_new) +
+			size * sizeof(struct mem_cgroup_threshold),
+			GFP_KERNEL);
+	if (!thresholds_new) {
+		ret = -ENOMEM;
+		goto unlock;
+	}
+	thresholds_new->size = size;
+
+	if (thresholds)
+		memcpy(thresholds_new->entries, thresholds->entries,
+				thresholds->size *
+				sizeof(struct mem_cgroup_threshold));
+	thresholds_new->entries[size - 1].eventfd = eventfd;
+	thresholds_new->entries[size - 1].threshold = threshold;
+
+	/* Sort thresholds. Registering of new threshold isn't time-critical */
+	sort(thresholds_new->entries, size,
+			sizeof(struct mem_cgroup_threshold),
+			compare_thresholds, NULL);
+
+	/* Find the highest threshold at or below the current usage */
+	atomic_set(&thresholds_new->current_threshold, -1);
+	for (i = 0; i < size; i++) {
+		if (thresholds_new->entries[i].threshold <= usage)
+			atomic_set(&thresholds_new->current_threshold, i);
+	}
+
+	/* The old spare is too small from now on, the old primary is not */
+	kfree(t->spare);
+	mem_cgroup_replace_thresholds(t, thresholds_new);
+unlock:
+	mutex_unlock(&memcg->thresholds_lock);
+
+	return ret;
+}
+
+static void mem_cgroup_usage_unregister_event(struct cgroup *cgrp,
+		struct cftype *cft, struct eventfd_ctx *eventfd)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_cont(cgrp);
+	struct mem_cgroup_threshold_ary *thresholds, *thresholds_new;
+	struct mem_cgroup_thresholds *t;
+	int type = MEMFILE_TYPE(cft->private);
+	u64 usage;
+	int size = 0;
+	int i, j;
+
+	mutex_lock(&memcg->thresholds_lock);
+	if (type == _MEM)
+		t = &memcg->thresholds;
+	else
+		t = &memcg->memsw_thresholds;
+	thresholds = t->primary;
+
+	/*
+	 * Something went wrong if we trying to unregister a threshold
+	 * if we don't have thresholds
+	 */
+	BUG_ON(!thresholds);
+
+	usage = mem_cgroup_usage(memcg, type == _MEMSWAP);
+
+	/* Check if a threshold crossed before removing */
+	__mem_cgroup_threshold(memcg, type == _MEMSWAP);
+
+	/* Calculate new number of threshold */
+	for (i = 0; i < thresholds->size; i++) {
+		if (thresholds->entries[i].eventfd != eventfd)
+			size++;
+	}
+
+	/* Set thresholds array to NULL if we don't have thresholds */
+	if (!size) {
+		kfree(t->spare);
+		t->spare = NULL;
+		thresholds_new = NULL;
+		goto assign;
+	}
+
+	/* The spare is large enough: this must not fail */
+	thresholds_new = t->spare;
+	BUG_ON(!thresholds_new);
+	thresholds_new->size = size;
+
+	/* Copy thresholds and find current threshold */
+	atomic_set(&thresholds_new->current_threshold, -1);
+	for (i = 0, j = 0; i < thresholds->size; i++) {
+		if (thresholds->entries[i].eventfd == eventfd)
+			continue;
+
+		thresholds_new->entries[j] = thresholds->entries[i];
+		if (thresholds_new->entries[j].threshold <= usage)
+			atomic_set(&thresholds_new->current_threshold, j);
+		j++;
+	}
+
+assign:
+	mem_cgroup_replace_thresholds(t, thresholds_new);
+	mutex_unlock(&memcg->thresholds_lock);
+}
+
+static enum mem_cgroup_pressure_level
+mem_cgroup_pressure_calc_level(unsigned long scanned, unsigned long reclaimed)
+{
+	unsigned long pressure;
+
+	/*
+	 * Reclaimed can exceed scanned: pages freed by writeback completing
+	 * meanwhile are counted too.  That is no pressure at all.
+	 */
+	if (reclaimed >= scanned)
+		return MEMCG_PRESSURE_LOW;
+
+	pressure = 100 - reclaimed * 100 / scanned;
+	if (pressure >= VMPRESSURE_LEVEL_CRITICAL)
+		return MEMCG_PRESSURE_CRITICAL;
+	if (pressure >= VMPRESSURE_LEVEL_MED)
+		return MEMCG_PRESSURE_MEDIUM;
+	return MEMCG_PRESSURE_LOW;
+}
+
+/* Signal the listeners of @memcg for @level; returns true if there were any */
+static bool mem_cgroup_pressure_event(struct mem_cgroup *memcg,
+				      enum mem_cgroup_pressure_level level)
+{
+	struct mem_cgroup_pressure *vmpr = &memcg->pressure;
+	struct mem_cgroup_pressure_event *ev;
+	bool signalled = false;
+
+	mutex_lock(&vmpr->events_lock);
+	list_for_each_entry(ev, &vmpr->events, node) {
+		if (level >= ev->level) {
+			eventfd_signal(ev->eventfd, 1);
+			signalled = true;
+		}
+	}
+	mutex_unlock(&vmpr->events_lock);
+
+	return signalled;
+}
+
+static void mem_cgroup_pressure_work_fn(struct work_struct *work)
+{
+	struct mem_cgroup_pressure *vmpr = container_of(work,
+			struct mem_cgroup_pressure, work);
+	struct mem_cgroup *memcg = container_of(vmpr,
+			struct mem_cgroup, pressure);
+	enum mem_cgroup_pressure_level level;
+	unsigned long scanned, reclaimed;
+
+	spin_lock(&vmpr->sr_lock);
+	scanned = vmpr->scanned;
+	reclaimed = vmpr->reclaimed;
+	vmpr->scanned = 0;
+	vmpr->reclaimed = 0;
+	spin_unlock(&vmpr->sr_lock);
+
+	if (!scanned)
+		return;
+
+	level = mem_cgroup_pressure_calc_level(scanned, reclaimed);
+
+	/*
+	 * With use_hierarchy, pressure in a group is pressure on its
+	 * ancestors as well: signal the closest group with listeners.
+	 */
+	do {
+		if (mem_cgroup_pressure_event(memcg, level))
+			break;
+		memcg = parent_mem_cgroup(memcg);
+	} while (memcg);
+}
+
+/**
+ * mem_cgroup_vmpressure - account reclaim efficiency for pressure levels
+ * @gfp_mask: the gfp mask of the allocation reclaiming
+ * @memcg: the cgroup reclaimed from, or NULL for global reclaim
+ * @scanned: pages scanned
+ * @reclaimed: pages reclaimed of those
+ *
+ * Called from the page reclaim path.  Once a window of VMPRESSURE_WIN
+ * scanned pages has accumulated, the pressure level is computed and the
+ * listeners signalled from a workqueue.
+ */
+void mem_cgroup_vmpressure(gfp_t gfp_mask, struct mem_cgroup *memcg,
+			   unsigned long scanned, unsigned long reclaimed)
+{
+	struct mem_cgroup_pressure *vmpr;
+
+	if (mem_cgroup_disabled())
+		return;
+
+	/*
+	 * Only reclaim for allocations that can use any freed page tells
+	 * how tight memory is; a failing GFP_NOIO atomic allocation just
+	 * says that the clean page cache of the zone is used up.
+	 */
+	if (!(gfp_mask & (__GFP_HIGHMEM | __GFP_MOVABLE | __GFP_IO | __GFP_FS)))
+		return;
+
+	if (!scanned)
+		return;
+
+	if (!memcg)
+		memcg = root_mem_cgroup;
+	if (!memcg)
+		return;
+
+	vmpr = &memcg->pressure;
+	spin_lock(&vmpr->sr_lock);
+	vmpr->scanned += scanned;
+	vmpr->reclaimed += reclaimed;
+	scanned = vmpr->scanned;
+	spin_unlock(&vmpr->sr_lock);
+
+	if (scanned < VMPRESSURE_WIN)
+		return;
+	schedule_work(&vmpr->work);
+}
+
+/**
+ * mem_cgroup_vmpressure_prio - account reclaim priority for pressure levels
+ * @gfp_mask: the gfp mask of the allocation reclaiming
+ * @memcg: the cgroup reclaimed from, or NULL for global reclaim
+ * @prio: the reclaim priority about to be scanned at
+ *
+ * Reclaim having to go this deep means memory is nearly gone whatever
+ * the efficiency so far: report a full window of unreclaimable pages.
+ */
+void mem_cgroup_vmpressure_prio(gfp_t gfp_mask, struct mem_cgroup *memcg,
+				int prio)
+{
+	if (prio > VMPRESSURE_CRITICAL_PRIO)
+		return;
+
+	mem_cgroup_vmpressure(gfp_mask, memcg, VMPRESSURE_WIN, 0);
+}
+
+static int mem_cgroup_pressure_register_event(struct cgroup *cgrp,
+		struct cftype *cft, struct eventfd_ctx *eventfd,
+		const char *args)
+{
+	struct mem_cgroup_pressure *vmpr = &mem_cgroup_from_cont(cgrp)->pressure;
+	struct mem_cgroup_pressure_event *ev;
+	int level;
+
+	for (level = 0; level < MEMCG_PRESSURE_NR_LEVELS; level++) {
+		if (!strcmp(args, mem_cgroup_pressure_names[level]))
+			break;
+	}
+	if (level == MEMCG_PRESSURE_NR_LEVELS)
+		return -EINVAL;
+
+	ev = kzalloc(sizeof(*ev), GFP_KERNEL);
+	if (!ev)
+		return -ENOMEM;
+	ev->eventfd = eventfd;
+	ev->level = level;
+
+	mutex_lock(&vmpr->events_lock);
+	list_add(&ev->node, &vmpr->events);
+	mutex_unlock(&vmpr->events_lock);
+
+	return 0;
+}
+
+static void mem_cgroup_pressure_unregister_event(struct cgroup *cgrp,
+		struct cftype *cft, struct eventfd_ctx *eventfd)
+{
+	struct mem_cgroup_pressure *vmpr = &mem_cgroup_from_cont(cgrp)->pressure;
+	struct mem_cgroup_pressure_event *ev;
+
+	mutex_lock(&vmpr->events_lock);
+	list_for_each_entry(ev, &vmpr->events, node) {
+		if (ev->eventfd != eventfd)
+			continue;
+		list_del(&ev->node);
+		kfree(ev);
+		break;
+	}
+	mutex_unlock(&vmpr->events_lock);
+}
+
+static void mem_cgroup_pressure_init(struct mem_cgroup_pressure *vmpr)
+{
+	spin_lock_init(&vmpr->sr_lock);
+	INIT_LIST_HEAD(&vmpr->events);
+	mutex_init(&vmpr->events_lock);
+	INIT_WORK(&vmpr->work, mem_cgroup_pressure_work_fn);
+}
 
 static struct cftype mem_cgroup_files[] = {
 	{
 		.name = "usage_in_bytes",
 		.private = MEMFILE_PRIVATE(_MEM, RES_USAGE),
 		.read_u64 = mem_cgroup_read,
+		.register_event = mem_cgroup_usage_register_event,
+		.unregister_event = mem_cgroup_usage_unregister_event,
 	},
 	{
 		.name = "max_usage_in_bytes",
@@ -2358,6 +3011,12 @@ static struct cftype mem_cgroup_files[] = {
 		.name = "force_empty",
 		.trigger = mem_cgroup_force_empty_write,
 	},
+	{
+		.name = "reclaim",
+		.write = mem_cgroup_reclaim_write,
+		.read = mem_cgroup_reclaim_read,
+		.mode = S_IRUSR | S_IWUSR,
+	},
 	{
 		.name = "use_hierarchy",
 		.write_u64 = mem_cgroup_hierarchy_write,
@@ -2368,6 +3027,12 @@ static struct cftype mem_cgroup_files[] = {
 		.read_u64 = mem_cgroup_swappiness_read,
 		.write_u64 = mem_cgroup_swappiness_write,
 	},
+	{
+		.name = "pressure_level",
+		.register_event = mem_cgroup_pressure_register_event,
+		.unregister_event = mem_cgroup_pressure_unregister_event,
+		.mode = S_IRUGO,
+	},
 };
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
@@ -2376,6 +3041,8 @@ static struct cftype memsw_cgroup_files[] = {
 		.name = "memsw.usage_in_bytes",
 		.private = MEMFILE_PRIVATE(_MEMSWAP, RES_USAGE),
 		.read_u64 = mem_cgroup_read,
+		.register_event = mem_cgroup_usage_register_event,
+		.unregister_event = mem_cgroup_usage_unregister_event,
 	},
 	{
 		.name = "memsw.max_usage_in_bytes",
@@ -2485,6 +3152,10 @@ static void __mem_cgroup_free(struct mem_cgroup *mem)
 
 	free_css_id(&mem_cgroup_subsys, &mem->css);
 
+	/* all thresholds are unregistered by now, but for the spares */
+	kfree(mem->thresholds.spare);
+	kfree(mem->memsw_thresholds.spare);
+
 	for_each_node_state(node, N_POSSIBLE)
 		free_mem_cgroup_per_zone_info(mem, node);
 
@@ -2549,6 +3220,7 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	if (cont->parent == NULL) {
 		enable_swap_cgroup();
 		parent = NULL;
+		root_mem_cgroup = mem;
 	} else {
 		parent = mem_cgroup_from_cont(cont->parent);
 		mem->use_hierarchy = parent->use_hierarchy;
@@ -2570,6 +3242,8 @@ mem_cgroup_create(struct cgroup_subsys *ss, struct cgroup *cont)
 	}
 	mem->last_scanned_child = 0;
 	spin_lock_init(&mem->reclaim_param_lock);
+	mutex_init(&mem->thresholds_lock);
+	mem_cgroup_pressure_init(&mem->pressure);
 
 	if (parent)
 		mem->swappiness = get_swappiness(parent);
@@ -2593,6 +3267,8 @@ static void mem_cgroup_destroy(struct cgroup_subsys *ss,
 {
 	struct mem_cgroup *mem = mem_cgroup_from_cont(cont);
 
+	/* the group is empty now, so reclaim cannot queue the work again */
+	cancel_work_sync(&mem->pressure.work);
 	mem_cgroup_put(mem);
 }
 
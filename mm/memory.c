@@ -135,10 +135,60 @@ void pmd_clear_bad(pmd_t *pmd)
  * Note: this doesn't free the actual pages themselves. That
  * has been handled earlier when unmapping all the memory regions.
  */
+#ifdef CONFIG_PTE_SHARING
+/*
+ * Drop this mm's use of a shared pte table, leaving its ptes to the
+ * others.  Returns 0 if it turns out not to be shared any more.
+ */
+static int drop_shared_pte_table(struct mmu_gather *tlb, pmd_t *pmd,
+				 unsigned long addr)
+{
+	struct mm_struct *mm = tlb->mm;
+	struct page *table = pmd_page(*pmd);
+	spinlock_t *ptl;
+	pte_t *pte;
+	int rss = 0;
+	int i;
+
+	pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
+	if (!pte_table_shared(table)) {
+		pte_unmap_unlock(pte, ptl);
+		return 0;
+	}
+	/* Only fork charges an mm with the pages of a table it shares */
+	if (pmd_cow_shared(*pmd)) {
+		pte -= pte_index(addr);
+		for (i = 0; i < PTRS_PER_PTE; i++)
+			if (pte_present(pte[i]))
+				rss++;
+	}
+	atomic_dec(&table->_mapcount);
+	pmd_clear(pmd);
+	pte_unmap_unlock(pte, ptl);
+
+	mm->nr_ptes--;
+	add_mm_counter(mm, anon_rss, -rss);
+	/* The others may free it as soon as this mm's TLBs are flushed */
+	tlb_remove_page(tlb, table);
+	return 1;
+}
+#else
+static inline int drop_shared_pte_table(struct mmu_gather *tlb, pmd_t *pmd,
+					unsigned long addr)
+{
+	return 0;
+}
+#endif
+
 static void free_pte_range(struct mmu_gather *tlb, pmd_t *pmd,
 			   unsigned long addr)
 {
 	pgtable_t token = pmd_pgtable(*pmd);
+
+	/* Another mm may have taken up the table since it was zapped */
+	if (pte_table_shared(pmd_page(*pmd)) &&
+	    drop_shared_pte_table(tlb, pmd, addr))
+		return;
 	pmd_clear(pmd);
 	pte_free_tlb(tlb, token, addr);
 	tlb->mm->nr_ptes--;
@@ -653,6 +703,495 @@ again:
 	return 0;
 }
 
+/*
+ * Mappings of the same part of a file can share the page tables mapping
+ * it: hugetlb shares the pmd pages of PUD_SIZE aligned mappings, and with
+ * CONFIG_PTE_SHARING the pte tables of PMD_SIZE aligned ones.
+ */
+
+/* Does vma map all of the size aligned range around addr, shared? */
+int vma_table_shareable(struct vm_area_struct *vma, unsigned long addr,
+			unsigned long size)
+{
+	unsigned long base = addr & ~(size - 1);
+
+	return (vma->vm_flags & VM_MAYSHARE) &&
+		vma->vm_start <= base && base + size <= vma->vm_end;
+}
+
+/**
+ * page_table_shareable - can vma share a page table of svma
+ * @svma: the vma which may have the page table
+ * @vma: the vma which wants it
+ * @addr: the address in vma
+ * @idx: the page offset in the file at @addr
+ * @size: the range the page table maps
+ *
+ * Returns the address in svma which the page table maps along with @idx,
+ * or 0 if the vmas differ in permissions or in alignment, or if svma does
+ * not map all of the range.
+ */
+unsigned long page_table_shareable(struct vm_area_struct *svma,
+				   struct vm_area_struct *vma,
+				   unsigned long addr, pgoff_t idx,
+				   unsigned long size)
+{
+	unsigned long saddr = ((idx - svma->vm_pgoff) << PAGE_SHIFT) +
+				svma->vm_start;
+	unsigned long sbase = saddr & ~(size - 1);
+	unsigned long s_end = sbase + size;
+
+	/* Allow segments to share if only one is marked locked */
+	unsigned long vm_flags = vma->vm_flags & ~VM_LOCKED;
+	unsigned long svm_flags = svma->vm_flags & ~VM_LOCKED;
+
+	/*
+	 * match the virtual addresses, permission and the alignment of the
+	 * page table page.
+	 */
+	if (((addr ^ saddr) & (size - 1) & PAGE_MASK) ||
+	    vm_flags != svm_flags ||
+	    sbase < svma->vm_start || svma->vm_end < s_end)
+		return 0;
+
+	return saddr;
+}
+
+#ifdef CONFIG_PTE_SHARING
+int sysctl_fork_share_pte __read_mostly;
+
+/*
+ * Only whole pte tables of private anonymous memory are shared, so that
+ * nothing but faults, reclaim and the unmapping of the whole table is
+ * left to go through a shared table.  The pte lock must be in the table
+ * itself, for all the mms sharing it.
+ */
+static inline int can_share_pte_table(struct vm_area_struct *vma,
+				      unsigned long addr, unsigned long end)
+{
+	if (!sysctl_fork_share_pte || !USE_SPLIT_PTLOCKS)
+		return 0;
+	if (vma->vm_file || !vma->anon_vma ||
+	    (vma->vm_flags & (VM_SHARED | VM_HUGETLB | VM_NONLINEAR |
+			      VM_PFNMAP | VM_MIXEDMAP | VM_INSERTPAGE)))
+		return 0;
+	return !(addr & ~PMD_MASK) && end - addr == PMD_SIZE;
+}
+
+/*
+ * Rather than copy the ptes to the child, map the parent's pte table
+ * read-only in both: the first fault on it in either copies it, see
+ * unshare_pte_table().  The pages it maps are not referenced again,
+ * only the table is: the child's rss counts them for now, but is not
+ * exact while the table is shared.
+ */
+static void share_pte_table(struct mm_struct *dst_mm, struct mm_struct *src_mm,
+			    pmd_t *dst_pmd, pmd_t *src_pmd, unsigned long addr)
+{
+	struct page *table = pmd_page(*src_pmd);
+	spinlock_t *ptl;
+	pte_t *pte;
+	int rss = 0, swap = 0;
+	int i;
+
+	pte = pte_offset_map_lock(src_mm, src_pmd, addr, &ptl);
+	for (i = 0; i < PTRS_PER_PTE; i++) {
+		if (pte_present(pte[i]))
+			rss++;
+		else if (!pte_none(pte[i]) && !pte_file(pte[i]))
+			swap++;
+	}
+	get_page(table);
+	atomic_inc(&table->_mapcount);
+	set_pmd(src_pmd, pmd_wrprotect(*src_pmd));
+	pmd_populate(dst_mm, dst_pmd, table);
+	set_pmd(dst_pmd, pmd_wrprotect(*dst_pmd));
+	pte_unmap_unlock(pte, ptl);
+
+	dst_mm->nr_ptes++;
+	add_mm_rss(dst_mm, 0, rss);
+	/* make sure dst_mm is on swapoff's mmlist. */
+	if (swap && unlikely(list_empty(&dst_mm->mmlist))) {
+		spin_lock(&mmlist_lock);
+		if (list_empty(&dst_mm->mmlist))
+			list_add(&dst_mm->mmlist, &src_mm->mmlist);
+		spin_unlock(&mmlist_lock);
+	}
+}
+
+/**
+ * unshare_pte_table - give the vma's mm its own copy of a shared pte table
+ * @vma: the vma covering the table
+ * @pmd: the mm's pmd mapping the table read-only
+ * @address: an address the table maps
+ *
+ * Copies the ptes as fork would have, and leaves the shared table to the
+ * other mms.  If they have all unshared it already, just takes it back.
+ * Returns 0, or -ENOMEM.
+ */
+int unshare_pte_table(struct vm_area_struct *vma, pmd_t *pmd,
+		      unsigned long address)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long start = address & PMD_MASK;
+	unsigned long addr = start;
+	pmd_t orig = *pmd;
+	struct page *table;
+	pte_t *old_pte, *new_pte;
+	spinlock_t *ptl;
+	pgtable_t new;
+	int rss[2];
+	int i;
+
+	new = pte_alloc_one(mm, start);
+	if (!new)
+		return -ENOMEM;
+
+	spin_lock(&mm->page_table_lock);
+	/* Has another thread of this mm unshared it already? */
+	if (unlikely(pmd_val(*pmd) != pmd_val(orig)))
+		goto out_unlock;
+	table = pmd_page(orig);
+	ptl = pte_lockptr(mm, pmd);
+	spin_lock(ptl);
+	if (!pte_table_shared(table)) {
+		if (pmd_cow_shared(orig))
+			set_pmd(pmd, pmd_mkwrite(orig));
+		spin_unlock(ptl);
+		goto out_unlock;
+	}
+
+	/*
+	 * The rss is already counted by fork, but not for the pages of a
+	 * file table, which are this mm's alone again in the copy.
+	 */
+	rss[1] = rss[0] = 0;
+	old_pte = pte_offset_map(pmd, start);
+	new_pte = kmap_atomic(new, KM_PTE1);
+	for (i = 0; i < PTRS_PER_PTE; i++, addr += PAGE_SIZE) {
+		if (pte_none(old_pte[i]))
+			continue;
+		copy_one_pte(mm, mm, new_pte + i, old_pte + i, vma, addr, rss);
+	}
+	kunmap_atomic(new_pte, KM_PTE1);
+	pte_unmap(old_pte);
+
+	smp_wmb(); /* See comment in __pte_alloc */
+	pmd_populate(mm, pmd, new);
+	atomic_dec(&table->_mapcount);
+	if (pte_table_uncounted(table))
+		add_mm_rss(mm, rss[0], rss[1]);
+	spin_unlock(ptl);
+	spin_unlock(&mm->page_table_lock);
+
+	flush_tlb_range(vma, start, start + PMD_SIZE);
+	put_page(table);
+	return 0;
+
+out_unlock:
+	spin_unlock(&mm->page_table_lock);
+	pte_free(mm, new);
+	return 0;
+}
+
+/* The pmd in mm for address, if there is one */
+static pmd_t *mm_find_pmd(struct mm_struct *mm, unsigned long address)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+
+	pgd = pgd_offset(mm, address);
+	if (!pgd_present(*pgd))
+		return NULL;
+	pud = pud_offset(pgd, address);
+	if (!pud_present(*pud))
+		return NULL;
+	return pmd_offset(pud, address);
+}
+
+/**
+ * unshare_pte_range - copy the shared pte tables mapping part of a vma
+ * @vma: the vma
+ * @start: start of the range
+ * @end: end of the range
+ *
+ * To be called, with mmap_sem held for writing, before the ptes of the
+ * range are changed other than by a fault: mprotect, mremap.  Holding it
+ * also keeps other mms from taking up a table, see share_file_pte_table().
+ * Returns 0, or -ENOMEM.
+ */
+int unshare_pte_range(struct vm_area_struct *vma, unsigned long start,
+		      unsigned long end)
+{
+	unsigned long addr;
+	pmd_t *pmd;
+
+	for (addr = start & PMD_MASK; addr < end; addr += PMD_SIZE) {
+		pmd = mm_find_pmd(vma->vm_mm, addr);
+		if (!pmd || !pmd_present(*pmd) || pmd_trans_huge(*pmd))
+			continue;
+		if (!pmd_cow_shared(*pmd) && !pte_table_shared(pmd_page(*pmd)))
+			continue;
+		if (unshare_pte_table(vma, pmd, addr))
+			return -ENOMEM;
+	}
+	return 0;
+}
+
+/**
+ * unshare_pte_boundary - copy a shared pte table a vma is split in
+ * @vma: the vma
+ * @address: where it is split, or partly unmapped
+ *
+ * A shared pte table is only ever unmapped as a whole: the table across
+ * a boundary within a pmd is copied first.  Returns 0, or -ENOMEM.
+ */
+int unshare_pte_boundary(struct vm_area_struct *vma, unsigned long address)
+{
+	if (!(address & ~PMD_MASK))
+		return 0;
+	return unshare_pte_range(vma, address, address + 1);
+}
+
+/*
+ * Call @fn on the vmas of the other mms that map pte table @table, which
+ * @vma maps at @start, with the address the range [@start, @end) of the
+ * table is at in each.  Fork shares a table with the vmas on the same
+ * anon_vma, at the same address, and faults share one with the vmas on
+ * the same part of the file: the caller holds the anon_vma lock or the
+ * i_mmap_lock, which keeps their page tables from being freed.
+ */
+static void pte_table_sharers(struct vm_area_struct *vma, struct page *table,
+			      unsigned long start, unsigned long end,
+			      void (*fn)(struct vm_area_struct *svma,
+					 unsigned long saddr,
+					 unsigned long size))
+{
+	struct mm_struct *mm = vma->vm_mm;
+	struct vm_area_struct *svma;
+	unsigned long saddr;
+	pmd_t *spmd;
+
+	if (vma->vm_file) {
+		struct address_space *mapping = vma->vm_file->f_mapping;
+		pgoff_t idx = linear_page_index(vma, start);
+		struct prio_tree_iter iter;
+
+		vma_prio_tree_foreach(svma, &iter, &mapping->i_mmap, idx, idx) {
+			if (svma->vm_mm == mm)
+				continue;
+			saddr = svma->vm_start +
+				((idx - svma->vm_pgoff) << PAGE_SHIFT);
+			spmd = mm_find_pmd(svma->vm_mm, saddr);
+			if (spmd && pmd_present(*spmd) &&
+			    !pmd_trans_huge(*spmd) && pmd_page(*spmd) == table)
+				fn(svma, saddr, end - start);
+		}
+	} else if (vma->anon_vma) {
+		list_for_each_entry(svma, &vma->anon_vma->head, anon_vma_node) {
+			if (svma->vm_mm == mm || start < svma->vm_start ||
+			    end > svma->vm_end)
+				continue;
+			spmd = mm_find_pmd(svma->vm_mm, start);
+			if (spmd && pmd_present(*spmd) &&
+			    !pmd_trans_huge(*spmd) && pmd_page(*spmd) == table)
+				fn(svma, start, end - start);
+		}
+	}
+}
+
+static void sharer_flush_page(struct vm_area_struct *svma,
+			      unsigned long saddr, unsigned long size)
+{
+	flush_tlb_page(svma, saddr);
+	mmu_notifier_invalidate_page(svma->vm_mm, saddr);
+}
+
+/**
+ * flush_shared_pte - flush a pte of a shared table from the other mms
+ * @vma: the vma the pte was cleared or write-protected through
+ * @pte: the pte, in a shared table
+ * @address: its address in @vma
+ *
+ * ptep_clear_flush_notify() only flushes the TLBs and the secondary MMUs
+ * of @vma's mm: this does it for the other mms sharing the table, and
+ * only for them.  Called from rmap with the pte lock and the rmap lock
+ * held.
+ */
+void flush_shared_pte(struct vm_area_struct *vma, pte_t *pte,
+		      unsigned long address)
+{
+	pte_table_sharers(vma, virt_to_page(pte), address, address + PAGE_SIZE,
+			  sharer_flush_page);
+}
+
+static void sharer_invalidate_start(struct vm_area_struct *svma,
+				    unsigned long saddr, unsigned long size)
+{
+	mmu_notifier_invalidate_range_start(svma->vm_mm, saddr, saddr + size);
+}
+
+static void sharer_invalidate_end(struct vm_area_struct *svma,
+				  unsigned long saddr, unsigned long size)
+{
+	flush_tlb_range(svma, saddr, saddr + size);
+	mmu_notifier_invalidate_range_end(svma->vm_mm, saddr, saddr + size);
+}
+
+/*
+ * Can the fault at address use a pte table of another mm mapping the same
+ * part of the file, rather than a new one?  Then the ptes are filled in by
+ * the first fault in any of the mms, as for hugetlb, see huge_pmd_share().
+ *
+ * Only the page cache of regular files and shared memory gives the same
+ * page for a file offset whoever faults: a device's or an anon inode's
+ * ->fault may depend on the open file.
+ */
+static inline int can_share_file_pte_table(struct vm_area_struct *vma,
+					   unsigned long address)
+{
+	struct address_space *mapping;
+
+	if (!USE_SPLIT_PTLOCKS || !vma->vm_file || vma->anon_vma ||
+	    (vma->vm_flags & (VM_HUGETLB | VM_NONLINEAR | VM_PFNMAP |
+			      VM_MIXEDMAP | VM_INSERTPAGE)))
+		return 0;
+	mapping = vma->vm_file->f_mapping;
+	if (!S_ISREG(mapping->host->i_mode) || !vma->vm_ops ||
+	    (vma->vm_ops->fault != filemap_fault && !shmem_mapping(mapping)))
+		return 0;
+	return vma_table_shareable(vma, address, PMD_SIZE);
+}
+
+/*
+ * The first time another mm takes up a file table, stop counting the
+ * pages it maps in the rss of the mm that faulted them in: see
+ * pte_table_uncounted().  Called with the table's lock held.
+ */
+static void uncount_pte_table(struct mm_struct *mm, pmd_t *pmd,
+			      unsigned long addr, struct page *table)
+{
+	pte_t *pte;
+	int rss = 0;
+	int i;
+
+	pte = pte_offset_map(pmd, addr & PMD_MASK);
+	for (i = 0; i < PTRS_PER_PTE; i++)
+		if (pte_present(pte[i]))
+			rss++;
+	pte_unmap(pte);
+
+	add_mm_counter(mm, file_rss, -rss);
+	set_pte_table_uncounted(table);
+}
+
+/*
+ * The mm of the vma sharing a table is only read-locked here, so as not
+ * to take up a table it is changing the ptes of, or unmapping part of:
+ * unshare_pte_range() and unshare_pte_boundary() are then called with it
+ * write-locked.  Its vma's page tables are only freed after the vma is
+ * unlinked from i_mmap, but the table may be dropped from its pmd, and
+ * freed by the others, until a reference is held on it.
+ *
+ * exit_mmap() zaps the ptes without mmap_sem, so an mm that is exiting
+ * is left alone; zap_pte_range() still checks under the pte lock that
+ * the table did not get shared meanwhile.
+ *
+ * A pte table shared this way is mapped writable.  The pages it maps are
+ * counted in no mm's rss from then on.
+ */
+static void share_file_pte_table(struct vm_area_struct *vma, pmd_t *pmd,
+				 unsigned long address)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	struct address_space *mapping = vma->vm_file->f_mapping;
+	unsigned long base = address & PMD_MASK;
+	pgoff_t idx = ((base - vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
+	struct prio_tree_iter iter;
+	struct vm_area_struct *svma;
+	int shared = 0;
+
+	spin_lock(&mapping->i_mmap_lock);
+	vma_prio_tree_foreach(svma, &iter, &mapping->i_mmap, idx, idx) {
+		struct page *table;
+		unsigned long saddr;
+		spinlock_t *ptl;
+		pmd_t *spmd, orig;
+
+		if (svma->vm_mm == mm)
+			continue;
+		if (svma->anon_vma)
+			continue;
+		saddr = page_table_shareable(svma, vma, base, idx, PMD_SIZE);
+		if (!saddr || !down_read_trylock(&svma->vm_mm->mmap_sem))
+			continue;
+		if (!atomic_read(&svma->vm_mm->mm_users))
+			goto next;
+		spmd = mm_find_pmd(svma->vm_mm, saddr);
+		if (!spmd)
+			goto next;
+		orig = *spmd;
+		if (!pmd_present(orig) || pmd_trans_huge(orig) ||
+		    pmd_cow_shared(orig))
+			goto next;
+		table = pmd_page(orig);
+		if (!get_page_unless_zero(table))
+			goto next;
+		if (pmd_val(*spmd) != pmd_val(orig))
+			goto put;
+
+		ptl = pte_lockptr(svma->vm_mm, spmd);
+		spin_lock(&mm->page_table_lock);
+		if (pmd_none(*pmd)) {
+			spin_lock(ptl);
+			if (pmd_val(*spmd) == pmd_val(orig)) {
+				if (!pte_table_uncounted(table))
+					uncount_pte_table(svma->vm_mm, spmd,
+							  saddr, table);
+				atomic_inc(&table->_mapcount);
+				mm->nr_ptes++;
+				pmd_populate(mm, pmd, table);
+				shared = 1;
+			}
+			spin_unlock(ptl);
+		} else
+			shared = -1;	/* populated by another thread */
+		spin_unlock(&mm->page_table_lock);
+put:
+		if (shared <= 0)
+			put_page(table);
+next:
+		up_read(&svma->vm_mm->mmap_sem);
+		if (shared)
+			break;
+	}
+	spin_unlock(&mapping->i_mmap_lock);
+}
+#else
+static inline int can_share_pte_table(struct vm_area_struct *vma,
+				      unsigned long addr, unsigned long end)
+{
+	return 0;
+}
+
+static inline void share_pte_table(struct mm_struct *dst_mm,
+				   struct mm_struct *src_mm, pmd_t *dst_pmd,
+				   pmd_t *src_pmd, unsigned long addr)
+{
+}
+
+static inline int can_share_file_pte_table(struct vm_area_struct *vma,
+					   unsigned long address)
+{
+	return 0;
+}
+
+static inline void share_file_pte_table(struct vm_area_struct *vma,
+					pmd_t *pmd, unsigned long address)
+{
+}
+#endif /* CONFIG_PTE_SHARING */
+
 static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		pud_t *dst_pud, pud_t *src_pud, struct vm_area_struct *vma,
 		unsigned long addr, unsigned long end)
@@ -666,8 +1205,16 @@ static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src
 	src_pmd = pmd_offset(src_pud, addr);
 	do {
 		next = pmd_addr_end(addr, end);
-		if (pmd_none_or_clear_bad(src_pmd))
+		/*
+		 * Huge pmds only map shared page cache: leave the child to
+		 * fault it in again, as for a vma without an anon_vma.
+		 */
+		if (pmd_none_or_trans_huge_or_clear_bad(src_pmd))
+			continue;
+		if (can_share_pte_table(vma, addr, next)) {
+			share_pte_table(dst_mm, src_mm, dst_pmd, src_pmd, addr);
 			continue;
+		}
 		if (copy_pte_range(dst_mm, src_mm, dst_pmd, src_pmd,
 						vma, addr, next))
 			return -ENOMEM;
@@ -762,7 +1309,8 @@ int copy_page_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 static unsigned long zap_pte_range(struct mmu_gather *tlb,
 				struct vm_area_struct *vma, pmd_t *pmd,
 				unsigned long addr, unsigned long end,
-				long *zap_work, struct zap_details *details)
+				long *zap_work, struct zap_details *details,
+				int shared)
 {
 	struct mm_struct *mm = tlb->mm;
 	pte_t *pte;
@@ -771,6 +1319,17 @@ static unsigned long zap_pte_range(struct mmu_gather *tlb,
 	int anon_rss = 0;
 
 	pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
+	/*
+	 * Unless the caller zaps a shared table for all of its mms, another
+	 * mm may have taken the table up since zap_pmd_range() looked, when
+	 * we hold no mmap_sem: its ptes are then the other's too, and left
+	 * to it; free_pte_range() only drops this mm's use of the table.
+	 */
+	if (unlikely(!shared && pte_table_shared(pmd_page(*pmd)))) {
+		pte_unmap_unlock(pte, ptl);
+		(*zap_work)--;
+		return end;
+	}
 	arch_enter_lazy_mmu_mode();
 	do {
 		pte_t ptent = *pte;
@@ -844,6 +1403,8 @@ static unsigned long zap_pte_range(struct mmu_gather *tlb,
 		pte_clear_not_present_full(mm, addr, pte, tlb->fullmm);
 	} while (pte++, addr += PAGE_SIZE, (addr != end && *zap_work > 0));
 
+	if (unlikely(pte_table_uncounted(pmd_page(*pmd))))
+		file_rss = 0;
 	add_mm_rss(mm, file_rss, anon_rss);
 	arch_leave_lazy_mmu_mode();
 	pte_unmap_unlock(pte - 1, ptl);
@@ -851,6 +1412,57 @@ static unsigned long zap_pte_range(struct mmu_gather *tlb,
 	return addr;
 }
 
+#ifdef CONFIG_PTE_SHARING
+/*
+ * Unmap a shared pte table from this mm, or the ptes in it from all.
+ */
+static unsigned long zap_shared_pte_table(struct mmu_gather *tlb,
+				struct vm_area_struct *vma, pmd_t *pmd,
+				unsigned long addr, unsigned long end,
+				long *zap_work, struct zap_details *details)
+{
+	struct page *table;
+	unsigned long start;
+
+	if (end - addr == PMD_SIZE) {
+		if (drop_shared_pte_table(tlb, pmd, addr)) {
+			(*zap_work) -= PAGE_SIZE;
+			return end;
+		}
+		/* The others have all gone */
+		return zap_pte_range(tlb, vma, pmd, addr, end,
+				     zap_work, details, 0);
+	}
+
+	/* unshare_pte_boundary() should have copied it */
+	if (WARN_ON_ONCE(pmd_cow_shared(*pmd))) {
+		(*zap_work)--;
+		return end;
+	}
+
+	/*
+	 * Only truncation unmaps part of a table shared by mappings of the
+	 * file, and from all of them, under the i_mmap_lock: the ptes go for
+	 * all the mms, and so must their TLB entries, in one flush for the
+	 * table for each.  The page cache still holds the pages meanwhile.
+	 */
+	start = addr;
+	table = pmd_page(*pmd);
+	pte_table_sharers(vma, table, start, end, sharer_invalidate_start);
+	addr = zap_pte_range(tlb, vma, pmd, start, end, zap_work, details, 1);
+	pte_table_sharers(vma, table, start, end, sharer_invalidate_end);
+	return addr;
+}
+#else
+static inline unsigned long zap_shared_pte_table(struct mmu_gather *tlb,
+				struct vm_area_struct *vma, pmd_t *pmd,
+				unsigned long addr, unsigned long end,
+				long *zap_work, struct zap_details *details)
+{
+	return end;
+}
+#endif
+
 static inline unsigned long zap_pmd_range(struct mmu_gather *tlb,
 				struct vm_area_struct *vma, pud_t *pud,
 				unsigned long addr, unsigned long end,
@@ -862,12 +1474,26 @@ static inline unsigned long zap_pmd_range(struct mmu_gather *tlb,
 	pmd = pmd_offset(pud, addr);
 	do {
 		next = pmd_addr_end(addr, end);
+		if (pmd_trans_huge(*pmd)) {
+			if (next - addr == HPAGE_PMD_SIZE &&
+			    !(details && details->nonlinear_vma) &&
+			    zap_huge_pmd(tlb, vma, pmd, addr)) {
+				(*zap_work) -= PAGE_SIZE;
+				continue;
+			}
+			split_huge_pmd(vma->vm_mm, pmd, addr);
+		}
 		if (pmd_none_or_clear_bad(pmd)) {
 			(*zap_work)--;
 			continue;
 		}
+		if (pte_table_shared(pmd_page(*pmd))) {
+			next = zap_shared_pte_table(tlb, vma, pmd, addr, next,
+						    zap_work, details);
+			continue;
+		}
 		next = zap_pte_range(tlb, vma, pmd, addr, next,
-						zap_work, details);
+						zap_work, details, 0);
 	} while (pmd++, addr = next, (addr != end && *zap_work > 0));
 
 	return addr;
@@ -1127,6 +1753,14 @@ struct page *follow_page(struct vm_area_struct *vma, unsigned long address,
 	pmd = pmd_offset(pud, address);
 	if (pmd_none(*pmd))
 		goto no_page_table;
+	if (pmd_trans_huge(*pmd) && !is_vm_hugetlb_page(vma)) {
+		page = follow_huge_pmd_page(vma, address, pmd, flags);
+		if (page)
+			goto out;
+		/* split or zapped under us: look at the ptes, if any */
+		if (!pmd_present(*pmd) || pmd_trans_huge(*pmd))
+			goto no_page_table;
+	}
 	if (pmd_huge(*pmd)) {
 		BUG_ON(flags & FOLL_GET);
 		page = follow_huge_pmd(mm, address, pmd, flags & FOLL_WRITE);
@@ -1140,7 +1774,8 @@ struct page *follow_page(struct vm_area_struct *vma, unsigned long address,
 	pte = *ptep;
 	if (!pte_present(pte))
 		goto no_page;
-	if ((flags & FOLL_WRITE) && !pte_write(pte))
+	if ((flags & FOLL_WRITE) &&
+	    (!pte_write(pte) || pmd_cow_shared(*pmd)))
 		goto unlock;
 	page = vm_normal_page(vma, address, pte);
 	if (unlikely(!page))
@@ -1437,8 +2072,10 @@ pte_t *get_locked_pte(struct mm_struct *mm, unsigned long addr,
 	pud_t * pud = pud_alloc(mm, pgd, addr);
 	if (pud) {
 		pmd_t * pmd = pmd_alloc(mm, pud, addr);
-		if (pmd)
+		if (pmd) {
+			split_huge_pmd(mm, pmd, addr);
 			return pte_alloc_map_lock(mm, pmd, addr, ptl);
+		}
 	}
 	return NULL;
 }
@@ -2793,7 +3430,8 @@ static int __do_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 			inc_mm_counter(mm, anon_rss);
 			page_add_new_anon_rmap(page, vma, address);
 		} else {
-			inc_mm_counter(mm, file_rss);
+			if (!pte_table_uncounted(virt_to_page(page_table)))
+				inc_mm_counter(mm, file_rss);
 			page_add_file_rmap(page);
 			if (flags & FAULT_FLAG_WRITE) {
 				dirty_page = page;
@@ -2981,9 +3619,27 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	pmd = pmd_alloc(mm, pud, address);
 	if (!pmd)
 		return VM_FAULT_OOM;
-	pte = pte_alloc_map(mm, pmd, address);
-	if (!pte)
+	if (pmd_none(*pmd) && vma->vm_ops && vma->vm_ops->pmd_fault) {
+		int ret = vma->vm_ops->pmd_fault(vma, address, pmd, flags);
+		if (!(ret & VM_FAULT_FALLBACK))
+			return ret;
+	} else if (pmd_trans_huge(*pmd)) {
+		if (!(huge_pmd_fault(vma, address, pmd, flags) &
+		      VM_FAULT_FALLBACK))
+			return 0;
+	}
+	if (unlikely(pmd_none(*pmd)) && can_share_file_pte_table(vma, address))
+		share_file_pte_table(vma, pmd, address);
+	if (unlikely(pmd_none(*pmd)) && __pte_alloc(mm, pmd, address))
+		return VM_FAULT_OOM;
+	/* A huge pmd may have been installed since: just retry the access */
+	if (unlikely(pmd_trans_huge(*pmd)))
+		return 0;
+	/* Any fault on a pte table shared by fork copies it */
+	if (unlikely(pmd_cow_shared(*pmd)) &&
+	    unshare_pte_table(vma, pmd, address))
 		return VM_FAULT_OOM;
+	pte = pte_offset_map(pmd, address);
 
 	return handle_pte_fault(mm, vma, address, pte, pmd, flags);
 }
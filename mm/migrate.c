@@ -100,7 +100,8 @@ static void remove_migration_pte(struct vm_area_struct *vma,
                 return;
 
 	pmd = pmd_offset(pud, addr);
-	if (!pmd_present(*pmd))
+	/* migration entries live in pte tables only */
+	if (!pmd_present(*pmd) || pmd_trans_huge(*pmd))
 		return;
 
 	ptep = pte_offset_map(pmd, addr);
@@ -95,8 +95,11 @@ static long do_mincore(unsigned long addr, unsigned char *vec, unsigned long pag
 	if (pud_none_or_clear_bad(pud))
 		goto none_mapped;
 	pmd = pmd_offset(pud, addr);
-	if (pmd_none_or_clear_bad(pmd))
+	if (pmd_none_or_trans_huge_or_clear_bad(pmd)) {
+		if (pmd_trans_huge(*pmd))
+			goto huge_mapped;
 		goto none_mapped;
+	}
 
 	ptep = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
 	for (i = 0; i < nr; i++, ptep++, addr += PAGE_SIZE) {
@@ -140,6 +143,13 @@ static long do_mincore(unsigned long addr, unsigned char *vec, unsigned long pag
 
 	return nr;
 
+huge_mapped:
+	/* nr never crosses a pmd boundary, so the whole range is mapped */
+	for (i = 0; i < nr; i++)
+		vec[i] = 1;
+
+	return nr;
+
 none_mapped:
 	if (vma->vm_file) {
 		pgoff = linear_page_index(vma, addr);
@@ -19,6 +19,7 @@
 #include <linux/security.h>
 #include <linux/syscalls.h>
 #include <linux/mmu_notifier.h>
+#include <linux/rmap.h>
 
 #include <asm/uaccess.h>
 #include <asm/cacheflush.h>
@@ -41,6 +42,7 @@ static pmd_t *get_old_pmd(struct mm_struct *mm, unsigned long addr)
 		return NULL;
 
 	pmd = pmd_offset(pud, addr);
+	split_huge_pmd(mm, pmd, addr);
 	if (pmd_none_or_clear_bad(pmd))
 		return NULL;
 
@@ -51,21 +53,13 @@ static pmd_t *alloc_new_pmd(struct mm_struct *mm, unsigned long addr)
 {
 	pgd_t *pgd;
 	pud_t *pud;
-	pmd_t *pmd;
 
 	pgd = pgd_offset(mm, addr);
 	pud = pud_alloc(mm, pgd, addr);
 	if (!pud)
 		return NULL;
 
-	pmd = pmd_alloc(mm, pud, addr);
-	if (!pmd)
-		return NULL;
-
-	if (!pmd_present(*pmd) && __pte_alloc(mm, pmd, addr))
-		return NULL;
-
-	return pmd;
+	return pmd_alloc(mm, pud, addr);
 }
 
 static void move_ptes(struct vm_area_struct *vma, pmd_t *old_pmd,
@@ -126,6 +120,69 @@ static void move_ptes(struct vm_area_struct *vma, pmd_t *old_pmd,
 	mmu_notifier_invalidate_range_end(vma->vm_mm, old_start, old_end);
 }
 
+#ifdef CONFIG_ARCH_SUPPORTS_MOVE_PTE_TABLE
+/*
+ * Move the whole pte table under @old_pmd to the empty @new_pmd, when the
+ * range covers all of it and both addresses are PMD aligned: one pmd
+ * update instead of PTRS_PER_PTE pte moves.  The ptes are unchanged, so
+ * the arch must not need move_pte() or a flush per pte.
+ */
+static int move_pte_table(struct vm_area_struct *vma, pmd_t *old_pmd,
+		unsigned long old_addr, struct vm_area_struct *new_vma,
+		pmd_t *new_pmd)
+{
+	struct address_space *mapping = NULL;
+	struct anon_vma *anon_vma = vma->anon_vma;
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long old_end = old_addr + PMD_SIZE;
+	spinlock_t *ptl;
+	pmd_t pmd;
+
+	mmu_notifier_invalidate_range_start(mm, old_addr, old_end);
+	/*
+	 * Unlike a pte, the table is found by rmap at the new address as
+	 * soon as it is moved: keep rmap walkers out until the old range
+	 * is flushed, as they would only flush the address they looked up.
+	 */
+	if (vma->vm_file) {
+		mapping = vma->vm_file->f_mapping;
+		spin_lock(&mapping->i_mmap_lock);
+		if (new_vma->vm_truncate_count &&
+		    new_vma->vm_truncate_count != vma->vm_truncate_count)
+			new_vma->vm_truncate_count = 0;
+	}
+	if (anon_vma)
+		spin_lock(&anon_vma->lock);
+
+	spin_lock(&mm->page_table_lock);
+	ptl = pte_lockptr(mm, old_pmd);
+	if (ptl != &mm->page_table_lock)
+		spin_lock_nested(ptl, SINGLE_DEPTH_NESTING);
+
+	pmd = *old_pmd;
+	pmd_clear(old_pmd);
+	set_pmd(new_pmd, pmd);
+	flush_tlb_range(vma, old_addr, old_end);
+
+	if (ptl != &mm->page_table_lock)
+		spin_unlock(ptl);
+	spin_unlock(&mm->page_table_lock);
+	if (anon_vma)
+		spin_unlock(&anon_vma->lock);
+	if (mapping)
+		spin_unlock(&mapping->i_mmap_lock);
+	mmu_notifier_invalidate_range_end(mm, old_addr, old_end);
+	return 1;
+}
+#else
+static inline int move_pte_table(struct vm_area_struct *vma, pmd_t *old_pmd,
+		unsigned long old_addr, struct vm_area_struct *new_vma,
+		pmd_t *new_pmd)
+{
+	return 0;
+}
+#endif
+
 #define LATENCY_LIMIT	(64 * PAGE_SIZE)
 
 unsigned long move_page_tables(struct vm_area_struct *vma,
@@ -150,6 +207,13 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 		new_pmd = alloc_new_pmd(vma->vm_mm, new_addr);
 		if (!new_pmd)
 			break;
+		if (extent == PMD_SIZE && !(new_addr & ~PMD_MASK) &&
+		    pmd_none(*new_pmd) &&
+		    move_pte_table(vma, old_pmd, old_addr, new_vma, new_pmd))
+			continue;
+		if (!pmd_present(*new_pmd) &&
+		    __pte_alloc(vma->vm_mm, new_pmd, new_addr))
+			break;
 		next = (new_addr + PMD_SIZE) & PMD_MASK;
 		if (extent > next - new_addr)
 			extent = next - new_addr;
@@ -164,7 +228,8 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 
 static unsigned long move_vma(struct vm_area_struct *vma,
 		unsigned long old_addr, unsigned long old_len,
-		unsigned long new_len, unsigned long new_addr)
+		unsigned long new_len, unsigned long new_addr,
+		unsigned long flags)
 {
 	struct mm_struct *mm = vma->vm_mm;
 	struct vm_area_struct *new_vma;
@@ -182,6 +247,23 @@ static unsigned long move_vma(struct vm_area_struct *vma,
 	if (mm->map_count >= sysctl_max_map_count - 3)
 		return -ENOMEM;
 
+	/* move_page_tables() moves ptes, not pte tables shared by fork */
+	if (unshare_pte_range(vma, old_addr, old_addr + old_len))
+		return -ENOMEM;
+
+	/*
+	 * MREMAP_DONTUNMAP leaves the old range mapped but unlocked, as its
+	 * lock goes with the pages: it needs a vma of its own for that.
+	 */
+	if ((flags & MREMAP_DONTUNMAP) && (vm_flags & VM_LOCKED)) {
+		if (old_addr > vma->vm_start &&
+		    split_vma(mm, vma, old_addr, 1))
+			return -ENOMEM;
+		if (old_addr + old_len < vma->vm_end &&
+		    split_vma(mm, vma, old_addr + old_len, 0))
+			return -ENOMEM;
+	}
+
 	new_pgoff = vma->vm_pgoff + ((old_addr - vma->vm_start) >> PAGE_SHIFT);
 	new_vma = copy_vma(&vma, new_addr, new_len, new_pgoff);
 	if (!new_vma)
@@ -199,6 +281,23 @@ static unsigned long move_vma(struct vm_area_struct *vma,
 		old_len = new_len;
 		old_addr = new_addr;
 		new_addr = -ENOMEM;
+	} else if (flags & MREMAP_DONTUNMAP) {
+		/*
+		 * Leave the old vma mapped, and empty: it keeps its own
+		 * commit charge, do_mremap() charged the new one.  The lock
+		 * and its share of locked_vm moved to the new vma with the
+		 * pages, unless copy_vma() merged the two into one.
+		 */
+		mm->total_vm += new_len >> PAGE_SHIFT;
+		vm_stat_account(mm, vma->vm_flags, vma->vm_file,
+				new_len >> PAGE_SHIFT);
+		if (vm_flags & VM_LOCKED) {
+			if (vma != new_vma)
+				vma->vm_flags &= ~VM_LOCKED;
+			else
+				mm->locked_vm += new_len >> PAGE_SHIFT;
+		}
+		return new_addr;
 	}
 
 	/* Conceal VM_ACCOUNT so old reservation is not undone */
@@ -253,6 +352,11 @@ static unsigned long move_vma(struct vm_area_struct *vma,
  *
  * MREMAP_FIXED option added 5-Dec-1999 by Benjamin LaHaise
  * This option implies MREMAP_MAYMOVE.
+ *
+ * MREMAP_DONTUNMAP moves the pages of a private anonymous range but leaves
+ * the range mapped, to fault in zeroed pages again: a garbage collector
+ * can evacuate a heap region without copying it, or giving it up.  It
+ * needs MREMAP_MAYMOVE, and the same old and new lengths.
  */
 unsigned long do_mremap(unsigned long addr,
 	unsigned long old_len, unsigned long new_len,
@@ -262,8 +366,13 @@ unsigned long do_mremap(unsigned long addr,
 	struct vm_area_struct *vma;
 	unsigned long ret = -EINVAL;
 	unsigned long charged = 0;
+	unsigned long grow;
 
-	if (flags & ~(MREMAP_FIXED | MREMAP_MAYMOVE))
+	if (flags & ~(MREMAP_FIXED | MREMAP_MAYMOVE | MREMAP_DONTUNMAP))
+		goto out;
+
+	if ((flags & MREMAP_DONTUNMAP) &&
+	    (!(flags & MREMAP_MAYMOVE) || old_len != new_len))
 		goto out;
 
 	if (addr & ~PAGE_MASK)
@@ -313,7 +422,7 @@ unsigned long do_mremap(unsigned long addr,
 	 * the unnecessary pages..
 	 * do_munmap does all the needed commit accounting
 	 */
-	if (old_len >= new_len) {
+	if (old_len >= new_len && !(flags & MREMAP_DONTUNMAP)) {
 		ret = do_munmap(mm, addr+new_len, old_len - new_len);
 		if (ret && old_len != new_len)
 			goto out;
@@ -334,6 +443,15 @@ unsigned long do_mremap(unsigned long addr,
 		ret = -EINVAL;
 		goto out;
 	}
+	if ((flags & MREMAP_DONTUNMAP) &&
+	    (vma->vm_ops || (vma->vm_flags & VM_MAYSHARE))) {
+		ret = -EINVAL;
+		goto out;
+	}
+	/* With MREMAP_DONTUNMAP the old range stays mapped too */
+	grow = new_len - old_len;
+	if (flags & MREMAP_DONTUNMAP)
+		grow = new_len;
 	/* We can't remap across vm area boundaries */
 	if (old_len > vma->vm_end - addr)
 		goto out;
@@ -345,18 +463,19 @@ unsigned long do_mremap(unsigned long addr,
 		unsigned long locked, lock_limit;
 		locked = mm->locked_vm << PAGE_SHIFT;
 		lock_limit = current->signal->rlim[RLIMIT_MEMLOCK].rlim_cur;
+		/* a moved lock is not a new one, even with MREMAP_DONTUNMAP */
 		locked += new_len - old_len;
 		ret = -EAGAIN;
 		if (locked > lock_limit && !capable(CAP_IPC_LOCK))
 			goto out;
 	}
-	if (!may_expand_vm(mm, (new_len - old_len) >> PAGE_SHIFT)) {
+	if (!may_expand_vm(mm, grow >> PAGE_SHIFT)) {
 		ret = -ENOMEM;
 		goto out;
 	}
 
 	if (vma->vm_flags & VM_ACCOUNT) {
-		charged = (new_len - old_len) >> PAGE_SHIFT;
+		charged = grow >> PAGE_SHIFT;
 		if (security_vm_enough_memory(charged))
 			goto out_nc;
 	}
@@ -411,7 +530,7 @@ unsigned long do_mremap(unsigned long addr,
 			if (ret)
 				goto out;
 		}
-		ret = move_vma(vma, addr, old_len, new_len, new_addr);
+		ret = move_vma(vma, addr, old_len, new_len, new_addr, flags);
 	}
 out:
 	if (ret & ~PAGE_MASK)
@@ -275,6 +275,13 @@ void *__vmalloc(unsigned long size, gfp_t gfp_mask, pgprot_t prot)
 }
 EXPORT_SYMBOL(__vmalloc);
 
+void *__vmalloc_flags(unsigned long size, gfp_t gfp_mask, pgprot_t prot,
+		      unsigned long vm_flags)
+{
+	return __vmalloc(size, gfp_mask, prot);
+}
+EXPORT_SYMBOL(__vmalloc_flags);
+
 void *vmalloc_user(unsigned long size)
 {
 	void *ret;
@@ -346,6 +353,12 @@ void *vmalloc_node(unsigned long size, int node)
 }
 EXPORT_SYMBOL(vmalloc_node);
 
+void *vmalloc_huge(unsigned long size)
+{
+	return vmalloc(size);
+}
+EXPORT_SYMBOL(vmalloc_huge);
+
 #ifndef PAGE_KERNEL_EXEC
 # define PAGE_KERNEL_EXEC PAGE_KERNEL
 #endif
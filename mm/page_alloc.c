@@ -48,6 +48,7 @@
 #include <linux/page_cgroup.h>
 #include <linux/debugobjects.h>
 #include <linux/kmemleak.h>
+#include <linux/kthread.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -1447,6 +1448,35 @@ static void zlc_mark_zone_full(struct zonelist *zonelist, struct zoneref *z)
 }
 #endif	/* CONFIG_NUMA */
 
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+static int deferred_init_chunk(pg_data_t *pgdat, unsigned long nr_pages);
+
+/*
+ * An allocation found @zone short of free pages: if the zone still has
+ * struct pages waiting for initialisation, do a few of them right away
+ * rather than fail.  This can be atomic context, so only one max-order
+ * block is done at a time.  Returns nonzero if the zone grew.
+ */
+static inline int deferred_grow_zone(struct zone *zone)
+{
+	pg_data_t *pgdat = zone->zone_pgdat;
+	unsigned long pfn = pgdat->first_deferred_pfn;
+
+	if (likely(pfn >= pgdat->deferred_end_pfn))
+		return 0;
+	if (pfn < zone->zone_start_pfn ||
+	    pfn >= zone->zone_start_pfn + zone->spanned_pages)
+		return 0;
+	return deferred_init_chunk(pgdat, MAX_ORDER_NR_PAGES);
+}
+
+#else
+static inline int deferred_grow_zone(struct zone *zone)
+{
+	return 0;
+}
+#endif /* CONFIG_DEFERRED_STRUCT_PAGE_INIT */
+
 /*
  * get_page_from_freelist goes through the zonelist trying to allocate
  * a page.
@@ -1489,6 +1519,9 @@ zonelist_scan:
 				    classzone_idx, alloc_flags))
 				goto try_this_zone;
 
+			if (deferred_grow_zone(zone))
+				goto try_this_zone;
+
 			if (zone_reclaim_mode == 0)
 				goto this_zone_full;
 
@@ -1513,6 +1546,8 @@ try_this_zone:
 						gfp_mask, migratetype);
 		if (page)
 			break;
+		if (deferred_grow_zone(zone))
+			goto try_this_zone;
 this_zone_full:
 		if (NUMA_BUILD)
 			zlc_mark_zone_full(zonelist, z);
@@ -2834,6 +2869,60 @@ static void setup_zone_migrate_reserve(struct zone *zone)
  * up by free_all_bootmem() once the early boot process is
  * done. Non-atomic initialization, single-pass.
  */
+static void __meminit __init_single_page(struct page *page, unsigned long pfn,
+					 unsigned long zone, int nid)
+{
+	set_page_links(page, zone, nid, pfn);
+	mminit_verify_page_links(page, zone, nid, pfn);
+	init_page_count(page);
+	reset_page_mapcount(page);
+	SetPageReserved(page);
+	INIT_LIST_HEAD(&page->lru);
+#ifdef WANT_PAGE_VIRTUAL
+	/* The shift won't overflow because ZONE_NORMAL is below 4G. */
+	if (!is_highmem_idx(zone))
+		set_page_address(page, __va(pfn << PAGE_SHIFT));
+#endif
+}
+
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+/*
+ * Struct pages initialised at boot in the highest zone of each node, the
+ * rest of it is left to a per-node kthread, which works in chunks of
+ * DEFERRED_INIT_CHUNK.  Both sizes are multiples of MAX_ORDER_NR_PAGES,
+ * so that no buddy straddles a chunk boundary.
+ */
+#define DEFERRED_STATIC_PAGES	(1UL << (31 - PAGE_SHIFT))
+#define DEFERRED_INIT_CHUNK	(1UL << (27 - PAGE_SHIFT))
+
+/*
+ * Returns true, after recording where the deferred struct pages start,
+ * at the first pfn of @zone that memmap_init_zone() should leave alone.
+ */
+static bool __meminit defer_init(struct zone *zone, unsigned long pfn,
+				 unsigned long end_pfn)
+{
+	pg_data_t *pgdat = zone->zone_pgdat;
+
+	if (zone->zone_start_pfn + zone->spanned_pages !=
+	    pgdat->node_start_pfn + pgdat->node_spanned_pages)
+		return false;
+	if (pfn < pgdat->node_start_pfn + DEFERRED_STATIC_PAGES ||
+	    (pfn & (MAX_ORDER_NR_PAGES - 1)))
+		return false;
+
+	pgdat->first_deferred_pfn = pfn;
+	pgdat->deferred_end_pfn = end_pfn;
+	return true;
+}
+#else
+static inline bool defer_init(struct zone *zone, unsigned long pfn,
+			      unsigned long end_pfn)
+{
+	return false;
+}
+#endif /* CONFIG_DEFERRED_STRUCT_PAGE_INIT */
+
 void __meminit memmap_init_zone(unsigned long size, int nid, unsigned long zone,
 		unsigned long start_pfn, enum memmap_context context)
 {
@@ -2853,17 +2942,15 @@ void __meminit memmap_init_zone(unsigned long size, int nid, unsigned long zone,
 		 * exist on hotplugged memory.
 		 */
 		if (context == MEMMAP_EARLY) {
+			if (defer_init(z, pfn, end_pfn))
+				break;
 			if (!early_pfn_valid(pfn))
 				continue;
 			if (!early_pfn_in_nid(pfn, nid))
 				continue;
 		}
 		page = pfn_to_page(pfn);
-		set_page_links(page, zone, nid, pfn);
-		mminit_verify_page_links(page, zone, nid, pfn);
-		init_page_count(page);
-		reset_page_mapcount(page);
-		SetPageReserved(page);
+		__init_single_page(page, pfn, zone, nid);
 		/*
 		 * Mark the block movable so that blocks are reserved for
 		 * movable at startup. This will force kernel allocations
@@ -2882,15 +2969,144 @@ void __meminit memmap_init_zone(unsigned long size, int nid, unsigned long zone,
 		    && (pfn < z->zone_start_pfn + z->spanned_pages)
 		    && !(pfn & (pageblock_nr_pages - 1)))
 			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
+	}
+}
 
-		INIT_LIST_HEAD(&page->lru);
-#ifdef WANT_PAGE_VIRTUAL
-		/* The shift won't overflow because ZONE_NORMAL is below 4G. */
-		if (!is_highmem_idx(zone))
-			set_page_address(page, __va(pfn << PAGE_SHIFT));
-#endif
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+/* pgdatinit kthreads wait here for the chunks allocations are doing */
+static __initdata DECLARE_WAIT_QUEUE_HEAD(deferred_inflight_wait);
+
+/*
+ * Claim the next @nr_pages (a multiple of MAX_ORDER_NR_PAGES) of @pgdat's
+ * deferred struct pages, initialise them, and hand what bootmem left free
+ * to the buddy allocator.  Called by the node's pgdatinit kthread, and by
+ * allocations that run out of memory before it is done.  Returns 0 when
+ * there is nothing left to claim.
+ *
+ * Only reachable until page_alloc_init_late() returns, so the __initdata
+ * of bootmem and of the early node map are still there.
+ */
+static int __ref deferred_init_chunk(pg_data_t *pgdat, unsigned long nr_pages)
+{
+	int nid = pgdat->node_id;
+	unsigned long start, end, pfn, flags, freed;
+	struct zone *zone;
+	unsigned long zid;
+
+	spin_lock_irqsave(&pgdat->deferred_lock, flags);
+	start = pgdat->first_deferred_pfn;
+	if (start >= pgdat->deferred_end_pfn) {
+		spin_unlock_irqrestore(&pgdat->deferred_lock, flags);
+		return 0;
+	}
+	end = min(start + nr_pages, pgdat->deferred_end_pfn);
+	pgdat->first_deferred_pfn = end;
+	pgdat->deferred_inflight++;
+	spin_unlock_irqrestore(&pgdat->deferred_lock, flags);
+
+	/* The deferred pages all belong to the highest zone of the node */
+	for (zid = 0; zid < MAX_NR_ZONES; zid++) {
+		zone = &pgdat->node_zones[zid];
+		if (start >= zone->zone_start_pfn &&
+		    start < zone->zone_start_pfn + zone->spanned_pages)
+			break;
+	}
+	BUG_ON(zid == MAX_NR_ZONES);
+
+	for (pfn = start; pfn < end; pfn++) {
+		if (!early_pfn_valid(pfn))
+			continue;
+		if (!early_pfn_in_nid(pfn, nid))
+			continue;
+		__init_single_page(pfn_to_page(pfn), pfn, zid, nid);
+	}
+
+	/* The pageblock bitmap words may be shared with live pageblocks */
+	spin_lock_irqsave(&zone->lock, flags);
+	for (pfn = ALIGN(start, pageblock_nr_pages); pfn < end;
+	     pfn += pageblock_nr_pages) {
+		if (early_pfn_valid(pfn) && early_pfn_in_nid(pfn, nid))
+			set_pageblock_migratetype(pfn_to_page(pfn),
+						  MIGRATE_MOVABLE);
+	}
+	spin_unlock_irqrestore(&zone->lock, flags);
+
+	freed = free_bootmem_deferred(pgdat, start, end);
+
+	spin_lock_irqsave(&pgdat->deferred_lock, flags);
+	pgdat->deferred_freed += freed;
+	pgdat->deferred_inflight--;
+	spin_unlock_irqrestore(&pgdat->deferred_lock, flags);
+
+	wake_up(&deferred_inflight_wait);
+	return 1;
+}
+
+static atomic_t pgdat_init_n_undone __initdata;
+static __initdata DECLARE_COMPLETION(pgdat_init_all_done_comp);
+
+static int __init deferred_init_memmap(void *data)
+{
+	pg_data_t *pgdat = data;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	unsigned long start = jiffies;
+	unsigned long first = pgdat->first_deferred_pfn;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+
+	while (deferred_init_chunk(pgdat, DEFERRED_INIT_CHUNK))
+		cond_resched();
+
+	/* Wait for any chunk an allocation is still doing */
+	wait_event(deferred_inflight_wait,
+		   !ACCESS_ONCE(pgdat->deferred_inflight));
+
+	printk(KERN_INFO "node %d initialised %lu pages in %ums\n",
+	       pgdat->node_id, pgdat->deferred_end_pfn - first,
+	       jiffies_to_msecs(jiffies - start));
+
+	if (atomic_dec_and_test(&pgdat_init_n_undone))
+		complete(&pgdat_init_all_done_comp);
+	return 0;
+}
+
+/*
+ * Called once the secondary CPUs are up: initialise the struct pages
+ * memmap_init_zone() deferred, with one kthread per node running on the
+ * node's CPUs, and wait for all of them before the bootmem data they use
+ * goes away.
+ */
+void __init page_alloc_init_late(void)
+{
+	struct task_struct *tsk;
+	int nid;
+
+	atomic_set(&pgdat_init_n_undone, 1);
+	for_each_online_node(nid) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+
+		if (!pgdat->deferred_end_pfn)
+			continue;
+		atomic_inc(&pgdat_init_n_undone);
+		tsk = kthread_run(deferred_init_memmap, pgdat,
+				  "pgdatinit%d", nid);
+		if (IS_ERR(tsk))
+			deferred_init_memmap(pgdat);
+	}
+	if (!atomic_dec_and_test(&pgdat_init_n_undone))
+		wait_for_completion(&pgdat_init_all_done_comp);
+
+	for_each_online_node(nid) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+
+		if (!pgdat->deferred_end_pfn)
+			continue;
+		totalram_pages += pgdat->deferred_freed;
+		totalram_pages += free_bootmem_map_deferred(pgdat);
 	}
 }
+#endif /* CONFIG_DEFERRED_STRUCT_PAGE_INIT */
 
 static void __meminit zone_init_free_lists(struct zone *zone)
 {
@@ -3787,6 +4003,11 @@ void __paginginit free_area_init_node(int nid, unsigned long *zones_size,
 
 	pgdat->node_id = nid;
 	pgdat->node_start_pfn = node_start_pfn;
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+	spin_lock_init(&pgdat->deferred_lock);
+	pgdat->first_deferred_pfn = ULONG_MAX;
+	pgdat->deferred_end_pfn = 0;
+#endif
 	calculate_node_totalpages(pgdat, zones_size, zholes_size);
 
 	alloc_node_mem_map(pgdat);
@@ -4751,7 +4972,8 @@ void *__init alloc_large_system_hash(const char *tablename,
 		if (flags & HASH_EARLY)
 			table = alloc_bootmem_nopanic(size);
 		else if (hashdist)
-			table = __vmalloc(size, GFP_ATOMIC, PAGE_KERNEL);
+			table = __vmalloc_flags(size, GFP_ATOMIC, PAGE_KERNEL,
+						VM_HUGE);
 		else {
 			/*
 			 * If bucketsize is not a power-of-two, we may free
@@ -33,7 +33,16 @@ static int walk_pmd_range(pud_t *pud, unsigned long addr, unsigned long end,
 	pmd = pmd_offset(pud, addr);
 	do {
 		next = pmd_addr_end(addr, end);
-		if (pmd_none_or_clear_bad(pmd)) {
+		if (pmd_trans_huge(*pmd) && !walk->pmd_entry)
+			split_huge_pmd(walk->mm, pmd, addr);
+		if (pmd_none_or_trans_huge_or_clear_bad(pmd)) {
+			/* ->pmd_entry must cope with a huge pmd itself */
+			if (pmd_trans_huge(*pmd) && walk->pmd_entry) {
+				err = walk->pmd_entry(pmd, addr, next, walk);
+				if (err)
+					break;
+				continue;
+			}
 			if (walk->pte_hole)
 				err = walk->pte_hole(addr, next, walk);
 			if (err)
@@ -0,0 +1,310 @@
+/*
+ *  linux/mm/process_vm_access.c
+ *
+ *  Copy data directly between the address spaces of two processes,
+ *  without going through a pipe or a shared buffer: the pages of the
+ *  remote process are pinned with get_user_pages() and copied to or
+ *  from the caller's iovecs, so each byte is copied only once.
+ */
+
+#include <linux/mm.h>
+#include <linux/uio.h>
+#include <linux/sched.h>
+#include <linux/highmem.h>
+#include <linux/ptrace.h>
+#include <linux/slab.h>
+#include <linux/syscalls.h>
+
+#ifdef CONFIG_COMPAT
+#include <linux/compat.h>
+#endif
+
+/* Remote pages pinned at a time, kept on the stack */
+#define PVM_MAX_PP_ARRAY_COUNT 16
+
+/* Position in the local iovecs */
+struct pvm_iter {
+	const struct iovec *iov;	/* current segment */
+	unsigned long nr_segs;		/* segments left, including *iov */
+	size_t offset;			/* offset into *iov */
+};
+
+/*
+ * Copy @len bytes, starting at @offset into the first of @pages, between
+ * the pinned remote pages and the local iovecs.  Returns 0, or -EFAULT if
+ * a local buffer faulted; *@copied is advanced either way.
+ */
+static int process_vm_rw_pages(struct page **pages, unsigned long offset,
+			       size_t len, struct pvm_iter *iter,
+			       int vm_write, ssize_t *copied)
+{
+	while (len && iter->nr_segs) {
+		struct page *page = *pages;
+		char __user *buf = iter->iov->iov_base + iter->offset;
+		size_t n = iter->iov->iov_len - iter->offset;
+		unsigned long left;
+		void *kaddr;
+
+		n = min_t(size_t, n, PAGE_SIZE - offset);
+		n = min_t(size_t, n, len);
+		if (n) {
+			kaddr = kmap(page);
+			if (vm_write)
+				left = copy_from_user(kaddr + offset, buf, n);
+			else
+				left = copy_to_user(buf, kaddr + offset, n);
+			kunmap(page);
+			if (vm_write)
+				set_page_dirty_lock(page);
+
+			*copied += n - left;
+			if (left)
+				return -EFAULT;
+		}
+
+		len -= n;
+		offset += n;
+		if (offset == PAGE_SIZE) {
+			offset = 0;
+			pages++;
+		}
+		iter->offset += n;
+		if (iter->offset == iter->iov->iov_len) {
+			iter->iov++;
+			iter->nr_segs--;
+			iter->offset = 0;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Copy one remote segment [@addr, @addr + @len) of @mm from or to the
+ * local iovecs, until either is exhausted.
+ */
+static int process_vm_rw_single_vec(unsigned long addr, unsigned long len,
+				    struct pvm_iter *iter,
+				    struct page **process_pages,
+				    struct mm_struct *mm,
+				    struct task_struct *task,
+				    int vm_write, ssize_t *copied)
+{
+	unsigned long pa = addr & PAGE_MASK;
+	unsigned long start_offset = addr - pa;
+	unsigned long nr_pages;
+	int rc = 0;
+
+	if (len == 0)
+		return 0;
+	nr_pages = (addr + len - 1) / PAGE_SIZE - addr / PAGE_SIZE + 1;
+
+	while (nr_pages && iter->nr_segs) {
+		int max_pages = min_t(unsigned long, nr_pages,
+				      PVM_MAX_PP_ARRAY_COUNT);
+		int nr_pinned, i;
+		size_t bytes;
+
+		down_read(&mm->mmap_sem);
+		nr_pinned = get_user_pages(task, mm, pa, max_pages, vm_write,
+					   0, process_pages, NULL);
+		up_read(&mm->mmap_sem);
+		if (nr_pinned <= 0)
+			return -EFAULT;
+
+		bytes = nr_pinned * PAGE_SIZE - start_offset;
+		if (bytes > len)
+			bytes = len;
+
+		rc = process_vm_rw_pages(process_pages, start_offset, bytes,
+					 iter, vm_write, copied);
+		for (i = 0; i < nr_pinned; i++)
+			put_page(process_pages[i]);
+		if (rc)
+			break;
+
+		len -= bytes;
+		start_offset = 0;
+		nr_pages -= nr_pinned;
+		pa += nr_pinned * PAGE_SIZE;
+	}
+	return rc;
+}
+
+/*
+ * Copy between the local iovecs and the remote iovecs of process @pid,
+ * both already copied into the kernel.  Returns the number of bytes
+ * copied; an error only when nothing could be copied at all.
+ */
+static ssize_t process_vm_rw_core(pid_t pid, const struct iovec *lvec,
+				  unsigned long liovcnt,
+				  const struct iovec *rvec,
+				  unsigned long riovcnt, int vm_write)
+{
+	struct page *pp_stack[PVM_MAX_PP_ARRAY_COUNT];
+	struct pvm_iter iter = { lvec, liovcnt, 0 };
+	struct task_struct *task;
+	struct mm_struct *mm;
+	ssize_t copied = 0;
+	unsigned long i;
+	int rc;
+
+	rcu_read_lock();
+	task = find_task_by_vpid(pid);
+	if (task)
+		get_task_struct(task);
+	rcu_read_unlock();
+	if (!task)
+		return -ESRCH;
+
+	/*
+	 * Same rules as for ptrace attach: hold cred_guard_mutex so that
+	 * the target cannot exec a setuid binary between the check and
+	 * our taking a reference on its mm.
+	 */
+	rc = mutex_lock_killable(&task->cred_guard_mutex);
+	if (rc)
+		goto put_task;
+	mm = get_task_mm(task);
+	if (!mm)
+		rc = -ESRCH;
+	else if (!ptrace_may_access(task, PTRACE_MODE_ATTACH)) {
+		mmput(mm);
+		mm = NULL;
+		rc = -EPERM;
+	}
+	mutex_unlock(&task->cred_guard_mutex);
+	if (!mm)
+		goto put_task;
+
+	for (i = 0; i < riovcnt && iter.nr_segs; i++) {
+		rc = process_vm_rw_single_vec(
+				(unsigned long)rvec[i].iov_base,
+				rvec[i].iov_len, &iter, pp_stack, mm, task,
+				vm_write, &copied);
+		if (rc)
+			break;
+	}
+	mmput(mm);
+
+put_task:
+	put_task_struct(task);
+
+	/* Report a partial copy rather than the error that stopped it */
+	if (copied)
+		return copied;
+	return rc;
+}
+
+static ssize_t process_vm_rw(pid_t pid, const struct iovec __user *lvec,
+			     unsigned long liovcnt,
+			     const struct iovec __user *rvec,
+			     unsigned long riovcnt, unsigned long flags,
+			     int vm_write)
+{
+	struct iovec iovstack_l[UIO_FASTIOV];
+	struct iovec iovstack_r[UIO_FASTIOV];
+	struct iovec *iov_l = iovstack_l;
+	struct iovec *iov_r = iovstack_r;
+	ssize_t rc;
+
+	if (flags != 0)
+		return -EINVAL;
+
+	/* The local buffers are read from for a write, and vice versa */
+	rc = rw_copy_check_uvector(vm_write ? WRITE : READ, lvec, liovcnt,
+				   UIO_FASTIOV, iovstack_l, &iov_l);
+	if (rc <= 0)
+		goto free_iovecs;
+
+	rc = rw_copy_check_uvector(CHECK_IOVEC_ONLY, rvec, riovcnt,
+				   UIO_FASTIOV, iovstack_r, &iov_r);
+	if (rc <= 0)
+		goto free_iovecs;
+
+	rc = process_vm_rw_core(pid, iov_l, liovcnt, iov_r, riovcnt, vm_write);
+
+free_iovecs:
+	if (iov_r != iovstack_r)
+		kfree(iov_r);
+	if (iov_l != iovstack_l)
+		kfree(iov_l);
+	return rc;
+}
+
+SYSCALL_DEFINE6(process_vm_readv, pid_t, pid, const struct iovec __user *, lvec,
+		unsigned long, liovcnt, const struct iovec __user *, rvec,
+		unsigned long, riovcnt,	unsigned long, flags)
+{
+	return process_vm_rw(pid, lvec, liovcnt, rvec, riovcnt, flags, 0);
+}
+
+SYSCALL_DEFINE6(process_vm_writev, pid_t, pid,
+		const struct iovec __user *, lvec,
+		unsigned long, liovcnt, const struct iovec __user *, rvec,
+		unsigned long, riovcnt,	unsigned long, flags)
+{
+	return process_vm_rw(pid, lvec, liovcnt, rvec, riovcnt, flags, 1);
+}
+
+#ifdef CONFIG_COMPAT
+
+static ssize_t compat_process_vm_rw(compat_pid_t pid,
+				    const struct compat_iovec __user *lvec,
+				    unsigned long liovcnt,
+				    const struct compat_iovec __user *rvec,
+				    unsigned long riovcnt, unsigned long flags,
+				    int vm_write)
+{
+	struct iovec iovstack_l[UIO_FASTIOV];
+	struct iovec iovstack_r[UIO_FASTIOV];
+	struct iovec *iov_l = iovstack_l;
+	struct iovec *iov_r = iovstack_r;
+	ssize_t rc;
+
+	if (flags != 0)
+		return -EINVAL;
+
+	rc = compat_rw_copy_check_uvector(vm_write ? WRITE : READ, lvec,
+					  liovcnt, UIO_FASTIOV, iovstack_l,
+					  &iov_l);
+	if (rc <= 0)
+		goto free_iovecs;
+
+	rc = compat_rw_copy_check_uvector(CHECK_IOVEC_ONLY, rvec, riovcnt,
+					  UIO_FASTIOV, iovstack_r, &iov_r);
+	if (rc <= 0)
+		goto free_iovecs;
+
+	rc = process_vm_rw_core(pid, iov_l, liovcnt, iov_r, riovcnt, vm_write);
+
+free_iovecs:
+	if (iov_r != iovstack_r)
+		kfree(iov_r);
+	if (iov_l != iovstack_l)
+		kfree(iov_l);
+	return rc;
+}
+
+asmlinkage ssize_t
+compat_sys_process_vm_readv(compat_pid_t pid,
+			    const struct compat_iovec __user *lvec,
+			    unsigned long liovcnt,
+			    const struct compat_iovec __user *rvec,
+			    unsigned long riovcnt, unsigned long flags)
+{
+	return compat_process_vm_rw(pid, lvec, liovcnt, rvec,
+				    riovcnt, flags, 0);
+}
+
+asmlinkage ssize_t
+compat_sys_process_vm_writev(compat_pid_t pid,
+			     const struct compat_iovec __user *lvec,
+			     unsigned long liovcnt,
+			     const struct compat_iovec __user *rvec,
+			     unsigned long riovcnt, unsigned long flags)
+{
+	return compat_process_vm_rw(pid, lvec, liovcnt, rvec,
+				    riovcnt, flags, 1);
+}
+
+#endif /* CONFIG_COMPAT */
@@ -269,7 +269,7 @@ pte_t *page_check_address(struct page *page, struct mm_struct *mm,
 {
 	pgd_t *pgd;
 	pud_t *pud;
-	pmd_t *pmd;
+	pmd_t *pmd, pmdval;
 	pte_t *pte;
 	spinlock_t *ptl;
 
@@ -282,7 +282,19 @@ pte_t *page_check_address(struct page *page, struct mm_struct *mm,
 		return NULL;
 
 	pmd = pmd_offset(pud, address);
-	if (!pmd_present(*pmd))
+	/*
+	 * Callers want a pte: break up a huge pmd.  A none pmd may become
+	 * huge under us, but a pte table stays one while we hold the rmap
+	 * lock, so only trust a single read of the pmd.
+	 */
+	pmdval = *pmd;
+	barrier();
+	if (pmd_trans_huge(pmdval)) {
+		split_huge_pmd(mm, pmd, address);
+		pmdval = *pmd;
+		barrier();
+	}
+	if (!pmd_present(pmdval) || pmd_trans_huge(pmdval))
 		return NULL;
 
 	pte = pte_offset_map(pmd, address);
@@ -339,6 +351,7 @@ static int page_referenced_one(struct page *page,
 {
 	struct mm_struct *mm = vma->vm_mm;
 	unsigned long address;
+	pmd_t *pmd;
 	pte_t *pte;
 	spinlock_t *ptl;
 	int referenced = 0;
@@ -347,6 +360,20 @@ static int page_referenced_one(struct page *page,
 	if (address == -EFAULT)
 		goto out;
 
+	/* Age a huge mapping as a whole rather than splitting it */
+	pmd = page_check_huge_pmd(page, mm, address);
+	if (pmd) {
+		if (vma->vm_flags & VM_LOCKED) {
+			*mapcount = 1;
+			*vm_flags |= VM_LOCKED;
+		} else if (pmdp_clear_flush_young(vma, address, pmd) &&
+			   likely(!VM_SequentialReadHint(vma)))
+			referenced++;
+		(*mapcount)--;
+		spin_unlock(&mm->page_table_lock);
+		goto out;
+	}
+
 	pte = page_check_address(page, mm, address, &ptl, 0);
 	if (!pte)
 		goto out;
@@ -551,6 +578,8 @@ static int page_mkclean_one(struct page *page, struct vm_area_struct *vma)
 
 		flush_cache_page(vma, address, pte_pfn(*pte));
 		entry = ptep_clear_flush_notify(vma, address, pte);
+		if (pte_table_shared(virt_to_page(pte)))
+			flush_shared_pte(vma, pte, address);
 		entry = pte_wrprotect(entry);
 		entry = pte_mkclean(entry);
 		set_pte_at(mm, address, pte, entry);
@@ -810,6 +839,9 @@ static int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 	/* Nuke the page table entry. */
 	flush_cache_page(vma, address, page_to_pfn(page));
 	pteval = ptep_clear_flush_notify(vma, address, pte);
+	/* A shared pte table may be cached in other mms' TLBs too */
+	if (pte_table_shared(virt_to_page(pte)))
+		flush_shared_pte(vma, pte, address);
 
 	/* Move the dirty bit to the physical page now the pte is gone. */
 	if (pte_dirty(pteval))
@@ -850,7 +882,7 @@ static int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 		swp_entry_t entry;
 		entry = make_migration_entry(page, pte_write(pteval));
 		set_pte_at(mm, address, pte, swp_entry_to_pte(entry));
-	} else
+	} else if (!pte_table_uncounted(virt_to_page(pte)))
 		dec_mm_counter(mm, file_rss);
 
 
@@ -922,6 +954,8 @@ static int try_to_unmap_cluster(unsigned long cursor, unsigned int *mapcount,
 		return ret;
 
 	pmd = pmd_offset(pud, address);
+	/* Huge pmds mapped before the vma went nonlinear */
+	split_huge_pmd(mm, pmd, address);
 	if (!pmd_present(*pmd))
 		return ret;
 
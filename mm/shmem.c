@@ -58,6 +58,7 @@ static struct vfsmount *shm_mnt;
 #include <linux/ctype.h>
 #include <linux/migrate.h>
 #include <linux/highmem.h>
+#include <linux/pagevec.h>
 #include <linux/seq_file.h>
 #include <linux/magic.h>
 
@@ -107,6 +108,37 @@ enum sgp_type {
 	SGP_WRITE,	/* may exceed i_size, may allocate page */
 };
 
+/* When to allocate page cache in huge extents, and map them with a pmd */
+#define SHMEM_HUGE_NEVER	0	/* never */
+#define SHMEM_HUGE_ALWAYS	1	/* for every extent */
+#define SHMEM_HUGE_WITHIN_SIZE	2	/* for extents inside i_size */
+#define SHMEM_HUGE_ADVISE	3	/* for extents faulted via MADV_HUGEPAGE */
+
+#if defined(CONFIG_TMPFS) || defined(CONFIG_SHMEM_HUGEPAGE)
+static const char *shmem_huge_names[] = {
+	[SHMEM_HUGE_NEVER]		= "never",
+	[SHMEM_HUGE_ALWAYS]		= "always",
+	[SHMEM_HUGE_WITHIN_SIZE]	= "within_size",
+	[SHMEM_HUGE_ADVISE]		= "advise",
+};
+
+static int shmem_parse_huge(const char *str)
+{
+	int huge;
+
+	for (huge = 0; huge < ARRAY_SIZE(shmem_huge_names); huge++)
+		if (sysfs_streq(str, shmem_huge_names[huge]))
+			break;
+	if (huge == ARRAY_SIZE(shmem_huge_names))
+		return -EINVAL;
+#ifndef CONFIG_SHMEM_HUGEPAGE
+	if (huge != SHMEM_HUGE_NEVER)
+		return -EINVAL;
+#endif
+	return huge;
+}
+#endif
+
 #ifdef CONFIG_TMPFS
 static unsigned long shmem_default_max_blocks(void)
 {
@@ -119,8 +151,15 @@ static unsigned long shmem_default_max_inodes(void)
 }
 #endif
 
-static int shmem_getpage(struct inode *inode, unsigned long idx,
-			 struct page **pagep, enum sgp_type sgp, int *type);
+static int __shmem_getpage(struct inode *inode, unsigned long idx,
+			   struct page **pagep, enum sgp_type sgp, int *type,
+			   struct page **newpagep);
+
+static inline int shmem_getpage(struct inode *inode, unsigned long idx,
+				struct page **pagep, enum sgp_type sgp, int *type)
+{
+	return __shmem_getpage(inode, idx, pagep, sgp, type, NULL);
+}
 
 static inline struct page *shmem_dir_alloc(gfp_t gfp_mask)
 {
@@ -1201,9 +1240,13 @@ static inline struct mempolicy *shmem_get_sbmpol(struct shmem_sb_info *sbinfo)
  * If we allocate a new one we do not mark it dirty. That's up to the
  * vm. If we swap it in we mark it dirty since we also free the swap
  * entry since a page cannot live in both the swap and page cache
+ *
+ * If @newpagep is given, *@newpagep is used instead of allocating a new
+ * page, and cleared once it has been consumed.
  */
-static int shmem_getpage(struct inode *inode, unsigned long idx,
-			struct page **pagep, enum sgp_type sgp, int *type)
+static int __shmem_getpage(struct inode *inode, unsigned long idx,
+			   struct page **pagep, enum sgp_type sgp, int *type,
+			   struct page **newpagep)
 {
 	struct address_space *mapping = inode->i_mapping;
 	struct shmem_inode_info *info = SHMEM_I(inode);
@@ -1395,7 +1438,11 @@ repeat:
 			int ret;
 
 			spin_unlock(&info->lock);
-			filepage = shmem_alloc_page(gfp, info, idx);
+			if (newpagep && *newpagep) {
+				filepage = *newpagep;
+				*newpagep = NULL;
+			} else
+				filepage = shmem_alloc_page(gfp, info, idx);
 			if (!filepage) {
 				shmem_unacct_blocks(info->flags, 1);
 				shmem_free_blocks(inode, 1);
@@ -1482,6 +1529,229 @@ static int shmem_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	return ret | VM_FAULT_LOCKED;
 }
 
+#ifdef CONFIG_SHMEM_HUGEPAGE
+/* Policy of the internal mount, for SysV shm and shared anonymous memory */
+static int shmem_huge __read_mostly;
+
+/*
+ * Should the extent of HPAGE_PMD_NR pages at @hindex be huge?  @size is
+ * the file size to judge "within_size" by, @vma the mapping faulting on
+ * the extent, if any.
+ */
+static int shmem_huge_enabled(struct inode *inode, pgoff_t hindex,
+			      loff_t size, struct vm_area_struct *vma)
+{
+	switch (SHMEM_SB(inode->i_sb)->huge) {
+	case SHMEM_HUGE_ALWAYS:
+		return 1;
+	case SHMEM_HUGE_WITHIN_SIZE:
+		return hindex + HPAGE_PMD_NR <=
+			(size + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	case SHMEM_HUGE_ADVISE:
+		return vma && (vma->vm_flags & VM_HUGEPAGE);
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Allocate the extent at @hindex as one naturally aligned block, unless
+ * some of it is cached already.  The block is split at once and each page
+ * goes into the page cache through shmem_getpage() like any other: so
+ * swapout, memcg and truncation see small pages, and a hole punched into
+ * the extent, or a page swapped out of it, simply stops it being mapped
+ * by a pmd from then on.
+ */
+static void shmem_huge_populate(struct inode *inode, pgoff_t hindex,
+				enum sgp_type sgp)
+{
+	struct address_space *mapping = inode->i_mapping;
+	struct shmem_inode_info *info = SHMEM_I(inode);
+	struct shmem_sb_info *sbinfo = SHMEM_SB(inode->i_sb);
+	struct mempolicy *mpol;
+	struct page *page, *newpage, *filepage;
+	int error = 0;
+	int i;
+
+	if (hindex + HPAGE_PMD_NR > SHMEM_MAX_INDEX)
+		return;
+	if (find_get_pages(mapping, hindex, 1, &page)) {
+		int cached = page->index < hindex + HPAGE_PMD_NR;
+
+		page_cache_release(page);
+		if (cached)
+			return;
+	}
+	/* Don't use up a size limit on pages that may never be written */
+	if (sbinfo->max_blocks && sbinfo->free_blocks < HPAGE_PMD_NR)
+		return;
+	/* A shared memory policy is applied page by page */
+	mpol = mpol_shared_policy_lookup(&info->policy, hindex);
+	if (mpol) {
+		mpol_cond_put(mpol);
+		return;
+	}
+
+	page = alloc_pages(mapping_gfp_mask(mapping) |
+			   __GFP_NORETRY | __GFP_NOWARN, HPAGE_PMD_ORDER);
+	if (!page) {
+		count_vm_event(SHMEM_HUGE_FALLBACK);
+		return;
+	}
+	count_vm_event(SHMEM_HUGE_ALLOC);
+	split_page(page, HPAGE_PMD_ORDER);
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		newpage = page + i;
+		filepage = NULL;
+		if (!error)
+			error = __shmem_getpage(inode, hindex + i, &filepage,
+						sgp, NULL, &newpage);
+		if (filepage) {
+			unlock_page(filepage);
+			page_cache_release(filepage);
+		}
+		if (newpage)
+			__free_page(newpage);
+	}
+}
+
+/*
+ * Take a reference on and lock each page of the extent at @hindex, if it
+ * is all cached, uptodate and one naturally aligned block.  Returns the
+ * first page, or NULL.
+ */
+static struct page *shmem_lock_extent(struct address_space *mapping,
+				      pgoff_t hindex)
+{
+	struct page *batch[PAGEVEC_SIZE];
+	struct page *head = NULL;
+	int locked = 0;
+	int nr, i;
+
+	while (locked < HPAGE_PMD_NR) {
+		nr = find_get_pages_contig(mapping, hindex + locked,
+				min_t(int, PAGEVEC_SIZE, HPAGE_PMD_NR - locked),
+				batch);
+		if (!nr)
+			goto unlock;
+		if (!head) {
+			head = batch[0];
+			if (page_to_pfn(head) & (HPAGE_PMD_NR - 1))
+				head = NULL;
+		}
+		for (i = 0; i < nr; i++) {
+			struct page *page = batch[i];
+
+			if (!head || page != head + locked ||
+			    !PageUptodate(page) || !trylock_page(page))
+				break;
+			locked++;
+		}
+		if (i < nr) {
+			while (i < nr)
+				page_cache_release(batch[i++]);
+			goto unlock;
+		}
+	}
+	return head;
+
+unlock:
+	for (i = 0; i < locked; i++) {
+		unlock_page(head + i);
+		page_cache_release(head + i);
+	}
+	return NULL;
+}
+
+static int shmem_pmd_fault(struct vm_area_struct *vma, unsigned long address,
+			   pmd_t *pmd, unsigned int flags)
+{
+	struct inode *inode = vma->vm_file->f_path.dentry->d_inode;
+	struct address_space *mapping = inode->i_mapping;
+	unsigned long haddr = address & HPAGE_PMD_MASK;
+	struct page *head;
+	pgoff_t hindex;
+	int ret = VM_FAULT_FALLBACK;
+	int i;
+
+	/* Private mappings need ptes for COW, nonlinear ones for pte_file */
+	if (!(vma->vm_flags & VM_SHARED) || (vma->vm_flags & VM_NONLINEAR))
+		return VM_FAULT_FALLBACK;
+	if (haddr < vma->vm_start || haddr + HPAGE_PMD_SIZE > vma->vm_end)
+		return VM_FAULT_FALLBACK;
+	hindex = linear_page_index(vma, haddr);
+	if (hindex & (HPAGE_PMD_NR - 1))
+		return VM_FAULT_FALLBACK;
+	if (!shmem_huge_enabled(inode, hindex, i_size_read(inode), vma) ||
+	    hindex + HPAGE_PMD_NR > DIV_ROUND_UP(i_size_read(inode),
+						 PAGE_CACHE_SIZE))
+		return VM_FAULT_FALLBACK;
+
+	shmem_huge_populate(inode, hindex, SGP_CACHE);
+
+	head = shmem_lock_extent(mapping, hindex);
+	if (!head)
+		return VM_FAULT_FALLBACK;
+
+	/* Page locks hold off truncation: check it did not get there first */
+	for (i = 0; i < HPAGE_PMD_NR; i++)
+		if (head[i].mapping != mapping)
+			goto out;
+	if (hindex + HPAGE_PMD_NR > DIV_ROUND_UP(i_size_read(inode),
+						 PAGE_CACHE_SIZE))
+		goto out;
+
+	ret = do_set_huge_pmd(vma, address, pmd, head, flags);
+out:
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		unlock_page(head + i);
+		page_cache_release(head + i);
+	}
+	return ret;
+}
+
+static ssize_t shmem_huge_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	int huge, len = 0;
+
+	for (huge = 0; huge < ARRAY_SIZE(shmem_huge_names); huge++)
+		len += sprintf(buf + len, huge == shmem_huge ? "[%s] " : "%s ",
+			       shmem_huge_names[huge]);
+	buf[len - 1] = '\n';
+	return len;
+}
+
+static ssize_t shmem_huge_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	int huge = shmem_parse_huge(buf);
+
+	if (huge < 0)
+		return huge;
+	shmem_huge = huge;
+	/* the file is only created once shm_mnt is mounted */
+	SHMEM_SB(shm_mnt->mnt_sb)->huge = huge;
+	return count;
+}
+
+static struct kobj_attribute shmem_huge_attr =
+	__ATTR(shmem_huge, 0644, shmem_huge_show, shmem_huge_store);
+
+static int __init setup_shmem_huge(char *str)
+{
+	int huge = shmem_parse_huge(str);
+
+	if (huge < 0)
+		return 0;
+	shmem_huge = huge;
+	return 1;
+}
+__setup("shmem_huge=", setup_shmem_huge);
+#endif /* CONFIG_SHMEM_HUGEPAGE */
+
 #ifdef CONFIG_NUMA
 static int shmem_set_policy(struct vm_area_struct *vma, struct mempolicy *new)
 {
@@ -1526,6 +1796,12 @@ out_nomem:
 	return retval;
 }
 
+/* Does @mapping hold the pages of a tmpfs file or a shared memory segment? */
+int shmem_mapping(struct address_space *mapping)
+{
+	return mapping->a_ops == &shmem_aops;
+}
+
 static int shmem_mmap(struct file *file, struct vm_area_struct *vma)
 {
 	file_accessed(file);
@@ -1616,6 +1892,14 @@ shmem_write_begin(struct file *file, struct address_space *mapping,
 {
 	struct inode *inode = mapping->host;
 	pgoff_t index = pos >> PAGE_CACHE_SHIFT;
+#ifdef CONFIG_SHMEM_HUGEPAGE
+	pgoff_t hindex = index & ~(pgoff_t)(HPAGE_PMD_NR - 1);
+
+	if (shmem_huge_enabled(inode, hindex,
+			       max_t(loff_t, i_size_read(inode), pos + len),
+			       NULL))
+		shmem_huge_populate(inode, hindex, SGP_WRITE);
+#endif
 	*pagep = NULL;
 	return shmem_getpage(inode, index, pagep, SGP_WRITE, NULL);
 }
@@ -2215,6 +2499,11 @@ static int shmem_parse_options(char *options, struct shmem_sb_info *sbinfo,
 		} else if (!strcmp(this_char,"mpol")) {
 			if (mpol_parse_str(value, &sbinfo->mpol, 1))
 				goto bad_val;
+		} else if (!strcmp(this_char,"huge")) {
+			int huge = shmem_parse_huge(value);
+			if (huge < 0)
+				goto bad_val;
+			sbinfo->huge = huge;
 		} else {
 			printk(KERN_ERR "tmpfs: Bad mount option %s\n",
 			       this_char);
@@ -2264,6 +2553,7 @@ static int shmem_remount_fs(struct super_block *sb, int *flags, char *data)
 	sbinfo->free_blocks = config.max_blocks - blocks;
 	sbinfo->max_inodes  = config.max_inodes;
 	sbinfo->free_inodes = config.max_inodes - inodes;
+	sbinfo->huge        = config.huge;
 
 	mpol_put(sbinfo->mpol);
 	sbinfo->mpol        = config.mpol;	/* transfers initial ref */
@@ -2287,6 +2577,8 @@ static int shmem_show_options(struct seq_file *seq, struct vfsmount *vfs)
 		seq_printf(seq, ",uid=%u", sbinfo->uid);
 	if (sbinfo->gid != 0)
 		seq_printf(seq, ",gid=%u", sbinfo->gid);
+	if (sbinfo->huge)
+		seq_printf(seq, ",huge=%s", shmem_huge_names[sbinfo->huge]);
 	shmem_show_mpol(seq, sbinfo->mpol);
 	return 0;
 }
@@ -2318,6 +2610,11 @@ static int shmem_fill_super(struct super_block *sb,
 	sbinfo->uid = current_fsuid();
 	sbinfo->gid = current_fsgid();
 	sbinfo->mpol = NULL;
+	sbinfo->huge = SHMEM_HUGE_NEVER;
+#ifdef CONFIG_SHMEM_HUGEPAGE
+	if (sb->s_flags & MS_NOUSER)
+		sbinfo->huge = shmem_huge;
+#endif
 	sb->s_fs_info = sbinfo;
 
 #ifdef CONFIG_TMPFS
@@ -2499,6 +2796,9 @@ static const struct super_operations shmem_ops = {
 
 static struct vm_operations_struct shmem_vm_ops = {
 	.fault		= shmem_fault,
+#ifdef CONFIG_SHMEM_HUGEPAGE
+	.pmd_fault	= shmem_pmd_fault,
+#endif
 #ifdef CONFIG_NUMA
 	.set_policy     = shmem_set_policy,
 	.get_policy     = shmem_get_policy,
@@ -2544,6 +2844,10 @@ static int __init init_tmpfs(void)
 		printk(KERN_ERR "Could not kern_mount tmpfs\n");
 		goto out1;
 	}
+#ifdef CONFIG_SHMEM_HUGEPAGE
+	if (sysfs_create_file(mm_kobj, &shmem_huge_attr.attr))
+		printk(KERN_ERR "Could not create /sys/kernel/mm/shmem_huge\n");
+#endif
 	return 0;
 
 out1:
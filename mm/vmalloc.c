@@ -52,6 +52,8 @@ static void vunmap_pmd_range(pud_t *pud, unsigned long addr, unsigned long end)
 	pmd = pmd_offset(pud, addr);
 	do {
 		next = pmd_addr_end(addr, end);
+		if (pmd_clear_huge(pmd))
+			continue;
 		if (pmd_none_or_clear_bad(pmd))
 			continue;
 		vunmap_pte_range(pmd, addr, next);
@@ -113,8 +115,36 @@ static int vmap_pte_range(pmd_t *pmd, unsigned long addr,
 	return 0;
 }
 
-static int vmap_pmd_range(pud_t *pud, unsigned long addr,
+/*
+ * Map a whole PMD worth of pages with one large page if the pages are
+ * physically contiguous and suitably aligned.  Returns 1 on success.
+ */
+static int vmap_try_huge_pmd(pmd_t *pmd, unsigned long addr,
 		unsigned long end, pgprot_t prot, struct page **pages, int *nr)
+{
+	unsigned long pfn;
+	int i;
+
+	if (end - addr != PMD_SIZE || !pmd_none(*pmd))
+		return 0;
+
+	pfn = page_to_pfn(pages[*nr]);
+	if (!IS_ALIGNED(pfn, PMD_SIZE >> PAGE_SHIFT))
+		return 0;
+	for (i = 1; i < PMD_SIZE >> PAGE_SHIFT; i++) {
+		if (page_to_pfn(pages[*nr + i]) != pfn + i)
+			return 0;
+	}
+
+	if (!pmd_set_huge(pmd, (phys_addr_t)pfn << PAGE_SHIFT, prot))
+		return 0;
+	*nr += PMD_SIZE >> PAGE_SHIFT;
+	return 1;
+}
+
+static int vmap_pmd_range(pud_t *pud, unsigned long addr,
+		unsigned long end, pgprot_t prot, struct page **pages, int *nr,
+		int huge)
 {
 	pmd_t *pmd;
 	unsigned long next;
@@ -124,6 +154,8 @@ static int vmap_pmd_range(pud_t *pud, unsigned long addr,
 		return -ENOMEM;
 	do {
 		next = pmd_addr_end(addr, end);
+		if (huge && vmap_try_huge_pmd(pmd, addr, next, prot, pages, nr))
+			continue;
 		if (vmap_pte_range(pmd, addr, next, prot, pages, nr))
 			return -ENOMEM;
 	} while (pmd++, addr = next, addr != end);
@@ -131,7 +163,8 @@ static int vmap_pmd_range(pud_t *pud, unsigned long addr,
 }
 
 static int vmap_pud_range(pgd_t *pgd, unsigned long addr,
-		unsigned long end, pgprot_t prot, struct page **pages, int *nr)
+		unsigned long end, pgprot_t prot, struct page **pages, int *nr,
+		int huge)
 {
 	pud_t *pud;
 	unsigned long next;
@@ -141,7 +174,7 @@ static int vmap_pud_range(pgd_t *pgd, unsigned long addr,
 		return -ENOMEM;
 	do {
 		next = pud_addr_end(addr, end);
-		if (vmap_pmd_range(pud, addr, next, prot, pages, nr))
+		if (vmap_pmd_range(pud, addr, next, prot, pages, nr, huge))
 			return -ENOMEM;
 	} while (pud++, addr = next, addr != end);
 	return 0;
@@ -152,9 +185,12 @@ static int vmap_pud_range(pgd_t *pgd, unsigned long addr,
  * will have pfns corresponding to the "pages" array.
  *
  * Ie. pte at addr+N*PAGE_SIZE shall point to pfn corresponding to pages[N]
+ *
+ * If "huge" is set, PMD-aligned runs of physically contiguous pages are
+ * mapped with a single large page instead of a pte table.
  */
 static int vmap_page_range_noflush(unsigned long start, unsigned long end,
-				   pgprot_t prot, struct page **pages)
+				   pgprot_t prot, struct page **pages, int huge)
 {
 	pgd_t *pgd;
 	unsigned long next;
@@ -166,7 +202,7 @@ static int vmap_page_range_noflush(unsigned long start, unsigned long end,
 	pgd = pgd_offset_k(addr);
 	do {
 		next = pgd_addr_end(addr, end);
-		err = vmap_pud_range(pgd, addr, next, prot, pages, &nr);
+		err = vmap_pud_range(pgd, addr, next, prot, pages, &nr, huge);
 		if (err)
 			break;
 	} while (pgd++, addr = next, addr != end);
@@ -177,11 +213,11 @@ static int vmap_page_range_noflush(unsigned long start, unsigned long end,
 }
 
 static int vmap_page_range(unsigned long start, unsigned long end,
-			   pgprot_t prot, struct page **pages)
+			   pgprot_t prot, struct page **pages, int huge)
 {
 	int ret;
 
-	ret = vmap_page_range_noflush(start, end, prot, pages);
+	ret = vmap_page_range_noflush(start, end, prot, pages, huge);
 	flush_cache_vmap(start, end);
 	return ret;
 }
@@ -220,7 +256,10 @@ struct page *vmalloc_to_page(const void *vmalloc_addr)
 		pud_t *pud = pud_offset(pgd, addr);
 		if (!pud_none(*pud)) {
 			pmd_t *pmd = pmd_offset(pud, addr);
-			if (!pmd_none(*pmd)) {
+			if (pmd_huge_vmap(*pmd)) {
+				page = pmd_page(*pmd) +
+					((addr & ~PMD_MASK) >> PAGE_SHIFT);
+			} else if (!pmd_none(*pmd)) {
 				pte_t *ptep, pte;
 
 				ptep = pte_offset_map(pmd, addr);
@@ -980,7 +1019,7 @@ void *vm_map_ram(struct page **pages, unsigned int count, int node, pgprot_t pro
 		addr = va->va_start;
 		mem = (void *)addr;
 	}
-	if (vmap_page_range(addr, addr + size, prot, pages) < 0) {
+	if (vmap_page_range(addr, addr + size, prot, pages, 0) < 0) {
 		vm_unmap_ram(mem, count);
 		return NULL;
 	}
@@ -1063,7 +1102,7 @@ void __init vmalloc_init(void)
 int map_kernel_range_noflush(unsigned long addr, unsigned long size,
 			     pgprot_t prot, struct page **pages)
 {
-	return vmap_page_range_noflush(addr, addr + size, prot, pages);
+	return vmap_page_range_noflush(addr, addr + size, prot, pages, 0);
 }
 
 /**
@@ -1108,7 +1147,7 @@ int map_vm_area(struct vm_struct *area, pgprot_t prot, struct page ***pages)
 	unsigned long end = addr + area->size - PAGE_SIZE;
 	int err;
 
-	err = vmap_page_range(addr, end, prot, *pages);
+	err = vmap_page_range(addr, end, prot, *pages, area->flags & VM_HUGE);
 	if (err > 0) {
 		*pages += err;
 		err = 0;
@@ -1142,6 +1181,8 @@ static struct vm_struct *__get_vm_area_node(unsigned long size,
 
 		align = 1ul << bit;
 	}
+	if (flags & VM_HUGE)
+		align = PMD_SIZE;
 
 	size = PAGE_ALIGN(size);
 	if (unlikely(!size))
@@ -1387,6 +1428,33 @@ EXPORT_SYMBOL(vmap);
 
 static void *__vmalloc_node(unsigned long size, gfp_t gfp_mask, pgprot_t prot,
 			    int node, void *caller);
+
+/*
+ * Try to back pages[0 .. PMD_SIZE/PAGE_SIZE) with a single naturally
+ * aligned high-order page, split into order-0 pages so that __vunmap()
+ * can free them one by one.  Returns 0 on failure, in which case the
+ * caller fills the range with order-0 pages instead.
+ */
+static int vmalloc_huge_chunk(struct page **pages, gfp_t gfp_mask, int node)
+{
+	unsigned int order = PMD_SHIFT - PAGE_SHIFT;
+	struct page *page;
+	int i;
+
+	gfp_mask |= __GFP_NOWARN | __GFP_NORETRY;
+	if (node < 0)
+		page = alloc_pages(gfp_mask, order);
+	else
+		page = alloc_pages_node(node, gfp_mask, order);
+	if (!page)
+		return 0;
+
+	split_page(page, order);
+	for (i = 0; i < 1 << order; i++)
+		pages[i] = page + i;
+	return 1;
+}
+
 static void *__vmalloc_area_node(struct vm_struct *area, gfp_t gfp_mask,
 				 pgprot_t prot, int node, void *caller)
 {
@@ -1418,6 +1486,14 @@ static void *__vmalloc_area_node(struct vm_struct *area, gfp_t gfp_mask,
 	for (i = 0; i < area->nr_pages; i++) {
 		struct page *page;
 
+		if ((area->flags & VM_HUGE) &&
+		    IS_ALIGNED(i, PMD_SIZE >> PAGE_SHIFT) &&
+		    area->nr_pages - i >= PMD_SIZE >> PAGE_SHIFT &&
+		    vmalloc_huge_chunk(area->pages + i, gfp_mask, node)) {
+			i += (PMD_SIZE >> PAGE_SHIFT) - 1;
+			continue;
+		}
+
 		if (node < 0)
 			page = alloc_page(gfp_mask);
 		else
@@ -1456,19 +1532,24 @@ void *__vmalloc_area(struct vm_struct *area, gfp_t gfp_mask, pgprot_t prot)
 }
 
 /**
- *	__vmalloc_node  -  allocate virtually contiguous memory
+ *	__vmalloc_node_flags  -  allocate virtually contiguous memory
  *	@size:		allocation size
  *	@gfp_mask:	flags for the page level allocator
  *	@prot:		protection mask for the allocated pages
+ *	@vm_flags:	additional vm_struct flags (%VM_HUGE)
  *	@node:		node to use for allocation or -1
  *	@caller:	caller's return address
  *
  *	Allocate enough pages to cover @size from the page level
  *	allocator with @gfp_mask flags.  Map them into contiguous
  *	kernel virtual space, using a pagetable protection of @prot.
+ *
+ *	With %VM_HUGE, allocations of at least PMD_SIZE are rounded up to
+ *	a multiple of PMD_SIZE and backed by large pages where possible.
  */
-static void *__vmalloc_node(unsigned long size, gfp_t gfp_mask, pgprot_t prot,
-						int node, void *caller)
+static void *__vmalloc_node_flags(unsigned long size, gfp_t gfp_mask,
+				  pgprot_t prot, unsigned long vm_flags,
+				  int node, void *caller)
 {
 	struct vm_struct *area;
 	void *addr;
@@ -1478,8 +1559,14 @@ static void *__vmalloc_node(unsigned long size, gfp_t gfp_mask, pgprot_t prot,
 	if (!size || (size >> PAGE_SHIFT) > num_physpages)
 		return NULL;
 
-	area = __get_vm_area_node(size, VM_ALLOC, VMALLOC_START, VMALLOC_END,
-						node, gfp_mask, caller);
+	if ((vm_flags & VM_HUGE) && size >= PMD_SIZE &&
+	    arch_vmap_pmd_supported())
+		size = ALIGN(size, PMD_SIZE);
+	else
+		vm_flags &= ~VM_HUGE;
+
+	area = __get_vm_area_node(size, VM_ALLOC | vm_flags, VMALLOC_START,
+				  VMALLOC_END, node, gfp_mask, caller);
 
 	if (!area)
 		return NULL;
@@ -1496,6 +1583,12 @@ static void *__vmalloc_node(unsigned long size, gfp_t gfp_mask, pgprot_t prot,
 	return addr;
 }
 
+static void *__vmalloc_node(unsigned long size, gfp_t gfp_mask, pgprot_t prot,
+			    int node, void *caller)
+{
+	return __vmalloc_node_flags(size, gfp_mask, prot, 0, node, caller);
+}
+
 void *__vmalloc(unsigned long size, gfp_t gfp_mask, pgprot_t prot)
 {
 	return __vmalloc_node(size, gfp_mask, prot, -1,
@@ -1503,6 +1596,40 @@ void *__vmalloc(unsigned long size, gfp_t gfp_mask, pgprot_t prot)
 }
 EXPORT_SYMBOL(__vmalloc);
 
+/**
+ *	__vmalloc_flags  -  allocate virtually contiguous memory
+ *	@size:		allocation size
+ *	@gfp_mask:	flags for the page level allocator
+ *	@prot:		protection mask for the allocated pages
+ *	@vm_flags:	%VM_HUGE to ask for large page backing
+ *
+ *	Like __vmalloc(), but lets the caller request that the area be
+ *	mapped with PMD-sized pages where memory and alignment allow.
+ */
+void *__vmalloc_flags(unsigned long size, gfp_t gfp_mask, pgprot_t prot,
+		      unsigned long vm_flags)
+{
+	return __vmalloc_node_flags(size, gfp_mask, prot, vm_flags, -1,
+				    __builtin_return_address(0));
+}
+EXPORT_SYMBOL(__vmalloc_flags);
+
+/**
+ *	vmalloc_huge  -  allocate virtually contiguous memory with large pages
+ *	@size:		allocation size
+ *
+ *	Allocate enough pages to cover @size and map them into contiguous
+ *	kernel virtual space, using PMD-sized mappings where possible to
+ *	save TLB entries.  Falls back to small pages transparently.
+ */
+void *vmalloc_huge(unsigned long size)
+{
+	return __vmalloc_node_flags(size, GFP_KERNEL | __GFP_HIGHMEM,
+				    PAGE_KERNEL, VM_HUGE, -1,
+				    __builtin_return_address(0));
+}
+EXPORT_SYMBOL(vmalloc_huge);
+
 /**
  *	vmalloc  -  allocate virtually contiguous memory
  *	@size:		allocation size
@@ -1906,6 +2033,9 @@ static int s_show(struct seq_file *m, void *p)
 	if (v->flags & VM_VPAGES)
 		seq_printf(m, " vpages");
 
+	if (v->flags & VM_HUGE)
+		seq_printf(m, " huge");
+
 	show_numa_info(m, v);
 	seq_putc(m, '\n');
 	return 0;
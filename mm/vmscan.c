@@ -81,6 +81,14 @@ struct scan_control {
 	/* Which cgroup do we reclaim from */
 	struct mem_cgroup *mem_cgroup;
 
+	/*
+	 * For kswapd: this thread's index, and the number of kswapd threads
+	 * of the node, which share out the node's LRU lists between them,
+	 * see kswapd_owns_list().
+	 */
+	int kswapd_id;
+	int nr_kswapd;
+
 	/*
 	 * Nodemask of nodes allowed by the caller. If NULL, all nodes
 	 * are scanned.
@@ -164,6 +172,11 @@ static unsigned long zone_nr_pages(struct zone *zone, struct scan_control *sc,
 void register_shrinker(struct shrinker *shrinker)
 {
 	shrinker->nr = 0;
+	/* Without it, the nodes just share the deferred count in ->nr */
+	shrinker->nr_deferred = NULL;
+	if (shrinker->flags & SHRINKER_NUMA_AWARE)
+		shrinker->nr_deferred = kcalloc(nr_node_ids, sizeof(long),
+						GFP_KERNEL);
 	down_write(&shrinker_rwsem);
 	list_add_tail(&shrinker->list, &shrinker_list);
 	up_write(&shrinker_rwsem);
@@ -178,10 +191,74 @@ void unregister_shrinker(struct shrinker *shrinker)
 	down_write(&shrinker_rwsem);
 	list_del(&shrinker->list);
 	up_write(&shrinker_rwsem);
+	kfree(shrinker->nr_deferred);
+	shrinker->nr_deferred = NULL;
 }
 EXPORT_SYMBOL(unregister_shrinker);
 
 #define SHRINK_BATCH 128
+
+/*
+ * Age one shrinker, for the node in sc->nid only if it is NUMA aware.
+ * *nr carries the scan work deferred from earlier calls, for that node.
+ */
+static unsigned long shrink_slab_node(struct shrinker *shrinker,
+				      struct shrink_control *sc, long *nr,
+				      unsigned long scanned,
+				      unsigned long lru_pages)
+{
+	unsigned long long delta;
+	unsigned long total_scan;
+	unsigned long max_pass;
+	unsigned long ret = 0;
+
+	sc->nr_to_scan = 0;
+	max_pass = (*shrinker->shrink)(shrinker, sc);
+
+	delta = (4 * scanned) / shrinker->seeks;
+	delta *= max_pass;
+	do_div(delta, lru_pages + 1);
+	*nr += delta;
+	if (*nr < 0) {
+		printk(KERN_ERR "shrink_slab: %pF negative objects to "
+		       "delete nr=%ld\n", shrinker->shrink, *nr);
+		*nr = max_pass;
+	}
+
+	/*
+	 * Avoid risking looping forever due to too large nr value:
+	 * never try to free more than twice the estimate number of
+	 * freeable entries.
+	 */
+	if (*nr > max_pass * 2)
+		*nr = max_pass * 2;
+
+	total_scan = *nr;
+	*nr = 0;
+
+	while (total_scan >= SHRINK_BATCH) {
+		long this_scan = SHRINK_BATCH;
+		int shrink_ret;
+		int nr_before;
+
+		sc->nr_to_scan = 0;
+		nr_before = (*shrinker->shrink)(shrinker, sc);
+		sc->nr_to_scan = this_scan;
+		shrink_ret = (*shrinker->shrink)(shrinker, sc);
+		if (shrink_ret == -1)
+			break;
+		if (shrink_ret < nr_before)
+			ret += nr_before - shrink_ret;
+		count_vm_events(SLABS_SCANNED, this_scan);
+		total_scan -= this_scan;
+
+		cond_resched();
+	}
+
+	*nr += total_scan;
+	return ret;
+}
+
 /*
  * Call the shrink functions to age shrinkable caches
  *
@@ -199,65 +276,46 @@ EXPORT_SYMBOL(unregister_shrinker);
  * are eligible for the caller's allocation attempt.  It is used for balancing
  * slab reclaim versus page reclaim.
  *
+ * `nodes' are the nodes those zones are on, or NULL for all of them.  NUMA
+ * aware shrinkers only age the objects on these nodes: the pressure on each
+ * node is its share of the objects relative to `lru_pages', so that summed
+ * over the nodes it is the same as for a shrinker aging its whole cache.
+ *
  * Returns the number of slab objects which we shrunk.
  */
 unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
-			unsigned long lru_pages)
+			unsigned long lru_pages, const nodemask_t *nodes)
 {
 	struct shrinker *shrinker;
+	struct shrink_control sc;
 	unsigned long ret = 0;
 
 	if (scanned == 0)
 		scanned = SWAP_CLUSTER_MAX;
 
+	if (!nodes)
+		nodes = &node_states[N_HIGH_MEMORY];
+
 	if (!down_read_trylock(&shrinker_rwsem))
 		return 1;	/* Assume we'll be able to shrink next time */
 
+	sc.gfp_mask = gfp_mask;
 	list_for_each_entry(shrinker, &shrinker_list, list) {
-		unsigned long long delta;
-		unsigned long total_scan;
-		unsigned long max_pass = (*shrinker->shrink)(0, gfp_mask);
-
-		delta = (4 * scanned) / shrinker->seeks;
-		delta *= max_pass;
-		do_div(delta, lru_pages + 1);
-		shrinker->nr += delta;
-		if (shrinker->nr < 0) {
-			printk(KERN_ERR "shrink_slab: %pF negative objects to "
-			       "delete nr=%ld\n",
-			       shrinker->shrink, shrinker->nr);
-			shrinker->nr = max_pass;
+		if (!(shrinker->flags & SHRINKER_NUMA_AWARE)) {
+			sc.nid = -1;
+			ret += shrink_slab_node(shrinker, &sc, &shrinker->nr,
+						scanned, lru_pages);
+			continue;
 		}
 
-		/*
-		 * Avoid risking looping forever due to too large nr value:
-		 * never try to free more than twice the estimate number of
-		 * freeable entries.
-		 */
-		if (shrinker->nr > max_pass * 2)
-			shrinker->nr = max_pass * 2;
-
-		total_scan = shrinker->nr;
-		shrinker->nr = 0;
-
-		while (total_scan >= SHRINK_BATCH) {
-			long this_scan = SHRINK_BATCH;
-			int shrink_ret;
-			int nr_before;
-
-			nr_before = (*shrinker->shrink)(0, gfp_mask);
-			shrink_ret = (*shrinker->shrink)(this_scan, gfp_mask);
-			if (shrink_ret == -1)
-				break;
-			if (shrink_ret < nr_before)
-				ret += nr_before - shrink_ret;
-			count_vm_events(SLABS_SCANNED, this_scan);
-			total_scan -= this_scan;
+		for_each_node_mask(sc.nid, *nodes) {
+			long *nr = &shrinker->nr;
 
-			cond_resched();
+			if (shrinker->nr_deferred)
+				nr = &shrinker->nr_deferred[sc.nid];
+			ret += shrink_slab_node(shrinker, &sc, nr,
+						scanned, lru_pages);
 		}
-
-		shrinker->nr += total_scan;
 	}
 	up_read(&shrinker_rwsem);
 	return ret;
@@ -1127,6 +1185,10 @@ static unsigned long shrink_inactive_list(unsigned long max_scan,
 		if (current_is_kswapd()) {
 			__count_zone_vm_events(PGSCAN_KSWAPD, zone, nr_scan);
 			__count_vm_events(KSWAPD_STEAL, nr_freed);
+			__count_vm_events(KSWAPD_THREAD_SCAN_0 + sc->kswapd_id,
+					  nr_scan);
+			__count_vm_events(KSWAPD_THREAD_STEAL_0 + sc->kswapd_id,
+					  nr_freed);
 		} else if (scanning_global_lru(sc))
 			__count_zone_vm_events(PGSCAN_DIRECT, zone, nr_scan);
 
@@ -1171,6 +1233,30 @@ done:
 	return nr_reclaimed;
 }
 
+/*
+ * The kswapd threads of a node partition the evictable LRU lists of its
+ * zones: a list is only ever scanned by one of them, so that its
+ * nr_saved_scan is not updated concurrently.  Other reclaimers scan
+ * everything.
+ */
+static inline int kswapd_owns_list(struct scan_control *sc,
+				   struct zone *zone, enum lru_list l)
+{
+	if (sc->nr_kswapd <= 1)
+		return 1;
+	return (zone_idx(zone) * (LRU_ACTIVE_FILE + 1) + l) % sc->nr_kswapd ==
+		sc->kswapd_id;
+}
+
+/*
+ * The per-zone state kept by kswapd, prev_priority, is left to the
+ * thread that owns the zone's first list.
+ */
+static inline int kswapd_owns_zone(struct scan_control *sc, struct zone *zone)
+{
+	return kswapd_owns_list(sc, zone, LRU_BASE);
+}
+
 /*
  * We are about to scan this zone at a certain priority level.  If that priority
  * level is smaller (ie: more urgent) than the previous priority, then note
@@ -1525,6 +1611,7 @@ static void shrink_zone(int priority, struct zone *zone,
 	unsigned long percent[2];	/* anon @ 0; file @ 1 */
 	enum lru_list l;
 	unsigned long nr_reclaimed = sc->nr_reclaimed;
+	unsigned long nr_scanned = sc->nr_scanned;
 	unsigned long swap_cluster_max = sc->swap_cluster_max;
 	int noswap = 0;
 
@@ -1540,6 +1627,10 @@ static void shrink_zone(int priority, struct zone *zone,
 		int file = is_file_lru(l);
 		unsigned long scan;
 
+		if (!kswapd_owns_list(sc, zone, l)) {
+			nr[l] = 0;
+			continue;
+		}
 		scan = zone_nr_pages(zone, sc, l);
 		if (priority || noswap) {
 			scan >>= priority;
@@ -1577,13 +1668,19 @@ static void shrink_zone(int priority, struct zone *zone,
 			break;
 	}
 
+	/* Report the reclaim efficiency to pressure level listeners */
+	mem_cgroup_vmpressure(sc->gfp_mask, sc->mem_cgroup,
+			      sc->nr_scanned - nr_scanned,
+			      nr_reclaimed - sc->nr_reclaimed);
+
 	sc->nr_reclaimed = nr_reclaimed;
 
 	/*
 	 * Even if we did not try to evict anon pages at all, we want to
 	 * rebalance the anon lru active/inactive ratio.
 	 */
-	if (inactive_anon_is_low(zone, sc) && nr_swap_pages > 0)
+	if (kswapd_owns_list(sc, zone, LRU_ACTIVE_ANON) &&
+	    inactive_anon_is_low(zone, sc) && nr_swap_pages > 0)
 		shrink_active_list(SWAP_CLUSTER_MAX, zone, sc, priority, 0);
 
 	throttle_vm_writeout(sc->gfp_mask);
@@ -1668,6 +1765,7 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 	unsigned long total_scanned = 0;
 	struct reclaim_state *reclaim_state = current->reclaim_state;
 	unsigned long lru_pages = 0;
+	nodemask_t slab_nodes = NODE_MASK_NONE;
 	struct zoneref *z;
 	struct zone *zone;
 	enum zone_type high_zoneidx = gfp_zone(sc->gfp_mask);
@@ -1686,6 +1784,7 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 				continue;
 
 			lru_pages += zone_lru_pages(zone);
+			node_set(zone_to_nid(zone), slab_nodes);
 		}
 	}
 
@@ -1693,13 +1792,16 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		sc->nr_scanned = 0;
 		if (!priority)
 			disable_swap_token();
+		mem_cgroup_vmpressure_prio(sc->gfp_mask, sc->mem_cgroup,
+					   priority);
 		shrink_zones(priority, zonelist, sc);
 		/*
 		 * Don't shrink slabs when reclaiming memory from
 		 * over limit cgroups
 		 */
 		if (scanning_global_lru(sc)) {
-			shrink_slab(sc->nr_scanned, sc->gfp_mask, lru_pages);
+			shrink_slab(sc->nr_scanned, sc->gfp_mask, lru_pages,
+				    &slab_nodes);
 			if (reclaim_state) {
 				sc->nr_reclaimed += reclaim_state->reclaimed_slab;
 				reclaim_state->reclaimed_slab = 0;
@@ -1825,13 +1927,14 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *mem_cont,
  * interoperates with the page allocator fallback scheme to ensure that aging
  * of pages is balanced across the zones.
  */
-static unsigned long balance_pgdat(pg_data_t *pgdat, int order)
+static unsigned long balance_pgdat(pg_data_t *pgdat, int order, int id)
 {
 	int all_zones_ok;
 	int priority;
 	int i;
 	unsigned long total_scanned;
 	struct reclaim_state *reclaim_state = current->reclaim_state;
+	nodemask_t pgdat_nodes = nodemask_of_node(pgdat->node_id);
 	struct scan_control sc = {
 		.gfp_mask = GFP_KERNEL,
 		.may_unmap = 1,
@@ -1841,6 +1944,7 @@ static unsigned long balance_pgdat(pg_data_t *pgdat, int order)
 		.order = order,
 		.mem_cgroup = NULL,
 		.isolate_pages = isolate_pages_global,
+		.kswapd_id = id,
 	};
 	/*
 	 * temp_priority is used to remember the scanning priority at which
@@ -1853,6 +1957,7 @@ loop_again:
 	total_scanned = 0;
 	sc.nr_reclaimed = 0;
 	sc.may_writepage = !laptop_mode;
+	sc.nr_kswapd = ACCESS_ONCE(pgdat->nr_kswapd);
 	count_vm_event(PAGEOUTRUN);
 
 	for (i = 0; i < pgdat->nr_zones; i++)
@@ -1886,7 +1991,8 @@ loop_again:
 			 * Do some background aging of the anon list, to give
 			 * pages a chance to be referenced before reclaiming.
 			 */
-			if (inactive_anon_is_low(zone, &sc))
+			if (kswapd_owns_list(&sc, zone, LRU_ACTIVE_ANON) &&
+			    inactive_anon_is_low(zone, &sc))
 				shrink_active_list(SWAP_CLUSTER_MAX, zone,
 							&sc, priority, 0);
 
@@ -1930,7 +2036,8 @@ loop_again:
 				all_zones_ok = 0;
 			temp_priority[i] = priority;
 			sc.nr_scanned = 0;
-			note_zone_scanning_priority(zone, priority);
+			if (kswapd_owns_zone(&sc, zone))
+				note_zone_scanning_priority(zone, priority);
 			/*
 			 * We put equal pressure on every zone, unless one
 			 * zone has way too many pages free already.
@@ -1940,7 +2047,7 @@ loop_again:
 				shrink_zone(priority, zone, &sc);
 			reclaim_state->reclaimed_slab = 0;
 			nr_slab = shrink_slab(sc.nr_scanned, GFP_KERNEL,
-						lru_pages);
+						lru_pages, &pgdat_nodes);
 			sc.nr_reclaimed += reclaim_state->reclaimed_slab;
 			total_scanned += sc.nr_scanned;
 			if (zone_is_all_unreclaimable(zone))
@@ -1985,7 +2092,8 @@ out:
 	for (i = 0; i < pgdat->nr_zones; i++) {
 		struct zone *zone = pgdat->node_zones + i;
 
-		zone->prev_priority = temp_priority[i];
+		if (kswapd_owns_zone(&sc, zone))
+			zone->prev_priority = temp_priority[i];
 	}
 	if (!all_zones_ok) {
 		cond_resched();
@@ -2009,6 +2117,13 @@ out:
 		if (sc.nr_reclaimed < SWAP_CLUSTER_MAX)
 			order = sc.order = 0;
 
+		/*
+		 * A kswapd thread whose lists are all empty has nothing to
+		 * do until the other threads of the node make progress.
+		 */
+		if (sc.nr_kswapd > 1 && !total_scanned)
+			congestion_wait(BLK_RW_ASYNC, HZ/10);
+
 		goto loop_again;
 	}
 
@@ -2027,6 +2142,9 @@ out:
  *
  * If there are applications that are active memory-allocators
  * (most normal use), this basically shouldn't matter.
+ *
+ * A node can have up to MAX_KSWAPD_THREADS of them, all woken together,
+ * which partition the LRU lists of the node's zones between them.
  */
 static int kswapd(void *p)
 {
@@ -2034,6 +2152,7 @@ static int kswapd(void *p)
 	pg_data_t *pgdat = (pg_data_t*)p;
 	struct task_struct *tsk = current;
 	DEFINE_WAIT(wait);
+	int id;
 	struct reclaim_state reclaim_state = {
 		.reclaimed_slab = 0,
 	};
@@ -2060,8 +2179,14 @@ static int kswapd(void *p)
 	tsk->flags |= PF_MEMALLOC | PF_SWAPWRITE | PF_KSWAPD;
 	set_freezable();
 
+	/* kswapd_start_thread() fills in our slot before waking us */
+	for (id = 0; id < MAX_KSWAPD_THREADS; id++)
+		if (pgdat->kswapd[id] == tsk)
+			break;
+	BUG_ON(id == MAX_KSWAPD_THREADS);
+
 	order = 0;
-	for ( ; ; ) {
+	while (!kthread_should_stop()) {
 		unsigned long new_order;
 
 		prepare_to_wait(&pgdat->kswapd_wait, &wait, TASK_INTERRUPTIBLE);
@@ -2074,20 +2199,24 @@ static int kswapd(void *p)
 			 */
 			order = new_order;
 		} else {
-			if (!freezing(current))
+			if (!freezing(current) && !kthread_should_stop())
 				schedule();
 
 			order = pgdat->kswapd_max_order;
 		}
 		finish_wait(&pgdat->kswapd_wait, &wait);
 
+		if (kthread_should_stop())
+			break;
+
 		if (!try_to_freeze()) {
 			/* We can speed up thawing tasks if we don't call
 			 * balance_pgdat after returning from the refrigerator
 			 */
-			balance_pgdat(pgdat, order);
+			balance_pgdat(pgdat, order, id);
 		}
 	}
+	tsk->reclaim_state = NULL;
 	return 0;
 }
 
@@ -2195,7 +2324,7 @@ unsigned long shrink_all_memory(unsigned long nr_pages)
 	/* If slab caches are huge, it's better to hit them first */
 	while (nr_slab >= lru_pages) {
 		reclaim_state.reclaimed_slab = 0;
-		shrink_slab(nr_pages, sc.gfp_mask, lru_pages);
+		shrink_slab(nr_pages, sc.gfp_mask, lru_pages, NULL);
 		if (!reclaim_state.reclaimed_slab)
 			break;
 
@@ -2232,7 +2361,7 @@ unsigned long shrink_all_memory(unsigned long nr_pages)
 
 			reclaim_state.reclaimed_slab = 0;
 			shrink_slab(sc.nr_scanned, sc.gfp_mask,
-					global_lru_pages());
+					global_lru_pages(), NULL);
 			sc.nr_reclaimed += reclaim_state.reclaimed_slab;
 			if (sc.nr_reclaimed >= nr_pages)
 				goto out;
@@ -2249,7 +2378,8 @@ unsigned long shrink_all_memory(unsigned long nr_pages)
 	if (!sc.nr_reclaimed) {
 		do {
 			reclaim_state.reclaimed_slab = 0;
-			shrink_slab(nr_pages, sc.gfp_mask, global_lru_pages());
+			shrink_slab(nr_pages, sc.gfp_mask, global_lru_pages(),
+				    NULL);
 			sc.nr_reclaimed += reclaim_state.reclaimed_slab;
 		} while (sc.nr_reclaimed < nr_pages &&
 				reclaim_state.reclaimed_slab > 0);
@@ -2263,6 +2393,13 @@ out:
 }
 #endif /* CONFIG_HIBERNATION */
 
+/*
+ * kswapd threads per node, see kswapd_threads_store().  The lock also
+ * protects the kswapd[] and nr_kswapd of every node.
+ */
+static int kswapd_threads = 1;
+static DEFINE_MUTEX(kswapd_threads_lock);
+
 /* It's optimal to keep kswapds on the same CPUs as their memory, but
    not required for correctness.  So if the last cpu in a node goes
    away, we get changed to run anywhere: as the first one comes back,
@@ -2279,14 +2416,62 @@ static int __devinit cpu_callback(struct notifier_block *nfb,
 
 			mask = cpumask_of_node(pgdat->node_id);
 
-			if (cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids)
+			if (cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids) {
+				int id;
+
 				/* One of our CPUs online: restore mask */
-				set_cpus_allowed_ptr(pgdat->kswapd, mask);
+				mutex_lock(&kswapd_threads_lock);
+				for (id = 0; id < pgdat->nr_kswapd; id++)
+					set_cpus_allowed_ptr(pgdat->kswapd[id],
+							     mask);
+				mutex_unlock(&kswapd_threads_lock);
+			}
 		}
 	}
 	return NOTIFY_OK;
 }
 
+static int kswapd_start_thread(pg_data_t *pgdat, int id)
+{
+	struct task_struct *tsk;
+
+	if (id)
+		tsk = kthread_create(kswapd, pgdat, "kswapd%d:%d",
+				     pgdat->node_id, id);
+	else
+		tsk = kthread_create(kswapd, pgdat, "kswapd%d",
+				     pgdat->node_id);
+	if (IS_ERR(tsk))
+		return PTR_ERR(tsk);
+
+	pgdat->kswapd[id] = tsk;
+	pgdat->nr_kswapd = id + 1;
+	wake_up_process(tsk);
+	return 0;
+}
+
+/*
+ * Bring the kswapd threads of @pgdat to kswapd_threads, or as close to it
+ * as we can.  Called with kswapd_threads_lock held.
+ */
+static int kswapd_adjust_threads(pg_data_t *pgdat)
+{
+	int err = 0;
+
+	while (pgdat->nr_kswapd < kswapd_threads) {
+		err = kswapd_start_thread(pgdat, pgdat->nr_kswapd);
+		if (err)
+			break;
+	}
+	while (pgdat->nr_kswapd > kswapd_threads) {
+		int id = --pgdat->nr_kswapd;
+
+		kthread_stop(pgdat->kswapd[id]);
+		pgdat->kswapd[id] = NULL;
+	}
+	return err;
+}
+
 /*
  * This kswapd start function will be called by init and node-hot-add.
  * On node-hot-add, kswapd will moved to proper cpus if cpus are hot-added.
@@ -2296,19 +2481,53 @@ int kswapd_run(int nid)
 	pg_data_t *pgdat = NODE_DATA(nid);
 	int ret = 0;
 
-	if (pgdat->kswapd)
-		return 0;
-
-	pgdat->kswapd = kthread_run(kswapd, pgdat, "kswapd%d", nid);
-	if (IS_ERR(pgdat->kswapd)) {
+	mutex_lock(&kswapd_threads_lock);
+	if (kswapd_adjust_threads(pgdat) && !pgdat->nr_kswapd) {
 		/* failure at boot is fatal */
 		BUG_ON(system_state == SYSTEM_BOOTING);
 		printk("Failed to start kswapd on node %d\n",nid);
 		ret = -1;
 	}
+	mutex_unlock(&kswapd_threads_lock);
 	return ret;
 }
 
+#ifdef CONFIG_SYSFS
+static ssize_t kswapd_threads_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", kswapd_threads);
+}
+
+static ssize_t kswapd_threads_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	unsigned long val;
+	int nid, err = 0;
+
+	if (strict_strtoul(buf, 10, &val))
+		return -EINVAL;
+	if (val < 1 || val > MAX_KSWAPD_THREADS)
+		return -EINVAL;
+
+	mutex_lock(&kswapd_threads_lock);
+	kswapd_threads = val;
+	for_each_node_state(nid, N_HIGH_MEMORY) {
+		int ret = kswapd_adjust_threads(NODE_DATA(nid));
+
+		if (ret)
+			err = ret;
+	}
+	mutex_unlock(&kswapd_threads_lock);
+
+	return err ? err : count;
+}
+
+static struct kobj_attribute kswapd_threads_attr =
+	__ATTR(kswapd_threads, 0644, kswapd_threads_show, kswapd_threads_store);
+#endif
+
 static int __init kswapd_init(void)
 {
 	int nid;
@@ -2317,6 +2536,10 @@ static int __init kswapd_init(void)
 	for_each_node_state(nid, N_HIGH_MEMORY)
  		kswapd_run(nid);
 	hotcpu_notifier(cpu_callback, 0);
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_file(mm_kobj, &kswapd_threads_attr.attr))
+		printk(KERN_ERR "kswapd: register sysfs failed\n");
+#endif
 	return 0;
 }
 
@@ -2418,6 +2641,7 @@ static int __zone_reclaim(struct zone *zone, gfp_t gfp_mask, unsigned int order)
 		.order = order,
 		.isolate_pages = isolate_pages_global,
 	};
+	nodemask_t zone_nodes = nodemask_of_node(zone_to_nid(zone));
 	unsigned long slab_reclaimable;
 
 	disable_swap_token();
@@ -2453,10 +2677,11 @@ static int __zone_reclaim(struct zone *zone, gfp_t gfp_mask, unsigned int order)
 		 * by the same nr_pages that we used for reclaiming unmapped
 		 * pages.
 		 *
-		 * Note that shrink_slab will free memory on all zones and may
-		 * take a long time.
+		 * Note that shrink_slab will free memory on all zones of the
+		 * node and may take a long time.
 		 */
-		while (shrink_slab(sc.nr_scanned, gfp_mask, order) &&
+		while (shrink_slab(sc.nr_scanned, gfp_mask, order,
+				   &zone_nodes) &&
 			zone_page_state(zone, NR_SLAB_RECLAIMABLE) >
 				slab_reclaimable - nr_pages)
 			;
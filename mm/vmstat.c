@@ -622,6 +622,9 @@ static const struct file_operations pagetypeinfo_file_ops = {
 #define TEXTS_FOR_ZONES(xx) TEXT_FOR_DMA(xx) TEXT_FOR_DMA32(xx) xx "_normal", \
 					TEXT_FOR_HIGHMEM(xx) xx "_movable",
 
+#define TEXTS_FOR_KSWAPD_THREADS(xx) xx "0", xx "1", xx "2", xx "3", \
+					xx "4", xx "5", xx "6", xx "7",
+
 static const char * const vmstat_text[] = {
 	/* Zoned VM counters */
 	"nr_free_pages",
@@ -684,9 +687,19 @@ static const char * const vmstat_text[] = {
 	"allocstall",
 
 	"pgrotated",
+
+	TEXTS_FOR_KSWAPD_THREADS("kswapd_scan")
+	TEXTS_FOR_KSWAPD_THREADS("kswapd_steal")
+
 #ifdef CONFIG_HUGETLB_PAGE
 	"htlb_buddy_alloc_success",
 	"htlb_buddy_alloc_fail",
+#endif
+#ifdef CONFIG_SHMEM_HUGEPAGE
+	"shmem_huge_alloc",
+	"shmem_huge_fallback",
+	"shmem_huge_mapped",
+	"shmem_huge_split",
 #endif
 	"unevictable_pgs_culled",
 	"unevictable_pgs_scanned",
@@ -0,0 +1,488 @@
+/*
+ *  linux/mm/zcache.c
+ *
+ *  A cleancache backend keeping evicted page cache pages LZO compressed
+ *  in kernel memory.
+ *
+ *  Each filesystem gets a pool, holding an rbtree of the inodes it has
+ *  pages of, each with a radix tree of its compressed pages by index.
+ *  All compressed pages are also on one LRU list, which is trimmed when
+ *  the compressed data exceeds max_bytes, and by a shrinker when memory
+ *  gets short.  Everything is under one lock, taken with interrupts off:
+ *  pages are put from __remove_from_page_cache() under the tree_lock.
+ */
+
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/rbtree.h>
+#include <linux/radix-tree.h>
+#include <linux/highmem.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
+#include <linux/swap.h>
+#include <linux/lzo.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/cleancache.h>
+
+#define ZCACHE_MAX_POOLS	32
+
+/* Pages compressing worse than this are not worth keeping */
+#define ZCACHE_MAX_LEN		(PAGE_SIZE * 3 / 4)
+
+struct zcache_pool {
+	struct rb_root objs;		/* zcache_obj by inode number */
+};
+
+/* The pages of one inode */
+struct zcache_obj {
+	struct rb_node rb_node;
+	ino_t ino;
+	struct radix_tree_root pages;	/* zcache_page by index */
+	unsigned long nr_pages;
+	struct zcache_pool *pool;
+};
+
+struct zcache_page {
+	struct list_head lru;
+	struct zcache_obj *obj;
+	pgoff_t index;
+	size_t len;
+	unsigned char data[0];		/* LZO compressed */
+};
+
+static DEFINE_SPINLOCK(zcache_lock);
+static struct zcache_pool *zcache_pools[ZCACHE_MAX_POOLS];
+static LIST_HEAD(zcache_lru);
+
+/* All under zcache_lock */
+static unsigned long zcache_max_bytes;
+static unsigned long zcache_bytes;
+static unsigned long zcache_pages;
+static unsigned long zcache_evicted;
+static unsigned long zcache_rejected;
+
+/* Compression buffers, used with interrupts disabled */
+static DEFINE_PER_CPU(void *, zcache_workmem);
+static DEFINE_PER_CPU(unsigned char *, zcache_dstmem);
+
+static struct zcache_obj *zcache_obj_find(struct zcache_pool *pool,
+					  ino_t ino)
+{
+	struct rb_node *node = pool->objs.rb_node;
+
+	while (node) {
+		struct zcache_obj *obj;
+
+		obj = rb_entry(node, struct zcache_obj, rb_node);
+		if (ino < obj->ino)
+			node = node->rb_left;
+		else if (ino > obj->ino)
+			node = node->rb_right;
+		else
+			return obj;
+	}
+	return NULL;
+}
+
+static struct zcache_obj *zcache_obj_get(struct zcache_pool *pool, ino_t ino)
+{
+	struct rb_node **link = &pool->objs.rb_node;
+	struct rb_node *parent = NULL;
+	struct zcache_obj *obj;
+
+	while (*link) {
+		parent = *link;
+		obj = rb_entry(parent, struct zcache_obj, rb_node);
+		if (ino < obj->ino)
+			link = &parent->rb_left;
+		else if (ino > obj->ino)
+			link = &parent->rb_right;
+		else
+			return obj;
+	}
+
+	obj = kmalloc(sizeof(*obj), GFP_ATOMIC | __GFP_NOWARN);
+	if (!obj)
+		return NULL;
+	obj->ino = ino;
+	INIT_RADIX_TREE(&obj->pages, GFP_ATOMIC | __GFP_NOWARN);
+	obj->nr_pages = 0;
+	obj->pool = pool;
+	rb_link_node(&obj->rb_node, parent, link);
+	rb_insert_color(&obj->rb_node, &pool->objs);
+	return obj;
+}
+
+/* Unlink a page from its inode and the LRU, and free the inode if empty */
+static void zcache_page_remove(struct zcache_page *zp)
+{
+	struct zcache_obj *obj = zp->obj;
+
+	radix_tree_delete(&obj->pages, zp->index);
+	list_del(&zp->lru);
+	zcache_bytes -= zp->len;
+	zcache_pages--;
+	if (--obj->nr_pages == 0) {
+		rb_erase(&obj->rb_node, &obj->pool->objs);
+		kfree(obj);
+	}
+}
+
+static void zcache_page_free(struct zcache_page *zp)
+{
+	zcache_page_remove(zp);
+	kfree(zp);
+}
+
+static struct zcache_page *zcache_page_find(int pool_id, ino_t ino,
+					    pgoff_t index)
+{
+	struct zcache_pool *pool;
+	struct zcache_obj *obj;
+
+	if (pool_id < 0 || pool_id >= ZCACHE_MAX_POOLS)
+		return NULL;
+	pool = zcache_pools[pool_id];
+	if (!pool)
+		return NULL;
+	obj = zcache_obj_find(pool, ino);
+	if (!obj)
+		return NULL;
+	return radix_tree_lookup(&obj->pages, index);
+}
+
+static void zcache_obj_free(struct zcache_obj *obj)
+{
+	unsigned long left = obj->nr_pages;
+	struct zcache_page *batch[16];
+	unsigned int i, nr;
+
+	/* The obj goes away with its last page: don't touch it after that */
+	while (left) {
+		nr = radix_tree_gang_lookup(&obj->pages, (void **)batch, 0,
+					    ARRAY_SIZE(batch));
+		if (WARN_ON_ONCE(!nr))
+			break;
+		left -= nr;
+		for (i = 0; i < nr; i++)
+			zcache_page_free(batch[i]);
+	}
+}
+
+/* Drop the oldest pages until there are @bytes of room below the limit */
+static void zcache_evict(unsigned long bytes, unsigned long nr_to_scan)
+{
+	while (!list_empty(&zcache_lru) &&
+	       (zcache_bytes + bytes > zcache_max_bytes || nr_to_scan)) {
+		struct zcache_page *zp;
+
+		zp = list_entry(zcache_lru.prev, struct zcache_page, lru);
+		zcache_page_free(zp);
+		zcache_evicted++;
+		if (nr_to_scan)
+			nr_to_scan--;
+	}
+}
+
+static int zcache_init_fs(size_t pagesize)
+{
+	struct zcache_pool *pool;
+	unsigned long flags;
+	int i;
+
+	if (pagesize != PAGE_SIZE)
+		return -1;
+	pool = kmalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return -1;
+	pool->objs = RB_ROOT;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	for (i = 0; i < ZCACHE_MAX_POOLS; i++) {
+		if (!zcache_pools[i]) {
+			zcache_pools[i] = pool;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&zcache_lock, flags);
+
+	if (i == ZCACHE_MAX_POOLS) {
+		kfree(pool);
+		return -1;
+	}
+	return i;
+}
+
+static int zcache_get_page(int pool_id, ino_t ino, pgoff_t index,
+			   struct page *page)
+{
+	struct zcache_page *zp;
+	unsigned long flags;
+	size_t len = PAGE_SIZE;
+	void *dst;
+	int ret;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	zp = zcache_page_find(pool_id, ino, index);
+	if (zp)
+		zcache_page_remove(zp);
+	spin_unlock_irqrestore(&zcache_lock, flags);
+	if (!zp)
+		return -1;
+
+	dst = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_decompress_safe(zp->data, zp->len, dst, &len);
+	kunmap_atomic(dst, KM_USER0);
+	flush_dcache_page(page);
+	kfree(zp);
+
+	if (WARN_ON_ONCE(ret != LZO_E_OK || len != PAGE_SIZE))
+		return -1;
+	return 0;
+}
+
+static void zcache_put_page(int pool_id, ino_t ino, pgoff_t index,
+			    struct page *page)
+{
+	struct zcache_page *zp, *old;
+	struct zcache_pool *pool;
+	struct zcache_obj *obj;
+	unsigned char *dst;
+	unsigned long flags;
+	size_t len;
+	void *src;
+	int ret;
+
+	local_irq_save(flags);
+	dst = __get_cpu_var(zcache_dstmem);
+	src = kmap_atomic(page, KM_USER0);
+	ret = lzo1x_1_compress(src, PAGE_SIZE, dst, &len,
+			       __get_cpu_var(zcache_workmem));
+	kunmap_atomic(src, KM_USER0);
+
+	zp = NULL;
+	if (ret == LZO_E_OK && len <= ZCACHE_MAX_LEN)
+		zp = kmalloc(sizeof(*zp) + len,
+			     GFP_ATOMIC | __GFP_NORETRY | __GFP_NOWARN);
+	if (zp) {
+		memcpy(zp->data, dst, len);
+		zp->index = index;
+		zp->len = len;
+	}
+
+	spin_lock(&zcache_lock);
+	/* Whatever happens to the new copy, an old one is stale now */
+	old = zcache_page_find(pool_id, ino, index);
+	if (old)
+		zcache_page_free(old);
+	if (!zp || len > zcache_max_bytes)
+		goto reject;
+
+	pool = NULL;
+	if (pool_id >= 0 && pool_id < ZCACHE_MAX_POOLS)
+		pool = zcache_pools[pool_id];
+	obj = pool ? zcache_obj_get(pool, ino) : NULL;
+	if (!obj)
+		goto reject;
+	if (radix_tree_insert(&obj->pages, index, zp)) {
+		if (!obj->nr_pages) {
+			rb_erase(&obj->rb_node, &pool->objs);
+			kfree(obj);
+		}
+		goto reject;
+	}
+	zp->obj = obj;
+	obj->nr_pages++;
+	zcache_evict(len, 0);
+	list_add(&zp->lru, &zcache_lru);
+	zcache_bytes += len;
+	zcache_pages++;
+	spin_unlock(&zcache_lock);
+	local_irq_restore(flags);
+	return;
+
+reject:
+	zcache_rejected++;
+	spin_unlock(&zcache_lock);
+	local_irq_restore(flags);
+	kfree(zp);
+}
+
+static void zcache_flush_page(int pool_id, ino_t ino, pgoff_t index)
+{
+	struct zcache_page *zp;
+	unsigned long flags;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	zp = zcache_page_find(pool_id, ino, index);
+	if (zp)
+		zcache_page_free(zp);
+	spin_unlock_irqrestore(&zcache_lock, flags);
+}
+
+static void zcache_flush_inode(int pool_id, ino_t ino)
+{
+	struct zcache_pool *pool;
+	struct zcache_obj *obj;
+	unsigned long flags;
+
+	if (pool_id < 0 || pool_id >= ZCACHE_MAX_POOLS)
+		return;
+	spin_lock_irqsave(&zcache_lock, flags);
+	pool = zcache_pools[pool_id];
+	obj = pool ? zcache_obj_find(pool, ino) : NULL;
+	if (obj)
+		zcache_obj_free(obj);
+	spin_unlock_irqrestore(&zcache_lock, flags);
+}
+
+static void zcache_flush_fs(int pool_id)
+{
+	struct zcache_pool *pool;
+	struct rb_node *node;
+	unsigned long flags;
+
+	if (pool_id < 0 || pool_id >= ZCACHE_MAX_POOLS)
+		return;
+	spin_lock_irqsave(&zcache_lock, flags);
+	pool = zcache_pools[pool_id];
+	zcache_pools[pool_id] = NULL;
+	if (pool) {
+		while ((node = rb_first(&pool->objs)) != NULL) {
+			zcache_obj_free(rb_entry(node, struct zcache_obj,
+						 rb_node));
+		}
+	}
+	spin_unlock_irqrestore(&zcache_lock, flags);
+	kfree(pool);
+}
+
+static struct cleancache_ops zcache_ops = {
+	.init_fs	= zcache_init_fs,
+	.get_page	= zcache_get_page,
+	.put_page	= zcache_put_page,
+	.flush_page	= zcache_flush_page,
+	.flush_inode	= zcache_flush_inode,
+	.flush_fs	= zcache_flush_fs,
+};
+
+/* Give the compressed pages back under memory pressure, oldest first */
+static int zcache_shrink(struct shrinker *shrink, struct shrink_control *sc)
+{
+	unsigned long flags;
+	int nr;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	if (sc->nr_to_scan)
+		zcache_evict(0, sc->nr_to_scan);
+	nr = zcache_pages;
+	spin_unlock_irqrestore(&zcache_lock, flags);
+	return nr;
+}
+
+static struct shrinker zcache_shrinker = {
+	.shrink = zcache_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+#ifdef CONFIG_SYSFS
+
+#define ZCACHE_ATTR_RO(_name)						\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%lu\n", zcache_##_name);			\
+}									\
+static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+
+ZCACHE_ATTR_RO(bytes);
+ZCACHE_ATTR_RO(pages);
+ZCACHE_ATTR_RO(evicted);
+ZCACHE_ATTR_RO(rejected);
+
+static ssize_t max_bytes_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", zcache_max_bytes);
+}
+
+static ssize_t max_bytes_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	unsigned long max, flags;
+	int err;
+
+	err = strict_strtoul(buf, 10, &max);
+	if (err)
+		return -EINVAL;
+
+	spin_lock_irqsave(&zcache_lock, flags);
+	zcache_max_bytes = max;
+	zcache_evict(0, 0);
+	spin_unlock_irqrestore(&zcache_lock, flags);
+	return count;
+}
+static struct kobj_attribute max_bytes_attr =
+	__ATTR(max_bytes, 0644, max_bytes_show, max_bytes_store);
+
+static struct attribute *zcache_attrs[] = {
+	&max_bytes_attr.attr,
+	&bytes_attr.attr,
+	&pages_attr.attr,
+	&evicted_attr.attr,
+	&rejected_attr.attr,
+	NULL,
+};
+
+static struct attribute_group zcache_attr_group = {
+	.attrs = zcache_attrs,
+	.name = "zcache",
+};
+
+#endif /* CONFIG_SYSFS */
+
+static int __init zcache_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		void *wmem = vmalloc(LZO1X_MEM_COMPRESS);
+		void *dst = (void *)__get_free_pages(GFP_KERNEL, 1);
+
+		if (!wmem || !dst) {
+			printk(KERN_ERR "zcache: can't allocate buffers\n");
+			vfree(wmem);
+			free_pages((unsigned long)dst, 1);
+			goto out_free;
+		}
+		per_cpu(zcache_workmem, cpu) = wmem;
+		per_cpu(zcache_dstmem, cpu) = dst;
+	}
+
+	/* By default, up to a tenth of memory in compressed pages */
+	zcache_max_bytes = (totalram_pages / 10) << PAGE_SHIFT;
+
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_group(mm_kobj, &zcache_attr_group))
+		printk(KERN_ERR "zcache: register sysfs failed\n");
+#endif
+	register_shrinker(&zcache_shrinker);
+	if (cleancache_register_ops(&zcache_ops))
+		printk(KERN_ERR "zcache: another cleancache backend is "
+		       "registered\n");
+	return 0;
+
+out_free:
+	for_each_possible_cpu(cpu) {
+		vfree(per_cpu(zcache_workmem, cpu));
+		free_pages((unsigned long)per_cpu(zcache_dstmem, cpu), 1);
+		per_cpu(zcache_workmem, cpu) = NULL;
+		per_cpu(zcache_dstmem, cpu) = NULL;
+	}
+	return -ENOMEM;
+}
+module_init(zcache_init);